@@ -0,0 +1,528 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * aqdconvert.c : Converter for Aquadopp .AQD files
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Convert the .AQD files saved by downloadAquadoppFiles() into
+ *  per-beam velocity, amplitude, pressure and tilt tables.
+ *
+ *  usage: aqdconvert [-d] [-f csv|bin] [-j jobs] [-n cast] [-o dir]
+ *                    file.AQD ...
+ *
+ *  Each input file is memory mapped and walked structure by
+ *  structure with decodeAquadoppStructure().  Structures which
+ *  fail their checksum are counted and skipped by searching for
+ *  the next sync byte.  Profile records produce one row per
+ *  cell, single point records a single row with cell 1.  The
+ *  cast number is taken from the file name ( <prefix>NNNN.AQD or
+ *  <prefix>NNNN_NN.AQD ) unless given with -n.
+ *
+ *  The output is written next to the input ( or into dir ) as
+ *  <name>_aqd.csv or <name>_aqd.bin.  The binary layout follows
+ *  the CTD stream files ( host byte order ):
+ *
+ *     struct aqdConvertHeader
+ *     block 0: uint32_t numRows
+ *              double   time[numRows]      ( secs since the epoch )
+ *              float    column[numRows]    ( for each remaining column )
+ *     block 1: ...
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "general.h"
+#include "orcad.h"
+#include "log.h"
+#include "aquadopp.h"
+#include "aqddecode.h"
+
+#define CONVERT_BLOCKROWS   1024
+#define CONVERT_COLNAMELEN  16
+#define CONVERT_MAXJOBS     64
+#define CONVERT_MAGIC       "ORCAAQD"
+#define CONVERT_VERSION     1
+
+enum convertFormats { FORMAT_CSV, FORMAT_BIN };
+
+// Column indexes ( time is stored as a double, the rest as floats )
+enum aqdColumns { AQDCOL_TIME, AQDCOL_CELL, AQDCOL_HEADING, AQDCOL_PITCH,
+                  AQDCOL_ROLL, AQDCOL_PRESSURE, AQDCOL_TEMPERATURE,
+                  AQDCOL_BATTERY, AQDCOL_VEL1, AQDCOL_AMP1 = AQDCOL_VEL1 +
+                  AQD_MAXBEAMS, AQDCOL_NUM = AQDCOL_AMP1 + AQD_MAXBEAMS };
+
+static const char *aqdColumnNames[AQDCOL_NUM] = {
+  "time", "cell", "heading_deg", "pitch_deg", "roll_deg", "pressure_db",
+  "temp_c", "battery_v", "vel1_ms", "vel2_ms", "vel3_ms", "amp1", "amp2",
+  "amp3" };
+
+struct aqdConvertHeader {
+  char magic[8];
+  uint32_t version;
+  int32_t castNum;
+  uint32_t numColumns;
+  char columnNames[AQDCOL_NUM][CONVERT_COLNAMELEN];
+}__attribute__ ((packed));
+
+//
+// Per-file conversion state.  Rows are gathered column by
+// column and written a block at a time.
+//
+struct convertBlock {
+  long castNum;
+  uint32_t numRows;
+  double time[CONVERT_BLOCKROWS];
+  float column[AQDCOL_NUM][CONVERT_BLOCKROWS];
+  struct aqdDecoder dec;
+  struct aqdRecord rec;
+};
+
+static int outputFormat = FORMAT_CSV;
+static int includeDiagnostics = 0;
+static long forcedCastNum = -1;
+static char *outputDir = NULL;
+static char **inputFiles;
+static int numInputFiles;
+static int nextInputFile = 0;
+static int numFailed = 0;
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+
+void usage( void );
+long convertAqdFile( char *fileName );
+
+
+//
+// NAME
+//   writeHeader - Write the CSV or binary column header
+//
+static int writeHeader ( FILE *outFile, struct convertBlock *block )
+{
+  struct aqdConvertHeader header;
+  int i;
+
+  if ( outputFormat == FORMAT_CSV )
+  {
+    fprintf( outFile, "cast" );
+    for ( i = 0; i < AQDCOL_NUM; i++ )
+      fprintf( outFile, ",%s", aqdColumnNames[i] );
+    fprintf( outFile, "\n" );
+  }else
+  {
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, CONVERT_MAGIC, strlen( CONVERT_MAGIC ) );
+    header.version = CONVERT_VERSION;
+    header.castNum = block->castNum;
+    header.numColumns = AQDCOL_NUM;
+    for ( i = 0; i < AQDCOL_NUM; i++ )
+      strncpy( header.columnNames[i], aqdColumnNames[i],
+               CONVERT_COLNAMELEN - 1 );
+    fwrite( &header, sizeof( header ), 1, outFile );
+  }
+
+  return( ferror( outFile ) ? FAILURE : SUCCESS );
+}
+
+
+//
+// NAME
+//   flushBlock - Write out the gathered rows
+//
+static int flushBlock ( FILE *outFile, struct convertBlock *block )
+{
+  uint32_t r;
+  int c;
+
+  if ( block->numRows == 0 )
+    return( SUCCESS );
+
+  if ( outputFormat == FORMAT_CSV )
+  {
+    for ( r = 0; r < block->numRows; r++ )
+    {
+      fprintf( outFile, "%ld,%.0f,%.0f", block->castNum, block->time[r],
+               block->column[AQDCOL_CELL][r] );
+      for ( c = AQDCOL_HEADING; c < AQDCOL_AMP1; c++ )
+        fprintf( outFile, ",%.4f", block->column[c][r] );
+      for ( c = AQDCOL_AMP1; c < AQDCOL_NUM; c++ )
+        fprintf( outFile, ",%.0f", block->column[c][r] );
+      fputc( '\n', outFile );
+    }
+  }else
+  {
+    fwrite( &block->numRows, sizeof( uint32_t ), 1, outFile );
+    fwrite( block->time, sizeof( double ), block->numRows, outFile );
+    for ( c = AQDCOL_CELL; c < AQDCOL_NUM; c++ )
+      fwrite( block->column[c], sizeof( float ), block->numRows, outFile );
+  }
+
+  block->numRows = 0;
+  return( ferror( outFile ) ? FAILURE : SUCCESS );
+}
+
+
+//
+// NAME
+//   addRecord - Add one row per cell of a decoded record
+//
+static int addRecord ( FILE *outFile, struct convertBlock *block )
+{
+  struct aqdRecord *rec = &block->rec;
+  uint32_t r;
+  int b, c;
+
+  if ( block->numRows + rec->nCells > CONVERT_BLOCKROWS &&
+       flushBlock( outFile, block ) < 0 )
+    return( FAILURE );
+
+  for ( c = 0; c < rec->nCells; c++ )
+  {
+    r = block->numRows++;
+    block->time[r] = rec->time;
+    block->column[AQDCOL_CELL][r] = c + 1;
+    block->column[AQDCOL_HEADING][r] = rec->heading;
+    block->column[AQDCOL_PITCH][r] = rec->pitch;
+    block->column[AQDCOL_ROLL][r] = rec->roll;
+    block->column[AQDCOL_PRESSURE][r] = rec->pressure;
+    block->column[AQDCOL_TEMPERATURE][r] = rec->temperature;
+    block->column[AQDCOL_BATTERY][r] = rec->battery;
+    for ( b = 0; b < AQD_MAXBEAMS; b++ )
+    {
+      if ( b < rec->nBeams )
+      {
+        block->column[AQDCOL_VEL1 + b][r] = rec->velocity[c][b];
+        block->column[AQDCOL_AMP1 + b][r] = rec->amplitude[c][b];
+      }else
+      {
+        block->column[AQDCOL_VEL1 + b][r] = 0.0;
+        block->column[AQDCOL_AMP1 + b][r] = 0.0;
+      }
+    }
+  }
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   getCastNumber - Pull the cast number out of a .AQD file name
+//
+// RETURNS
+//   The cast number or -1 if the name does not contain one.
+//
+static long getCastNumber ( char *fileName )
+{
+  char base[FILEPATHMAX];
+  char *ptr;
+  int len;
+
+  if ( ( ptr = strrchr( fileName, '/' ) ) != NULL )
+    fileName = ptr + 1;
+  snprintf( base, FILEPATHMAX, "%s", fileName );
+  if ( ( ptr = strrchr( base, '.' ) ) != NULL )
+    *ptr = '\0';
+
+  // Drop the _NN uniqueness suffix added by downloadAquadoppFiles
+  len = strlen( base );
+  if ( len > 3 && base[len-3] == '_' && isdigit( (int)base[len-2] ) &&
+       isdigit( (int)base[len-1] ) )
+    base[len -= 3] = '\0';
+
+  while ( len > 0 && isdigit( (int)base[len-1] ) )
+    len--;
+  if ( base[len] == '\0' )
+    return( -1 );
+  return( atol( base + len ) );
+}
+
+
+//
+// NAME
+//   getOutputFileName - Build the output name for an input file
+//
+static void getOutputFileName ( char *fileName, char *outName, int size )
+{
+  char base[FILEPATHMAX];
+  char *ptr;
+
+  if ( outputDir != NULL )
+  {
+    ptr = strrchr( fileName, '/' );
+    snprintf( base, FILEPATHMAX, "%s/%s", outputDir,
+              ( ptr ? ptr + 1 : fileName ) );
+  }else
+    snprintf( base, FILEPATHMAX, "%s", fileName );
+
+  if ( ( ptr = strrchr( base, '.' ) ) != NULL &&
+       strchr( ptr, '/' ) == NULL )
+    *ptr = '\0';
+
+  snprintf( outName, size, "%s_aqd.%s", base,
+            ( outputFormat == FORMAT_CSV ? "csv" : "bin" ) );
+}
+
+
+//
+// NAME
+//   convertAqdFile - Convert a single .AQD file
+//
+// SYNOPSIS
+//   long convertAqdFile( char *fileName );
+//
+// DESCRIPTION
+//   Map the file and decode every structure in it.  Corrupt
+//   structures are skipped by resynchronizing on the next sync
+//   byte.  Diagnostics records are only written when -d was
+//   given.
+//
+// RETURNS
+//   The number of records converted or -1 upon failure.
+//
+long convertAqdFile ( char *fileName )
+{
+  struct convertBlock *block;
+  struct stat st;
+  char outName[FILEPATHMAX + 16];
+  unsigned char *data, *next;
+  FILE *outFile = NULL;
+  long off, len, numBad = 0, numWritten = 0;
+  int fd;
+  int retValue = SUCCESS;
+
+  if ( ( fd = open( fileName, O_RDONLY ) ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "convertAqdFile(): Could not open %s: %s",
+              fileName, strerror( errno ) );
+    return( FAILURE );
+  }
+  if ( fstat( fd, &st ) < 0 || st.st_size == 0 )
+  {
+    LOGPRINT( LVL_WARN, "convertAqdFile(): %s is empty", fileName );
+    close( fd );
+    return( FAILURE );
+  }
+  data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( data == MAP_FAILED )
+  {
+    LOGPRINT( LVL_WARN, "convertAqdFile(): Could not map %s: %s",
+              fileName, strerror( errno ) );
+    return( FAILURE );
+  }
+  madvise( data, st.st_size, MADV_SEQUENTIAL );
+
+  if ( ( block = calloc( 1, sizeof( struct convertBlock ) ) ) == NULL )
+  {
+    munmap( data, st.st_size );
+    return( FAILURE );
+  }
+  initAquadoppDecoder( &block->dec );
+  block->castNum = ( forcedCastNum >= 0 ) ? forcedCastNum :
+                                            getCastNumber( fileName );
+
+  getOutputFileName( fileName, outName, sizeof( outName ) );
+  if ( ( outFile = fopen( outName, "w" ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "convertAqdFile(): Could not create %s", outName );
+    free( block );
+    munmap( data, st.st_size );
+    return( FAILURE );
+  }
+  retValue = writeHeader( outFile, block );
+
+  off = 0;
+  while ( off < st.st_size && retValue > 0 )
+  {
+    len = decodeAquadoppStructure( &block->dec, data + off,
+                                   st.st_size - off, &block->rec );
+    if ( len > 0 )
+    {
+      if ( block->rec.type != AQD_REC_NONE &&
+           ( block->rec.type != AQD_REC_DIAGNOSTIC || includeDiagnostics ) )
+      {
+        retValue = addRecord( outFile, block );
+        numWritten++;
+      }
+      off += len;
+    }else if ( len == 0 )
+    {
+      // Truncated final structure
+      numBad++;
+      break;
+    }else
+    {
+      numBad++;
+      next = memchr( data + off + 1, AQUA_SYNC, st.st_size - off - 1 );
+      off = next ? next - data : st.st_size;
+    }
+  }
+
+  if ( retValue > 0 )
+    retValue = flushBlock( outFile, block );
+  if ( fclose( outFile ) != 0 )
+    retValue = FAILURE;
+
+  if ( retValue > 0 )
+    LOGPRINT( LVL_INFO, "convertAqdFile(): %s: cast %ld, %ld records "
+              "( %ld bad, %ld skipped )", fileName, block->castNum,
+              numWritten, numBad, block->dec.numSkipped );
+  else
+    LOGPRINT( LVL_WARN, "convertAqdFile(): Failed converting %s",
+              fileName );
+
+  free( block );
+  munmap( data, st.st_size );
+  return( retValue > 0 ? numWritten : FAILURE );
+}
+
+
+//
+// NAME
+//   convertWorker - Thread body which converts queued files
+//
+static void *convertWorker ( void *arg )
+{
+  int i;
+
+  for ( ;; )
+  {
+    pthread_mutex_lock( &queueLock );
+    i = nextInputFile++;
+    pthread_mutex_unlock( &queueLock );
+    if ( i >= numInputFiles )
+      break;
+
+    if ( convertAqdFile( inputFiles[i] ) < 0 )
+    {
+      pthread_mutex_lock( &queueLock );
+      numFailed++;
+      pthread_mutex_unlock( &queueLock );
+    }
+  }
+
+  return( NULL );
+}
+
+
+int main ( int argc, char *argv[] )
+{
+  pthread_t workers[CONVERT_MAXJOBS];
+  int numJobs = 0;
+  int opt, i;
+
+  logFile = stderr;
+  progName = "aqdconvert";
+  opts.debugLevel = 3;
+
+  while ( ( opt = getopt( argc, argv, "df:j:n:o:v" ) ) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'd':
+        includeDiagnostics = 1;
+        break;
+      case 'f':
+        if ( strcmp( optarg, "csv" ) == 0 )
+          outputFormat = FORMAT_CSV;
+        else if ( strcmp( optarg, "bin" ) == 0 )
+          outputFormat = FORMAT_BIN;
+        else
+        {
+          usage();
+          exit( 1 );
+        }
+        break;
+      case 'j':
+        numJobs = atoi( optarg );
+        break;
+      case 'n':
+        forcedCastNum = atol( optarg );
+        break;
+      case 'o':
+        outputDir = optarg;
+        break;
+      case 'v':
+        opts.debugLevel = LVL_INFO;
+        break;
+      default:
+        usage();
+        exit( 1 );
+    }
+  }
+
+  if ( optind >= argc )
+  {
+    usage();
+    exit( 1 );
+  }
+  inputFiles = &argv[optind];
+  numInputFiles = argc - optind;
+
+  if ( numJobs < 1 )
+    numJobs = sysconf( _SC_NPROCESSORS_ONLN );
+  if ( numJobs < 1 )
+    numJobs = 1;
+  if ( numJobs > CONVERT_MAXJOBS )
+    numJobs = CONVERT_MAXJOBS;
+  if ( numJobs > numInputFiles )
+    numJobs = numInputFiles;
+
+  for ( i = 0; i < numJobs; i++ )
+  {
+    if ( pthread_create( &workers[i], NULL, convertWorker, NULL ) != 0 )
+    {
+      LOGPRINT( LVL_CRIT, "Could not start worker thread %d", i );
+      numJobs = i;
+      break;
+    }
+  }
+  // Nothing started...do the work here
+  if ( numJobs == 0 )
+    convertWorker( NULL );
+  for ( i = 0; i < numJobs; i++ )
+    pthread_join( workers[i], NULL );
+
+  if ( numFailed )
+    LOGPRINT( LVL_WARN, "%d of %d files failed to convert", numFailed,
+              numInputFiles );
+
+  return( numFailed ? 1 : 0 );
+}
+
+
+void usage( void )
+{
+  fprintf( stderr,
+    "usage: aqdconvert [-d] [-f csv|bin] [-j jobs] [-n cast] [-o dir] [-v] "
+    "file.AQD ...\n"
+    "  -d         : Include diagnostics records\n"
+    "  -f format  : csv ( default ) or bin\n"
+    "  -j jobs    : Number of files to convert at once ( default: "
+    "one per CPU )\n"
+    "  -n cast    : Cast number to record ( default: from the file name )\n"
+    "  -o dir     : Write the output files to dir\n"
+    "  -v         : Report each file converted\n" );
+}
@@ -0,0 +1,281 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * aqddecode.c : Aquadopp record decoder
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Every Nortek binary structure has the same framing:
+ *
+ *     uint8_t  sync       0xA5
+ *     uint8_t  id
+ *     uint16_t size       ( in 16 bit words, little endian )
+ *     ...
+ *     uint16_t checksum   0xB58C + sum of the preceding words
+ *
+ *  Aquadopp velocity ( 0x01 ), diagnostics data ( 0x80 ) and
+ *  profiler velocity ( 0x21 ) records share a 30 byte header:
+ *
+ *     offset  4  clock[6]      BCD min, sec, day, hour, year, month
+ *     offset 10  error         int16
+ *     offset 14  battery       uint16  0.1 V
+ *     offset 16  soundSpeed    uint16  0.1 m/s
+ *     offset 18  heading       int16   0.1 deg
+ *     offset 20  pitch         int16   0.1 deg
+ *     offset 22  roll          int16   0.1 deg
+ *     offset 24  pressureMSB   uint8
+ *     offset 25  status        uint8
+ *     offset 26  pressureLSW   uint16  0.001 dbar ( with MSB )
+ *     offset 28  temperature   int16   0.01 deg C
+ *
+ *  followed by three int16 velocities and three uint8 amplitudes
+ *  for a single point record, or int16 velocity[beam][cell] and
+ *  uint8 amplitude[beam][cell] for a profile.
+ *
+ */
+#define _GNU_SOURCE     // timegm()
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include "general.h"
+#include "aquadopp.h"
+#include "aqddecode.h"
+
+#define AQD_HEADERLEN    30
+#define AQD_VELOCITYLEN  42
+
+static uint16_t getU16 ( const unsigned char *p )
+{
+  return( p[0] | ( p[1] << 8 ) );
+}
+
+static int16_t getS16 ( const unsigned char *p )
+{
+  return( (int16_t)( p[0] | ( p[1] << 8 ) ) );
+}
+
+static int bcd ( unsigned char val )
+{
+  return( ( val >> 4 ) * 10 + ( val & 0x0F ) );
+}
+
+
+//
+// NAME
+//   initAquadoppDecoder - Reset the decoder to the instrument defaults
+//
+// SYNOPSIS
+//   #include "aqddecode.h"
+//
+//   void initAquadoppDecoder( struct aqdDecoder *dec );
+//
+// DESCRIPTION
+//   Prepare dec for a new file.  Until a user configuration
+//   structure is seen the decoder assumes three beams and
+//   1 mm/s velocity resolution, which is how Aquadopps ship.
+//
+void initAquadoppDecoder ( struct aqdDecoder *dec )
+{
+  memset( dec, 0, sizeof( struct aqdDecoder ) );
+  dec->nBeams = AQD_MAXBEAMS;
+  dec->velScale = 0.001;
+}
+
+
+//
+// NAME
+//   checkAquadoppStructure - Verify one Nortek binary structure
+//
+// SYNOPSIS
+//   #include "aqddecode.h"
+//
+//   long checkAquadoppStructure( unsigned char *data, long len );
+//
+// DESCRIPTION
+//   Examine the structure starting at data ( len bytes are
+//   available ) and verify its framing and checksum.
+//
+// RETURNS
+//   The length of the structure in bytes if it is complete and
+//   the checksum matches, 0 if more than len bytes are needed
+//   to decide, and -1 if the structure is corrupt.
+//
+long checkAquadoppStructure ( unsigned char *data, long len )
+{
+  long size, i;
+  uint16_t sum = AQUA_CHECKSUM_BASE;
+
+  if ( len < 4 )
+    return( 0 );
+  if ( data[0] != AQUA_SYNC )
+    return( FAILURE );
+
+  size = getU16( data + 2 ) * 2;
+  if ( size < 6 || size > AQUA_MAXSTRUCT )
+    return( FAILURE );
+  if ( len < size )
+    return( 0 );
+
+  for ( i = 0; i < size - 2; i += 2 )
+    sum += getU16( data + i );
+  if ( sum != getU16( data + size - 2 ) )
+    return( FAILURE );
+
+  return( size );
+}
+
+
+//
+// NAME
+//   decodeHeader - Decode the fields common to all measurement records
+//
+static void decodeHeader ( const unsigned char *data, struct aqdRecord *rec )
+{
+  struct tm tm;
+
+  memset( &tm, 0, sizeof( tm ) );
+  tm.tm_min  = bcd( data[4] );
+  tm.tm_sec  = bcd( data[5] );
+  tm.tm_mday = bcd( data[6] );
+  tm.tm_hour = bcd( data[7] );
+  tm.tm_year = bcd( data[8] ) + 100;
+  tm.tm_mon  = bcd( data[9] ) - 1;
+  rec->time = (double)timegm( &tm );
+
+  rec->error       = getS16( data + 10 );
+  rec->battery     = getU16( data + 14 ) * 0.1;
+  rec->soundSpeed  = getU16( data + 16 ) * 0.1;
+  rec->heading     = getS16( data + 18 ) * 0.1;
+  rec->pitch       = getS16( data + 20 ) * 0.1;
+  rec->roll        = getS16( data + 22 ) * 0.1;
+  rec->status      = data[25];
+  rec->pressure    = ( data[24] * 65536.0 + getU16( data + 26 ) ) * 0.001;
+  rec->temperature = getS16( data + 28 ) * 0.01;
+}
+
+
+//
+// NAME
+//   decodeAquadoppStructure - Verify and decode one Nortek binary structure
+//
+// SYNOPSIS
+//   #include "aqddecode.h"
+//
+//   long decodeAquadoppStructure( struct aqdDecoder *dec,
+//                                 unsigned char *data, long len,
+//                                 struct aqdRecord *rec );
+//
+// DESCRIPTION
+//   Verify the structure at data ( see checkAquadoppStructure )
+//   and decode it.  Configuration structures update the decoder
+//   state and leave rec->type set to AQD_REC_NONE.  Velocity,
+//   diagnostics and profile records are decoded into rec.  Other
+//   structures ( diagnostics headers, wave data etc. ) are
+//   counted in dec->numSkipped.
+//
+//   A caller that gets -1 back should look for the next sync
+//   byte after data[0] and carry on from there.
+//
+// RETURNS
+//   The length of the structure in bytes, 0 if more than len
+//   bytes are needed, or -1 if the structure is corrupt.
+//
+long decodeAquadoppStructure ( struct aqdDecoder *dec, unsigned char *data,
+                               long len, struct aqdRecord *rec )
+{
+  long size;
+  int b, c, nCells;
+
+  rec->type = AQD_REC_NONE;
+  if ( ( size = checkAquadoppStructure( data, len ) ) <= 0 )
+    return( size );
+
+  switch ( data[1] )
+  {
+    case AQD_ID_USERCONFIG:
+      if ( size < (long)sizeof( struct userConfig ) )
+        break;
+      dec->nBeams = getU16( data + offsetof( struct userConfig, nBeams ) );
+      dec->nCells = getU16( data + offsetof( struct userConfig, nBins ) );
+      dec->coordSystem =
+        getU16( data + offsetof( struct userConfig, coordSystem ) );
+      // mode bit 4: velocity scaling 0=1 mm/s, 1=0.1 mm/s
+      dec->velScale =
+        ( getU16( data + offsetof( struct userConfig, mode_1 ) ) & 0x10 ) ?
+          0.0001 : 0.001;
+      if ( dec->nBeams < 1 || dec->nBeams > AQD_MAXBEAMS )
+        dec->nBeams = AQD_MAXBEAMS;
+      dec->haveConfig = 1;
+      break;
+
+    case AQD_ID_HWCONFIG:
+    case AQD_ID_HEADCONFIG:
+      break;
+
+    case AQD_ID_VELOCITY:
+    case AQD_ID_DIAGDATA:
+      if ( size < AQD_VELOCITYLEN )
+      {
+        dec->numSkipped++;
+        break;
+      }
+      decodeHeader( data, rec );
+      rec->type = ( data[1] == AQD_ID_VELOCITY ) ? AQD_REC_VELOCITY :
+                                                   AQD_REC_DIAGNOSTIC;
+      rec->nBeams = AQD_MAXBEAMS;
+      rec->nCells = 1;
+      for ( b = 0; b < AQD_MAXBEAMS; b++ )
+      {
+        rec->velocity[0][b] = getS16( data + AQD_HEADERLEN + b * 2 ) *
+                              dec->velScale;
+        rec->amplitude[0][b] = data[AQD_HEADERLEN + 6 + b];
+      }
+      dec->numRecords++;
+      break;
+
+    case AQD_ID_PROFILE:
+      // The cell count follows from the size, which also copes
+      // with files that lack their configuration block
+      nCells = ( size - AQD_HEADERLEN - 2 ) / ( 3 * dec->nBeams );
+      if ( nCells < 1 || nCells > AQD_MAXCELLS )
+      {
+        dec->numSkipped++;
+        break;
+      }
+      decodeHeader( data, rec );
+      rec->type = AQD_REC_PROFILE;
+      rec->nBeams = dec->nBeams;
+      rec->nCells = nCells;
+      for ( b = 0; b < dec->nBeams; b++ )
+        for ( c = 0; c < nCells; c++ )
+        {
+          rec->velocity[c][b] =
+            getS16( data + AQD_HEADERLEN + ( b * nCells + c ) * 2 ) *
+            dec->velScale;
+          rec->amplitude[c][b] =
+            data[AQD_HEADERLEN + dec->nBeams * nCells * 2 + b * nCells + c];
+        }
+      dec->numRecords++;
+      break;
+
+    default:
+      dec->numSkipped++;
+      break;
+  }
+
+  return( size );
+}
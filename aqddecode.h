@@ -0,0 +1,95 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * aqddecode.h : Header for the Aquadopp record decoder
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ * These routines decode the Nortek binary structures found in
+ * .AQD files ( and in the Aquadopp recorder ).  They do no I/O
+ * of their own so they may be used both by orcad and by the
+ * stand alone converters.
+ *
+ */
+#ifndef _AQDDECODE_H
+#define _AQDDECODE_H
+
+#include <stdint.h>
+
+// Largest profile the decoder will hold
+#define AQD_MAXBEAMS  3
+#define AQD_MAXCELLS  128
+
+// Structure ids
+#define AQD_ID_USERCONFIG  0x00
+#define AQD_ID_HEADCONFIG  0x04
+#define AQD_ID_HWCONFIG    0x05
+#define AQD_ID_VELOCITY    0x01
+#define AQD_ID_DIAGHEADER  0x06
+#define AQD_ID_DIAGDATA    0x80
+#define AQD_ID_PROFILE     0x21
+
+enum aqdRecordTypes { AQD_REC_NONE, AQD_REC_VELOCITY, AQD_REC_DIAGNOSTIC,
+                      AQD_REC_PROFILE };
+
+//
+// Decoder state.  The configuration structures at the start of
+// a .AQD file set the beam/cell counts and velocity scaling used
+// for the records which follow.
+//
+struct aqdDecoder {
+  int haveConfig;
+  int nBeams;
+  int nCells;
+  int coordSystem;
+  double velScale;       // m/s per velocity count
+  long numRecords;
+  long numSkipped;
+};
+
+//
+// One decoded measurement.  Profile records fill nCells cells,
+// single point records fill cell 0.
+//
+struct aqdRecord {
+  int type;
+  double time;           // secs since the epoch ( instrument clock )
+  int error;
+  int status;
+  double battery;        // volts
+  double soundSpeed;     // m/s
+  double heading;        // degrees
+  double pitch;          // degrees
+  double roll;           // degrees
+  double pressure;       // decibars
+  double temperature;    // degrees C
+  int nBeams;
+  int nCells;
+  float velocity[AQD_MAXCELLS][AQD_MAXBEAMS];    // m/s
+  uint8_t amplitude[AQD_MAXCELLS][AQD_MAXBEAMS]; // counts
+};
+
+//   initAquadoppDecoder - Reset the decoder to the instrument defaults
+void initAquadoppDecoder( struct aqdDecoder *dec );
+
+//   checkAquadoppStructure - Verify one Nortek binary structure
+long checkAquadoppStructure( unsigned char *data, long len );
+
+//   decodeAquadoppStructure - Verify and decode one Nortek binary structure
+long decodeAquadoppStructure( struct aqdDecoder *dec, unsigned char *data,
+                              long len, struct aqdRecord *rec );
+
+#endif
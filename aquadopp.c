@@ -33,9 +33,11 @@
 #include "log.h"
 #include "orcad.h"
 #include "serial.h"
+#include "term.h"
 #include "general.h"
 #include "util.h"
 #include "aquadopp.h"
+#include "aqddecode.h"
 
 
 // Useful info for time routines
@@ -106,6 +108,7 @@ int syncAquadoppTime( int aquadoppFD )
 {
   time_t now_t;
   struct tm *now_tm;
+  struct tm nowTM;
   time_t was_t;
   struct tm *was_tm;
   int timeOff = 0;
@@ -115,7 +118,7 @@ int syncAquadoppTime( int aquadoppFD )
 
   // Get the system time
   now_t = time( NULL );
-  now_tm = localtime( &now_t );
+  now_tm = localtime_r( &now_t, &nowTM );
 
 
   // Get the aquadopp time
@@ -156,7 +159,7 @@ int syncAquadoppTime( int aquadoppFD )
 
     // Get the system time
     now_t = time( NULL );
-    now_tm = localtime( &now_t );
+    now_tm = localtime_r( &now_t, &nowTM );
 
 
     // Get the aquadopp time
@@ -734,6 +737,310 @@ int clearAquadoppFAT ( int aquadoppFD )
 }
 
 
+//
+// NAME
+//   getAquadoppAddress - Decode a recorder address
+//
+// SYNOPSIS
+//   static unsigned long getAquadoppAddress( char *addr );
+//
+// DESCRIPTION
+//   Recorder addresses in the FAT ( and in the RD command )
+//   are 4 byte little endian values.
+//
+// RETURNS
+//   The address.
+//
+static unsigned long getAquadoppAddress ( char *addr )
+{
+  unsigned char *a = (unsigned char *)addr;
+
+  return( (unsigned long)a[0] | ( (unsigned long)a[1] << 8 ) |
+          ( (unsigned long)a[2] << 16 ) | ( (unsigned long)a[3] << 24 ) );
+}
+
+
+//
+// NAME
+//   putAquadoppAddress - Encode a recorder address
+//
+// SYNOPSIS
+//   static void putAquadoppAddress( char *addr, unsigned long value );
+//
+// DESCRIPTION
+//   Store value as a 4 byte little endian recorder address.
+//
+static void putAquadoppAddress ( char *addr, unsigned long value )
+{
+  addr[0] = value & 0xFF;
+  addr[1] = ( value >> 8 ) & 0xFF;
+  addr[2] = ( value >> 16 ) & 0xFF;
+  addr[3] = ( value >> 24 ) & 0xFF;
+}
+
+
+//
+// NAME
+//   readAquadoppAcks - Consume the ACK ACK ending a transfer
+//
+// SYNOPSIS
+//   static int readAquadoppAcks( int aquadoppFD );
+//
+// RETURNS
+//    1 If the ACK ACK was received
+//   -1 Otherwise
+//
+static int readAquadoppAcks ( int aquadoppFD )
+{
+  char acks[2];
+
+  if ( serialGetBlock( aquadoppFD, acks, 2, AQUA_IDLE_TIMEOUT ) == 2 &&
+       acks[0] == dblAck[0] && acks[1] == dblAck[1] )
+    return( SUCCESS );
+
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   downloadAquadoppConfig - Save the configuration for a recorder file
+//
+// SYNOPSIS
+//   static int downloadAquadoppConfig( int aquadoppFD, int FATIndex,
+//                                      FILE *fpl );
+//
+// DESCRIPTION
+//   Issue the FC command for the FAT entry FATIndex and read
+//   back the hardware, head and user configuration structures
+//   that were in effect when the file was recorded.  Each
+//   structure is checksummed before the block is written to
+//   fpl; the trailing ACK ACK is not.  The transfer is retried
+//   up to AQUA_DOWNLOAD_RETRIES times.
+//
+// RETURNS
+//    1 Upon success
+//   -1 Upon failure
+//
+static int downloadAquadoppConfig ( int aquadoppFD, int FATIndex,
+                                    FILE *fpl )
+{
+  unsigned char config[AQUA_CONFIG_LEN];
+  char cmdArr[10];
+  long bytesRead, len, off;
+  int retries = 0;
+
+  memset( cmdArr, 0, sizeof( cmdArr ) );
+  cmdArr[0] = 'F';
+  cmdArr[1] = 'C';
+  cmdArr[9] = FATIndex;
+
+  while ( retries++ < AQUA_DOWNLOAD_RETRIES )
+  {
+    if ( getAquadoppPrompt( aquadoppFD ) < 1 )
+    {
+      LOGPRINT( LVL_WARN, "downloadAquadoppConfig(): All attempts "
+                "at obtaining a command prompt failed." );
+      return( FAILURE );
+    }
+    term_flush( aquadoppFD );
+    serialPutData( aquadoppFD, cmdArr, 10 );
+
+    bytesRead = serialGetBlock( aquadoppFD, (char *)config,
+                                AQUA_CONFIG_LEN, AQUA_IDLE_TIMEOUT );
+    // Newer aquadopps echo the command ahead of the response
+    if ( bytesRead >= 2 && config[0] == 'F' && config[1] == 'C' )
+    {
+      memmove( config, config + 2, bytesRead - 2 );
+      bytesRead -= 2;
+      bytesRead += serialGetBlock( aquadoppFD, (char *)config + bytesRead,
+                                   AQUA_CONFIG_LEN - bytesRead,
+                                   AQUA_IDLE_TIMEOUT );
+    }
+    if ( bytesRead != AQUA_CONFIG_LEN )
+    {
+      LOGPRINT( LVL_WARN, "downloadAquadoppConfig(): Short configuration "
+                "block ( %ld of %d bytes ) for FAT entry %d.",
+                bytesRead, AQUA_CONFIG_LEN, FATIndex );
+      continue;
+    }
+
+    // Hardware, head and user configuration follow back to back
+    off = 0;
+    while ( off < AQUA_CONFIG_LEN &&
+            ( len = checkAquadoppStructure( config + off,
+                                            AQUA_CONFIG_LEN - off ) ) > 0 )
+      off += len;
+    if ( off != AQUA_CONFIG_LEN )
+    {
+      LOGPRINT( LVL_WARN, "downloadAquadoppConfig(): Bad configuration "
+                "structure at offset %ld for FAT entry %d.", off,
+                FATIndex );
+      continue;
+    }
+
+    if ( readAquadoppAcks( aquadoppFD ) < 1 )
+      LOGPRINT( LVL_DEBG, "downloadAquadoppConfig(): Missing ACK ACK "
+                "after configuration block." );
+
+    if ( fwrite( config, 1, AQUA_CONFIG_LEN, fpl ) != AQUA_CONFIG_LEN )
+    {
+      LOGPRINT( LVL_CRIT, "downloadAquadoppConfig(): Could not write "
+                "configuration block to the data file!" );
+      return( FAILURE );
+    }
+    return( SUCCESS );
+  }
+
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   downloadAquadoppData - Save the measurements for a recorder file
+//
+// SYNOPSIS
+//   static int downloadAquadoppData( int aquadoppFD,
+//                                    unsigned long startAddr,
+//                                    unsigned long stopAddr, FILE *fpl );
+//
+// DESCRIPTION
+//   Read the recorder memory from startAddr up to stopAddr with
+//   the RD command.  The exact number of bytes to expect is known
+//   from the addresses, so the data is read in AQUA_BLOCKLEN
+//   blocks rather than searched for an ACK ACK terminator ( which
+//   may legitimately occur inside binary data ).  Only structures
+//   which pass their checksum are written to fpl.  When a
+//   structure is corrupt, or the instrument stops sending, RD is
+//   reissued starting at the first unverified address.  The
+//   download is abandoned after AQUA_DOWNLOAD_RETRIES attempts in
+//   a row that make no progress.
+//
+//   If the range ends part way through a structure ( e.g. the
+//   instrument lost power while recording ) the partial structure
+//   is kept so the file still mirrors the recorder.
+//
+// RETURNS
+//    1 Upon success
+//   -1 Upon failure
+//
+static int downloadAquadoppData ( int aquadoppFD, unsigned long startAddr,
+                                  unsigned long stopAddr, FILE *fpl )
+{
+  static unsigned char dataBuff[AQUA_MAXSTRUCT + AQUA_BLOCKLEN];
+  char cmdArr[10];
+  unsigned long addr = startAddr;
+  long want, received, have, off, len, n;
+  ssize_t bytesRead;
+  int retries = 0;
+  int progress;
+
+  while ( addr < stopAddr && retries < AQUA_DOWNLOAD_RETRIES )
+  {
+    if ( getAquadoppPrompt( aquadoppFD ) < 1 )
+    {
+      LOGPRINT( LVL_WARN, "downloadAquadoppData(): All attempts "
+                "at obtaining a command prompt failed." );
+      return( FAILURE );
+    }
+    term_flush( aquadoppFD );
+
+    if ( addr != startAddr )
+      LOGPRINT( LVL_WARN, "downloadAquadoppData(): Resuming download "
+                "at address %lx ( %lu bytes remaining ).", addr,
+                stopAddr - addr );
+
+    cmdArr[0] = 'R';
+    cmdArr[1] = 'D';
+    putAquadoppAddress( &cmdArr[2], addr );
+    putAquadoppAddress( &cmdArr[6], stopAddr );
+    serialPutData( aquadoppFD, cmdArr, 10 );
+
+    want = stopAddr - addr;
+    received = 0;
+    have = 0;
+    len = 0;
+    progress = 0;
+    while ( received < want )
+    {
+      n = want - received;
+      if ( n > AQUA_BLOCKLEN )
+        n = AQUA_BLOCKLEN;
+      bytesRead = serialGetBlock( aquadoppFD, (char *)dataBuff + have, n,
+                                  AQUA_IDLE_TIMEOUT );
+      if ( bytesRead <= 0 )
+        break;
+      have += bytesRead;
+      received += bytesRead;
+
+      // Pass along every complete, verified structure
+      off = 0;
+      while ( ( len = checkAquadoppStructure( dataBuff + off,
+                                              have - off ) ) > 0 )
+        off += len;
+      if ( off > 0 )
+      {
+        if ( fwrite( dataBuff, 1, off, fpl ) != (size_t)off )
+        {
+          LOGPRINT( LVL_CRIT, "downloadAquadoppData(): Could not write "
+                    "to the data file!" );
+          return( FAILURE );
+        }
+        addr += off;
+        have -= off;
+        memmove( dataBuff, dataBuff + off, have );
+        progress = 1;
+      }
+      if ( len < 0 )
+      {
+        LOGPRINT( LVL_WARN, "downloadAquadoppData(): Checksum or framing "
+                  "error at address %lx.", addr );
+        break;
+      }
+    }
+
+    if ( received == want && len == 0 && have > 0 )
+    {
+      LOGPRINT( LVL_WARN, "downloadAquadoppData(): Recorder data ends "
+                "with a partial structure ( %ld bytes ) - keeping it "
+                "as is.", have );
+      if ( fwrite( dataBuff, 1, have, fpl ) != (size_t)have )
+      {
+        LOGPRINT( LVL_CRIT, "downloadAquadoppData(): Could not write "
+                  "to the data file!" );
+        return( FAILURE );
+      }
+      addr += have;
+    }
+
+    if ( addr == stopAddr )
+    {
+      if ( readAquadoppAcks( aquadoppFD ) < 1 )
+        LOGPRINT( LVL_DEBG, "downloadAquadoppData(): Missing ACK ACK "
+                  "after data block." );
+      return( SUCCESS );
+    }
+
+    if ( received < want && len >= 0 )
+      LOGPRINT( LVL_WARN, "downloadAquadoppData(): Transfer stalled "
+                "after %ld of %ld bytes.", received, want );
+
+    // Let the instrument finish sending before breaking in again
+    serialGetBlock( aquadoppFD, (char *)dataBuff,
+                    AQUA_MAXSTRUCT + AQUA_BLOCKLEN, AQUA_IDLE_TIMEOUT );
+    if ( progress )
+      retries = 0;
+    else
+      retries++;
+  }
+
+  LOGPRINT( LVL_WARN, "downloadAquadoppData(): Giving up at address %lx "
+            "after %d attempts without progress.", addr, retries );
+  return( FAILURE );
+}
+
+
 //
 // NAME
 //   downloadAquadoppFiles - Download the entire aquadopp archive
@@ -744,6 +1051,14 @@ int clearAquadoppFAT ( int aquadoppFD )
 //   int downloadAquadoppFiles( int aquadoppFD );
 //
 // DESCRIPTION
+//   Read the recorder FAT and save each non-empty file to the
+//   data directory as a .AQD file: the configuration block
+//   followed by the recorded structures, exactly as Nortek's
+//   own software writes them.  Every structure is checksummed
+//   as it arrives ( see downloadAquadoppData ) and the file is
+//   written under a temporary name until it is complete.  The
+//   recorder is only erased if every file downloaded cleanly;
+//   otherwise the data is left on the instrument to try again.
 //
 // RETURNS
 //    1 Upon success
@@ -752,14 +1067,15 @@ int clearAquadoppFAT ( int aquadoppFD )
 int downloadAquadoppFiles ( int aquadoppFD ) 
 {
   char   dataLogFile[FILEPATHMAX];
+  char   tmpLogFile[FILEPATHMAX + sizeof( CASTTMPSUFFIX )];
   int    FATIndex = 0;
   int    bytesRead = 0;
   int    retVal = 0;
   int    retries = 0;
   int    fileSuffixNum = 0;
-  char   fileBuff[129];
-  char   cmdArr[16];
-  struct aquadoppFAT buffer[32];
+  int    failed = 0;
+  unsigned long startAddr, stopAddr;
+  struct aquadoppFAT buffer[AQUA_FATENTRIES];
   struct stat statBuff;
   FILE   *fpl;
 
@@ -767,7 +1083,7 @@ int downloadAquadoppFiles ( int aquadoppFD )
   if ( getAquadoppPrompt( aquadoppFD ) < 1 )
   {
     // All attempts at obtaining a command prompt failed 
-    LOGPRINT( LVL_WARN, "clearAquadoppFAT(): All attempts "
+    LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): All attempts "
               "at obtaining a command prompt failed." );
     return( FAILURE );
   }
@@ -775,231 +1091,129 @@ int downloadAquadoppFiles ( int aquadoppFD )
   // Create/set the data directory variable.
   updateDataDir();
   
+  term_flush( aquadoppFD );
   serialPutLine( aquadoppFD, "RF" );
-  if ( serialGetLine( aquadoppFD, (char *)buffer, 
-                      sizeof( struct aquadoppFAT ) * 32, 
-                      500, dblAck ) >= 0 ) 
+  bytesRead = serialGetBlock( aquadoppFD, (char *)buffer,
+                              sizeof( buffer ), AQUA_IDLE_TIMEOUT );
+  // Newer aquadopps echo the command ahead of the response
+  if ( bytesRead >= 2 && buffer[0].filenamePrefix[0] == 'R' &&
+       buffer[0].filenamePrefix[1] == 'F' )
   {
-    while ( buffer[ FATIndex ].filenamePrefix[0] != '\0' )
+    memmove( buffer, (char *)buffer + 2, bytesRead - 2 );
+    bytesRead -= 2;
+    bytesRead += serialGetBlock( aquadoppFD, (char *)buffer + bytesRead,
+                                 sizeof( buffer ) - bytesRead,
+                                 AQUA_IDLE_TIMEOUT );
+  }
+  if ( bytesRead != sizeof( buffer ) )
+  {
+    LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Could not read Aquadopp "
+                        "FAT. Got %d of %d bytes from the RF command.",
+                        bytesRead, (int)sizeof( buffer ) );
+    return( FAILURE );
+  }
+  readAquadoppAcks( aquadoppFD );
+
+  while ( FATIndex < AQUA_FATENTRIES &&
+          buffer[ FATIndex ].filenamePrefix[0] != '\0' )
+  {
+    startAddr = getAquadoppAddress( buffer[ FATIndex ].startAddress );
+    stopAddr = getAquadoppAddress( buffer[ FATIndex ].stopAddress );
+    LOGPRINT( LVL_DEBG, "downloadAquadoppFiles(): filename = %.6s seq=%x "
+              "status=%x start=%lx end=%lx",
+              buffer[ FATIndex ].filenamePrefix, 
+              buffer[ FATIndex ].filenameSeq,
+              buffer[ FATIndex ].status, startAddr, stopAddr );
+
+    if ( stopAddr < startAddr )
     {
-      LOGPRINT( LVL_DEBG, "downloadAquadoppFiles(): filename = %s seq=%x status=%x "
-                " start= %x-%x-%x-%x end= %x-%x-%x-%x",
-                buffer[ FATIndex ].filenamePrefix, 
-                buffer[ FATIndex ].filenameSeq,
-                buffer[ FATIndex ].status,
-                buffer[ FATIndex ].startAddress[0],
-                buffer[ FATIndex ].startAddress[1],
-                buffer[ FATIndex ].startAddress[2],
-                buffer[ FATIndex ].startAddress[3],
-                buffer[ FATIndex ].stopAddress[0], 
-                buffer[ FATIndex ].stopAddress[1], 
-                buffer[ FATIndex ].stopAddress[2], 
-                buffer[ FATIndex ].stopAddress[3] );
+      LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): FAT entry %d has its "
+                "stop address ( %lx ) before its start ( %lx ) - "
+                "skipping!", FATIndex, stopAddr, startAddr );
+      failed = 1;
+    }else if ( stopAddr == startAddr )
+    {
+      LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): WARNING: Aquadop file "
+                          "has zero length ( same start/stop position ) "
+                          "skipping!" );
+    }else
+    {
+      if ( ( stopAddr - startAddr ) > 100000 )
+        LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Warning - unusually "
+                  "large aquadopp file: filename = %.6s seq=%x size=%lu",
+                  buffer[ FATIndex ].filenamePrefix,
+                  buffer[ FATIndex ].filenameSeq, stopAddr - startAddr );
 
-      long startAddr = 0;
-      long stopAddr = 0;
-      startAddr = ( (buffer[ FATIndex ].startAddress[0] << 24) | 
-                    (buffer[ FATIndex ].startAddress[1] << 16) |
-                    (buffer[ FATIndex ].startAddress[2] << 8) |
-                    (buffer[ FATIndex ].startAddress[3]) );
-      stopAddr =  ( (buffer[ FATIndex ].stopAddress[0] << 24) |
-                    (buffer[ FATIndex ].stopAddress[1] << 16) |
-                    (buffer[ FATIndex ].stopAddress[2] << 8) |
-                    (buffer[ FATIndex ].stopAddress[3]) );
+      // Open a file
+      sprintf( dataLogFile,"%s/%s%04ld.AQD", opts.dataSubDirName,
+               opts.dataFilePrefix, opts.lastCastNum );
 
-      if ( ( stopAddr - startAddr ) > 100000 )
+      while(    ( retVal = stat(dataLogFile, &statBuff ) ) == 0
+             && retries++ < 32 )
       {
-          LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Warning - unusually large aquadopp file: filename = %s seq=%x status=%x "
-                " start= %x-%x-%x-%x end= %x-%x-%x-%x size=%ld",
-                buffer[ FATIndex ].filenamePrefix, 
-                buffer[ FATIndex ].filenameSeq,
-                buffer[ FATIndex ].status,
-                buffer[ FATIndex ].startAddress[0],
-                buffer[ FATIndex ].startAddress[1],
-                buffer[ FATIndex ].startAddress[2],
-                buffer[ FATIndex ].startAddress[3],
-                buffer[ FATIndex ].stopAddress[0], 
-                buffer[ FATIndex ].stopAddress[1], 
-                buffer[ FATIndex ].stopAddress[2], 
-                buffer[ FATIndex ].stopAddress[3], ( stopAddr - startAddr ) );
+        fileSuffixNum++;
+        sprintf( dataLogFile,"%s/%s%04ld_%02d.AQD", opts.dataSubDirName,
+               opts.dataFilePrefix, opts.lastCastNum, fileSuffixNum );
       }
-      
-      if ( buffer[ FATIndex ].startAddress[0] != 
-              buffer[ FATIndex ].stopAddress[0] ||
-           buffer[ FATIndex ].startAddress[1] != 
-              buffer[ FATIndex ].stopAddress[1] ||
-           buffer[ FATIndex ].startAddress[2] != 
-              buffer[ FATIndex ].stopAddress[2] ||
-           buffer[ FATIndex ].startAddress[3] != 
-              buffer[ FATIndex ].stopAddress[3]  )
-      { 
-        // Open a file
-        sprintf( dataLogFile,"%s/%s%04ld.AQD", opts.dataSubDirName,
-                 opts.dataFilePrefix, opts.lastCastNum );
-
-        while(    ( retVal = stat(dataLogFile, &statBuff ) ) == 0
-               && retries++ < 32 )
-        {
-          fileSuffixNum++;
-          sprintf( dataLogFile,"%s/%s%04ld_%02d.AQD", opts.dataSubDirName,
-                 opts.dataFilePrefix, opts.lastCastNum, fileSuffixNum );
-        }
-        if ( retVal == 0 )
-        {
-          LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Failed to create "
-                    "a unique filename on filesystem.  Last attempt produced "
-                    "%s and it already exists!", dataLogFile );
-          return( FAILURE );
-        } 
-  
-        if((fpl = fopen(dataLogFile,"w")) == NULL)
-        {
-           LOGPRINT( LVL_CRIT, "downloadAquadoppFiles(): Could not open new "
-                    "data file = %s", dataLogFile );
-           return( FAILURE );
-        }
-  
-        LOGPRINT( LVL_ALWY, "downloadAquadoppFiles: Saving aquadopp file to "
-                  "data file = %s", dataLogFile );
-  
-  
-        LOGPRINT( LVL_DEBG, "downloadAquadoppFiles: Saving configuration " 
-                            "data.. " );
-  
-        // Clear the port
-        term_flush( aquadoppFD );
-  
-        // Normalize the Aquadopp state by getting a command prompt
-        if ( getAquadoppPrompt( aquadoppFD ) < 1 )
-        {
-          // All attempts at obtaining a command prompt failed 
-          LOGPRINT( LVL_WARN, "clearAquadoppFAT(): All attempts "
-                    "at obtaining a command prompt failed." );
-          return( FAILURE );
-        }
+      if ( retVal == 0 )
+      {
+        LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Failed to create "
+                  "a unique filename on filesystem.  Last attempt produced "
+                  "%s and it already exists!", dataLogFile );
+        return( FAILURE );
+      } 
 
-        cmdArr[0] = 'F';
-        cmdArr[1] = 'C';
-        cmdArr[2] = 0x00;
-        cmdArr[3] = 0x00;
-        cmdArr[4] = 0x00;
-        cmdArr[5] = 0x00;
-        cmdArr[6] = 0x00;
-        cmdArr[7] = 0x00;
-        cmdArr[8] = 0x00;
-        cmdArr[9] = FATIndex;
-        serialPutData( aquadoppFD, cmdArr, 10 );
-    
-        /*
-         * Timming Issues...
-        // Send the command to download a record file
-        serialPutLine( aquadoppFD, "FC" );
-        // Give it the FAT index
-        serialPutByte( aquadoppFD, 0x00 );
-        serialPutByte( aquadoppFD, 0x00 );
-        serialPutByte( aquadoppFD, 0x00 );
-        serialPutByte( aquadoppFD, 0x00 );
-        serialPutByte( aquadoppFD, 0x00 );
-        serialPutByte( aquadoppFD, 0x00 );
-        serialPutByte( aquadoppFD, 0x00 );
-        serialPutByte( aquadoppFD, FATIndex );
-        */
-  
-        // Read/write the data
-        // NOTE: Currently this leave the ACK ACK in between the data sets.
-        //       I believe this should be removed so as not to interfere
-        //       with NORTEKS conversion software.
-        int totalBytesRead = 0;
-        while ( ( bytesRead = 
-                 serialGetLine( aquadoppFD, fileBuff, 128, 500L, dblAck ) ) > 0 )
-        {
-          // if ( bytesRead > 1 )
-          // Characterize the current block
-          //if ( fileBuff[ bytesRead-1 ] == 0x06 )
-          //{
-          //  bytesRead--;
-          //  prevAcksFound = 1;
-          //}
-          //if ( fileBuff[ bytesRead-1 ] == 0x06 )
-          //{
-          //  bytesRead--;
-          //  prevAcksFound++;
-          //}
-          fwrite( fileBuff, 1, bytesRead, fpl ); 
-          totalBytesRead += bytesRead;
-        }
+      sprintf( tmpLogFile, "%s%s", dataLogFile, CASTTMPSUFFIX );
+      if((fpl = fopen(tmpLogFile,"w")) == NULL)
+      {
+         LOGPRINT( LVL_CRIT, "downloadAquadoppFiles(): Could not open new "
+                  "data file = %s", tmpLogFile );
+         return( FAILURE );
+      }
 
-        // Clear the port
-        term_flush( aquadoppFD );
-  
-        // Normalize the Aquadopp state by getting a command prompt
-        if ( getAquadoppPrompt( aquadoppFD ) < 1 )
-        {
-          // All attempts at obtaining a command prompt failed 
-          LOGPRINT( LVL_WARN, "clearAquadoppFAT(): All attempts "
-                    "at obtaining a command prompt failed." );
-          return( FAILURE );
-        }
+      LOGPRINT( LVL_ALWY, "downloadAquadoppFiles: Saving aquadopp file to "
+                "data file = %s", dataLogFile );
 
-        LOGPRINT( LVL_DEBG, "downloadAquadoppFiles: Saving measurement " 
+      LOGPRINT( LVL_DEBG, "downloadAquadoppFiles: Saving configuration " 
                           "data.. " );
+      retVal = downloadAquadoppConfig( aquadoppFD, FATIndex, fpl );
 
-        cmdArr[0] = 'R';
-        cmdArr[1] = 'D';
-        cmdArr[2] = buffer[ FATIndex ].startAddress[0];
-        cmdArr[3] = buffer[ FATIndex ].startAddress[1];
-        cmdArr[4] = buffer[ FATIndex ].startAddress[2];
-        cmdArr[5] = buffer[ FATIndex ].startAddress[3];
-        cmdArr[6] = buffer[ FATIndex ].stopAddress[0];
-        cmdArr[7] = buffer[ FATIndex ].stopAddress[1];
-        cmdArr[8] = buffer[ FATIndex ].stopAddress[2];
-        cmdArr[9] = buffer[ FATIndex ].stopAddress[3];
-        serialPutData( aquadoppFD, cmdArr, 10 );
- 
-        /*
-         * Timming Issues...
-        // Send the command to download a record file
-        serialPutLine( aquadoppFD, "RD" );
-        // Give it the start memory location
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].startAddress[0] );
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].startAddress[1] );
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].startAddress[2] );
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].startAddress[3] );
-        // Give it the stop memory location - little endian
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].stopAddress[0] );
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].stopAddress[1] );
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].stopAddress[2] );
-        serialPutByte( aquadoppFD, buffer[ FATIndex ].stopAddress[3] );
-        */
-      
-        // Read/write the data
-        // NOTE: Currently this leave the ACK ACK at the end of the file
-        //       I believe this should be removed so as not to interfere
-        //       with NORTEKS conversion software.
-        while ( ( bytesRead = 
-                 serialGetLine( aquadoppFD, fileBuff, 128, 500L, dblAck ) ) > 0 )
+      if ( retVal > 0 )
+      {
+        LOGPRINT( LVL_DEBG, "downloadAquadoppFiles: Saving measurement " 
+                            "data.. " );
+        retVal = downloadAquadoppData( aquadoppFD, startAddr, stopAddr,
+                                       fpl );
+      }
+
+      if ( fclose( fpl ) != 0 )
+        retVal = FAILURE;
+
+      if ( retVal > 0 )
+      {
+        if ( rename( tmpLogFile, dataLogFile ) != 0 )
         {
-          fwrite( fileBuff, 1, bytesRead, fpl ); 
-          totalBytesRead += bytesRead;
+          LOGPRINT( LVL_CRIT, "downloadAquadoppFiles(): Could not rename "
+                    "%s to %s!", tmpLogFile, dataLogFile );
+          failed = 1;
         }
-  
-        // Close the file.
-        fclose( fpl );
-      }else {
-        LOGPRINT( LVL_WARN, "downloadArchive(): WARNING: Aquadop file has "
-                            "zero length ( same start/stop position ) "
-                            "skipping!" );
+      }else
+      {
+        LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Download of FAT "
+                  "entry %d failed. Partial data left in %s.", FATIndex,
+                  tmpLogFile );
+        failed = 1;
       }
-
-      FATIndex++;
     }
-  }else {
-    LOGPRINT( LVL_WARN, "downloadArchive(): Could not read Aquadopp FAT. "
-                        "Nothing returned from RF command. " );
-    return( FAILURE );
+
+    FATIndex++;
   }
 
-  if ( clearAquadoppFAT( aquadoppFD ) < 1 )
+  if ( failed )
+  {
+    LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Not all files downloaded "
+              "cleanly - leaving the aquadopp archive in place." );
+  }else if ( clearAquadoppFAT( aquadoppFD ) < 1 )
   {
     // All attempts at obtaining a command prompt failed 
     LOGPRINT( LVL_WARN, "downloadAquadoppFiles(): Failed to erase "
@@ -1015,6 +1229,23 @@ int downloadAquadoppFiles ( int aquadoppFD )
                 "to write PD ( power down ) command to Aquadopp!");
     }
  
+  if ( failed )
+    return( FAILURE );
   return( SUCCESS );
 }
- 
+
+
+//
+// Device driver ( see buoy.c ).  Downloads go through
+// downloadAquadoppFiles(), which names its own files.
+//
+const struct deviceDriver aquadoppDriver = {
+  .deviceType = AQUADOPP,
+  .flags = 0,
+  .init = initAquadopp,
+  .start = startLoggingAquadopp,
+  .stop = stopLoggingAquadopp,
+  .syncTime = syncAquadoppTime,
+  .getTime = getAquadoppTime,
+  .setTime = setAquadoppTime
+};
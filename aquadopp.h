@@ -27,6 +27,24 @@
 //
 #define AQUABUFFLEN 256
 
+//
+// Binary transfer parameters.  Every Nortek structure starts
+// with AQUA_SYNC and ends with a checksum word seeded with
+// AQUA_CHECKSUM_BASE.  The FC command returns the hardware, head
+// and user configuration ( AQUA_CONFIG_LEN bytes ) and RF returns
+// AQUA_FATENTRIES directory entries.  Recorder data is read
+// AQUA_BLOCKLEN bytes at a time and a transfer is considered
+// stalled after AQUA_IDLE_TIMEOUT ms without data.
+//
+#define AQUA_SYNC              0xA5
+#define AQUA_CHECKSUM_BASE     0xB58C
+#define AQUA_CONFIG_LEN        784
+#define AQUA_FATENTRIES        32
+#define AQUA_MAXSTRUCT         8192
+#define AQUA_BLOCKLEN          4096
+#define AQUA_IDLE_TIMEOUT      2000L
+#define AQUA_DOWNLOAD_RETRIES  3
+
 
 
 
@@ -253,7 +271,7 @@ int displayAquadoppFAT( int aquadoppFD );
 //
 int clearAquadoppFAT( int aquadoppFD );
 
-//
+//   downloadAquadoppFiles - Download the entire aquadopp archive
 int downloadAquadoppFiles( int aquadoppFD );
 
 //   initAquadopp - Initialize the Aquadopp for normal operations
@@ -289,4 +307,7 @@ struct tm *getAquadoppTime( int aquadoppFD );
 //   setAquadoppTime - Set the date/time on the Aquadopp 
 int setAquadoppTime( int aquadoppFD, struct tm *time );
 
+//   aquadoppDriver - Device driver for buoy.c's registry
+extern const struct deviceDriver aquadoppDriver;
+
 #endif
@@ -0,0 +1,358 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * arcquery.c : Query tool for the binary MET/AUX archives
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Pull a time range out of the .MET.bin/.AUX.bin archives
+ *  written by weatherd and auxiliaryd.
+ *
+ *  usage: arcquery [-c fields] [-e end] [-f csv|text|info]
+ *                  [-s start] [-u] file.bin ...
+ *
+ *  Each file is opened with openBinArchive(), the first record
+ *  at or after start is found through the archive's time index
+ *  and records are read sequentially until end.  Files are
+ *  processed in the order given, so a multi-day query is
+ *  simply a list of daily archives.
+ *
+ *  Output is CSV ( a "time,epoch,<field>..." header and one row
+ *  per record, missing values left empty ) or, with -f text,
+ *  the "#" header followed by tab separated lines starting
+ *  with "MM/DD/YYYY hh:mm:ss" at the precision the daemons
+ *  use.  For a MET archive this is the MET file layout, with
+ *  missing values written as -555 as weatherd does, and can
+ *  be fed to the existing Perl tools ( e.g.
+ *  utils/parseWeather.pl ).  An AUX file holds the raw SeaFET
+ *  frames, which are not archived, so for an AUX archive
+ *  -f text gives only the decoded values.  -f info lists the
+ *  fields, record count and time span of each file.
+ *
+ */
+#define _GNU_SOURCE     // strptime(), timegm()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "general.h"
+#include "orcad.h"
+#include "log.h"
+#include "binarchive.h"
+
+enum queryFormats { FORMAT_CSV, FORMAT_TEXT, FORMAT_INFO };
+
+static int outputFormat = FORMAT_CSV;
+static int useUTC = 0;
+static time_t startTime = 0;
+static time_t endTime = (time_t)INT64_MAX;
+static char *fieldList = NULL;
+static int lastHeaderFields = -1;
+
+void usage( void );
+int queryArchive( char *fileName );
+
+
+//
+// NAME
+//   parseTimeArg - Convert a command line time
+//
+// DESCRIPTION
+//   Accepts "YYYY-MM-DD[ hh:mm[:ss]]", "YYYYMMDDhhmm" ( as
+//   in the MET/AUX file names ) or seconds since the epoch
+//   prefixed with '@'.  Times are local unless -u is given.
+//
+static int parseTimeArg( char *arg, time_t *when )
+{
+  static const char *formats[] = { "%Y-%m-%d %H:%M:%S", "%Y-%m-%d %H:%M",
+                                   "%Y-%m-%dT%H:%M:%S", "%Y-%m-%dT%H:%M",
+                                   "%Y-%m-%d", "%Y%m%d%H%M", NULL };
+  struct tm tm;
+  char *end;
+  int i;
+
+  if ( arg[0] == '@' )
+  {
+    *when = (time_t)strtoll( arg + 1, &end, 10 );
+    return( ( end != arg + 1 && *end == '\0' ) ? SUCCESS : FAILURE );
+  }
+
+  for ( i = 0; formats[i] != NULL; i++ )
+  {
+    memset( &tm, 0, sizeof( tm ) );
+    end = strptime( arg, formats[i], &tm );
+    if ( end != NULL && *end == '\0' )
+    {
+      tm.tm_isdst = -1;
+      *when = useUTC ? timegm( &tm ) : mktime( &tm );
+      return( SUCCESS );
+    }
+  }
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   selectFields - Map the -c field list onto an archive
+//
+// DESCRIPTION
+//   Fill columns[] with the archive field numbers named in
+//   the comma separated fieldList, or with every field when
+//   there is no list.
+//
+// RETURNS
+//   The number of columns, or -1 if a name is not found.
+//
+static int selectFields( struct binArchive *arc, int *columns )
+{
+  char list[1024];
+  char *name;
+  char *save;
+  int numColumns = 0;
+  uint32_t i;
+
+  if ( fieldList == NULL )
+  {
+    for ( i = 0; i < arc->header.numFields; i++ )
+      columns[numColumns++] = i;
+    return( numColumns );
+  }
+
+  strncpy( list, fieldList, sizeof( list ) - 1 );
+  list[sizeof( list ) - 1] = '\0';
+  for ( name = strtok_r( list, ",", &save ); name != NULL &&
+        numColumns < BINARC_MAXFIELDS; name = strtok_r( NULL, ",", &save ) )
+  {
+    for ( i = 0; i < arc->header.numFields; i++ )
+      if ( strncmp( arc->fields[i].name, name, BINARC_NAMELEN ) == 0 )
+        break;
+    if ( i == arc->header.numFields )
+    {
+      LOGPRINT( LVL_WARN, "No field named %s", name );
+      return( FAILURE );
+    }
+    columns[numColumns++] = i;
+  }
+  return( numColumns );
+}
+
+
+//
+// NAME
+//   printArchiveInfo - Describe an archive for -f info
+//
+static void printArchiveInfo( char *fileName, struct binArchive *arc )
+{
+  time_t first, last;
+  char timeStr[80];
+  uint32_t i;
+
+  printf( "%s: %llu records, %llu index entries\n", fileName,
+          (unsigned long long)arc->numRecords,
+          (unsigned long long)arc->numEntries );
+  if ( arc->numRecords > 0 &&
+       readBinArchive( arc, 0, &first, NULL ) == SUCCESS &&
+       readBinArchive( arc, arc->numRecords - 1, &last, NULL ) == SUCCESS )
+  {
+    strftime( timeStr, sizeof( timeStr ), "%Y-%m-%d %H:%M:%S",
+              useUTC ? gmtime( &first ) : localtime( &first ) );
+    printf( "  from: %s\n", timeStr );
+    strftime( timeStr, sizeof( timeStr ), "%Y-%m-%d %H:%M:%S",
+              useUTC ? gmtime( &last ) : localtime( &last ) );
+    printf( "  to:   %s\n", timeStr );
+  }
+  for ( i = 0; i < arc->header.numFields; i++ )
+    printf( "  %2u %-32.32s %-12.12s\n", i, arc->fields[i].name,
+            arc->fields[i].units );
+}
+
+
+//
+// NAME
+//   queryArchive - Write the selected records of one archive
+//
+// RETURNS
+//   The number of records written, or -1 on failure.
+//
+int queryArchive( char *fileName )
+{
+  struct binArchive arc;
+  float values[BINARC_MAXFIELDS];
+  int columns[BINARC_MAXFIELDS];
+  int numColumns;
+  int64_t record;
+  long numWritten = 0;
+  time_t when;
+  char timeStr[80];
+  int i, j;
+
+  if ( openBinArchive( &arc, fileName ) < 0 )
+    return( FAILURE );
+
+  if ( outputFormat == FORMAT_INFO )
+  {
+    printArchiveInfo( fileName, &arc );
+    closeBinArchive( &arc );
+    return( 0 );
+  }
+
+  if ( ( numColumns = selectFields( &arc, columns ) ) < 0 ||
+       ( record = findBinArchiveTime( &arc, startTime ) ) < 0 )
+  {
+    closeBinArchive( &arc );
+    return( FAILURE );
+  }
+
+  if ( outputFormat == FORMAT_TEXT )
+    printf( "%s", arc.header.description );
+  else if ( lastHeaderFields != numColumns )
+  {
+    // One header unless the files have different fields
+    printf( "time,epoch" );
+    for ( i = 0; i < numColumns; i++ )
+      printf( ",%.*s", BINARC_NAMELEN, arc.fields[columns[i]].name );
+    printf( "\n" );
+    lastHeaderFields = numColumns;
+  }
+
+  for ( ; (uint64_t)record < arc.numRecords; record++ )
+  {
+    if ( readBinArchive( &arc, record, &when, values ) < 0 )
+    {
+      LOGPRINT( LVL_WARN, "%s: Could not read record %lld", fileName,
+                (long long)record );
+      break;
+    }
+    if ( when > endTime )
+      break;
+
+    if ( outputFormat == FORMAT_TEXT )
+    {
+      strftime( timeStr, sizeof( timeStr ), "%m/%d/%Y %H:%M:%S",
+                useUTC ? gmtime( &when ) : localtime( &when ) );
+      printf( "%s", timeStr );
+    }else
+    {
+      strftime( timeStr, sizeof( timeStr ), "%Y-%m-%d %H:%M:%S",
+                useUTC ? gmtime( &when ) : localtime( &when ) );
+      printf( "%s,%lld", timeStr, (long long)when );
+    }
+    for ( i = 0; i < numColumns; i++ )
+    {
+      j = columns[i];
+      if ( isnan( values[j] ) && outputFormat == FORMAT_TEXT )
+        printf( "\t%.*f", arc.fields[j].decimals, -555.0 );
+      else if ( isnan( values[j] ) )
+        printf( "," );
+      else
+        printf( outputFormat == FORMAT_TEXT ? "\t%.*f" : ",%.*f",
+                arc.fields[j].decimals, values[j] );
+    }
+    printf( "\n" );
+    numWritten++;
+  }
+
+  closeBinArchive( &arc );
+  return( numWritten );
+}
+
+
+int main ( int argc, char *argv[] )
+{
+  char *startArg = NULL;
+  char *endArg = NULL;
+  int numFailed = 0;
+  int opt, i;
+
+  logFile = stderr;
+  progName = "arcquery";
+  opts.debugLevel = 3;
+
+  while ( ( opt = getopt( argc, argv, "c:e:f:s:u" ) ) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'c':
+        fieldList = optarg;
+        break;
+      case 'e':
+        endArg = optarg;
+        break;
+      case 'f':
+        if ( strcmp( optarg, "csv" ) == 0 )
+          outputFormat = FORMAT_CSV;
+        else if ( strcmp( optarg, "text" ) == 0 )
+          outputFormat = FORMAT_TEXT;
+        else if ( strcmp( optarg, "info" ) == 0 )
+          outputFormat = FORMAT_INFO;
+        else
+        {
+          usage();
+          exit( 1 );
+        }
+        break;
+      case 's':
+        startArg = optarg;
+        break;
+      case 'u':
+        useUTC = 1;
+        break;
+      default:
+        usage();
+        exit( 1 );
+    }
+  }
+
+  if ( optind >= argc )
+  {
+    usage();
+    exit( 1 );
+  }
+
+  // Parsed after the loop so -u applies wherever it appears
+  if ( ( startArg && parseTimeArg( startArg, &startTime ) < 0 ) ||
+       ( endArg && parseTimeArg( endArg, &endTime ) < 0 ) )
+  {
+    LOGPRINT( LVL_CRIT, "Could not understand the start/end time" );
+    usage();
+    exit( 1 );
+  }
+
+  for ( i = optind; i < argc; i++ )
+    if ( queryArchive( argv[i] ) < 0 )
+      numFailed++;
+
+  return( numFailed ? 1 : 0 );
+}
+
+
+void usage( void )
+{
+  fprintf( stderr,
+    "usage: arcquery [-c fields] [-e end] [-f csv|text|info] [-s start] "
+    "[-u] file.bin ...\n"
+    "  -c fields  : Comma separated fields to output ( default: all )\n"
+    "  -e end     : Last time to output\n"
+    "  -f format  : csv ( default ), text ( tab separated as in the MET\n"
+    "               file, AUX values decoded ) or info\n"
+    "  -s start   : First time to output\n"
+    "  -u         : Times are UTC ( default: local )\n"
+    "  Times are YYYY-MM-DD[ hh:mm[:ss]], YYYYMMDDhhmm or @epochSeconds\n" );
+}
@@ -29,6 +29,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <math.h>
 
 #include <auxiliaryd.h>
 #include <hardio.h>
@@ -39,19 +41,53 @@
 #include <orcad.h>
 #include <parser.h>
 #include <serial.h>
+#include <timer.h>
+#include <fieldparse.h>
+#include <readingbus.h>
+#include <datawriter.h>
+#include <seafet.h>
 
 #define FAILURE -1
 #define LCKFILE "/var/run/auxiliaryd.pid"
 #define Name "auxiliaryd"
 #define LOGFILE "/usr/local/orcaD/logs/auxiliaryd"
 #define STDERR stderr
-#define AUXBUFFLEN 256
+#define TMPAUXFILE "/usr/local/orcaD/data/tmpAuxFile"
 
 extern const char *Version;
 //struct ftdi_context *ftdic = NULL;
-FILE * fpAuxiliary = NULL;
+struct dataWriter auxWriter = { .fd = -1 };   // not open yet
 time_t timeLastArchiveCreated;
-time_t timeLastSampled;
+struct binArchive auxArchive;
+
+// Binary archive columns, the numeric SeaFET frame fields
+// ( see getSeaFETValues() )
+static const struct binArchiveField auxArchiveFields[] = {
+  { "DATE", "YYYYDDD", 0 },
+  { "TIME", "hours", 7 },
+  { "PH_INT", "pH", 5 },
+  { "PH_EXT", "pH", 5 },
+  { "TEMP", "C", 4 },
+  { "TEMP_CTD", "C", 4 },
+  { "S_CTD", "psu", 4 },
+  { "O_CTD", "ml/L", 3 },
+  { "P_CTD", "dbar", 3 },
+  { "VRS_INT", "V", 8 },
+  { "VRS_EXT", "V", 8 },
+  { "V_THERM", "V", 8 },
+  { "V_SUPPLY", "V", 3 },
+  { "I_SUPPLY", "mA", 0 },
+  { "HUMIDITY", "%", 1 },
+  { "V_5V", "V", 3 },
+  { "V_MBATT", "V", 3 },
+  { "V_ISO", "V", 3 },
+  { "V_ISOBATT", "V", 3 },
+  { "I_B", "nA", 0 },
+  { "I_K", "nA", 0 },
+  { "V_K", "V", 8 }
+};
+#define NUMAUXARCHIVEFIELDS \
+  ( sizeof( auxArchiveFields ) / sizeof( struct binArchiveField ) )
 
 
 /*auxiliaryd:
@@ -69,11 +105,14 @@ time_t timeLastSampled;
     - during deployment:
        - define sampling schedule
        - send SeaFET any character (we use "!!!!!") to wake up
+       - wait for the wake up prompt to finish
        - within 5 seconds of sending wake up command, send "s" command to sample
        - SeaFET will echo back "s" if sampling command is received 
-       - read SeaFET data line
-       - write data line to AUX file
+       - read SeaFET data frame, complete when all fields and the
+         <CR><LF> have arrived
+       - check the frame's checksum and write it to the AUX file
        - SeaFET automatically enters sleep state
+       ( see seafet.c )
 
 */
 
@@ -301,11 +340,9 @@ int main(int argc, char **argv)
   // Print out the options as we know them
   logOpts( logFile );
 
-  if ( ( fpAuxiliary = fopen("/usr/local/orcaD/data/tmpAuxFile", "w" ) ) == NULL )
-  {     
-    LOGPRINT( LVL_EMRG, "Could not open up a new auxiliary file!");
-    cleanup( FAILURE );
-  }
+  // Share our readings with the other daemons
+  if ( attachReadingBus( 1 ) < 0 )
+    LOGPRINT( LVL_WARN, "main(): Readings will not be shared!" );
 
   if ( hasSerialDevice( SEAFETPH ) > 0 )
   {
@@ -323,21 +360,135 @@ int main(int argc, char **argv)
 
 
 
+// 
+// NAME
+//   openAuxArchive - Start the binary companion to the AUX file.
+//
+// SYNOPSIS
+//   #include "auxiliaryd.h"
+//
+//   int openAuxArchive( const char *fileHeader, int writerState,
+//                       const char *recoverName );
+//
+// DESCRIPTION
+//   Create the temporary binary AUX archive, or resume or
+//   move aside the one left by a crash along with the AUX 
+//   file ( writerState from openDataWriter() ).  A failure
+//   is logged but does not stop the text logging.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int openAuxArchive( const char *fileHeader, int writerState,
+                    const char *recoverName )
+{
+  char archiveFile[FILEPATHMAX + sizeof( BINARC_SUFFIX )];
+
+  if ( writerState == DATAWRITER_RESUMED &&
+       resumeBinArchive( &auxArchive, TMPAUXFILE BINARC_SUFFIX,
+                         auxArchiveFields, NUMAUXARCHIVEFIELDS ) == SUCCESS )
+    return( SUCCESS );
+
+  if ( writerState == DATAWRITER_RECOVERED && recoverName != NULL )
+  {
+    snprintf( archiveFile, sizeof( archiveFile ), "%s%s", recoverName, BINARC_SUFFIX );
+    rename( TMPAUXFILE BINARC_SUFFIX, archiveFile );
+  }
+
+  if ( createBinArchive( &auxArchive, TMPAUXFILE BINARC_SUFFIX, fileHeader,
+                         auxArchiveFields, NUMAUXARCHIVEFIELDS ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "openAuxArchive(): Could not start the binary "
+                        "AUX archive!" );
+    return( FAILURE );
+  }
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   saveAuxArchive - Close and rename the binary AUX archive.
+//
+// SYNOPSIS
+//   #include "auxiliaryd.h"
+//
+//   void saveAuxArchive( const char *dataLogFile );
+//
+// DESCRIPTION
+//   Write the archive's index and move it next to the AUX 
+//   file dataLogFile ( as dataLogFile.bin ).
+//
+void saveAuxArchive( const char *dataLogFile )
+{
+  char archiveFile[FILEPATHMAX + sizeof( BINARC_SUFFIX )];
+
+  if ( auxArchive.fp == NULL )
+    return;
+  syncBinArchive( &auxArchive, opts.dataSyncPolicy != DATASYNC_NONE );
+  closeBinArchive( &auxArchive );
+  snprintf( archiveFile, sizeof( archiveFile ), "%s%s", dataLogFile, BINARC_SUFFIX );
+  rename( TMPAUXFILE BINARC_SUFFIX, archiveFile );
+}
+
+
+// 
+// NAME
+//   makeAuxFileName - Name the AUX file saved at a given time.
+//
+// SYNOPSIS
+//   #include "auxiliaryd.h"
+//
+//   void makeAuxFileName( char *dataLogFile, time_t when );
+//
+// DESCRIPTION
+//   Fill dataLogFile ( FILEPATHMAX long ) with the data 
+//   directory path of the AUX file saved at when, creating
+//   the data directory if necessary.
+//
+void makeAuxFileName( char *dataLogFile, time_t when )
+{
+  struct tm *whenTM;
+
+  updateDataDir();
+  whenTM = localtime( &when );
+  snprintf( dataLogFile, FILEPATHMAX, "%s/%s%04d%02d%02d%02d%02d.AUX", 
+            opts.dataSubDirName, opts.auxiliaryDataPrefix,
+            whenTM->tm_year + 1900, whenTM->tm_mon + 1, whenTM->tm_mday,
+            whenTM->tm_hour, whenTM->tm_min );
+}
+
+
 void wsSEAFET( )
 {
   int auxPort = -1;
   // Initialize the time
   time_t nowTimeT;
-  struct tm *nowTM;
   tzset();
   time( &nowTimeT );  
-  nowTM = localtime( &nowTimeT );
   char dataLogFile[FILEPATHMAX];
-  char buffer[AUXBUFFLEN];
+  char buffer[SEAFET_FRAMELEN];
   int bytesRead = 0;
+  struct seafetFrame frame;
+  float frameValues[NUMAUXARCHIVEFIELDS];
+  struct periodicTimer sampleTimer;
+  int skipped;
+  int rotated;
+  int ret;
+  struct stat tmpStat;
 
   char *fileHeader = NULL;
  
+  // The header must come out the same every time for 
+  // openDataWriter() to resume an AUX file after a crash.
+  if ( ( fileHeader = calloc( 1, sizeof(char) ) ) == NULL )
+  {
+    LOGPRINT( LVL_EMRG, "wsSEAFET(): Could not allocate memory for the "
+              "file header!");
+    cleanup( FAILURE );
+  }
+
   if ( hasSerialDevice( SEAFETPH  ) > 0 )
   {
     static char *auxDesc = "# Satlantic SeaFET Ocean pH Sensor\n";
@@ -367,14 +518,34 @@ void wsSEAFET( )
   }
   strcat( fileHeader, fieldDesc );
 
-  // Write header to file
-  fprintf( fpAuxiliary,"%s", fileHeader);
+  // Start the AUX file, or pick up the one we were writing
+  // before a crash.  A crashed file with a different header 
+  // is saved under the time it was last written.
+  if ( stat( TMPAUXFILE, &tmpStat ) != 0 )
+    tmpStat.st_mtime = time( NULL );
+  makeAuxFileName( dataLogFile, tmpStat.st_mtime );
+  if ( ( ret = openDataWriter( &auxWriter, TMPAUXFILE, fileHeader, 
+                               opts.dataCommitInterval, opts.dataSyncPolicy,
+                               dataLogFile ) ) < 0 )
+  {     
+    LOGPRINT( LVL_EMRG, "Could not open up a new auxiliary file!");
+    cleanup( FAILURE );
+  }
+  openAuxArchive( fileHeader, ret, dataLogFile );
 
   // Last minute initializations
   time( &nowTimeT );  
   timeLastArchiveCreated = nowTimeT;
-  timeLastSampled = nowTimeT;
-  nowTM = localtime( &nowTimeT );
+
+  // Sample on wall clock aligned boundaries ( e.g. every 
+  // 15 minutes on the quarter hour )
+  if ( initPeriodicTimer( &sampleTimer, opts.auxiliarySamplePeriod * 60L,
+                          0 ) < 0 )
+  {
+    LOGPRINT( LVL_EMRG, "wsSEAFET(): Bad auxiliarySamplePeriod %d!",
+              opts.auxiliarySamplePeriod );
+    cleanup( FAILURE );
+  }
 
   LOGPRINT( LVL_ALRT, "Logging started" );
 
@@ -383,124 +554,70 @@ void wsSEAFET( )
   //
   for (;;)
   {
-    // Record the time
-    time( &nowTimeT );  
-    nowTM = localtime( &nowTimeT );
+    // Wait for the next sample time
+    if ( ( skipped = waitPeriodicTimer( &sampleTimer ) ) > 0 )
+      LOGPRINT( LVL_WARN, "wsSEAFET(): Sampling overran, skipped %d "
+                "sample(s) ( %lu overruns so far ).", skipped, 
+                sampleTimer.numOverruns );
+
+    // Samples are stamped with the time they were scheduled
+    nowTimeT = ( skipped < 0 ) ? time( NULL ) : sampleTimer.fired;
 
     // Check to see if we need to create AUX archive
     if ( ( nowTimeT - timeLastArchiveCreated ) > (1440 * 60) )
     {
-      // Time to close the AUX file and reopen a new one
-      fclose( fpAuxiliary );
-
-      updateDataDir();
-      
-      // Move the temporary file into a new AUX file
-      sprintf( dataLogFile,"%s/%s%04d%02d%02d%02d%02d.AUX", 
-           opts.dataSubDirName,
-           opts.auxiliaryDataPrefix,
-           nowTM->tm_year + 1900, nowTM->tm_mon + 1, nowTM->tm_mday,
-           nowTM->tm_hour, nowTM->tm_min );
-
+      // Time to move the temporary file into a new AUX file
+      // and start another
+      makeAuxFileName( dataLogFile, nowTimeT );
       LOGPRINT( LVL_ALRT, "Creating %s.", dataLogFile );
-      rename( "/usr/local/orcaD/data/tmpAuxFile", dataLogFile );
-
-      if ( ( fpAuxiliary = fopen("/usr/local/orcaD/data/tmpAuxFile", "w" ) ) 
-            == NULL )
+      if ( ( rotated = rotateDataWriter( &auxWriter, dataLogFile ) ) < 0 &&
+           auxWriter.fd < 0 )
       {     
         LOGPRINT( LVL_ALRT, "Could not open up a new auxiliary file!");
         cleanup( FAILURE );
       }
-      fprintf( fpAuxiliary,"%s", fileHeader);
-      fflush( fpAuxiliary );
+      // If the rename failed the samples stay in the temporary
+      // file, so the binary archive must stay with them
+      if ( rotated >= 0 )
+      {
+        saveAuxArchive( dataLogFile );
+        openAuxArchive( fileHeader, DATAWRITER_CREATED, NULL );
+      }
 
       timeLastArchiveCreated = nowTimeT;
     }
-    if ( ( nowTimeT - timeLastSampled ) > (opts.auxiliarySamplePeriod * 60) )
+    if ( skipped >= 0 )
     {
       //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint 1: time to take a sample!");
       // Read from the auxiliary device(s)
       //  -- SeaFET pH
 
-      // SEAFET Data
-      // Full ASCII MOde: max number of characters in Full (long) ASCII frame is 197
-      // Example from manual: SATPHA0001,2014083,13.0932646,7.80829,7.78879,20.5221,20.5038,32.6027,4.669,10.523,0.05975991,
-      //	-0.85879952,1.13056064,11.326,114,0.5,4.882,9.602,6.106,5.903,100,100,-0.95693927,0x0000,7<CR><LF>
-      //
-      // Example from sensor: SATPHA0217,2014317,23.2585735,6.53811,6.41548,18.8480,nan,nan,nan,nan,-0.97828925,-0.93706161,
-      //         0.90207696,0.000,19,3.9,4.850,0.000,6.073,0.101,0,10,0.00000000,0x0000,172
-      //
-      // Columns:
-      // HEADER,DATE,TIME,PH_INT,PH_EXT,TEMP,TEMP_CTD,S_CTD,O_CTD,P_CTD,VRS_INT,VRS_EXT,V_THERM,V_SUPPLY,I_SUPPLY,HUMIDITY,
-      //         V_5V,V_MBATT,V_ISO,V_ISOBATT,I_B,I_K,V_K,STATUS,CHECKSUM,TERMINATOR
-      // Note: columns are comma seperated, missing values are nan strings
-      //  AS = ASCII string, AF = ASCII float, AI = ASCII integer
-      //   HEADER: "SAT" followed by 3 characters identifying frame type (PHL = pH Long), followed by serial number (4 characters): AS 10
-      //   DATE: Sample Date (UTC), YYYYDDD: AI 7
-      //   TIME: Sample Time (UTC), DECIMALHOUR: AF 9-10
-      //   PH_INT: internal calculated pH in total scale: AF 7-8
-      //   PH_EXT: external calculated pH in total scale: AF 7-8
-      //   TEMP: ISFET Thermister temperature (degrees C): AF 6-8
-      //   TEMP_CTD: CTD temperature (degrees C): AF 6-8
-      //   S_CTD: CTD salinity (psu): AF 6-7
-      //   O_CTD: CTD oxygen concentration (ml/L): AF 5-6
-      //   P_CTD: CTD pressure (dbar): AF 5-6
-      //   VRS_INT: internal FET voltage (volts): AF 10-11
-      //   VRS_EXT: external FET voltage (volts): AF 10-11
-      //   V_THERM: thermister voltage (volts): AF 10
-      //   V_SUPPLY: supply voltage (volts): AF 5-6
-      //   I_SUPPLY: supply current (mA): AI ???
-      //   HUMIDITY: enclosure relative humidity (%): AF 3-4
-      //   V_5V: Internal 5V supply voltage (volts): AF 5
-      //   V_MBATT: Main battery pack voltage (volts): AF 5-6
-      //   V_ISO: Internal isolated supply voltage (volts): AF 5
-      //   V_ISOBATT: Isolated battery pack voltage (volts): AF 5
-      //   I_B: Substrate leakage current (nA): AI ???
-      //   I_K: Counter electrode leakage current (nA): AI ???
-      //   V_K: Counter electrode voltage (volts): AF 10-11
-      //   STATUS: Status word (16-bit hex formateed bitmask): AS 6
-      //   CHECKSUM: checksum value: AI 1-3
-      //   TERMINATOR: <CR><LF>: AS 2
-
-      // Flush and resync ourselves on a line
-      term_flush( auxPort );
-      //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint 2: time to wake up SeaFET!");
-      // Wake up SeaFET
-      //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint 2.1!");
-      serialPutLine( auxPort, "!!!!!" );
-      //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint 2.2!");
-      // Wait 1 second
-      sleep( 2 );
-      //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint 2.3!");
-      // Send sampling command "s"
-      
-     if ( serialChat( auxPort, "s", "s", 2000L, "s" ) < 1 )
-        {
-          LOGPRINT( LVL_WARN, "SEAFET: Sensor failed to echo 's' after "           
-                   "sending sample 's' command ( one attempt made )." );
-        } 
-        else 
-        {
-          //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint 3: read samples from buffer!");
-
-          // save full data frame to file
-          while ( ( bytesRead = serialGetLine( auxPort, buffer, AUXBUFFLEN, 8000L, "\n" ) ) > 0 ) 
-            {
-              fwrite( buffer, 1, bytesRead, fpAuxiliary );
-            } 
-            term_flush( auxPort );
-            fflush(fpAuxiliary);
-        } 
+      // Save the full data frame to the file.  A frame which is 
+      // incomplete or fails its checksum is dropped.
+      if ( ( bytesRead = sampleSeaFET( auxPort, buffer, &frame ) ) > 0 )
+      {
+        writeDataWriter( &auxWriter, buffer, bytesRead );
+        getSeaFETValues( &frame, frameValues );
+        if ( auxArchive.fp != NULL )
+          appendBinArchive( &auxArchive, nowTimeT, frameValues );
+        publishReading( BUS_PHINT, frame.phInt );
+        publishReading( BUS_PHEXT, frame.phExt );
+        publishReading( BUS_SEAFETTEMP, frame.temp );
+        publishReading( BUS_SEAFETSUPPLY, frame.vSupply );
+      }
         //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint 4: time to reset sample loop!");
 
-        timeLastSampled = nowTimeT;
-
-    } // if ( ( nowTimeT - timeLastSampled ) > (opts.auxiliarySamplePeriod * 60) )
+    } // if ( skipped >= 0 )
     else
     {
-      //LOGPRINT( LVL_EMRG, "wsSEAFET(): Checkpoint A: sleeping for 10 seconds...");
+      LOGPRINT( LVL_WARN, "wsSEAFET(): Sample timer failed!" );
       sleep( 10 );
     }
+
+    // Write out the batched AUX records if they are due
+    if ( flushDataWriter( &auxWriter, 0 ) > 0 && auxArchive.fp != NULL )
+      syncBinArchive( &auxArchive, opts.dataSyncPolicy == DATASYNC_COMMIT );
+
     fflush(stderr);
     fflush(stdout);
 
@@ -522,6 +639,8 @@ int initialize() {
   opts.auxiliarySamplePeriod = 15;
   opts.auxiliaryArchiveDownloadPeriod = 1440;
   opts.auxiliaryDataPrefix = "AUX";
+  opts.dataCommitInterval = DATAWRITER_DEFAULT_INTERVAL;
+  opts.dataSyncPolicy = DATAWRITER_DEFAULT_SYNC;
   opts.configFileName = defaultConfigFile;
   opts.dataFilePrefix = '\0';
   opts.dataDirName[0] = '\0';
@@ -562,8 +681,6 @@ void processCommandLine (int argc, char *argv[] )
 
 void cleanup (int passed_signal)
 {   
-  time_t nowTimeT;
-  struct tm *nowTM;
   char dataLogFile[FILEPATHMAX];
   sigset_t block;
   sigset_t oblock;
@@ -572,20 +689,15 @@ void cleanup (int passed_signal)
   (void) sigfillset (&block);
   sigprocmask (SIG_SETMASK, &block, &oblock);
 
-  // Try and close the auxiliary file
-  fclose( fpAuxiliary );
-
-  // Move the temporary file into a new AUX file
-  updateDataDir();
-                  
-  time( &nowTimeT );  
-  nowTM = localtime( &nowTimeT );
-  sprintf( dataLogFile,"%s/%s%04d%02d%02d%02d%02d.AUX", opts.dataSubDirName,
-           opts.auxiliaryDataPrefix,
-           nowTM->tm_year + 1900, nowTM->tm_mon + 1, nowTM->tm_mday,
-           nowTM->tm_hour, nowTM->tm_min );
-  LOGPRINT( LVL_ALRT, "Saving data to %s.", dataLogFile );
-  rename( "/usr/local/orcaD/data/tmpAuxFile", dataLogFile );
+  // Write out what is batched and move the temporary file 
+  // into a new AUX file
+  if ( auxWriter.fd >= 0 )
+  {
+    makeAuxFileName( dataLogFile, time( NULL ) );
+    LOGPRINT( LVL_ALRT, "Saving data to %s.", dataLogFile );
+    closeDataWriter( &auxWriter, dataLogFile );
+    saveAuxArchive( dataLogFile );
+  }
 
   // Say our last goodbye
   LOGPRINT( LVL_ALRT, "cleanup(): Even though extra data bits are spilling "
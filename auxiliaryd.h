@@ -25,9 +25,14 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include "term.h"
+#include "binarchive.h"
 
 int initialize();
 void wsSEAFET();
+int openAuxArchive( const char *fileHeader, int writerState,
+                    const char *recoverName );
+void saveAuxArchive( const char *dataLogFile );
+void makeAuxFileName( char *dataLogFile, time_t when );
 void processCommandLine(int argc, char *argv[] );
 void cleanup_TERM();
 void cleanup_QUIT();
@@ -0,0 +1,553 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * binarchive.c : Binary time series archives
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  weatherd and auxiliaryd write one of these next to each
+ *  MET/AUX text file ( <name>.MET.bin, <name>.AUX.bin ).  The
+ *  layout ( host byte order ) is:
+ *
+ *     struct binArchiveHeader
+ *     struct binArchiveField     [numFields]
+ *     record 0: int64_t time     ( secs since the epoch )
+ *               float   value    [numFields]
+ *     record 1: ...
+ *     struct binArchiveIndexEntry [numEntries]   ( on close )
+ *     struct binArchiveTrailer                   ( on close )
+ *
+ *  Records are fixed width and appended in time order, so the
+ *  file is usable ( by binary search ) while it is still being
+ *  written or if the daemon died before closing it.  Records
+ *  are buffered until syncBinArchive() is called, which the
+ *  daemons do whenever they commit the text file, and an
+ *  archive left by a crash can be reopened for appending with
+ *  resumeBinArchive().  Closing
+ *  adds an index with the first record of every indexInterval
+ *  seconds so a time range can be found with a single seek.
+ *  Missing values are stored as NaN.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "general.h"
+#include "log.h"
+#include "binarchive.h"
+
+
+// 
+// NAME
+//   createBinArchive - Start a new archive.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int createBinArchive( struct binArchive *arc, const char *fileName,
+//                         const char *description,
+//                         const struct binArchiveField *fields, 
+//                         int numFields );
+//
+// DESCRIPTION
+//   Create ( or truncate ) fileName and write the header and
+//   field descriptions.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int createBinArchive( struct binArchive *arc, const char *fileName,
+                      const char *description,
+                      const struct binArchiveField *fields, int numFields )
+{
+  memset( arc, 0, sizeof( struct binArchive ) );
+  if ( numFields < 1 || numFields > BINARC_MAXFIELDS )
+  {
+    LOGPRINT( LVL_WARN, "createBinArchive(): Bad field count %d", 
+              numFields );
+    return( FAILURE );
+  }
+
+  memcpy( arc->header.magic, BINARC_MAGIC, strlen( BINARC_MAGIC ) );
+  arc->header.version = BINARC_VERSION;
+  arc->header.numFields = numFields;
+  arc->header.recordLen = sizeof( int64_t ) + numFields * sizeof( float );
+  arc->header.headerLen = sizeof( struct binArchiveHeader ) +
+                          numFields * sizeof( struct binArchiveField );
+  arc->header.indexInterval = BINARC_INDEXINTERVAL;
+  if ( description )
+    strncpy( arc->header.description, description, BINARC_DESCLEN - 1 );
+  memcpy( arc->fields, fields, numFields * sizeof( struct binArchiveField ) );
+
+  if ( ( arc->recordBuff = malloc( arc->header.recordLen ) ) == NULL )
+    return( FAILURE );
+
+  if ( ( arc->fp = fopen( fileName, "w" ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "createBinArchive(): Could not create %s", 
+              fileName );
+    free( arc->recordBuff );
+    arc->recordBuff = NULL;
+    return( FAILURE );
+  }
+  if ( fwrite( &(arc->header), sizeof( struct binArchiveHeader ), 1, 
+               arc->fp ) != 1 ||
+       fwrite( arc->fields, sizeof( struct binArchiveField ), numFields, 
+               arc->fp ) != (size_t)numFields ||
+       fflush( arc->fp ) != 0 )
+  {
+    LOGPRINT( LVL_WARN, "createBinArchive(): Could not write header to %s",
+              fileName );
+    fclose( arc->fp );
+    arc->fp = NULL;
+    return( FAILURE );
+  }
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   addIndexEntry - Index a record if it starts an interval
+//
+// RETURNS
+//   -1 : Failure ( out of memory )
+//    1 : Success
+//
+static int addIndexEntry( struct binArchive *arc, int64_t recTime,
+                          uint64_t record )
+{
+  struct binArchiveIndexEntry *entries;
+
+  if ( arc->numEntries > 0 && 
+       recTime / arc->header.indexInterval == 
+         arc->index[arc->numEntries - 1].time / arc->header.indexInterval )
+    return( SUCCESS );
+
+  if ( arc->numEntries == arc->maxEntries )
+  {
+    entries = realloc( arc->index, ( arc->maxEntries + 64 ) * 
+                       sizeof( struct binArchiveIndexEntry ) );
+    if ( entries == NULL )
+      return( FAILURE );
+    arc->index = entries;
+    arc->maxEntries += 64;
+  }
+  arc->index[arc->numEntries].time = recTime;
+  arc->index[arc->numEntries].record = record;
+  arc->numEntries++;
+
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   appendBinArchive - Add a record to an archive.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int appendBinArchive( struct binArchive *arc, time_t when, 
+//                         const float *values );
+//
+// DESCRIPTION
+//   Write one record ( header.numFields values ).  The 
+//   record is buffered until the next syncBinArchive().  The
+//   first record of each index interval is remembered for 
+//   the index written on close.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int appendBinArchive( struct binArchive *arc, time_t when, 
+                      const float *values )
+{
+  int64_t recTime = (int64_t)when;
+
+  if ( arc->fp == NULL || arc->recordBuff == NULL )
+    return( FAILURE );
+
+  if ( addIndexEntry( arc, recTime, arc->numRecords ) < 0 )
+    return( FAILURE );
+
+  memcpy( arc->recordBuff, &recTime, sizeof( int64_t ) );
+  memcpy( arc->recordBuff + sizeof( int64_t ), values, 
+          arc->header.numFields * sizeof( float ) );
+  if ( fwrite( arc->recordBuff, arc->header.recordLen, 1, arc->fp ) != 1 )
+  {
+    LOGPRINT( LVL_WARN, "appendBinArchive(): Write failed" );
+    return( FAILURE );
+  }
+  arc->numRecords++;
+
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   syncBinArchive - Write buffered records to the file.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int syncBinArchive( struct binArchive *arc, int doSync );
+//
+// DESCRIPTION
+//   Flush the records appended so far and, if doSync is
+//   set, fsync() them to the card.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int syncBinArchive( struct binArchive *arc, int doSync )
+{
+  if ( arc->fp == NULL || arc->recordBuff == NULL )
+    return( FAILURE );
+
+  if ( fflush( arc->fp ) != 0 ||
+       ( doSync && fsync( fileno( arc->fp ) ) != 0 ) )
+  {
+    LOGPRINT( LVL_WARN, "syncBinArchive(): Write failed" );
+    return( FAILURE );
+  }
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   resumeBinArchive - Reopen an archive for appending.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int resumeBinArchive( struct binArchive *arc, const char *fileName,
+//                         const struct binArchiveField *fields, 
+//                         int numFields );
+//
+// DESCRIPTION
+//   Continue an archive left behind by a daemon which did
+//   not close it.  The archive must have the given fields.
+//   A trailing partial record ( or the index of an archive 
+//   which was closed ) is cut off and the index is rebuilt
+//   from the records.
+//
+// RETURNS
+//   -1 : Failure ( create a new archive instead )
+//    1 : Success
+//
+int resumeBinArchive( struct binArchive *arc, const char *fileName,
+                      const struct binArchiveField *fields, int numFields )
+{
+  uint64_t record;
+  time_t recTime;
+  off_t dataEnd;
+
+  if ( openBinArchive( arc, fileName ) < 0 )
+    return( FAILURE );
+
+  if ( arc->header.numFields != (uint32_t)numFields ||
+       memcmp( arc->fields, fields, 
+               numFields * sizeof( struct binArchiveField ) ) != 0 )
+  {
+    LOGPRINT( LVL_WARN, "resumeBinArchive(): %s has different fields", 
+              fileName );
+    closeBinArchive( arc );
+    return( FAILURE );
+  }
+
+  free( arc->index );
+  arc->index = NULL;
+  arc->numEntries = 0;
+  arc->maxEntries = 0;
+  for ( record = 0; record < arc->numRecords; record++ )
+  {
+    if ( readBinArchive( arc, record, &recTime, NULL ) < 0 ||
+         addIndexEntry( arc, (int64_t)recTime, record ) < 0 )
+    {
+      LOGPRINT( LVL_WARN, "resumeBinArchive(): Could not read %s", 
+                fileName );
+      closeBinArchive( arc );
+      return( FAILURE );
+    }
+  }
+
+  dataEnd = arc->header.headerLen + arc->numRecords * arc->header.recordLen;
+  fclose( arc->fp );
+  if ( ( arc->fp = fopen( fileName, "r+" ) ) == NULL ||
+       ftruncate( fileno( arc->fp ), dataEnd ) != 0 ||
+       fseeko( arc->fp, dataEnd, SEEK_SET ) != 0 ||
+       ( arc->recordBuff = malloc( arc->header.recordLen ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "resumeBinArchive(): Could not reopen %s", 
+              fileName );
+    if ( arc->fp )
+      fclose( arc->fp );
+    arc->fp = NULL;
+    free( arc->index );
+    arc->index = NULL;
+    return( FAILURE );
+  }
+
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   closeBinArchive - Finish and close an archive.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int closeBinArchive( struct binArchive *arc );
+//
+// DESCRIPTION
+//   For an archive being written, append the time index 
+//   and trailer.  In all cases close the file and release
+//   the archive's memory.
+//
+// RETURNS
+//   -1 : Failure ( the index could not be written )
+//    1 : Success
+//
+int closeBinArchive( struct binArchive *arc )
+{
+  struct binArchiveTrailer trailer;
+  int ret = SUCCESS;
+
+  if ( arc->fp == NULL )
+    return( FAILURE );
+
+  if ( arc->recordBuff != NULL )
+  {
+    memset( &trailer, 0, sizeof( trailer ) );
+    memcpy( trailer.magic, BINARC_INDEXMAGIC, strlen( BINARC_INDEXMAGIC ) );
+    trailer.indexOffset = arc->header.headerLen + 
+                          arc->numRecords * arc->header.recordLen;
+    trailer.numEntries = arc->numEntries;
+    if ( ( arc->numEntries > 0 &&
+           fwrite( arc->index, sizeof( struct binArchiveIndexEntry ), 
+                   arc->numEntries, arc->fp ) != arc->numEntries ) ||
+         fwrite( &trailer, sizeof( trailer ), 1, arc->fp ) != 1 )
+    {
+      LOGPRINT( LVL_WARN, "closeBinArchive(): Could not write the index" );
+      ret = FAILURE;
+    }
+  }
+  if ( fclose( arc->fp ) != 0 )
+    ret = FAILURE;
+  arc->fp = NULL;
+  free( arc->index );
+  free( arc->recordBuff );
+  arc->index = NULL;
+  arc->recordBuff = NULL;
+
+  return( ret );
+}
+
+
+// 
+// NAME
+//   openBinArchive - Open an archive for reading.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int openBinArchive( struct binArchive *arc, const char *fileName );
+//
+// DESCRIPTION
+//   Read the header and field descriptions and, if the 
+//   archive was closed, its time index.  The number of 
+//   records is taken from the index offset, or from the
+//   file size for an archive which is still open ( a 
+//   trailing partial record is ignored ).
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int openBinArchive( struct binArchive *arc, const char *fileName )
+{
+  struct binArchiveTrailer trailer;
+  struct stat st;
+  uint64_t dataEnd;
+
+  memset( arc, 0, sizeof( struct binArchive ) );
+  if ( ( arc->fp = fopen( fileName, "r" ) ) == NULL ||
+       fstat( fileno( arc->fp ), &st ) != 0 )
+  {
+    LOGPRINT( LVL_WARN, "openBinArchive(): Could not open %s", fileName );
+    if ( arc->fp )
+      fclose( arc->fp );
+    arc->fp = NULL;
+    return( FAILURE );
+  }
+
+  if ( fread( &(arc->header), sizeof( struct binArchiveHeader ), 1, 
+              arc->fp ) != 1 ||
+       memcmp( arc->header.magic, BINARC_MAGIC, strlen( BINARC_MAGIC ) ) ||
+       arc->header.version != BINARC_VERSION ||
+       arc->header.numFields < 1 || 
+       arc->header.numFields > BINARC_MAXFIELDS ||
+       arc->header.recordLen != sizeof( int64_t ) + 
+                                arc->header.numFields * sizeof( float ) ||
+       fread( arc->fields, sizeof( struct binArchiveField ), 
+              arc->header.numFields, arc->fp ) != arc->header.numFields )
+  {
+    LOGPRINT( LVL_WARN, "openBinArchive(): %s is not an archive", fileName );
+    fclose( arc->fp );
+    arc->fp = NULL;
+    return( FAILURE );
+  }
+  arc->header.description[BINARC_DESCLEN - 1] = '\0';
+
+  dataEnd = st.st_size;
+  if ( st.st_size >= (off_t)( arc->header.headerLen + sizeof( trailer ) ) &&
+       fseeko( arc->fp, st.st_size - sizeof( trailer ), SEEK_SET ) == 0 &&
+       fread( &trailer, sizeof( trailer ), 1, arc->fp ) == 1 &&
+       memcmp( trailer.magic, BINARC_INDEXMAGIC, 
+               strlen( BINARC_INDEXMAGIC ) ) == 0 &&
+       trailer.indexOffset + trailer.numEntries * 
+         sizeof( struct binArchiveIndexEntry ) + sizeof( trailer ) == 
+         (uint64_t)st.st_size )
+  {
+    dataEnd = trailer.indexOffset;
+    if ( trailer.numEntries > 0 &&
+         ( arc->index = malloc( trailer.numEntries * 
+                         sizeof( struct binArchiveIndexEntry ) ) ) != NULL &&
+         fseeko( arc->fp, trailer.indexOffset, SEEK_SET ) == 0 &&
+         fread( arc->index, sizeof( struct binArchiveIndexEntry ), 
+                trailer.numEntries, arc->fp ) == trailer.numEntries )
+      arc->numEntries = trailer.numEntries;
+  }
+  if ( dataEnd > arc->header.headerLen )
+    arc->numRecords = ( dataEnd - arc->header.headerLen ) / 
+                      arc->header.recordLen;
+
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   readBinArchive - Read one record from an archive.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int readBinArchive( struct binArchive *arc, uint64_t record, 
+//                       time_t *when, float *values );
+//
+// DESCRIPTION
+//   Read record number record ( from 0 ).  values may be 
+//   NULL when only the time is wanted.  Sequential reads
+//   do not seek.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int readBinArchive( struct binArchive *arc, uint64_t record, 
+                    time_t *when, float *values )
+{
+  int64_t recTime;
+  off_t offset;
+
+  if ( arc->fp == NULL || record >= arc->numRecords )
+    return( FAILURE );
+
+  offset = arc->header.headerLen + record * arc->header.recordLen;
+  if ( ftello( arc->fp ) != offset && 
+       fseeko( arc->fp, offset, SEEK_SET ) != 0 )
+    return( FAILURE );
+  if ( fread( &recTime, sizeof( int64_t ), 1, arc->fp ) != 1 )
+    return( FAILURE );
+  if ( values != NULL )
+  {
+    if ( fread( values, sizeof( float ), arc->header.numFields, arc->fp ) 
+         != arc->header.numFields )
+      return( FAILURE );
+  }else if ( fseeko( arc->fp, arc->header.numFields * sizeof( float ),
+                     SEEK_CUR ) != 0 )
+    return( FAILURE );
+  *when = (time_t)recTime;
+
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   findBinArchiveTime - Find the first record at or after a time.
+//
+// SYNOPSIS
+//   #include "binarchive.h"
+//
+//   int64_t findBinArchiveTime( struct binArchive *arc, time_t when );
+//
+// DESCRIPTION
+//   Narrow the search with the time index when there is
+//   one, then binary search the fixed width records.
+//
+// RETURNS
+//   The record number, numRecords if every record is 
+//   earlier than when, or -1 on a read error.
+//
+int64_t findBinArchiveTime( struct binArchive *arc, time_t when )
+{
+  uint64_t low = 0;
+  uint64_t high = arc->numRecords;
+  uint64_t mid;
+  uint64_t i;
+  time_t recTime;
+
+  // The index holds the first record of each interval
+  for ( i = 0; i < arc->numEntries; i++ )
+  {
+    if ( arc->index[i].time <= (int64_t)when )
+      low = arc->index[i].record;
+    else
+    {
+      high = arc->index[i].record;
+      break;
+    }
+  }
+  if ( high > arc->numRecords )
+    high = arc->numRecords;
+
+  while ( low < high )
+  {
+    mid = low + ( high - low ) / 2;
+    if ( readBinArchive( arc, mid, &recTime, NULL ) != SUCCESS )
+      return( FAILURE );
+    if ( recTime < when )
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return( (int64_t)low );
+}
@@ -0,0 +1,124 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * binarchive.h : Header for the binary time series archives
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Binary companions to the MET and AUX text files.  See 
+ *  binarchive.c for the file layout.
+ *
+ */
+#ifndef _BINARCHIVE_H
+#define _BINARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define BINARC_MAGIC         "ORCAARC"
+#define BINARC_INDEXMAGIC    "ORCAIDX"
+#define BINARC_VERSION       1
+#define BINARC_MAXFIELDS     64
+#define BINARC_NAMELEN       32
+#define BINARC_UNITSLEN      12
+#define BINARC_DESCLEN       1024
+#define BINARC_INDEXINTERVAL 3600
+#define BINARC_SUFFIX        ".bin"
+
+/* binArchiveHeader
+ *
+ * Start of every archive.  headerLen is the offset of
+ * the first record, recordLen is 8 + 4 * numFields.
+ * description is the text file's "#" comment header.
+ *
+ */
+struct binArchiveHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerLen;
+  uint32_t recordLen;
+  uint32_t numFields;
+  uint32_t indexInterval;
+  uint32_t reserved;
+  char description[BINARC_DESCLEN];
+}__attribute__ ((packed));
+
+/* binArchiveField
+ *
+ * One entry per value in a record.  decimals is the 
+ * precision the text file uses, so exports match it.
+ *
+ */
+struct binArchiveField {
+  char name[BINARC_NAMELEN];
+  char units[BINARC_UNITSLEN];
+  int32_t decimals;
+}__attribute__ ((packed));
+
+/* binArchiveIndexEntry
+ *
+ * Time and number of the first record in each index
+ * interval.
+ *
+ */
+struct binArchiveIndexEntry {
+  int64_t time;
+  uint64_t record;
+}__attribute__ ((packed));
+
+/* binArchiveTrailer
+ *
+ * Written after the index when the archive is closed.
+ *
+ */
+struct binArchiveTrailer {
+  char magic[8];
+  uint64_t indexOffset;
+  uint64_t numEntries;
+}__attribute__ ((packed));
+
+/* binArchive
+ *
+ * An archive open for appending or reading.
+ *
+ */
+struct binArchive {
+  FILE *fp;
+  struct binArchiveHeader header;
+  struct binArchiveField fields[BINARC_MAXFIELDS];
+  uint64_t numRecords;
+  struct binArchiveIndexEntry *index;
+  uint64_t numEntries;
+  uint64_t maxEntries;
+  unsigned char *recordBuff;
+};
+
+int createBinArchive( struct binArchive *arc, const char *fileName,
+                      const char *description,
+                      const struct binArchiveField *fields, int numFields );
+int appendBinArchive( struct binArchive *arc, time_t when, 
+                      const float *values );
+int syncBinArchive( struct binArchive *arc, int doSync );
+int resumeBinArchive( struct binArchive *arc, const char *fileName,
+                      const struct binArchiveField *fields, int numFields );
+int closeBinArchive( struct binArchive *arc );
+int openBinArchive( struct binArchive *arc, const char *fileName );
+int64_t findBinArchiveTime( struct binArchive *arc, time_t when );
+int readBinArchive( struct binArchive *arc, uint64_t record, 
+                    time_t *when, float *values );
+
+#endif
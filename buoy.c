@@ -28,6 +28,8 @@
 #include <sys/ioctl.h>
 #include <time.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 #ifndef RASPPI
 #include <ftdi.h>
@@ -41,9 +43,340 @@
 #include "aquadopp.h"
 #include "weather.h"
 #include "hardio.h"
+#include "ctd.h"
+#include "parser.h"
+#include "timer.h"
 #include "buoy.h"
 
 
+//
+// Hydro wire devices without a full driver yet.  They
+// are registered so the hydro wire can be identified.
+//
+static const struct deviceDriver ecolabDriver = {
+  .deviceType = ENVIROTECH_ECOLAB,
+  .flags = DRIVER_HYDROWIRE
+};
+static const struct deviceDriver isisDriver = {
+  .deviceType = SATLANTIC_ISIS,
+  .flags = DRIVER_HYDROWIRE
+};
+static const struct deviceDriver isisXDriver = {
+  .deviceType = SATLANTIC_ISIS_X,
+  .flags = DRIVER_HYDROWIRE
+};
+
+// The registry, by enum serialDeviceTypes
+static const struct deviceDriver *deviceDrivers[NUMDEVICETYPES];
+static int driversRegistered = 0;
+
+// The configured port for each device type and the
+// opts.serialPorts list it was built from.
+static struct sPort *devicePorts[NUMDEVICETYPES];
+static struct sPort *indexedPorts = NULL;
+static int portsIndexed = 0;
+
+
+//
+// NAME
+//   registerDeviceDriver - Add a driver to the device registry
+//
+// SYNOPSIS
+//   #include "buoy.h"
+//
+//   int registerDeviceDriver( const struct deviceDriver *driver );
+//
+// DESCRIPTION
+//   Make driver the handler for driver->deviceType.  A
+//   later registration for the same type replaces the
+//   earlier one.
+//
+// RETURNS
+//   1 Upon success
+//  -1 If the device type is invalid
+//
+int registerDeviceDriver ( const struct deviceDriver *driver )
+{
+  if ( driver == NULL || driver->deviceType < 0 || 
+       driver->deviceType >= NUMDEVICETYPES )
+  {
+    LOGPRINT( LVL_WARN, "registerDeviceDriver(): Invalid device type!" );
+    return( FAILURE );
+  }
+  deviceDrivers[driver->deviceType] = driver;
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   registerDeviceDrivers - Register the built in drivers
+//
+static void registerDeviceDrivers ( void )
+{
+  driversRegistered = 1;
+  registerDeviceDriver( &ctd19Driver );
+  registerDeviceDriver( &ctd19PlusDriver );
+  registerDeviceDriver( &ecolabDriver );
+  registerDeviceDriver( &isisDriver );
+  registerDeviceDriver( &isisXDriver );
+  registerDeviceDriver( &davisDriver );
+  registerDeviceDriver( &aquadoppDriver );
+}
+
+
+//
+// NAME
+//   getDeviceDriver - Lookup the driver for a device type
+//
+// SYNOPSIS
+//   #include "buoy.h"
+//
+//   const struct deviceDriver *getDeviceDriver( int deviceType );
+//
+// RETURNS
+//   The driver or NULL if none is registered.
+//
+const struct deviceDriver *getDeviceDriver ( int deviceType )
+{
+  if ( ! driversRegistered )
+    registerDeviceDrivers();
+  if ( deviceType < 0 || deviceType >= NUMDEVICETYPES )
+    return( NULL );
+  return( deviceDrivers[deviceType] );
+}
+
+
+//
+// NAME
+//   indexSerialPorts - Index the configured ports by device type
+//
+// SYNOPSIS
+//   #include "buoy.h"
+//
+//   int indexSerialPorts();
+//
+// DESCRIPTION
+//   Rebuild the device type to sPort table from opts.serialPorts.
+//   As with the old list walk, the first port listed for a type
+//   is the one used.  This is done automatically on first use
+//   and must be called again if opts.serialPorts is replaced.
+//
+// RETURNS
+//   The number of ports indexed.
+//
+int indexSerialPorts ( void )
+{
+  struct sPort *port;
+  int numPorts = 0;
+
+  memset( devicePorts, 0, sizeof( devicePorts ) );
+  for ( port = opts.serialPorts; port != NULL; port = port->nextPort )
+  {
+    if ( port->deviceType < 0 || port->deviceType >= NUMDEVICETYPES )
+      continue;
+    if ( devicePorts[port->deviceType] == NULL )
+      devicePorts[port->deviceType] = port;
+    numPorts++;
+  }
+  indexedPorts = opts.serialPorts;
+  portsIndexed = 1;
+  return( numPorts );
+}
+
+
+//
+// NAME
+//   sameString - strcmp() for strings which may be NULL
+//
+static int sameString ( const char *a, const char *b )
+{
+  if ( a == NULL || b == NULL )
+    return( a == b );
+  return( strcmp( a, b ) == 0 );
+}
+
+
+//
+// NAME
+//   adoptSerialPorts - Move open devices to a reloaded port list
+//
+// SYNOPSIS
+//   #include "buoy.h"
+//
+//   int adoptSerialPorts( struct sPort *oldPorts );
+//
+// DESCRIPTION
+//   After the config file has been reloaded, hand the open
+//   file descriptors and USB contexts of oldPorts to the ports
+//   in opts.serialPorts which have the same device type and
+//   settings, and flag them as adopted.  Anything left open
+//   on the old ports is closed and the port index is rebuilt.
+//
+// RETURNS
+//   The number of ports in opts.serialPorts which are new or 
+//   changed, and so may need initializing.
+//
+int adoptSerialPorts ( struct sPort *oldPorts )
+{
+  struct sPort *port;
+  struct sPort *oldPort;
+  int numChanged = 0;
+
+  for ( port = opts.serialPorts; port != NULL; port = port->nextPort )
+  {
+    for ( oldPort = oldPorts; oldPort != NULL; oldPort = oldPort->nextPort )
+    {
+      if ( oldPort->deviceType == port->deviceType &&
+           sameString( oldPort->tty, port->tty ) &&
+           oldPort->baud == port->baud &&
+           oldPort->stopBits == port->stopBits &&
+           oldPort->dataBits == port->dataBits &&
+           oldPort->flow == port->flow &&
+           oldPort->parity == port->parity &&
+           oldPort->vendorID == port->vendorID &&
+           oldPort->productID == port->productID &&
+           sameString( oldPort->serialID, port->serialID ) )
+        break;
+    }
+    if ( oldPort == NULL )
+    {
+      numChanged++;
+      continue;
+    }
+    port->fileDescriptor = oldPort->fileDescriptor;
+    port->ftdiContext = oldPort->ftdiContext;
+    port->adopted = 1;
+    oldPort->fileDescriptor = -1;
+    oldPort->ftdiContext = NULL;
+  }
+
+  // Close the devices which were removed or changed
+  for ( oldPort = oldPorts; oldPort != NULL; oldPort = oldPort->nextPort )
+  {
+    if ( oldPort->fileDescriptor >= 0 )
+    {
+      LOGPRINT( LVL_DEBG, "adoptSerialPorts(): Closing %s", oldPort->tty );
+      term_erase( oldPort->fileDescriptor );
+      close( oldPort->fileDescriptor );
+      oldPort->fileDescriptor = -1;
+    }
+    if ( oldPort->ftdiContext != NULL )
+    {
+      ftdi_usb_close( oldPort->ftdiContext );
+      ftdi_deinit( oldPort->ftdiContext );
+      free( oldPort->ftdiContext );
+      oldPort->ftdiContext = NULL;
+    }
+  }
+
+  indexSerialPorts();
+  return( numChanged );
+}
+
+
+//
+// NAME
+//   findPort - The sPort configured for a device type or NULL
+//
+static struct sPort *findPort ( int deviceType )
+{
+  if ( ! portsIndexed || indexedPorts != opts.serialPorts )
+    indexSerialPorts();
+  if ( deviceType < 0 || deviceType >= NUMDEVICETYPES )
+    return( NULL );
+  return( devicePorts[deviceType] );
+}
+
+
+
+//
+// NAME
+//   wantsInit - Should initializeDevices() bring up a device
+//
+static int wantsInit ( int deviceType, int newOnly )
+{
+  struct sPort *port;
+
+  if ( ( port = findPort( deviceType ) ) == NULL )
+    return( 0 );
+  return( ! newOnly || ! port->adopted );
+}
+
+
+//
+// Power rails switched by initializeDevices().  Devices
+// on the same rail are initialized one after another, the
+// rest concurrently.
+//
+enum powerRails { RAIL_NONE, RAIL_HYDRO, RAIL_WEATHER, RAIL_METER };
+
+// The Davis console needs this long after power up
+#define WEATHER_SETTLE_SECS 3
+
+/* initTask
+ *
+ * One device brought up by initializeDevices().
+ *
+ */
+struct initTask {
+  int deviceType;
+  int rail;                    // See enum powerRails
+  int settleSecs;              // Wait this long after power up
+  int fd;
+  const char *what;            // For the log
+  struct initTask *nextOnRail; // Initialized after this one
+  int ret;
+  long msecs;                  // Time taken
+};
+
+// When the rails were switched on
+static struct timeval powerUpTime;
+
+
+//
+// NAME
+//   runInitTask - Initialize one device
+//
+static void runInitTask ( struct initTask *task )
+{
+  const struct deviceDriver *driver;
+  struct timeval startTime;
+  long waitMs;
+
+  gettimeofday( &startTime, NULL );
+
+  // Let the device come up after its power is turned on
+  waitMs = task->settleSecs * 1000L - getMilliSecSince( &powerUpTime );
+  if ( waitMs > 0 )
+    usleep( waitMs * 1000 );
+
+  if ( task->rail == RAIL_HYDRO )
+    task->ret = initHydro( task->deviceType, task->fd );
+  else if ( ( driver = getDeviceDriver( task->deviceType ) ) != NULL &&
+            driver->init != NULL )
+    task->ret = driver->init( task->fd );
+  else
+    task->ret = SUCCESS;
+
+  task->msecs = getMilliSecSince( &startTime );
+}
+
+
+//
+// NAME
+//   initRailWorker - Thread which initializes the devices on a rail
+//
+static void *initRailWorker ( void *arg )
+{
+  struct initTask *task;
+
+  for ( task = arg; task != NULL; task = task->nextOnRail )
+    runInitTask( task );
+  return( NULL );
+}
+
+
 // 
 // NAME
 //   initializeHardware - Initialize the buoy hardware
@@ -55,7 +388,8 @@
 //
 // DESCRIPTION
 //   Setup the BitsyX processor board prior to use with the OrcaD
-//   package.  This is called prior to doing any I/O operations.
+//   package.  This is called once, prior to doing any I/O 
+//   operations.
 //   
 //   The basic intializations are:
 //
@@ -67,22 +401,19 @@
 //     - This resets the winch power to off and direction to up ( a
 //       low voltage on the direction port ). 
 //
-//     - Turns on external hardware if defined in the config file.
-//       This includes the hydro wire power, the weather station power,
-//       and the meterwheel power.
+//     - Initialize the term library.  This forgets every port
+//       the library knows about, so it must not be done again
+//       once devices are open.
 //
-//     - Initialize the communication ports for devices which 
-//       are defined in the config file.  This includes the hydro
-//       device, the weather station, and the meterwheel.
+//     - Bring up the devices defined in the config file with
+//       initializeDevices().
 //
 // RETURNS
 //   -1 Upon failure
 //    1 Upon Success
 //
 int initializeHardware () {
-  int r, wsFD;
-  int hydroType;
-  int hydroFD;
+  int r;
 
   // Say hi
   LOGPRINT( LVL_VERB, "intializeHardware(): Entered" );
@@ -113,95 +444,175 @@ int initializeHardware () {
     return( FAILURE );
   }
 
+  return( initializeDevices( 0 ) );
+}
+
+
+// 
+// NAME
+//   initializeDevices - Power up and initialize the configured devices
+//
+// SYNOPSIS
+//   #include "buoy.h"
+//
+//   int initializeDevices( int newOnly );
+//
+// DESCRIPTION
+//   Turn on external hardware and initialize the devices which
+//   are defined in the config file.  This includes the weather
+//   station power and the meterwheel power, and the hydro 
+//   device, the weather station, and the aquadopp.  Their 
+//   serial ports are opened here and then each power rail's 
+//   devices are initialized in a thread of their own, so the
+//   slow prompt handshakes overlap.  The time each device took
+//   is logged.
+//
+//   If newOnly is set, devices whose port was adopted by
+//   adoptSerialPorts() are left alone, so after a config reload
+//   only new or changed ports are initialized.
+//
+//   initializeHardware() must have been called first.
+//
+// RETURNS
+//   -1 Upon failure
+//    1 Upon Success
+//
+int initializeDevices ( int newOnly ) {
+  struct initTask tasks[3];
+  pthread_t workers[3];
+  int started[3];
+  int numTasks = 0;
+  struct timeval startTime;
+  long msecs;
+  int hydroType;
+  int i, j;
+  int ret = SUCCESS;
+
+  // Say hi
+  LOGPRINT( LVL_VERB, "initializeDevices(): Entered" );
+  gettimeofday( &startTime, NULL );
+
   //
   // Turn on external hardware if present
   //
-  if ( ( hydroType = getHydroWireDeviceType() ) > -1 )
+  memset( tasks, 0, sizeof( tasks ) );
+  if ( ( hydroType = getHydroWireDeviceType() ) > -1 &&
+       wantsInit( hydroType, newOnly ) )
   {
     // WMR 10/16/13: All buoy's have been switched from an 
     //               underwater battery pack to a supercapacitor
     //               bank.  Therefore, there is no need to keep
     //               the power on the cable while we are not
     //               profiling.
-    // LOGPRINT( LVL_INFO, "initializeHardware(): Turning on hydrowire power" );
+    // LOGPRINT( LVL_INFO, "initializeDevices(): Turning on hydrowire power" );
     // HYDRO_ON;
- 
-    // Open up the serial port
-    if( ( hydroFD = getDeviceFileDescriptor( hydroType ) ) < 0 ) 
-    {
-      LOGPRINT( LVL_ALRT, "intializeHardware(): Could not open up the "
-                "hydro device serial port!" );
-      return( FAILURE );
-    }
-    if ( initHydro( hydroType, hydroFD ) < 0 ) {
-      LOGPRINT( LVL_ALRT, "intializeHardware(): Could not initialize "
-                "the hydro device!" );
-      return( FAILURE );
-    }
+    tasks[numTasks].deviceType = hydroType;
+    tasks[numTasks].rail = RAIL_HYDRO;
+    tasks[numTasks].what = "hydro device";
+    numTasks++;
   }
 
-  if ( hasSerialDevice( DAVIS_WEATHER_STATION ) > 0 )
+  if ( wantsInit( DAVIS_WEATHER_STATION, newOnly ) )
   { 
     // Turn on
-    LOGPRINT( LVL_INFO, "initializeHardware(): Turning on weather station " 
+    LOGPRINT( LVL_INFO, "initializeDevices(): Turning on weather station " 
               "power" );
     WEATHER_ON;
-
-    // Give it some time to initialize
-    sleep( 3 );
-
-    // Open up the serial port
-    if( ( wsFD = getDeviceFileDescriptor( DAVIS_WEATHER_STATION ) ) < 0 ) 
-    {
-      LOGPRINT( LVL_ALRT, "intializeHardware(): Could not open up the "
-                "weather station serial port!" );
-      return( FAILURE );
-    }
-
-    if ( initializeWeatherStation( wsFD ) < 0 ) 
-    {
-      LOGPRINT( LVL_ALRT, "intializeHardware(): Could not initialize the "
-                "weather station!" );
-      return( FAILURE );
-    }
-
+    tasks[numTasks].deviceType = DAVIS_WEATHER_STATION;
+    tasks[numTasks].rail = RAIL_WEATHER;
+    tasks[numTasks].settleSecs = WEATHER_SETTLE_SECS;
+    tasks[numTasks].what = "weather station";
+    numTasks++;
   }
 
-  if ( hasSerialDevice( AGO_METER_WHEEL_COUNTER ) > 0
+  if ( wantsInit( AGO_METER_WHEEL_COUNTER, newOnly )
        || 
-       hasSerialDevice( ARDUINO_METER_WHEEL_COUNTER ) > 0 ) 
+       wantsInit( ARDUINO_METER_WHEEL_COUNTER, newOnly ) ) 
   {
     // Turn it on
     METER_ON;
     // TODO: Record it's base position
   }
+  gettimeofday( &powerUpTime, NULL );
 
-  if ( hasSerialDevice( AQUADOPP ) > 0 )
+  if ( wantsInit( AQUADOPP, newOnly ) )
   {
-    LOGPRINT( LVL_INFO, "initializeHardware(): Initializing the " 
+    LOGPRINT( LVL_INFO, "initializeDevices(): Initializing the " 
               "Aquadopp." );
+    tasks[numTasks].deviceType = AQUADOPP;
+    tasks[numTasks].rail = RAIL_NONE;
+    tasks[numTasks].what = "aquadopp";
+    numTasks++;
+  }
 
-    // Open up the serial port
-    if( ( wsFD = getDeviceFileDescriptor( AQUADOPP ) ) < 0 ) 
+  // Open up the serial ports.  The term library is not
+  // thread safe so this is done up front.
+  for ( i = 0; i < numTasks; i++ )
+  {
+    if ( ( tasks[i].fd = getDeviceFileDescriptor( 
+                                      tasks[i].deviceType ) ) < 0 ) 
     {
-      LOGPRINT( LVL_ALRT, "intializeHardware(): Could not open up the "
-                "aquadopp serial port!" );
+      LOGPRINT( LVL_ALRT, "initializeDevices(): Could not open up the "
+                "%s serial port!", tasks[i].what );
       return( FAILURE );
     }
+  }
 
-    // initialize it.
-    if ( initAquadopp( wsFD ) < 0 )
+  // Chain the devices which share a power rail and start
+  // one thread per rail
+  for ( i = 0; i < numTasks; i++ )
+  {
+    started[i] = 0;
+    for ( j = 0; j < i; j++ )
     {
-      LOGPRINT( LVL_ALRT, "intializeHardware(): Could not initialize "
-                "aquadopp hardware!" );
-      return( FAILURE );
+      if ( tasks[i].rail != RAIL_NONE && tasks[j].rail == tasks[i].rail )
+        break;
     }
+    if ( j < i )
+    {
+      while ( tasks[j].nextOnRail != NULL )
+        j = tasks[j].nextOnRail - tasks;
+      tasks[j].nextOnRail = &tasks[i];
+      continue;
+    }
+    if ( pthread_create( &workers[i], NULL, initRailWorker, &tasks[i] ) == 0 )
+      started[i] = 1;
+    else
+    {
+      LOGPRINT( LVL_WARN, "initializeDevices(): Could not start a thread "
+                "for the %s.  Initializing it directly.", tasks[i].what );
+      initRailWorker( &tasks[i] );
+    }
+  }
+  for ( i = 0; i < numTasks; i++ )
+  {
+    if ( started[i] )
+      pthread_join( workers[i], NULL );
+  }
+
+  // Startup timing report
+  for ( i = 0; i < numTasks; i++ )
+  {
+    if ( tasks[i].ret < 0 )
+    {
+      LOGPRINT( LVL_ALRT, "initializeDevices(): Could not initialize "
+                "the %s!", tasks[i].what );
+      ret = FAILURE;
+    }else
+      LOGPRINT( LVL_INFO, "initializeDevices(): %s ( %s ) ready in "
+                "%ld.%03ld secs", tasks[i].what, 
+                getDeviceTypeName( tasks[i].deviceType ),
+                tasks[i].msecs / 1000, tasks[i].msecs % 1000 );
   }
+  msecs = getMilliSecSince( &startTime );
+  LOGPRINT( LVL_INFO, "initializeDevices(): Device initialization "
+            "took %ld.%03ld secs", msecs / 1000, msecs % 1000 );
 
   // Say goodbye
-  LOGPRINT( LVL_VERB, "intializeHardware(): Returning: SUCCESS" );
+  LOGPRINT( LVL_VERB, "initializeDevices(): Returning: %s",
+            ret == SUCCESS ? "SUCCESS" : "FAILURE" );
 
-  return( SUCCESS );
+  return( ret );
 }
 
 
@@ -228,34 +639,14 @@ int hasSerialDevice ( int deviceType )
 {
   struct sPort *port;
 
-  // Say hi
-  LOGPRINT( LVL_VERB, "hasSerialDevice( %d ): Entered", deviceType );
+  if ( ( port = findPort( deviceType ) ) == NULL )
+    return( -1 );
 
-  port = opts.serialPorts;
-  while ( port != NULL ) 
-  {
-    if ( port->deviceType == deviceType  )
-    {
-      // TODO: A kludgy test for serial type.  This should be a member
-      // of the sPort structure!
-      if ( port->vendorID != 0 )
-      {
-        LOGPRINT( LVL_VERB, 
-                 "hasSerialDevice(): Returning true ( 2 )" );
-        return( 2 );
-      }else 
-      {
-        LOGPRINT( LVL_VERB, 
-                 "hasSerialDevice(): Returning true ( 1 )" );
-        return( 1 );
-      }
-   }
-    port = port->nextPort;
-  }
-  
-  LOGPRINT( LVL_VERB, 
-            "hasSerialDevice(): Returning false ( -1 )" );
-  return ( -1 );
+  // TODO: A kludgy test for serial type.  This should be a member
+  // of the sPort structure!
+  if ( port->vendorID != 0 )
+    return( 2 );
+  return( 1 );
 }
 
 //
@@ -281,52 +672,29 @@ struct sPort *getSerialDevice ( int deviceType )
 {
   struct sPort *port;
 
-  // Say hi
-  LOGPRINT( LVL_VERB, "getSerialDevice(): Entered" );
+  if ( ( port = findPort( deviceType ) ) == NULL )
+    return( NULL );
 
-  port = opts.serialPorts;
-  while ( port != NULL ) 
+  if ( port->vendorID != 0 )
   {
-    if ( port->deviceType == deviceType  )
-    {
-      if ( port->vendorID != 0 )
-      {
-        if ( port->ftdiContext == NULL )
-        {
-          // We need to open the USB port before returning
-          if ( getUSBDeviceContext( deviceType ) == NULL )
-          {
-            return( NULL );
-          }
-        }
-        // We have a USB port and it's opened
-        return( port );
-      }else if ( port->tty != NULL )
-      {
-        if ( port->fileDescriptor == -1 )
-        {
-          // We need to open the serial port before returning
-          if ( getDeviceFileDescriptor( deviceType ) == -1 )
-          {
-            return( NULL );
-          }
-        }
-        // We have a standard serial port and it's opened
-        return( port );
-      }else
-      {
-        LOGPRINT( LVL_WARN, 
-              "getSerialDevice(): Could not determine the "
-              "the serial device type ( usb/serial )!" );
-        return( NULL );
-      }
-    }
-    port = port->nextPort;
+    // Open the USB port if necessary
+    if ( port->ftdiContext == NULL && 
+         getUSBDeviceContext( deviceType ) == NULL )
+      return( NULL );
+    return( port );
+  }else if ( port->tty != NULL )
+  {
+    // Open the standard serial port if necessary
+    if ( port->fileDescriptor == -1 && 
+         getDeviceFileDescriptor( deviceType ) == -1 )
+      return( NULL );
+    return( port );
   }
-  
-  LOGPRINT( LVL_VERB, 
-            "getSerialDevice(): Returning false ( NULL )" );
-  return ( NULL );
+
+  LOGPRINT( LVL_WARN, 
+            "getSerialDevice(): Could not determine the "
+            "the serial device type ( usb/serial )!" );
+  return( NULL );
 }
 
 
@@ -347,43 +715,30 @@ struct sPort *getSerialDevice ( int deviceType )
 //
 // RETURNS
 //   The device type on the other end of the hydro wire.
-//   Currently one of:
+//   This is the first port in opts.serialPorts ( config
+//   file order ) whose driver is flagged DRIVER_HYDROWIRE,
+//   currently one of:
 //     SEABIRD_CTD_19
 //     SEABIRD_CTD_19_PLUS 
 //     ENVIROTECH_ECOLAB
 //     SATLANTIC_ISIS
 //     SATLANTIC_ISIS_X
 //
-//   See buoy.h for device types
+//   See orcad.h for device types
 //   This function will return -1 if it fails.
 //
 int getHydroWireDeviceType ()
 {
+  const struct deviceDriver *driver;
   struct sPort *port;
 
-  // Say hi
-  LOGPRINT( LVL_VERB, "getHydroWireDeviceType(): Entered" );
-
-  port = opts.serialPorts;
-  while ( port != NULL ) 
+  for ( port = opts.serialPorts; port != NULL; port = port->nextPort )
   {
-    if ( port->deviceType == SEABIRD_CTD_19 || 
-         port->deviceType == SEABIRD_CTD_19_PLUS ||
-         port->deviceType == ENVIROTECH_ECOLAB ||
-         port->deviceType == SATLANTIC_ISIS ||
-         port->deviceType == SATLANTIC_ISIS_X ) 
-    {
-      LOGPRINT( LVL_VERB, 
-                "getHydroWireDeviceType(): Returning device number %d", 
-                port->deviceType );
+    driver = getDeviceDriver( port->deviceType );
+    if ( driver != NULL && ( driver->flags & DRIVER_HYDROWIRE ) )
       return( port->deviceType );
-    }
-    port = port->nextPort;
   }
-  
-  LOGPRINT( LVL_VERB, 
-            "getHydroWireDeviceType(): Returning: -1" );
-  return ( FAILURE );
+  return( FAILURE );
 }
 
 
@@ -410,16 +765,7 @@ struct ftdi_context * getUSBDeviceContext ( int deviceType )
   struct ftdi_context *ftdic;
   int ftdiRetVal = 0;
 
-  // Say hi
-  LOGPRINT( LVL_VERB, "getUSBDeviceContext(): Entered" );
-
-  usbPort = opts.serialPorts;
-  while ( usbPort != NULL ) 
-  {
-    if ( usbPort->deviceType == deviceType )
-      break;
-    usbPort = usbPort->nextPort;
-  }
+  usbPort = findPort( deviceType );
   if ( usbPort == NULL || usbPort->vendorID == 0 )
   {
     LOGPRINT( LVL_WARN, 
@@ -497,16 +843,7 @@ int getDeviceFileDescriptor ( int deviceType )
   struct sPort *port;
   int fd, r;
 
-  // Say hi
-  LOGPRINT( LVL_VERB, "getDeviceFileDescriptor(): Entered" );
-
-  port = opts.serialPorts;
-  while ( port != NULL ) 
-  {
-    if ( port->deviceType == deviceType )
-      break;
-    port = port->nextPort;
-  }
+  port = findPort( deviceType );
   if ( port == NULL || port->tty == NULL )
   {
     LOGPRINT( LVL_WARN, 
@@ -586,17 +923,7 @@ int closeDeviceFileDescriptor ( int deviceType )
 {
   struct sPort *port;
 
-  // Say hi
-  LOGPRINT( LVL_VERB, "closeDeviceFileDescriptor(): Entered" );
-
-  port = opts.serialPorts;
-  while ( port != NULL ) 
-  {
-    if ( port->deviceType == deviceType )
-      break;
-    port = port->nextPort;
-  }
-  if ( port == NULL )
+  if ( ( port = findPort( deviceType ) ) == NULL )
   {
     LOGPRINT( LVL_WARN, 
               "closeDeviceFileDescriptor(): Could not find port for "
@@ -611,8 +938,6 @@ int closeDeviceFileDescriptor ( int deviceType )
     port->fileDescriptor = -1;
   }
 
-  // Say goodbye
-  LOGPRINT( LVL_VERB, "closeDeviceFileDescriptor(): Returning: 1" );
   return( SUCCESS );
  
 }
@@ -22,13 +22,21 @@
 #ifndef _BUOY_H
 #define _BUOY_H
 
+struct deviceDriver;      // See orcad.h
+struct sPort;
+
 int initializeHardware();
+int initializeDevices( int newOnly );
 int closeDeviceFileDescriptor( int deviceType );
 int getDeviceFileDescriptor( int deviceType );
 int getHydroWireDeviceType();
 struct sPort *getSerialDevice( int deviceType );
 int hasSerialDevice( int deviceType );
 struct ftdi_context * getUSBDeviceContext( int deviceType );
+int registerDeviceDriver( const struct deviceDriver *driver );
+const struct deviceDriver *getDeviceDriver( int deviceType );
+int indexSerialPorts( void );
+int adoptSerialPorts( struct sPort *oldPorts );
 
 
 #endif
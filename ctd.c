@@ -21,6 +21,7 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <math.h>
 #include <time.h>
 #include <unistd.h>
@@ -30,7 +31,10 @@
 #include "log.h"
 #include "orcad.h"
 #include "serial.h"
+#include "term.h"
 #include "general.h"
+#include "ctdstream.h"
+#include "fieldparse.h"
 
 
 // Useful info for time routines
@@ -207,6 +211,43 @@ double convertDBToDepth ( double db )
 }
 
 
+//
+// NAME
+//   convertDBToDepthBatch - Convert an array of pressures into depths
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   void convertDBToDepthBatch( const double *db, double *depth, long n );
+//
+// DESCRIPTION
+//   Same conversion as convertDBToDepth() but for n pressures
+//   at once.  The latitude term is only computed once, which
+//   matters when converting whole cast files.  Pressures which
+//   give a non-positive gravity get a depth of -1.
+//
+// RETURNS
+//   The depths are written to the depth array.
+//
+void convertDBToDepthBatch ( const double *db, double *depth, long n ) 
+{
+  double x, gr0, gr, p;
+  long i;
+
+  x = pow( sin( BOUY_LATITUDE / 57.29578 ), 2.0 );
+  gr0 = 9.780318 * ( 1.0 + ( 5.2788e-3 + 2.36e-5 * x ) * x );
+
+  for ( i = 0; i < n; i++ )
+  {
+    p = db[i];
+    gr = gr0 + 1.092e-6 * p;
+    depth[i] = ( gr > 0 ) ? 
+      ((((-1.82e-15 * p + 2.279e-10) * p - 2.2512e-5) * p + 9.72659) * p) / gr :
+      -1.0;
+  }
+}
+
+
 //
 // NAME
 //   getCTD19SPrompt - Obtain an "S>" prompt from a Seabird CTD 19
@@ -397,6 +438,9 @@ int stopLoggingCTD19 ( int ctdFD )
   // Say hello
   LOGPRINT( LVL_VERB, "stopLoggingCTD19(): Called" );
 
+  // The stream is about to be interrupted
+  resetCTDStream( ctdFD );
+
   if ( serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "\n" ) != 26 )  
     if ( serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "\n" ) != 26 )  
       if ( serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "\n" ) != 26 )  
@@ -449,6 +493,7 @@ int startLoggingCTD19 ( int ctdFD )
 
   // Say hello
   LOGPRINT( LVL_VERB, "startLoggingCTD19(): Called" );
+  resetCTDStream( ctdFD );
 
   // Normalize the CTD state by getting an "S>" prompt
   if ( ( baud = getCTD19SPrompt( ctdFD ) ) != 600 )
@@ -576,18 +621,21 @@ double getCTD19Pressure ( int ctdFD )
   char buffer[CTDBUFFLEN];
   double P=0.0;
 
-  term_flush( ctdFD );
+  // Record what has arrived since we last looked and
+  // then wait for a fresh record.
+  drainCTDStream( ctdFD );
   if ( ( bytesRead = 
-           serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" ) ) != 26 ) 
+           readCTDStreamLine( ctdFD, buffer, CTDBUFFLEN, 1000L ) ) != 26 ) 
     if ( ( bytesRead = 
-             serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" ) ) != 26 ) 
+             readCTDStreamLine( ctdFD, buffer, CTDBUFFLEN, 1000L ) ) != 26 ) 
       if ( ( bytesRead = 
-              serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" ) ) != 26 ) 
+              readCTDStreamLine( ctdFD, buffer, CTDBUFFLEN, 1000L ) ) != 26 ) 
       {
         // Couldn't get a data record!
         return( FAILURE );
       }
             
+  recordCTDStreamLine( buffer );
   htoP(buffer,20,23,&P); 
   return( P );
 }
@@ -600,14 +648,16 @@ double getCTD19Pressure ( int ctdFD )
 // SYNOPSIS
 //   #include "ctd.h"
 //
-//   int downloadCTD19Data( int ctdFD, FILE *outFile );
+//   int downloadCTD19Data( int ctdFD, FILE *outFile, int useMark );
 //
 // DESCRIPTION
 //   Communicate with a Seabird 19 CTD and download
 //   all the stored casts to a file.  Communications
 //   to the CTD oocur through a pre-initialized file
 //   descriptor port. Data output goes directly to
-//   a pre-initialized output file descriptor.
+//   a pre-initialized output file descriptor.  No
+//   high-water mark is kept for the 19 so useMark
+//   is ignored.
 //
 //   The communications with the CTD are provided through
 //   an open/initialized file descriptor ctdFD.  The output
@@ -630,7 +680,7 @@ double getCTD19Pressure ( int ctdFD )
 //         number of samples and check the data width of
 //         each as they come in.
 //
-int downloadCTD19Data ( int ctdFD, FILE * outFile ) 
+int downloadCTD19Data ( int ctdFD, FILE * outFile, int useMark ) 
 {
   int baudRate = 600;
   int bytesRead;
@@ -933,46 +983,93 @@ int setCTD19Time ( int ctdFD, struct tm *time ) {
 //
 void htoP ( char str[], int startc, int endc, double *P)
 {
-  int i, sign;
   long n;
+  long magMask;
 
-  n=0L;
-  sign=1;
-
-  // turn first hex character into decimal 
-  i=startc;
-  if (str[i] >= '0' && str[i] <= '9') n=16*n + (str[i]-'0');
-  else if (str[i] >= 'A' && str[i] <= 'F') n=16*n + (str[i]-'A'+10);
-  else if (str[i] >= 'a' && str[i] <= 'f') n=16*n + (str[i]-'a'+10);
-  else 
+  if ( ( n = hexToLong( str + startc, endc - startc + 1 ) ) < 0 )
   {
-    LOGPRINT( LVL_ALRT, "htoP(): Error in hex value! (%c)", str[i] );
-  } 
-
-  // disregard bit 15 
-  if(n>=8) n=n-8;
-  // interpret bit 14 as the sign 
-  if(n>=4) 
-  {
-    n=n-4;
-    sign=-sign;
+    LOGPRINT( LVL_ALRT, "htoP(): Error in hex value! (%.*s)", 
+              endc - startc + 1, str + startc );
+    *P = -1.0;
+    return;
   }
 
-  // interpret bits 0-13 as the magnitude 
-  for(i=startc+1; i<=endc && str[i] != '\0';i++)
+  // disregard the top bit, interpret the next as the
+  // sign and the rest as the magnitude
+  magMask = ( 1L << ( 4 * ( endc - startc + 1 ) - 2 ) ) - 1;
+  if ( n & ( magMask + 1 ) )
+    n = -( n & magMask );
+  else
+    n = n & magMask;
+
+  *P = convertCTD19Pressure( n );
+} 
+
+
+//
+// NAME
+//   convertCTD19Pressure - Apply the CTD 19 pressure calibration
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   double convertCTD19Pressure( long n );
+//
+// DESCRIPTION
+//   Convert a signed CTD 19 pressure count ( see htoP() ) to
+//   decibars of water using the ctd_cal_PA1..PA3 coefficients
+//   and assuming the atmosphere is 9.6 decibars.
+//
+// RETURNS
+//   The pressure in decibars.
+//
+double convertCTD19Pressure ( long n )
+{
+  //*P=(248.24555-6.524518E-2*n+5.430179E-8*n*n)*0.689476-9.6;
+  return( ( opts.ctdCalPA1 + opts.ctdCalPA2*n + opts.ctdCalPA3*n*n ) *
+          0.689476 - 9.6 );
+}
+
+
+//
+// NAME
+//   hexToLong - Table driven conversion of a hex field
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   long hexToLong( const char *str, int len );
+//
+// DESCRIPTION
+//   Convert up to len hex characters ( either case ) at str
+//   into a number using a lookup table rather than range
+//   checks.  Conversion stops early at a NUL.  Fields up to
+//   7 characters wide are supported.
+//
+// RETURNS
+//   The value or -1 if a non-hex character was found.
+//
+long hexToLong ( const char *str, int len )
+{
+  // Digit value + 1 so that the default 0 marks a bad character
+  static const unsigned char hexTable[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+    ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+  };
+  long n = 0;
+  unsigned char bad = 1;
+  int i;
+
+  for ( i = 0; i < len && str[i] != '\0'; i++ )
   {
-    if (str[i] >= '0' && str[i] <= '9') n=16*n + (str[i]-'0');
-    else if (str[i] >= 'A' && str[i] <= 'F') n=16*n + (str[i]-'A'+10);
-    else if (str[i] >= 'a' && str[i] <= 'f') n=16*n + (str[i]-'a'+10);
-    else printf("error in hex conv");
+    bad &= ( hexTable[(unsigned char)str[i]] != 0 );
+    n = ( n << 4 ) | ( hexTable[(unsigned char)str[i]] - 1 );
   }
-  n=sign*n;
-  // 
-  //  CONVERT P TO DECIBARS OF WATER ASSUMING ATMOSPHERE IS 9.5 DECIBARS
-  // 
-  //*P=(248.24555-6.524518E-2*n+5.430179E-8*n*n)*0.689476-9.6;
-  *P=( opts.ctdCalPA1 + opts.ctdCalPA2*n + opts.ctdCalPA3*n*n )*0.689476-9.6;
-} 
+
+  return( bad ? n : -1 );
+}
 
 
 
@@ -1007,6 +1104,11 @@ int initCTD19Plus ( int ctdFD ) {
   // Say hello
   LOGPRINT( LVL_VERB, "initCTD19Plus(): Called" );
 
+  // An interrupted upload can leave the CTD at a faster baud
+  // than the one we talk to it at.  Fix that before anything
+  // else.
+  recoverCTD19PlusBaud( ctdFD );
+
   // Start off with the S> prompt.  This ensures
   // that we are not logging when we attempt to
   // set the CTDs parameters.
@@ -1286,6 +1388,7 @@ int stopLoggingCTD19Plus ( int ctdFD )
   // Say hello
   LOGPRINT( LVL_VERB, "stopLoggingCTD19(): Called" );
 
+  resetCTDStream( ctdFD );
   return( getCTD19PlusSPrompt( ctdFD ) );
 }
 
@@ -1301,7 +1404,10 @@ int stopLoggingCTD19Plus ( int ctdFD )
 //
 // DESCRIPTION
 //   Initiate Seabird CTD 19+ logging through the use of the
-//   Go Log "STARTNOW" command.
+//   Go Log "STARTNOW" command.  The logger memory is only
+//   re-initialized ( INITLOGGING ) once fewer than
+//   CTD19PLUS_MIN_FREE samples remain free, otherwise the new
+//   cast is appended to the samples already in memory.
 //
 // RETURNS
 //   Returns 1 for success and -1 for failure.  The
@@ -1313,14 +1419,38 @@ int startLoggingCTD19Plus ( int ctdFD )
   int failed;
   int bytesRead;
   char buffer[CTDBUFFLEN];
+  char serial[CTDSERIALMAX];
+  long samples = -1;
+  long freeSamples = -1;
+  long lastSample;
 
   // Say hello
   LOGPRINT( LVL_VERB, "startLoggingCTD19Plus(): Called" );
+  resetCTDStream( ctdFD );
+
+  // Only clear the logger memory when it is close to full.  Until
+  // then each cast is appended and downloadCTD19PlusData() uploads
+  // just the new samples.
+  failed = 1;
+  if ( getCTD19PlusSampleInfo( ctdFD, NULL, serial, &samples, 
+                               &freeSamples, NULL ) > 0 &&
+       freeSamples >= CTD19PLUS_MIN_FREE )
+  {
+    LOGPRINT( LVL_INFO, "startLoggingCTD19Plus(): Appending to memory "
+              "( samples = %ld, free = %ld )", samples, freeSamples );
+    failed = 0;
+  }else if ( samples > 0 )
+  {
+    lastSample = readCTDHighWater( serial );
+    if ( lastSample < samples )
+      LOGPRINT( LVL_WARN, "startLoggingCTD19Plus(): Re-initializing "
+                "memory with %ld samples not yet downloaded!", 
+                samples - lastSample );
+  }
 
   // New code to support both 19Plus V1 and V2
   retries = 0;
-  failed = 1;
-  do { 
+  while ( failed && retries < 3 ) { 
 
     // Normalize the CTD state by getting an "S>" prompt
     if ( getCTD19PlusSPrompt( ctdFD ) < 1 )
@@ -1374,7 +1504,12 @@ int startLoggingCTD19Plus ( int ctdFD )
                    buffer, retries );
        } 
     }
-  }while ( failed && (retries++ < 2) );
+
+    // Sample numbering restarts at 1 after INITLOGGING
+    if ( ! failed && samples >= 0 )
+      writeCTDHighWater( serial, 0 );
+    retries++;
+  }
 
   if ( failed ) 
   {
@@ -1461,7 +1596,8 @@ int startLoggingCTD19Plus ( int ctdFD )
 //   format the CTD 19+ displays as the first 3 comma seperated
 //   floating point numbers: temperature, conductivity and 
 //   pressure ( in decibars ).  This routine captures the
-//   pressure value and returns it.
+//   pressure value and returns it.  Every line read along the
+//   way is handed to the stream recorder ( see ctdstream.c ).
 //
 // RETURNS
 //   The pressure in decibars or -1 for in the event of failure.
@@ -1474,16 +1610,24 @@ double getCTD19PlusPressure ( int ctdFD )
   int numAttempts = 3;
   int numConv = 0;
   char buffer[CTDBUFFLEN];
-  double temperature, conductivity, pressure;
+  char *fields[4];
+  double pressure;
     
-  // Flush and resync ourselves on a line
-  term_flush( ctdFD );
-  serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" ); 
+  // Record what has arrived since we last looked and
+  // then wait for a fresh line.  readCTDStreamLine() only
+  // hands back complete lines so there is no need to resync.
+  drainCTDStream( ctdFD );
   do  
   {
-    serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" ); 
-    numConv = sscanf( buffer, "%lf,%lf,%lf", 
-                      &temperature, &conductivity, &pressure );
+    numConv = 0;
+    if ( readCTDStreamLine( ctdFD, buffer, CTDBUFFLEN, 1000L ) > 0 )
+    {
+      recordCTDStreamLine( buffer );
+      // temperature, conductivity, pressure[, ...]
+      if ( splitFields( buffer, ',', fields, 4 ) >= 3 &&
+           parseDoubleField( fields[2], &pressure ) == SUCCESS )
+        numConv = 3;
+    }
   }while ( numAttempts-- > 0 && numConv != 3 );
 
   if ( numConv == 3 )  
@@ -1495,50 +1639,787 @@ double getCTD19PlusPressure ( int ctdFD )
 }
 
 
-// 
+// The rates the 19plus can be set to, fastest first
+static const int ctd19PlusBauds[] = { 115200, 57600, 38400, 19200, 
+                                      9600, 4800, 2400, 1200, 0 };
+
+
+//
 // NAME
-//   downloadCTD19PlusData - Download CTD 19 historical data to a file
-// 
+//   sendCTD19PlusBaud - Ask the CTD 19+ to switch baud rates
+//
+// SYNOPSIS
+//   static int sendCTD19PlusBaud( int ctdFD, int baud );
+//
+// DESCRIPTION
+//   Send the "BAUD=" command at the current port rate.  The
+//   19plus V2 asks for the command to be repeated before it
+//   will change rates, the V1 changes right away.  The port
+//   itself is not changed.
+//
+// RETURNS
+//   1 if the command was echoed, -1 otherwise.
+//
+static int sendCTD19PlusBaud ( int ctdFD, int baud )
+{
+  char cmdBuff[CTDBUFFLEN];
+  char echoBuff[CTDBUFFLEN];
+  char buffer[CTDBUFFLEN];
+
+  snprintf( cmdBuff, CTDBUFFLEN, "BAUD=%d\r", baud );
+  snprintf( echoBuff, CTDBUFFLEN, "BAUD=%d\r\n", baud );
+
+  term_flush( ctdFD );
+  if ( serialChat( ctdFD, cmdBuff, echoBuff, 1000L, "\r\n" ) < 1 )
+    return( FAILURE );
+
+  // V2: "this command will change the baud rate...repeat the command"
+  buffer[0] = '\0';
+  serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" );
+  if ( strstr( buffer, "this command will" ) != NULL )
+  {
+    serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" );
+    term_flush( ctdFD );
+    if ( serialChat( ctdFD, cmdBuff, echoBuff, 1000L, "\r\n" ) < 1 )
+      return( FAILURE );
+  }
+
+  // Give the CTD a moment to switch over
+  term_drain( ctdFD );
+  usleep( 250000 );
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   testCTD19PlusLink - Check the CTD 19+ link quality at the current baud
+//
+// SYNOPSIS
+//   static int testCTD19PlusLink( int ctdFD );
+//
+// DESCRIPTION
+//   Request the status paragraph ( "DS" ) CTD19PLUS_BAUD_TESTS
+//   times and check that it comes back complete and clean.
+//   Framing errors at a baud the cable can't sustain show up
+//   as non-printing bytes or as a missing "samples =" line.
+//
+// RETURNS
+//   1 if every round trip was clean, -1 otherwise.
+//
+static int testCTD19PlusLink ( int ctdFD )
+{
+  int bytesRead;
+  int test;
+  int i;
+  int gotSamples;
+  char buffer[CTDBUFFLEN];
+
+  for ( test = 0; test < CTD19PLUS_BAUD_TESTS; test++ )
+  {
+    term_flush( ctdFD );
+    if ( serialPutLine( ctdFD, "DS\r" ) < 1 )
+      return( FAILURE );
+
+    gotSamples = 0;
+    while ( ( bytesRead = 
+               serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" ) ) > 0 ) 
+    {
+      for ( i = 0; i < bytesRead; i++ )
+      {
+        if ( ! isprint( (int)(unsigned char)buffer[i] ) && 
+             buffer[i] != '\r' && buffer[i] != '\n' && buffer[i] != '\t' )
+        {
+          LOGPRINT( LVL_DEBG, "testCTD19PlusLink(): Garbled byte 0x%02x "
+                    "in status output", (unsigned char)buffer[i] );
+          return( FAILURE );
+        }
+      }
+      if ( strstr( buffer, "samples =" ) != NULL )
+        gotSamples = 1;
+    }
+
+    if ( ! gotSamples )
+    {
+      LOGPRINT( LVL_DEBG, "testCTD19PlusLink(): Incomplete status output" );
+      return( FAILURE );
+    }
+  }
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   setCTD19PlusBaud - Switch both the CTD 19+ and the port to a new baud
+//
 // SYNOPSIS
 //   #include "ctd.h"
 //
-//   int downloadCTD19PlusData( int ctdFD, FILE *outFile );
+//   int setCTD19PlusBaud( int ctdFD, int baud );
 //
 // DESCRIPTION
-//   Communicate with a Seabird 19+ CTD and download
-//   all the stored casts to a file.  Communications
-//   to the CTD oocur through a pre-initialized file
-//   descriptor port. Data output goes directly to
-//   a pre-initialized output file descriptor.
+//   Ask the CTD to change to the given baud rate, change the
+//   serial port to match and check that an "S>" prompt can be
+//   had at the new rate.  If the CTD can't be reached at the
+//   new rate the port is switched back and the CTD is checked
+//   at the old rate ( in case it never got the command ).
+//
+// RETURNS
+//   1 if the CTD answers at the new rate, 0 if it is still
+//   answering at the old rate and -1 if it can't be reached
+//   at either.
+//
+int setCTD19PlusBaud ( int ctdFD, int baud )
+{
+  int oldBaud;
+  int attempts;
+
+  if ( ( oldBaud = term_get_baudrate( ctdFD ) ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "setCTD19PlusBaud(): Could not get the current "
+              "port baud!" );
+    return( FAILURE );
+  }
+  if ( oldBaud == baud )
+    return( SUCCESS );
+
+  LOGPRINT( LVL_DEBG, "setCTD19PlusBaud(): Switching from %d to %d baud",
+            oldBaud, baud );
+
+  sendCTD19PlusBaud( ctdFD, baud );
+
+  term_set_baudrate( ctdFD, baud );
+  if ( term_apply( ctdFD ) < 0 ) 
+  {
+    LOGPRINT( LVL_WARN, "setCTD19PlusBaud(): Failed to change serial "
+              "port baud to %d!", baud );
+    return( FAILURE );
+  }
+  term_flush( ctdFD );
+
+  for ( attempts = 0; attempts < 3; attempts++ )
+    if ( serialChat( ctdFD, "\r", "\r\nS>", 500L, ">" ) > 0 )
+      return( SUCCESS );
+
+  // Didn't take...see if the CTD is still at the old rate
+  term_set_baudrate( ctdFD, oldBaud );
+  if ( term_apply( ctdFD ) < 0 ) 
+  {
+    LOGPRINT( LVL_WARN, "setCTD19PlusBaud(): Failed to change serial "
+              "port baud back to %d!", oldBaud );
+    return( FAILURE );
+  }
+  term_flush( ctdFD );
+
+  for ( attempts = 0; attempts < 3; attempts++ )
+    if ( serialChat( ctdFD, "\r", "\r\nS>", 500L, ">" ) > 0 )
+      return( 0 );
+
+  LOGPRINT( LVL_WARN, "setCTD19PlusBaud(): Lost contact with the CTD "
+            "switching from %d to %d baud!", oldBaud, baud );
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   negotiateCTD19PlusBaud - Find the fastest usable baud for an upload
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   int negotiateCTD19PlusBaud( int ctdFD, int maxBaud );
+//
+// DESCRIPTION
+//   Step down through the 19plus baud rates, starting at
+//   maxBaud, until one is found at which the link passes
+//   testCTD19PlusLink().  A rate that fails is backed out of
+//   before trying the next one.  Rates at or below the port's
+//   current ( logging ) rate are not tried.  The CTD and port
+//   are left at the chosen rate; use setCTD19PlusBaud() to
+//   restore the logging rate afterwards.
+//
+// RETURNS
+//   The baud rate in use when done ( the logging rate if no
+//   faster rate worked ), or -1 if contact with the CTD was lost.
+//
+int negotiateCTD19PlusBaud ( int ctdFD, int maxBaud )
+{
+  int logBaud;
+  int ret;
+  int i;
+
+  if ( ( logBaud = term_get_baudrate( ctdFD ) ) < 0 )
+    return( FAILURE );
+
+  for ( i = 0; ctd19PlusBauds[i] > logBaud; i++ )
+  {
+    if ( ctd19PlusBauds[i] > maxBaud )
+      continue;
+
+    if ( ( ret = setCTD19PlusBaud( ctdFD, ctd19PlusBauds[i] ) ) < 0 )
+      return( FAILURE );
+    if ( ret == 0 )
+      continue;
+
+    if ( testCTD19PlusLink( ctdFD ) > 0 )
+    {
+      LOGPRINT( LVL_INFO, "negotiateCTD19PlusBaud(): Using %d baud",
+                ctd19PlusBauds[i] );
+      return( ctd19PlusBauds[i] );
+    }
+
+    LOGPRINT( LVL_INFO, "negotiateCTD19PlusBaud(): Link test failed at "
+              "%d baud", ctd19PlusBauds[i] );
+    if ( setCTD19PlusBaud( ctdFD, logBaud ) < 0 )
+      return( FAILURE );
+  }
+
+  return( logBaud );
+}
+
+
+//
+// NAME
+//   probeCTD19PlusBaud - Is the CTD 19+ talking at the port's baud?
+//
+// SYNOPSIS
+//   static int probeCTD19PlusBaud( int ctdFD );
+//
+// DESCRIPTION
+//   Wake the CTD and look for an "S>" prompt.  A CTD which is
+//   logging may not give one, so a line of the OUTPUTFORMAT=3
+//   data stream is also taken as proof that the rate is right.
+//   At the wrong rate neither shows up intact.
+//
+// RETURNS
+//   1 if the CTD answered, -1 otherwise.
+//
+static int probeCTD19PlusBaud ( int ctdFD )
+{
+  char buffer[CTDBUFFLEN];
+  char *fields[4];
+  double value;
+  int i;
+
+  // If the CTD is sleeping it will take up to 1450ms
+  // to get a response.
+  term_flush( ctdFD );
+  serialPutLine( ctdFD, "\r\r\r" );
+  if ( serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "S>" ) > 0 &&
+       strstr( buffer, "S>" ) != NULL )
+    return( SUCCESS );
+
+  for ( i = 0; i < 3; i++ )
+  {
+    if ( serialGetLine( ctdFD, buffer, CTDBUFFLEN, 1000L, "\n" ) > 0 &&
+         splitFields( buffer, ',', fields, 4 ) >= 3 &&
+         parseDoubleField( fields[0], &value ) == SUCCESS &&
+         parseDoubleField( fields[2], &value ) == SUCCESS )
+      return( SUCCESS );
+  }
+
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   recoverCTD19PlusBaud - Bring a CTD 19+ back to the port's baud
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   int recoverCTD19PlusBaud( int ctdFD );
+//
+// DESCRIPTION
+//   The 19plus remembers "BAUD=".  If orcad dies or loses
+//   power during a fast upload ( see negotiateCTD19PlusBaud() )
+//   the CTD is left at the upload rate and no longer answers
+//   at the configured rate the port was opened with.  If the
+//   CTD does not answer at the port's rate try each of the
+//   other 19plus rates and, once it is found, switch it back
+//   with setCTD19PlusBaud().  The port is always left at the
+//   rate it started at.
+//
+// RETURNS
+//   1 if the CTD answers at the port's rate, -1 if it could
+//   not be found at any rate.
+//
+int recoverCTD19PlusBaud ( int ctdFD )
+{
+  int portBaud;
+  int i;
+
+  if ( ( portBaud = term_get_baudrate( ctdFD ) ) < 0 )
+    return( FAILURE );
+
+  if ( probeCTD19PlusBaud( ctdFD ) > 0 )
+    return( SUCCESS );
+
+  for ( i = 0; ctd19PlusBauds[i] > 0; i++ )
+  {
+    if ( ctd19PlusBauds[i] == portBaud )
+      continue;
+
+    term_set_baudrate( ctdFD, ctd19PlusBauds[i] );
+    if ( term_apply( ctdFD ) < 0 )
+      break;
+    if ( probeCTD19PlusBaud( ctdFD ) < 0 )
+      continue;
+
+    LOGPRINT( LVL_ALRT, "recoverCTD19PlusBaud(): Found the CTD at %d baud. "
+              "Setting it back to %d baud.", ctd19PlusBauds[i], portBaud );
+    if ( setCTD19PlusBaud( ctdFD, portBaud ) > 0 )
+      return( SUCCESS );
+    break;
+  }
+
+  term_set_baudrate( ctdFD, portBaud );
+  if ( term_apply( ctdFD ) < 0 )
+    LOGPRINT( LVL_WARN, "recoverCTD19PlusBaud(): Failed to change serial "
+              "port baud back to %d!", portBaud );
+  term_flush( ctdFD );
+  LOGPRINT( LVL_WARN, "recoverCTD19PlusBaud(): The CTD did not answer at "
+            "any baud rate!" );
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   isCTDChatter - Is this line a command echo or prompt?
+//
+// SYNOPSIS
+//   static int isCTDChatter( char *line, char *command );
+//
+// DESCRIPTION
+//   Lines read back while uploading include the echo of the
+//   command sent and the "S>" prompt which follows the data.
+//   Neither belongs in the cast file.
+//
+// RETURNS
+//   1 if the line should be dropped, 0 otherwise.
+//
+static int isCTDChatter ( char *line, char *command )
+{
+  while ( *line == '\r' || *line == '\n' || *line == ' ' )
+    line++;
+  if ( *line == '\0' || strncmp( line, "S>", 2 ) == 0 )
+    return( 1 );
+  if ( strncasecmp( line, command, strlen( command ) ) == 0 )
+    return( 1 );
+  return( 0 );
+}
+
+
+//
+// NAME
+//   isDSFlagSet - Is "name = yes" in a line of the DS output?
+//
+// SYNOPSIS
+//   static int isDSFlagSet( const char *line, const char *name );
+//
+// RETURNS
+//   1 if it is, 0 otherwise.
+//
+static int isDSFlagSet ( const char *line, const char *name )
+{
+  const char *ptr;
+
+  if ( ( ptr = strstr( line, name ) ) == NULL )
+    return( 0 );
+  ptr += strlen( name );
+  while ( *ptr != '\0' && *ptr != '=' && *ptr != ',' )
+    ptr++;
+  if ( *ptr != '=' )
+    return( 0 );
+  ptr++;
+  while ( *ptr == ' ' )
+    ptr++;
+  return( strncmp( ptr, "yes", 3 ) == 0 );
+}
+
+
+//
+// NAME
+//   getCTD19PlusSampleInfo - Read the serial number and sample counts
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   int getCTD19PlusSampleInfo( int ctdFD, FILE *outFile, char *serial,
+//                               long *samples, long *freeSamples,
+//                               int *scanWidth );
+//
+// DESCRIPTION
+//   Issue the "DS" command and pick the serial number and the
+//   "samples = n, free = m" counts out of the status paragraph.
+//   The serial buffer must hold CTDSERIALMAX characters.  If
+//   outFile is not NULL the status paragraph is also written
+//   to it.  If scanWidth is not NULL it is set to the width
+//   of a raw HEX profiling scan: CTD19PLUS_SCAN_BASELEN plus
+//   CTD19PLUS_SCAN_VOLTLEN for each "Ext Volt n = yes".  When
+//   a serial sensor ( SBE 38, SBE 50, WETLABS, OPTODE, GTD )
+//   is enabled the width can not be worked out and is set to 0.
+//
+// RETURNS
+//   1 if the sample counts were found, -1 otherwise.  Counts
+//   which could not be parsed are left at -1.
+//
+int getCTD19PlusSampleInfo ( int ctdFD, FILE *outFile, char *serial,
+                             long *samples, long *freeSamples,
+                             int *scanWidth )
+{
+  static const char *serialSensors[] = { "sbe 38", "sbe 50", "wetlabs",
+                                         "optode", "gas tension", NULL };
+  int bytesRead;
+  int numVolts = 0;
+  int extraSensors = 0;
+  int i;
+  char buffer[CTDBUFFLEN];
+  char lower[CTDBUFFLEN];
+  char name[16];
+  char *ptr;
+
+  // Say hello
+  LOGPRINT( LVL_VERB, "getCTD19PlusSampleInfo(): Called" );
+
+  strcpy( serial, "unknown" );
+  *samples = -1;
+  *freeSamples = -1;
+  if ( scanWidth != NULL )
+    *scanWidth = 0;
+
+  // Normalize the CTD state by getting an "S>" prompt
+  if ( getCTD19PlusSPrompt( ctdFD ) < 1 )
+  {
+    LOGPRINT( LVL_WARN, "getCTD19PlusSampleInfo(): All attempts "
+              "at obtaining an S> prompt failed." );
+    return( FAILURE );
+  }
+
+  serialPutLine( ctdFD, "DS\r" );
+  while ( ( bytesRead = 
+             serialGetLine( ctdFD, buffer, CTDBUFFLEN, 4000L, "\n" ) ) > 0 ) 
+  {
+    if ( outFile != NULL && ! isCTDChatter( buffer, "DS" ) )
+      fwrite( buffer, 1, bytesRead, outFile );
+
+    // SBE 19plus V 2.0c  SERIAL NO. 6087    11 Apr 2010 21:05:54
+    if ( ( ptr = strstr( buffer, "SERIAL NO." ) ) != NULL ) 
+      sscanf( ptr + 10, "%15s", serial );
+
+    // samples = 11460, free = 365839
+    if ( ( ptr = strstr( buffer, "samples =" ) ) != NULL ) 
+      sscanf( ptr, "samples = %ld, free = %ld", samples, freeSamples );
+
+    // Ext Volt 0 = yes, Ext Volt 1 = no
+    // SBE 38 = no, SBE 50 = no, WETLABS = no, OPTODE = no, ...
+    for ( i = 0; i < bytesRead; i++ )
+      lower[i] = tolower( (int)(unsigned char)buffer[i] );
+    lower[i] = '\0';
+    for ( i = 0; i < CTD19PLUS_MAXVOLTS; i++ )
+    {
+      snprintf( name, sizeof( name ), "ext volt %d", i );
+      numVolts += isDSFlagSet( lower, name );
+    }
+    for ( i = 0; serialSensors[i] != NULL; i++ )
+      extraSensors |= isDSFlagSet( lower, serialSensors[i] );
+  }
+
+  if ( scanWidth != NULL && ! extraSensors )
+    *scanWidth = CTD19PLUS_SCAN_BASELEN + 
+                 numVolts * CTD19PLUS_SCAN_VOLTLEN;
+
+  if ( *samples < 0 || *freeSamples < 0 )
+  {
+    LOGPRINT( LVL_WARN, "getCTD19PlusSampleInfo(): Couldn't find the "
+              "sample counts in the DS output!" );
+    return( FAILURE );
+  }
+
+  LOGPRINT( LVL_DEBG, "getCTD19PlusSampleInfo(): CTD %s samples = %ld "
+            "free = %ld", serial, *samples, *freeSamples );
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   readCTDHighWater - Get the last sample downloaded from a CTD
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   long readCTDHighWater( char *serial );
+//
+// DESCRIPTION
+//   Look up the number of the last sample successfully
+//   downloaded from the CTD with the given serial number.
+//   The values are kept in opts.dataDirName/CTDSAMPLESFILE.
+//
+// RETURNS
+//   The sample number or 0 if this CTD has not been
+//   downloaded before.
+//
+long readCTDHighWater ( char *serial )
+{
+  FILE *samplesFile;
+  char samplesFileName[FILEPATHMAX + sizeof( CTDSAMPLESFILE )];
+  char fileSerial[CTDSERIALMAX];
+  long lastSample;
+
+  snprintf( samplesFileName, sizeof( samplesFileName ),
+            "%s/%s", opts.dataDirName, CTDSAMPLESFILE );
+  if ( ( samplesFile = fopen( samplesFileName, "r" ) ) == NULL ) 
+    return( 0 );
+
+  while ( fscanf( samplesFile, "%15s %ld", fileSerial, &lastSample ) == 2 )
+  {
+    if ( strcmp( fileSerial, serial ) == 0 ) 
+    {
+      fclose( samplesFile );
+      return( lastSample );
+    }
+  }
+
+  fclose( samplesFile );
+  return( 0 );
+}
+
+
+//
+// NAME
+//   writeCTDHighWater - Store the last sample downloaded from a CTD
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   int writeCTDHighWater( char *serial, long lastSample );
+//
+// DESCRIPTION
+//   Record the number of the last sample successfully
+//   downloaded from the CTD with the given serial number in
+//   opts.dataDirName/CTDSAMPLESFILE.  Entries for other CTDs
+//   are preserved ( up to CTDMAXSERIALS of them ).
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+int writeCTDHighWater ( char *serial, long lastSample )
+{
+  FILE *samplesFile;
+  char samplesFileName[FILEPATHMAX + sizeof( CTDSAMPLESFILE )];
+  char serials[CTDMAXSERIALS][CTDSERIALMAX];
+  long lastSamples[CTDMAXSERIALS];
+  int numSerials = 0;
+  int i;
+
+  snprintf( samplesFileName, sizeof( samplesFileName ),
+            "%s/%s", opts.dataDirName, CTDSAMPLESFILE );
+
+  // Keep the entries for any other CTDs
+  if ( ( samplesFile = fopen( samplesFileName, "r" ) ) != NULL ) 
+  {
+    while ( numSerials < CTDMAXSERIALS && 
+            fscanf( samplesFile, "%15s %ld", serials[numSerials], 
+                    &lastSamples[numSerials] ) == 2 )
+    {
+      if ( strcmp( serials[numSerials], serial ) != 0 ) 
+        numSerials++;
+    }
+    fclose( samplesFile );
+  }
+
+  if ( ( samplesFile = fopen( samplesFileName, "w" ) ) == NULL ) 
+  {
+    LOGPRINT( LVL_WARN, "writeCTDHighWater(): Could not open %s for "
+              "writing!", samplesFileName );
+    return( FAILURE );
+  }
+
+  fprintf( samplesFile, "%s %ld\n", serial, lastSample );
+  for ( i = 0; i < numSerials && i < CTDMAXSERIALS - 1; i++ )
+    fprintf( samplesFile, "%s %ld\n", serials[i], lastSamples[i] );
+
+  fclose( samplesFile );
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   uploadCTD19PlusRange - Upload and verify a range of 19+ samples
+//
+// SYNOPSIS
+//   static long uploadCTD19PlusRange( int ctdFD, FILE *outFile,
+//                                     long first, long last,
+//                                     int *scanWidth );
+//
+// DESCRIPTION
+//   Request samples first through last ( at most
+//   CTD19PLUS_UPLOAD_CHUNK of them ) with "DDb,e" and check
+//   every record: it must be complete ( end in a newline ), be
+//   nothing but hex characters and be *scanWidth characters
+//   wide.  *scanWidth comes from the DS output ( see
+//   getCTD19PlusSampleInfo() ); if that could not tell, it is
+//   set from the first scan at least CTD19PLUS_SCAN_BASELEN
+//   wide.  The scans arrive in order, so everything before
+//   the first bad or missing record is good and is written
+//   to outFile as it is verified.  The rest is left for the
+//   caller to request again.
+//
+//   Reading stops once the requested number of scans is in
+//   and the "S>" prompt that follows them has been read, so
+//   a chunk costs no more than the time it takes to send.
+//   After a bad record the rest of the reply is read and
+//   discarded up to the prompt so the port is quiet for the
+//   next request.
+//
+// RETURNS
+//   The number of leading samples verified and written.
+//
+static long uploadCTD19PlusRange ( int ctdFD, FILE *outFile, long first,
+                                   long last, int *scanWidth )
+{
+  char buffer[CTDBUFFLEN];
+  char command[48];
+  long numScans = 0;
+  long expected = last - first + 1;
+  int gotPrompt = 0;
+  int bytesRead;
+  int len;
+
+  if ( expected > CTD19PLUS_UPLOAD_CHUNK )
+    expected = CTD19PLUS_UPLOAD_CHUNK;
+  last = first + expected - 1;
+
+  term_flush( ctdFD );
+  snprintf( command, sizeof( command ), "DD%ld,%ld", first, last );
+  snprintf( buffer, CTDBUFFLEN, "%s\r", command );
+  serialPutLine( ctdFD, buffer );
+
+  while ( numScans < expected &&
+          ( bytesRead = 
+             serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "\n" ) ) > 0 ) 
+  {
+    if ( isCTDChatter( buffer, command ) )
+    {
+      // The prompt means the CTD has nothing more to send
+      if ( strstr( buffer, "S>" ) != NULL )
+      {
+        gotPrompt = 1;
+        break;
+      }
+      continue;
+    }
+
+    // Partial lines come back when serialGetLine() times out
+    for ( len = 0; len < bytesRead && isxdigit( (int)buffer[len] ); len++ );
+    if ( *scanWidth == 0 && len >= CTD19PLUS_SCAN_BASELEN )
+      *scanWidth = len;
+    if ( buffer[bytesRead-1] != '\n' || len != *scanWidth || 
+         strspn( buffer + len, "\r\n" ) != (size_t)( bytesRead - len ) )
+    {
+      LOGPRINT( LVL_DEBG, "uploadCTD19PlusRange(): Bad record after "
+                "sample %ld: %s", first + numScans - 1, buffer );
+      break;
+    }
+
+    fputs( buffer, outFile );
+    numScans++;
+  }
+
+  // Read up to the prompt.  It follows the last scan right
+  // away so this only waits long after a bad record.
+  while ( ! gotPrompt &&
+          ( bytesRead = serialGetLine( ctdFD, buffer, CTDBUFFLEN, 
+                                       numScans == expected ? 500L : 2000L,
+                                       "S>" ) ) > 0 )
+    gotPrompt = ( strstr( buffer, "S>" ) != NULL );
+
+  if ( fflush( outFile ) != 0 )
+  {
+    LOGPRINT( LVL_WARN, "uploadCTD19PlusRange(): Error writing the "
+              "cast file!" );
+    return( 0 );
+  }
+
+  return( numScans );
+}
+
+
+//
+// NAME
+//   downloadCTD19PlusData - Download CTD 19+ historical data to a file
+//
+// SYNOPSIS
+//   #include "ctd.h"
+//
+//   int downloadCTD19PlusData( int ctdFD, FILE *outFile, int useMark );
+//
+// DESCRIPTION
+//   Communicate with a Seabird 19+ CTD and download the
+//   samples logged since the last successful download.
+//   The number of the last sample downloaded is kept per
+//   CTD serial number ( see readCTDHighWater() ) and only
+//   the new range is requested with the "DDb,e" command.
+//   If the CTD memory was re-initialized since the last
+//   download the range starts back at sample 1.  With
+//   useMark 0 the mark is neither read nor advanced and
+//   every sample is requested, so that a download by hand
+//   does not take samples away from orcad's next cast
+//   file.  If the
+//   sample counts cannot be read from the "DS" output the
+//   whole memory is dumped with "DC" as before.
+//
+//   When opts.ctdUploadBaud is above the port's baud the
+//   fastest rate the link sustains is negotiated first
+//   ( see negotiateCTD19PlusBaud() ) and the port's baud is
+//   restored once the upload is done.
 //
 //   The communications with the CTD are provided through
 //   an open/initialized file descriptor ctdFD.  The output
 //   file is passed in as outFile and should be already opened
 //   and writable.
 //
-//   NOTE: This routine also puts the CTD to sleep.
-//
 // RETURNS
-//     The CTD's status paragraph (ds), header paragraph (dh)
-//     and cast hex data ( dc ), formated  and written to
-//     the data file.  The data is returned in OUTPUTFORMAT=0
-//     which is raw HEX.  The data file remains open.  Upon
-//     success a 1 is returned otherwise -1 is returned.
+//     The CTD's status paragraph (DS), header paragraph (DH)
+//     and the new hex scans ( DDb,e ), written to the data
+//     file.  The data is returned in OUTPUTFORMAT=0 which is
+//     raw HEX.  The data file remains open.  The scans are
+//     requested CTD19PLUS_UPLOAD_CHUNK at a time and every record
+//     is checked for width and completeness ( see 
+//     uploadCTD19PlusRange() ).  On a bad record only the samples
+//     from that point on are requested again, up to
+//     CTD19PLUS_UPLOAD_RETRIES times without progress.  Command
+//     echoes and prompts are not written to the file.  The
+//     high-water mark is only advanced, when useMark is set, once
+//     every sample counted by "DS" has been verified.  Upon success
+//     a 1 is returned otherwise -1 is returned ( including when the
+//     sample count was unknown and the data could not be verified ).
 //     Specific problems are logged at a LVL_WARN level.
-//     
-//   TODO: I would like to clean this up so that it only
-//         writes the data expected by the SEABIRD software 
-//         and nothing extraneous.  At this point it will
-//         include (or not) any echoed commands.  It also
-//         should check the data before committing to the 
-//         success of the download...perhaps we can read the
-//         number of samples and check the data width of
-//         each as they come in.
 //
-int downloadCTD19PlusData ( int ctdFD, FILE * outFile ) 
+int downloadCTD19PlusData ( int ctdFD, FILE * outFile, int useMark ) 
 {
   int bytesRead;
+  int retValue = SUCCESS;
   char buffer[CTDBUFFLEN];
+  char serial[CTDSERIALMAX];
+  long samples;
+  long freeSamples;
+  long firstSample;
+  long nextSample;
+  long numScans;
+  int scanWidth = 0;
+  int retries;
+  int logBaud;
 
   // Say hello
   LOGPRINT( LVL_VERB, "downloadCTD19PlusData(): Called" );
@@ -1566,31 +2447,110 @@ int downloadCTD19PlusData ( int ctdFD, FILE * outFile )
     }
   }
 
-  // Print out the status of the CTD
-  serialPutLine( ctdFD, "DS\r" );
-  while ( ( bytesRead = 
-             serialGetLine( ctdFD, buffer, CTDBUFFLEN, 4000L, "\n" ) ) > 0 ) 
+  // Speed up the upload if the cable allows it
+  logBaud = term_get_baudrate( ctdFD );
+  if ( opts.ctdUploadBaud > logBaud && logBaud > 0 )
   {
-    fwrite( buffer, 1, bytesRead, outFile );
-  } 
+    if ( negotiateCTD19PlusBaud( ctdFD, opts.ctdUploadBaud ) < 0 )
+    {
+      LOGPRINT( LVL_WARN, "downloadCTD19PlusData(): Lost the CTD while "
+                "negotiating the upload baud!" );
+      return( FAILURE );
+    }
+  }
+
+  // Print out the status of the CTD and note how many 
+  // samples are in memory
+  getCTD19PlusSampleInfo( ctdFD, outFile, serial, &samples, &freeSamples,
+                          &scanWidth );
 
   // Print out the header from the CTD
   serialPutLine( ctdFD, "DH\r" );
   while ( ( bytesRead = 
              serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "\n" ) ) > 0 ) 
   {
-    fwrite( buffer, 1, bytesRead, outFile );
+    if ( ! isCTDChatter( buffer, "DH" ) )
+      fwrite( buffer, 1, bytesRead, outFile );
   }  
 
-  // Print out the data from the CTD
-  serialPutLine( ctdFD, "DC\r" );
-  while ( ( bytesRead = 
-             serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "\n" ) ) > 0 ) 
+  if ( samples < 0 )
   {
-    fwrite( buffer, 1, bytesRead, outFile );
-  }  
+    // Can't tell what is new...fall back to dumping everything.
+    // Without a sample count the data can't be verified.
+    LOGPRINT( LVL_WARN, "downloadCTD19PlusData(): Sample count unknown. "
+              "Downloading the entire memory unverified." );
+    serialPutLine( ctdFD, "DC\r" );
+    while ( ( bytesRead = 
+               serialGetLine( ctdFD, buffer, CTDBUFFLEN, 2000L, "\n" ) ) > 0 ) 
+    {
+      if ( ! isCTDChatter( buffer, "DC" ) )
+        fwrite( buffer, 1, bytesRead, outFile );
+    }  
+    retValue = FAILURE;
+  }else
+  {
+    firstSample = useMark ? readCTDHighWater( serial ) + 1 : 1;
+    if ( firstSample > samples + 1 )
+    {
+      LOGPRINT( LVL_WARN, "downloadCTD19PlusData(): CTD %s holds %ld "
+                "samples but %ld were already downloaded.  Assuming "
+                "the memory was re-initialized.", serial, samples, 
+                firstSample - 1 );
+      firstSample = 1;
+    }
+
+    if ( firstSample > samples )
+    {
+      LOGPRINT( LVL_INFO, "downloadCTD19PlusData(): No new samples on "
+                "CTD %s", serial );
+    }else
+    {
+      LOGPRINT( LVL_INFO, "downloadCTD19PlusData(): Downloading samples "
+                "%ld to %ld from CTD %s", firstSample, samples, serial );
+
+      // Upload in chunks, re-requesting from the first missing
+      // or corrupt sample rather than starting over
+      nextSample = firstSample;
+      retries = 0;
+      while ( nextSample <= samples && 
+              retries <= CTD19PLUS_UPLOAD_RETRIES )
+      {
+        numScans = uploadCTD19PlusRange( ctdFD, outFile, nextSample, 
+                                         samples, &scanWidth );
+        nextSample += numScans;
+        if ( nextSample <= samples && 
+             numScans < CTD19PLUS_UPLOAD_CHUNK )
+        {
+          LOGPRINT( LVL_INFO, "downloadCTD19PlusData(): Upload "
+                    "interrupted at sample %ld. Retrying.", nextSample );
+          retries = ( numScans > 0 ) ? 0 : retries + 1;
+        }
+      }
+
+      if ( nextSample > samples )
+      {
+        if ( useMark )
+          writeCTDHighWater( serial, samples );
+      }else 
+      {
+        LOGPRINT( LVL_WARN, "downloadCTD19PlusData(): Only verified "
+                  "samples %ld to %ld of %ld from CTD %s.  They will be "
+                  "requested again next time.", firstSample, 
+                  nextSample - 1, samples, serial );
+        retValue = FAILURE;
+      }
+    }
+  }
   term_flush( ctdFD );
 
+  // Back to the logging baud
+  if ( logBaud > 0 && setCTD19PlusBaud( ctdFD, logBaud ) < 1 )
+  {
+    LOGPRINT( LVL_WARN, "downloadCTD19PlusData(): Failed to restore "
+              "the CTD to %d baud!", logBaud );
+    return( FAILURE );
+  }
+
   // Try putting the CTD to sleep
   if ( serialPutLine( ctdFD, "QS\r") < 1 ) {  
     LOGPRINT( LVL_WARN, "downloadCTD19PlusData(): Failed to write qs "
@@ -1599,9 +2559,9 @@ int downloadCTD19PlusData ( int ctdFD, FILE * outFile )
   }
 
   // Say goodbye 
-  LOGPRINT( LVL_VERB, "downloadCTD19PlusData(): Returning: 1 - Success" );
+  LOGPRINT( LVL_VERB, "downloadCTD19PlusData(): Returning: %d", retValue );
 
-  return( SUCCESS );
+  return( retValue );
 }
 
 
@@ -1776,3 +2736,46 @@ int setCTD19PlusTime ( int ctdFD, struct tm *time ) {
 
   return ( SUCCESS );
 }
+
+
+//
+// NAME
+//   setCTD19TimeSettled - setCTD19Time() after a short pause
+//
+// DESCRIPTION
+//   The CTD 19 needs a moment after its clock is read
+//   before it will accept a new time.
+//
+static int setCTD19TimeSettled ( int ctdFD, struct tm *time )
+{
+  sleep( 1 );
+  return( setCTD19Time( ctdFD, time ) );
+}
+
+
+//
+// Device drivers ( see buoy.c ).  Clock syncing is done
+// by hydro.c's syncHydroTime() with getTime/setTime.
+//
+const struct deviceDriver ctd19Driver = {
+  .deviceType = SEABIRD_CTD_19,
+  .flags = DRIVER_HYDROWIRE,
+  .start = startLoggingCTD19,
+  .stop = stopLoggingCTD19,
+  .readSample = getCTD19Pressure,
+  .download = downloadCTD19Data,
+  .getTime = getCTD19Time,
+  .setTime = setCTD19TimeSettled
+};
+
+const struct deviceDriver ctd19PlusDriver = {
+  .deviceType = SEABIRD_CTD_19_PLUS,
+  .flags = DRIVER_HYDROWIRE,
+  .init = initCTD19Plus,
+  .start = startLoggingCTD19Plus,
+  .stop = stopLoggingCTD19Plus,
+  .readSample = getCTD19PlusPressure,
+  .download = downloadCTD19PlusData,
+  .getTime = getCTD19PlusTime,
+  .setTime = setCTD19PlusTime
+};
@@ -28,6 +28,36 @@
 #define CTDBUFFLEN 256
 #define TIMESTRMAX 16
 
+//
+// File ( in opts.dataDirName ) holding the number of the last
+// sample downloaded from each CTD.  One "serial sample" pair
+// per line.
+//
+#define CTDSAMPLESFILE "ctdSamples.txt"
+#define CTDSERIALMAX 16
+#define CTDMAXSERIALS 8
+
+//
+// Only re-initialize the 19+ memory ( INITLOGGING ) once fewer
+// than this many samples remain free.  Until then new casts are
+// appended and downloaded incrementally.
+//
+#define CTD19PLUS_MIN_FREE 20000
+
+// Number of clean status round trips needed to accept an upload baud
+#define CTD19PLUS_BAUD_TESTS 2
+
+// Samples requested per "DDb,e" and the number of times in a row
+// a request may fail to make progress before the upload gives up
+#define CTD19PLUS_UPLOAD_CHUNK   1000
+#define CTD19PLUS_UPLOAD_RETRIES 3
+
+// Raw HEX profiling scan width: temperature, conductivity,
+// pressure and pressure temperature plus 4 per external voltage
+#define CTD19PLUS_SCAN_BASELEN   22
+#define CTD19PLUS_SCAN_VOLTLEN   4
+#define CTD19PLUS_MAXVOLTS       6
+
 //
 // Prototypes
 //
@@ -38,6 +68,9 @@ float testCTDCommunication( int hydroDeviceType, int hydroFD );
 //   convertDBToDepth - Convert seawater pressure into depth
 double convertDBToDepth( double db );
 
+//   convertDBToDepthBatch - Convert an array of pressures into depths
+void convertDBToDepthBatch( const double *db, double *depth, long n );
+
 //   getCTD19SPrompt - Obtain an "S>" prompt from a Seabird CTD 19
 int getCTD19SPrompt( int ctdFD );
 
@@ -51,7 +84,7 @@ int startLoggingCTD19( int ctdFD );
 double getCTD19Pressure( int ctdFD );
 
 //   downloadCTD19Data - Download CTD 19 historical data to a file
-int downloadCTD19Data( int ctdFD, FILE * outFile );
+int downloadCTD19Data( int ctdFD, FILE * outFile, int useMark );
 
 //   getCTD19Time - Get the real time clock time from the CTD 19
 struct tm *getCTD19Time ( int ctdFD );
@@ -64,6 +97,12 @@ int setCTD19Time ( int ctdFD, struct tm *time );
 //   htoP - Convert CTD 4 Byte Hex and convert to 14bit signed number
 void htoP( char str[], int startc, int endc, double *P);
 
+//   convertCTD19Pressure - Apply the CTD 19 pressure calibration
+double convertCTD19Pressure( long n );
+
+//   hexToLong - Table driven conversion of a hex field
+long hexToLong( const char *str, int len );
+
 //////////////////////////CTD 19+ FUNCTIONS/////////////////////////
 
 //   initCTD19Plus - Initialize the CTD for general operations
@@ -81,8 +120,28 @@ int startLoggingCTD19Plus( int ctdFD );
 //   getCTD19PlusPressure - Read a CTD line and extract the pressure
 double getCTD19PlusPressure( int ctdFD );
 
+//   setCTD19PlusBaud - Switch both the CTD 19+ and the port to a new baud
+int setCTD19PlusBaud( int ctdFD, int baud );
+
+//   negotiateCTD19PlusBaud - Find the fastest usable baud for an upload
+int negotiateCTD19PlusBaud( int ctdFD, int maxBaud );
+
+//   recoverCTD19PlusBaud - Bring a CTD 19+ back to the port's baud
+int recoverCTD19PlusBaud( int ctdFD );
+
+//   getCTD19PlusSampleInfo - Read the serial number and sample counts ( DS )
+int getCTD19PlusSampleInfo( int ctdFD, FILE *outFile, char *serial,
+                            long *samples, long *freeSamples,
+                            int *scanWidth );
+
+//   readCTDHighWater - Get the last sample downloaded from a CTD
+long readCTDHighWater( char *serial );
+
+//   writeCTDHighWater - Store the last sample downloaded from a CTD
+int writeCTDHighWater( char *serial, long lastSample );
+
 //   downloadCTD19PlusData - Download CTD 19+ historical data to a file
-int downloadCTD19PlusData( int ctdFD, FILE * outFile );
+int downloadCTD19PlusData( int ctdFD, FILE * outFile, int useMark );
 
 //   getCTD19PlusTime - Get the real time clock time from the CTD 19+
 struct tm *getCTD19PlusTime ( int ctdFD );
@@ -90,4 +149,8 @@ struct tm *getCTD19PlusTime ( int ctdFD );
 //   setCTD19PlusTime - Set the real time clock time on the CTD 19+
 int setCTD19PlusTime ( int ctdFD, struct tm *time );
 
+//   Device drivers for buoy.c's registry
+extern const struct deviceDriver ctd19Driver;
+extern const struct deviceDriver ctd19PlusDriver;
+
 #endif
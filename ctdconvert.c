@@ -0,0 +1,578 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * ctdconvert.c : Bulk converter for CTD HEX cast files
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Convert the HEX cast files written by orcad ( status, header
+ *  and hex scans uploaded from the CTD ) into engineering units.
+ *
+ *  usage: ctdconvert [-c config] [-f csv|bin] [-j jobs] [-o dir]
+ *                    file.HEX ...
+ *
+ *  Each input file is memory mapped and the scans are decoded
+ *  in batches of CONVERT_BATCH using the table driven hexToLong()
+ *  and convertDBToDepthBatch() from ctd.c.  Files are spread
+ *  across "jobs" worker threads ( default: one per CPU ).  The
+ *  output is written next to the input ( or into dir ) with the
+ *  extension replaced by ".csv" or ".bin".
+ *
+ *  SBE 19 scans ( 24 hex characters ) are converted to pressure
+ *  and depth using the ctd_cal_PA1..PA3 coefficients from the
+ *  config file ( or the orcad defaults ).  The 19plus keeps its
+ *  temperature and pressure calibrations on the instrument so
+ *  only the quantities that need no coefficients are converted:
+ *  conductivity frequency and the A/D voltages.  Temperature and
+ *  pressure are written as raw counts.
+ *
+ *  Binary output layout ( host byte order ):
+ *
+ *     char     magic[8]           "ORCACNV"
+ *     uint32_t numColumns
+ *     char     names[numColumns][CONVERT_COLNAMELEN]
+ *     double   rows[][numColumns]
+ *
+ */
+#define _GNU_SOURCE     // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "general.h"
+#include "orcad.h"
+#include "log.h"
+#include "ctd.h"
+#include "parser.h"
+
+#define CONVERT_BATCH       4096
+#define CONVERT_MAXCOLS     10
+#define CONVERT_COLNAMELEN  16
+#define CONVERT_MAXJOBS     64
+#define CONVERT_MAGIC       "ORCACNV"
+
+// SBE 19 scan width ( hex characters, without CR/LF ).  A 19plus
+// scan is 22 + 4n characters so this never matches one.
+#define CTD19_SCAN_LEN  24
+
+// 19plus scan fields ( hex characters )
+#define PLUS_TEMP_LEN   6
+#define PLUS_COND_LEN   6
+#define PLUS_PRES_LEN   6
+#define PLUS_PTEMP_LEN  4
+#define PLUS_VOLT_LEN   4
+#define PLUS_MAXVOLTS   4
+
+enum convertFormats { FORMAT_CSV, FORMAT_BIN };
+enum ctdModels { MODEL_UNKNOWN, MODEL_CTD19, MODEL_CTD19PLUS };
+
+//
+// Per-file conversion state.  Rows are gathered column by
+// column so that each conversion runs over a whole batch.
+//
+struct convertBatch {
+  int model;
+  int numCols;
+  long numRows;
+  long scanNum;
+  long raw[CONVERT_MAXCOLS][CONVERT_BATCH];
+  double value[CONVERT_MAXCOLS][CONVERT_BATCH];
+};
+
+static int outputFormat = FORMAT_CSV;
+static char *outputDir = NULL;
+static char **inputFiles;
+static int numInputFiles;
+static int nextInputFile = 0;
+static int numFailed = 0;
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *ctd19Columns[] = { "scan", "pressure_db", "depth_m" };
+static const char *ctd19PlusColumns[] = { "scan", "temp_counts",
+                                          "cond_hz", "pres_counts",
+                                          "ptemp_volts", "volt0", "volt1",
+                                          "volt2", "volt3" };
+
+void usage( void );
+int convertHexFile( char *fileName );
+
+
+//
+// NAME
+//   getColumnNames - The column names for a CTD model
+//
+static const char **getColumnNames( int model )
+{
+  return( model == MODEL_CTD19 ? ctd19Columns : ctd19PlusColumns );
+}
+
+
+//
+// NAME
+//   writeHeader - Write the CSV or binary column header
+//
+static int writeHeader ( FILE *outFile, struct convertBatch *batch )
+{
+  const char **names = getColumnNames( batch->model );
+  char colName[CONVERT_COLNAMELEN];
+  uint32_t numCols = batch->numCols;
+  char magic[8];
+  int i;
+
+  if ( outputFormat == FORMAT_CSV )
+  {
+    for ( i = 0; i < batch->numCols; i++ )
+      fprintf( outFile, "%s%s", ( i ? "," : "" ), names[i] );
+    fprintf( outFile, "\n" );
+  }else
+  {
+    memset( magic, 0, sizeof( magic ) );
+    memcpy( magic, CONVERT_MAGIC, strlen( CONVERT_MAGIC ) );
+    fwrite( magic, 1, sizeof( magic ), outFile );
+    fwrite( &numCols, sizeof( numCols ), 1, outFile );
+    for ( i = 0; i < batch->numCols; i++ )
+    {
+      memset( colName, 0, sizeof( colName ) );
+      strncpy( colName, names[i], CONVERT_COLNAMELEN - 1 );
+      fwrite( colName, 1, CONVERT_COLNAMELEN, outFile );
+    }
+  }
+
+  return( ferror( outFile ) ? FAILURE : SUCCESS );
+}
+
+
+//
+// NAME
+//   flushBatch - Convert the gathered raw fields and write them out
+//
+// DESCRIPTION
+//   Each column is converted over the whole batch in one
+//   pass, then the rows are written in the output format.
+//
+static int flushBatch ( FILE *outFile, struct convertBatch *batch )
+{
+  double row[CONVERT_MAXCOLS];
+  long n = batch->numRows;
+  long r;
+  int c;
+
+  if ( n == 0 )
+    return( SUCCESS );
+
+  if ( batch->model == MODEL_CTD19 )
+  {
+    for ( r = 0; r < n; r++ )
+      batch->value[1][r] = convertCTD19Pressure( batch->raw[1][r] );
+    convertDBToDepthBatch( batch->value[1], batch->value[2], n );
+  }else
+  {
+    for ( r = 0; r < n; r++ )
+    {
+      batch->value[1][r] = (double)batch->raw[1][r];
+      batch->value[2][r] = batch->raw[2][r] / 256.0;
+      batch->value[3][r] = (double)batch->raw[3][r];
+    }
+    for ( c = 4; c < batch->numCols; c++ )
+      for ( r = 0; r < n; r++ )
+        batch->value[c][r] = ( batch->raw[c][r] < 0 ) ?
+                               -1.0 : batch->raw[c][r] / 13107.0;
+  }
+  for ( r = 0; r < n; r++ )
+    batch->value[0][r] = (double)batch->raw[0][r];
+
+  for ( r = 0; r < n; r++ )
+  {
+    if ( outputFormat == FORMAT_CSV )
+    {
+      fprintf( outFile, "%ld", batch->raw[0][r] );
+      for ( c = 1; c < batch->numCols; c++ )
+        fprintf( outFile, ",%.4f", batch->value[c][r] );
+      fputc( '\n', outFile );
+    }else
+    {
+      for ( c = 0; c < batch->numCols; c++ )
+        row[c] = batch->value[c][r];
+      fwrite( row, sizeof( double ), batch->numCols, outFile );
+    }
+  }
+
+  batch->numRows = 0;
+  return( ferror( outFile ) ? FAILURE : SUCCESS );
+}
+
+
+//
+// NAME
+//   addScan - Split one hex scan into raw fields
+//
+// RETURNS
+//   1 if the scan was added, -1 if it was malformed.
+//
+static int addScan ( struct convertBatch *batch, const char *scan,
+                     int len )
+{
+  long r = batch->numRows;
+  long n;
+  int pos, c;
+
+  if ( batch->model == MODEL_CTD19 )
+  {
+    // Pressure is the 14 bit signed value at characters 20-23
+    if ( len != CTD19_SCAN_LEN || ( n = hexToLong( scan + 20, 4 ) ) < 0 )
+      return( FAILURE );
+    batch->raw[1][r] = ( n & 0x4000 ) ? -( n & 0x3FFF ) : ( n & 0x3FFF );
+  }else
+  {
+    if ( len < PLUS_TEMP_LEN + PLUS_COND_LEN + PLUS_PRES_LEN +
+               PLUS_PTEMP_LEN )
+      return( FAILURE );
+    if ( ( batch->raw[1][r] = hexToLong( scan, PLUS_TEMP_LEN ) ) < 0 ||
+         ( batch->raw[2][r] = hexToLong( scan + 6, PLUS_COND_LEN ) ) < 0 ||
+         ( batch->raw[3][r] = hexToLong( scan + 12, PLUS_PRES_LEN ) ) < 0 )
+      return( FAILURE );
+    pos = PLUS_TEMP_LEN + PLUS_COND_LEN + PLUS_PRES_LEN;
+    for ( c = 4; c < batch->numCols; c++, pos += PLUS_VOLT_LEN )
+      batch->raw[c][r] = ( pos + PLUS_VOLT_LEN <= len ) ?
+                         hexToLong( scan + pos, PLUS_VOLT_LEN ) : -1;
+  }
+
+  batch->raw[0][r] = ++batch->scanNum;
+  batch->numRows++;
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   isHexScan - Is this line nothing but hex characters?
+//
+static int isHexScan ( const char *line, int len )
+{
+  int i;
+
+  if ( len < 8 )
+    return( 0 );
+  for ( i = 0; i < len; i++ )
+    if ( hexToLong( line + i, 1 ) < 0 )
+      return( 0 );
+  return( 1 );
+}
+
+
+//
+// NAME
+//   getOutputFileName - Build the output name for an input file
+//
+static void getOutputFileName ( char *fileName, char *outName, int size )
+{
+  char base[FILEPATHMAX];
+  char *ptr;
+
+  if ( outputDir != NULL )
+  {
+    ptr = strrchr( fileName, '/' );
+    snprintf( base, FILEPATHMAX, "%s/%s", outputDir,
+              ( ptr ? ptr + 1 : fileName ) );
+  }else
+    snprintf( base, FILEPATHMAX, "%s", fileName );
+
+  if ( ( ptr = strrchr( base, '.' ) ) != NULL &&
+       strchr( ptr, '/' ) == NULL )
+    *ptr = '\0';
+
+  snprintf( outName, size, "%s.%s", base,
+            ( outputFormat == FORMAT_CSV ? "csv" : "bin" ) );
+}
+
+
+//
+// NAME
+//   convertHexFile - Convert a single HEX cast file
+//
+// SYNOPSIS
+//   int convertHexFile( char *fileName );
+//
+// DESCRIPTION
+//   Map the file, work out which CTD wrote it from the status
+//   paragraph, and convert every hex scan line.  Lines which
+//   are not scans ( status, header, echoed commands ) are
+//   skipped.
+//
+// RETURNS
+//   The number of scans converted or -1 upon failure.
+//
+int convertHexFile ( char *fileName )
+{
+  struct convertBatch *batch;
+  struct stat st;
+  char outName[FILEPATHMAX + 8];
+  const char *data, *line, *end, *eol;
+  FILE *outFile = NULL;
+  long badScans = 0;
+  int len, fd, i;
+  int retValue = SUCCESS;
+
+  if ( ( fd = open( fileName, O_RDONLY ) ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "convertHexFile(): Could not open %s: %s",
+              fileName, strerror( errno ) );
+    return( FAILURE );
+  }
+  if ( fstat( fd, &st ) < 0 || st.st_size == 0 )
+  {
+    LOGPRINT( LVL_WARN, "convertHexFile(): %s is empty", fileName );
+    close( fd );
+    return( FAILURE );
+  }
+  data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( data == MAP_FAILED )
+  {
+    LOGPRINT( LVL_WARN, "convertHexFile(): Could not map %s: %s",
+              fileName, strerror( errno ) );
+    return( FAILURE );
+  }
+  madvise( (void *)data, st.st_size, MADV_SEQUENTIAL );
+
+  if ( ( batch = calloc( 1, sizeof( struct convertBatch ) ) ) == NULL )
+  {
+    munmap( (void *)data, st.st_size );
+    return( FAILURE );
+  }
+
+  end = data + st.st_size;
+  for ( line = data; line < end && retValue > 0; line = eol + 1 )
+  {
+    if ( ( eol = memchr( line, '\n', end - line ) ) == NULL )
+      eol = end;
+    len = eol - line;
+    while ( len > 0 && ( line[len-1] == '\r' || line[len-1] == ' ' ) )
+      len--;
+
+    if ( ! isHexScan( line, len ) )
+    {
+      // The status paragraph tells us which CTD this is
+      if ( batch->model == MODEL_UNKNOWN )
+      {
+        if ( len >= 15 && memmem( line, len, "SEACAT PROFILER", 15 ) )
+          batch->model = MODEL_CTD19;
+        else if ( ( len >= 10 && memmem( line, len, "SBE 19plus", 10 ) ) ||
+                  ( len >= 10 && memmem( line, len, "SeacatPlus", 10 ) ) )
+          batch->model = MODEL_CTD19PLUS;
+      }
+      continue;
+    }
+
+    // First scan: settle the model and open the output
+    if ( outFile == NULL )
+    {
+      if ( batch->model == MODEL_UNKNOWN )
+        batch->model = ( len == CTD19_SCAN_LEN ) ? MODEL_CTD19 : MODEL_CTD19PLUS;
+      if ( batch->model == MODEL_CTD19 )
+        batch->numCols = 3;
+      else
+      {
+        batch->numCols = 5;
+        for ( i = PLUS_TEMP_LEN + PLUS_COND_LEN + PLUS_PRES_LEN +
+                  PLUS_PTEMP_LEN;
+              i + PLUS_VOLT_LEN <= len && batch->numCols < 5 + PLUS_MAXVOLTS;
+              i += PLUS_VOLT_LEN )
+          batch->numCols++;
+      }
+
+      getOutputFileName( fileName, outName, sizeof( outName ) );
+      if ( ( outFile = fopen( outName, "w" ) ) == NULL )
+      {
+        LOGPRINT( LVL_WARN, "convertHexFile(): Could not create %s",
+                  outName );
+        retValue = FAILURE;
+        break;
+      }
+      retValue = writeHeader( outFile, batch );
+    }
+
+    if ( addScan( batch, line, len ) < 0 )
+      badScans++;
+    else if ( batch->numRows == CONVERT_BATCH )
+      retValue = flushBatch( outFile, batch );
+  }
+
+  if ( outFile != NULL )
+  {
+    if ( retValue > 0 )
+      retValue = flushBatch( outFile, batch );
+    if ( fclose( outFile ) != 0 )
+      retValue = FAILURE;
+  }
+
+  if ( retValue > 0 )
+  {
+    LOGPRINT( LVL_INFO, "convertHexFile(): %s: %ld scans ( %ld bad )",
+              fileName, batch->scanNum, badScans );
+    retValue = batch->scanNum;
+  }else
+    LOGPRINT( LVL_WARN, "convertHexFile(): Failed converting %s",
+              fileName );
+
+  free( batch );
+  munmap( (void *)data, st.st_size );
+  return( retValue );
+}
+
+
+//
+// NAME
+//   convertWorker - Thread body which converts queued files
+//
+static void *convertWorker ( void *arg )
+{
+  int i;
+
+  for ( ;; )
+  {
+    pthread_mutex_lock( &queueLock );
+    i = nextInputFile++;
+    pthread_mutex_unlock( &queueLock );
+    if ( i >= numInputFiles )
+      break;
+
+    if ( convertHexFile( inputFiles[i] ) < 0 )
+    {
+      pthread_mutex_lock( &queueLock );
+      numFailed++;
+      pthread_mutex_unlock( &queueLock );
+    }
+  }
+
+  return( NULL );
+}
+
+
+int main ( int argc, char *argv[] )
+{
+  pthread_t workers[CONVERT_MAXJOBS];
+  char *configFile = NULL;
+  int numJobs = 0;
+  int opt, i;
+
+  logFile = stderr;
+  progName = "ctdconvert";
+
+  // Same defaults as orcad
+  opts.debugLevel = 3;
+  opts.ctdCalPA1 = 248.24555;
+  opts.ctdCalPA2 = -6.524518E-2;
+  opts.ctdCalPA3 = 5.430179E-8;
+
+  while ( ( opt = getopt( argc, argv, "c:f:j:o:v" ) ) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'c':
+        configFile = optarg;
+        break;
+      case 'f':
+        if ( strcmp( optarg, "csv" ) == 0 )
+          outputFormat = FORMAT_CSV;
+        else if ( strcmp( optarg, "bin" ) == 0 )
+          outputFormat = FORMAT_BIN;
+        else
+        {
+          usage();
+          exit( 1 );
+        }
+        break;
+      case 'j':
+        numJobs = atoi( optarg );
+        break;
+      case 'o':
+        outputDir = optarg;
+        break;
+      case 'v':
+        opts.debugLevel = LVL_INFO;
+        break;
+      default:
+        usage();
+        exit( 1 );
+    }
+  }
+
+  if ( optind >= argc )
+  {
+    usage();
+    exit( 1 );
+  }
+  inputFiles = &argv[optind];
+  numInputFiles = argc - optind;
+
+  // Pick up the CTD calibrations
+  if ( configFile != NULL && parseConfigFile( configFile ) < 0 )
+  {
+    LOGPRINT( LVL_CRIT, "Could not parse config file %s", configFile );
+    exit( 1 );
+  }
+
+  if ( numJobs < 1 )
+    numJobs = sysconf( _SC_NPROCESSORS_ONLN );
+  if ( numJobs < 1 )
+    numJobs = 1;
+  if ( numJobs > CONVERT_MAXJOBS )
+    numJobs = CONVERT_MAXJOBS;
+  if ( numJobs > numInputFiles )
+    numJobs = numInputFiles;
+
+  for ( i = 0; i < numJobs; i++ )
+  {
+    if ( pthread_create( &workers[i], NULL, convertWorker, NULL ) != 0 )
+    {
+      LOGPRINT( LVL_CRIT, "Could not start worker thread %d", i );
+      numJobs = i;
+      break;
+    }
+  }
+  // Nothing started...do the work here
+  if ( numJobs == 0 )
+    convertWorker( NULL );
+  for ( i = 0; i < numJobs; i++ )
+    pthread_join( workers[i], NULL );
+
+  if ( numFailed )
+    LOGPRINT( LVL_WARN, "%d of %d files failed to convert", numFailed,
+              numInputFiles );
+
+  return( numFailed ? 1 : 0 );
+}
+
+
+void usage( void )
+{
+  fprintf( stderr,
+    "usage: ctdconvert [-c config] [-f csv|bin] [-j jobs] [-o dir] [-v] "
+    "file.HEX ...\n"
+    "  -c config  : Read ctd_cal_PA1..3 from an orcad config file\n"
+    "  -f format  : csv ( default ) or bin\n"
+    "  -j jobs    : Number of files to convert at once ( default: "
+    "one per CPU )\n"
+    "  -o dir     : Write the output files to dir\n"
+    "  -v         : Report each file converted\n" );
+}
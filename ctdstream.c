@@ -0,0 +1,519 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * ctdstream.c : Live decoding of the CTD data stream during a cast
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  While logging, the CTD streams every sample over the hydrowire
+ *  in addition to storing it in memory.  Previously we only looked
+ *  at the stream for the pressure needed to drive the winch and
+ *  threw the rest away.  These routines decode every line which
+ *  comes across into engineering units and save them in a binary
+ *  columnar file ( see ctdstream.h ) so that a usable profile is
+ *  on disk the moment the package is parked.
+ *
+ *  There is no separate acquisition thread.  The hydrowire port is
+ *  shared with the command/response traffic of the CTD drivers, so
+ *  instead the stream is pumped from the places where the control
+ *  loop already waits on it: the pressure reads used by the winch
+ *  routines and the warm up / equilibration sleeps.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include "general.h"
+#include "orcad.h"
+#include "log.h"
+#include "ctd.h"
+#include "timer.h"
+#include "ctdstream.h"
+
+
+static const char *const columnNamesList[CTDSTREAM_NUMCOLS] = {
+  "time",
+  "temperature",
+  "conductivity",
+  "pressure",
+  "depth",
+  "volt0",
+  "volt1",
+  "volt2",
+  "volt3"
+};
+
+// The open stream file ( NULL if not recording )
+static FILE *streamFile = NULL;
+static int streamDeviceType = -1;
+static long streamSamples = 0;
+
+// Current block of samples
+static uint32_t blockRows = 0;
+static double blockTimes[CTDSTREAM_BLOCKROWS];
+static float blockColumns[CTDSTREAM_NUMCOLS][CTDSTREAM_BLOCKROWS];
+
+// Partial line carried between calls to readCTDStreamLine().
+// It belongs to the port lineBuffFD and is only trusted to
+// start at the beginning of a line once lineBuffSynced is set.
+static char lineBuff[CTDSTREAM_LINEBUFFLEN];
+static long lineBuffLen = 0;
+static int lineBuffFD = -1;
+static int lineBuffSynced = 0;
+static struct timeval lineBuffTime;   // When lineBuff last grew
+
+
+//
+// Write out the current block of samples
+//
+static int writeCTDStreamBlock ( void )
+{
+  int i;
+
+  if ( streamFile == NULL || blockRows == 0 )
+    return( SUCCESS );
+
+  if ( fwrite( &blockRows, sizeof( blockRows ), 1, streamFile ) != 1 ||
+       fwrite( blockTimes, sizeof( double ), blockRows, streamFile )
+         != blockRows )
+  {
+    LOGPRINT( LVL_WARN, "writeCTDStreamBlock(): Failed writing stream "
+              "block!" );
+    blockRows = 0;
+    return( FAILURE );
+  }
+  for ( i = CTDCOL_TEMPERATURE; i < CTDSTREAM_NUMCOLS; i++ )
+  {
+    if ( fwrite( blockColumns[i], sizeof( float ), blockRows, streamFile )
+           != blockRows )
+    {
+      LOGPRINT( LVL_WARN, "writeCTDStreamBlock(): Failed writing stream "
+                "block!" );
+      blockRows = 0;
+      return( FAILURE );
+    }
+  }
+  fflush( streamFile );
+  blockRows = 0;
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   openCTDStream - Start recording the CTD data stream to a file
+//
+// SYNOPSIS
+//   #include "ctdstream.h"
+//
+//   int openCTDStream( int hydroDeviceType, char *fileName );
+//
+// DESCRIPTION
+//   Create the stream file fileName, write the file header and
+//   start recording every line decoded by recordCTDStreamLine().
+//   An existing file is never overwritten.
+//   Any partial line left over from a previous cast is dropped
+//   ( see resetCTDStream() ).
+//
+// RETURNS
+//   1 on Success
+//  -1 on Failure
+//
+int openCTDStream ( int hydroDeviceType, char *fileName )
+{
+  struct ctdStreamHeader header;
+  int fd;
+  int i;
+
+  if ( streamFile != NULL )
+    closeCTDStream();
+
+  if ( ( fd = open( fileName, O_WRONLY | O_CREAT | O_EXCL, 0644 ) ) < 0 ||
+       ( streamFile = fdopen( fd, "w" ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "openCTDStream(): Could not create stream file "
+              "%s! ( %s )", fileName, strerror( errno ) );
+    if ( fd >= 0 )
+      close( fd );
+    return( FAILURE );
+  }
+
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, CTDSTREAM_MAGIC, strlen( CTDSTREAM_MAGIC ) );
+  header.version = CTDSTREAM_VERSION;
+  header.numColumns = CTDSTREAM_NUMCOLS;
+  header.deviceType = hydroDeviceType;
+  for ( i = 0; i < CTDSTREAM_NUMCOLS; i++ )
+    strncpy( header.columnNames[i], columnNamesList[i],
+             CTDSTREAM_COLNAMELEN - 1 );
+  if ( fwrite( &header, sizeof( header ), 1, streamFile ) != 1 )
+  {
+    LOGPRINT( LVL_WARN, "openCTDStream(): Could not write header to %s!",
+              fileName );
+    fclose( streamFile );
+    streamFile = NULL;
+    return( FAILURE );
+  }
+
+  streamDeviceType = hydroDeviceType;
+  streamSamples = 0;
+  blockRows = 0;
+  resetCTDStream( lineBuffFD );
+
+  LOGPRINT( LVL_INFO, "openCTDStream(): Recording CTD stream to %s",
+            fileName );
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   closeCTDStream - Flush and close the stream file
+//
+// SYNOPSIS
+//   #include "ctdstream.h"
+//
+//   long closeCTDStream();
+//
+// DESCRIPTION
+//   Write out any samples still buffered and close the
+//   stream file.  Any partial line is dropped since the port
+//   is about to be used for commands again.  Does nothing
+//   if a stream is not open.
+//
+// RETURNS
+//   The number of samples recorded.
+//
+long closeCTDStream ( void )
+{
+  long samples = streamSamples;
+
+  if ( streamFile == NULL )
+    return( 0 );
+
+  writeCTDStreamBlock();
+  fclose( streamFile );
+  resetCTDStream( lineBuffFD );
+  streamFile = NULL;
+  streamDeviceType = -1;
+  streamSamples = 0;
+
+  LOGPRINT( LVL_INFO, "closeCTDStream(): Recorded %ld CTD samples",
+            samples );
+  return( samples );
+}
+
+
+//
+// NAME
+//   recordCTDStreamLine - Decode one streamed line into the stream file
+//
+// SYNOPSIS
+//   #include "ctdstream.h"
+//
+//   int recordCTDStreamLine( char *line );
+//
+// DESCRIPTION
+//   Decode a line from the CTD data stream and append it to
+//   the open stream file.  For the 19plus the line is in
+//   OUTPUTFORMAT=3 ( decimal engineering units ): temperature,
+//   conductivity, pressure and then any auxiliary voltages
+//   separated by commas.  For the 19 only the pressure can be
+//   converted onboard ( see htoP() ); the remaining columns are
+//   left as NaN.  Lines which do not decode ( prompts, echoed
+//   commands, noise ) are ignored.
+//
+// RETURNS
+//   1 if a sample was recorded, 0 otherwise.
+//
+// NOTE Does not log.  This is called from the time critical
+//      winch routines.
+//
+int recordCTDStreamLine ( char *line )
+{
+  int i, numVals;
+  double vals[3 + CTDSTREAM_MAXVOLTS];
+  double pressure = 0;
+  char *cptr, *endPtr;
+  struct timeval now;
+
+  if ( streamFile == NULL || line == NULL )
+    return( 0 );
+
+  for ( i = CTDCOL_TEMPERATURE; i < CTDSTREAM_NUMCOLS; i++ )
+    blockColumns[i][blockRows] = NAN;
+
+  if ( streamDeviceType == SEABIRD_CTD_19_PLUS )
+  {
+    numVals = 0;
+    cptr = line;
+    while ( numVals < 3 + CTDSTREAM_MAXVOLTS )
+    {
+      vals[numVals] = strtod( cptr, &endPtr );
+      if ( endPtr == cptr )
+        break;
+      numVals++;
+      cptr = endPtr;
+      while ( *cptr == ' ' || *cptr == '\t' )
+        cptr++;
+      if ( *cptr != ',' )
+        break;
+      cptr++;
+    }
+    if ( numVals < 3 )
+      return( 0 );
+    blockColumns[CTDCOL_TEMPERATURE][blockRows] = vals[0];
+    blockColumns[CTDCOL_CONDUCTIVITY][blockRows] = vals[1];
+    pressure = vals[2];
+    for ( i = 3; i < numVals; i++ )
+      blockColumns[CTDCOL_VOLT0 + i - 3][blockRows] = vals[i];
+  }else if ( streamDeviceType == SEABIRD_CTD_19 )
+  {
+    // 24 hex characters followed by CR LF
+    if ( strlen( line ) != 26 )
+      return( 0 );
+    for ( i = 0; i < 24; i++ )
+      if ( strchr( "0123456789ABCDEFabcdef", line[i] ) == NULL )
+        return( 0 );
+    htoP( line, 20, 23, &pressure );
+  }else
+  {
+    return( 0 );
+  }
+
+  gettimeofday( &now, NULL );
+  blockTimes[blockRows] = now.tv_sec + ( now.tv_usec * 1.e-6 );
+  blockColumns[CTDCOL_PRESSURE][blockRows] = pressure;
+  blockColumns[CTDCOL_DEPTH][blockRows] = convertDBToDepth( pressure );
+  streamSamples++;
+
+  if ( ++blockRows == CTDSTREAM_BLOCKROWS )
+    writeCTDStreamBlock();
+
+  return( 1 );
+}
+
+
+//
+// NAME
+//   resetCTDStream - Drop the partial stream line
+//
+// SYNOPSIS
+//   #include "ctdstream.h"
+//
+//   void resetCTDStream( int fd );
+//
+// DESCRIPTION
+//   Forget any partial line read by readCTDStreamLine() and
+//   resync to the next line end of port fd.  Call this before
+//   talking to the CTD with serialChat(), serialGetLine() or
+//   term_flush() so that what is left in the buffer is not
+//   joined to a later stream line.
+//
+// RETURNS
+//   Nothing.
+//
+void resetCTDStream ( int fd )
+{
+  lineBuffFD = fd;
+  lineBuffLen = 0;
+  lineBuffSynced = 0;
+}
+
+
+//
+// NAME
+//   readCTDStreamLine - Read one complete line from the CTD data stream
+//
+// SYNOPSIS
+//   #include "ctdstream.h"
+//
+//   ssize_t readCTDStreamLine( int fd, char *line, long lineSize,
+//                              long timeout );
+//
+// DESCRIPTION
+//   Wait up to timeout milliseconds for a complete "\n"
+//   terminated line from the non-blocking port fd and copy it
+//   ( '\0' terminated ) into line.  Unlike serialGetLine() a
+//   partial line is kept for the next call rather than being
+//   returned, so callers never see a line which is missing
+//   its beginning and don't need to flush the port to resync.
+//   A timeout of 0 only looks at data which is already waiting.
+//
+//   The partial line is kept for one port only.  After a
+//   reset ( see resetCTDStream() ), a change of port or an
+//   overflow, everything up to the next line end is thrown
+//   away since it may be the tail of a line whose beginning
+//   was read by someone else.
+//
+// RETURNS
+//   The length of the line, 0 if no complete line arrived
+//   before the timeout or -1 on a read error.  Lines longer
+//   than lineSize are truncated.
+//
+ssize_t readCTDStreamLine ( int fd, char *line, long lineSize, long timeout )
+{
+  struct timeval startTime;
+  char *eol;
+  long len, copyLen;
+  ssize_t bytesRead;
+
+  if ( line == NULL || lineSize < 1 )
+    return( FAILURE );
+  line[0] = '\0';
+
+  if ( fd != lineBuffFD )
+    resetCTDStream( fd );
+
+  gettimeofday( &startTime, NULL );
+  for (;;)
+  {
+    // Skip to the start of the next line
+    if ( ! lineBuffSynced && lineBuffLen > 0 )
+    {
+      if ( ( eol = memchr( lineBuff, '\n', lineBuffLen ) ) != NULL )
+      {
+        lineBuffLen -= ( eol - lineBuff ) + 1;
+        memmove( lineBuff, eol + 1, lineBuffLen );
+        lineBuffSynced = 1;
+      }else
+        lineBuffLen = 0;
+    }
+
+    if ( lineBuffSynced &&
+         ( eol = memchr( lineBuff, '\n', lineBuffLen ) ) != NULL )
+    {
+      len = ( eol - lineBuff ) + 1;
+      copyLen = len;
+      if ( copyLen > lineSize - 1 )
+        copyLen = lineSize - 1;
+      memcpy( line, lineBuff, copyLen );
+      line[copyLen] = '\0';
+      lineBuffLen -= len;
+      memmove( lineBuff, eol + 1, lineBuffLen );
+      return( copyLen );
+    }
+
+    // No line end in a full buffer...must be noise
+    if ( lineBuffLen >= CTDSTREAM_LINEBUFFLEN )
+    {
+      lineBuffLen = 0;
+      lineBuffSynced = 0;
+    }
+
+    bytesRead = read( fd, lineBuff + lineBuffLen,
+                      CTDSTREAM_LINEBUFFLEN - lineBuffLen );
+    if ( bytesRead > 0 )
+    {
+      lineBuffLen += bytesRead;
+      gettimeofday( &lineBuffTime, NULL );
+      continue;
+    }
+    if ( bytesRead < 0 && errno != EINTR && errno != EAGAIN )
+      return( FAILURE );
+    if ( getMilliSecSince( &startTime ) >= timeout )
+      return( 0 );
+    usleep( 1000 );
+  }
+}
+
+
+//
+// NAME
+//   drainCTDStream - Record every complete line waiting on the port
+//
+// SYNOPSIS
+//   #include "ctdstream.h"
+//
+//   int drainCTDStream( int fd );
+//
+// DESCRIPTION
+//   Read all of the complete lines which have already arrived
+//   on the port and pass them to recordCTDStreamLine().  This
+//   takes the place of flushing the port before looking for a
+//   fresh sample.  A partial line which has not grown for
+//   CTDSTREAM_STALEMS can not be the start of the line in
+//   flight ( the CTD streams continuously ), so the port was
+//   read elsewhere since and the partial line is dropped.
+//
+// RETURNS
+//   The number of lines read.
+//
+int drainCTDStream ( int fd )
+{
+  char buffer[CTDBUFFLEN];
+  int numLines = 0;
+
+  if ( fd != lineBuffFD ||
+       ( lineBuffLen > 0 &&
+         getMilliSecSince( &lineBuffTime ) > CTDSTREAM_STALEMS ) )
+    resetCTDStream( fd );
+
+  while ( readCTDStreamLine( fd, buffer, CTDBUFFLEN, 0L ) > 0 )
+  {
+    recordCTDStreamLine( buffer );
+    numLines++;
+  }
+  return( numLines );
+}
+
+
+//
+// NAME
+//   sleepCTDStream - Sleep while continuing to record the data stream
+//
+// SYNOPSIS
+//   #include "ctdstream.h"
+//
+//   void sleepCTDStream( int fd, unsigned int seconds );
+//
+// DESCRIPTION
+//   Wait for the given number of seconds.  If a stream is being
+//   recorded keep reading the port while we wait so that no
+//   samples are lost to a full serial buffer during long warm
+//   up and equilibration periods.  Otherwise this is a plain
+//   sleep.
+//
+// RETURNS
+//   Nothing.
+//
+void sleepCTDStream ( int fd, unsigned int seconds )
+{
+  char buffer[CTDBUFFLEN];
+  time_t endTime;
+  ssize_t ret;
+
+  if ( streamFile == NULL )
+  {
+    while ( ( seconds = sleep( seconds ) ) > 0 ) { /* nothing */ }
+    return;
+  }
+
+  endTime = time( NULL ) + seconds;
+  while ( time( NULL ) < endTime )
+  {
+    if ( ( ret = readCTDStreamLine( fd, buffer, CTDBUFFLEN, 500L ) ) > 0 )
+      recordCTDStreamLine( buffer );
+    else if ( ret < 0 )
+      sleep( 1 );
+  }
+}
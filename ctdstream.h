@@ -0,0 +1,90 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * ctdstream.h : Header for the live CTD stream recorder
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ */
+#ifndef _CTDSTREAM_H
+#define _CTDSTREAM_H
+
+#include <stdint.h>
+
+//
+// Stream file layout ( host byte order ):
+//
+//   struct ctdStreamHeader
+//   block 0: uint32_t numRows
+//            double time[numRows]       ( secs since the epoch )
+//            float  column[numRows]     ( for each remaining column )
+//   block 1: ...
+//
+// Blocks hold up to CTDSTREAM_BLOCKROWS samples and are
+// flushed to disk as they fill so that a crash loses at most
+// one block.  Values which the instrument does not provide
+// are stored as NaN.
+//
+#define CTDSTREAM_MAGIC      "ORCACTD"
+#define CTDSTREAM_VERSION    1
+#define CTDSTREAM_BLOCKROWS  64
+#define CTDSTREAM_MAXVOLTS   4
+#define CTDSTREAM_NUMCOLS    ( 5 + CTDSTREAM_MAXVOLTS )
+#define CTDSTREAM_COLNAMELEN 16
+
+// Size of the partial line buffer used by readCTDStreamLine()
+#define CTDSTREAM_LINEBUFFLEN 1024
+
+// A partial line which has not grown for this long ( ms ) is stale
+#define CTDSTREAM_STALEMS     1000L
+
+// Most "_n" suffixes tried for a cast's stream file name
+#define CTDSTREAM_MAXSUFFIX   100
+
+// Column indexes
+enum ctdStreamColumns { CTDCOL_TIME, CTDCOL_TEMPERATURE, CTDCOL_CONDUCTIVITY,
+                        CTDCOL_PRESSURE, CTDCOL_DEPTH, CTDCOL_VOLT0 };
+
+struct ctdStreamHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t numColumns;
+  uint32_t deviceType;
+  char columnNames[CTDSTREAM_NUMCOLS][CTDSTREAM_COLNAMELEN];
+}__attribute__ ((packed));
+
+//   openCTDStream - Start recording the CTD data stream to a file
+int openCTDStream( int hydroDeviceType, char *fileName );
+
+//   closeCTDStream - Flush and close the stream file
+long closeCTDStream( void );
+
+//   recordCTDStreamLine - Decode one streamed line into the stream file
+int recordCTDStreamLine( char *line );
+
+//   resetCTDStream - Drop the partial stream line
+void resetCTDStream( int fd );
+
+//   readCTDStreamLine - Read one complete line from the CTD data stream
+ssize_t readCTDStreamLine( int fd, char *line, long lineSize, long timeout );
+
+//   drainCTDStream - Record every complete line waiting on the port
+int drainCTDStream( int fd );
+
+//   sleepCTDStream - Sleep while continuing to record the data stream
+void sleepCTDStream( int fd, unsigned int seconds );
+
+#endif
@@ -0,0 +1,416 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * ctlsock.c : The orcad control socket
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  orcad listens on a UNIX domain socket ( CTLSOCK_PATH ) so
+ *  that orcactrl can query the instruments through orcad's
+ *  open ports instead of stopping the daemon.
+ *
+ *  The protocol is one request per connection.  The client
+ *  sends a single line:
+ *
+ *      <command> [args...]\n
+ *
+ *  and orcad answers with a status line followed by exactly
+ *  <length> bytes of text:
+ *
+ *      OK <length>\n<output>
+ *      ERR <length>\n<message>
+ *
+ *  then closes the connection.  orcad only services the socket
+ *  while it is idle in its main loop, so a request made during
+ *  a cast waits in the listen queue.  If the client gives up
+ *  first its request is dropped rather than run late.
+ *
+ */
+#define _GNU_SOURCE     // POLLRDHUP
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "general.h"
+#include "log.h"
+#include "timer.h"
+#include "ctlsock.h"
+
+// How long orcad waits for a client to send its request
+#define CTLSOCK_READTIMEOUT 2000      // ms
+#define CTLSOCK_STATUSLEN   32
+
+
+//
+// NAME
+//   fillSockAddr - Setup a UNIX domain address for path
+//
+static int fillSockAddr( struct sockaddr_un *addr, const char *path )
+{
+  memset( addr, 0, sizeof( *addr ) );
+  addr->sun_family = AF_UNIX;
+  if ( strlen( path ) >= sizeof( addr->sun_path ) )
+  {
+    LOGPRINT( LVL_WARN, "fillSockAddr(): Socket path %s is too long", path );
+    return( FAILURE );
+  }
+  strcpy( addr->sun_path, path );
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   writeAll - write() all of buff
+//
+static int writeAll( int fd, const char *buff, size_t len )
+{
+  ssize_t ret;
+
+  while ( len > 0 )
+  {
+    if ( ( ret = send( fd, buff, len, MSG_NOSIGNAL ) ) < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+      return( FAILURE );
+    }
+    buff += ret;
+    len -= ret;
+  }
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   readUntil - Read from a socket before a deadline
+//
+// DESCRIPTION
+//   Read up to len bytes into buff, stopping early after a
+//   newline if toNewline is set.  Gives up timeoutMs after
+//   startTime.
+//
+// RETURNS
+//   The number of bytes read, or -1 on error or timeout.
+//
+static ssize_t readUntil( int fd, char *buff, size_t len, int toNewline,
+                          struct timeval *startTime, long timeoutMs )
+{
+  struct pollfd pfd;
+  size_t numRead = 0;
+  ssize_t ret;
+  long waitMs;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while ( numRead < len )
+  {
+    if ( ( waitMs = timeoutMs - getMilliSecSince( startTime ) ) <= 0 )
+      return( FAILURE );
+    if ( ( ret = poll( &pfd, 1, waitMs ) ) < 0 && errno != EINTR )
+      return( FAILURE );
+    if ( ret <= 0 )
+      continue;
+    if ( ( ret = read( fd, buff + numRead, len - numRead ) ) < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+      return( FAILURE );
+    }
+    if ( ret == 0 )
+      break;
+    numRead += ret;
+    if ( toNewline && memchr( buff, '\n', numRead ) != NULL )
+      break;
+  }
+  return( numRead );
+}
+
+
+//
+// NAME
+//   openControlSocket - Start listening for control requests
+//
+// SYNOPSIS
+//   #include "ctlsock.h"
+//
+//   int openControlSocket( const char *path );
+//
+// DESCRIPTION
+//   Create the control socket at path, replacing any left
+//   behind by a previous run.  Only root may connect.  The
+//   caller must hold orcad's lock file.
+//
+// RETURNS
+//   The listening socket or -1 upon failure.
+//
+int openControlSocket( const char *path )
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  if ( fillSockAddr( &addr, path ) < 0 )
+    return( FAILURE );
+
+  if ( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "openControlSocket(): Could not create socket: %s",
+              strerror( errno ) );
+    return( FAILURE );
+  }
+  unlink( path );
+  if ( bind( fd, (struct sockaddr *)&addr, sizeof( addr ) ) < 0 ||
+       chmod( path, S_IRUSR | S_IWUSR ) < 0 ||
+       listen( fd, 4 ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "openControlSocket(): Could not listen on %s: %s",
+              path, strerror( errno ) );
+    close( fd );
+    return( FAILURE );
+  }
+  fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+  fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+  return( fd );
+}
+
+
+//
+// NAME
+//   closeControlSocket - Stop listening for control requests
+//
+// SYNOPSIS
+//   #include "ctlsock.h"
+//
+//   void closeControlSocket( int listenFD, const char *path );
+//
+// RETURNS
+//   Nothing
+//
+void closeControlSocket( int listenFD, const char *path )
+{
+  if ( listenFD < 0 )
+    return;
+  close( listenFD );
+  unlink( path );
+}
+
+
+//
+// NAME
+//   acceptControlRequest - Wait for a control request
+//
+// SYNOPSIS
+//   #include "ctlsock.h"
+//
+//   int acceptControlRequest( int listenFD, long timeoutMs,
+//                             char *request, size_t requestLen );
+//
+// DESCRIPTION
+//   Wait up to timeoutMs for a client to connect and read its
+//   request line ( without the newline ) into request.  The
+//   wait ends early if a signal arrives.  The client must be
+//   answered with sendControlResponse().
+//
+// RETURNS
+//   The client's socket or -1 if there was no request.
+//
+int acceptControlRequest( int listenFD, long timeoutMs, char *request,
+                          size_t requestLen )
+{
+  struct pollfd pfd;
+  struct timeval startTime;
+  ssize_t len;
+  char *eol;
+  int fd;
+
+  pfd.fd = listenFD;
+  pfd.events = POLLIN;
+  if ( poll( &pfd, 1, timeoutMs ) <= 0 )
+    return( FAILURE );
+  if ( ( fd = accept( listenFD, NULL, NULL ) ) < 0 )
+    return( FAILURE );
+
+  gettimeofday( &startTime, NULL );
+  len = readUntil( fd, request, requestLen - 1, 1, &startTime,
+                   CTLSOCK_READTIMEOUT );
+  if ( len <= 0 || ( eol = memchr( request, '\n', len ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "acceptControlRequest(): Incomplete request" );
+    close( fd );
+    return( FAILURE );
+  }
+  *eol = '\0';
+  if ( eol > request && *( eol - 1 ) == '\r' )
+    *( eol - 1 ) = '\0';
+
+  // A client which gave up while we were busy has hung up
+  pfd.fd = fd;
+  pfd.events = POLLRDHUP;
+  if ( poll( &pfd, 1, 0 ) > 0 &&
+       ( pfd.revents & ( POLLRDHUP | POLLHUP | POLLERR ) ) )
+  {
+    LOGPRINT( LVL_INFO, "acceptControlRequest(): Dropping request \"%s\", "
+              "the client has gone", request );
+    close( fd );
+    return( FAILURE );
+  }
+
+  return( fd );
+}
+
+
+//
+// NAME
+//   sendControlResponse - Answer a control request
+//
+// SYNOPSIS
+//   #include "ctlsock.h"
+//
+//   int sendControlResponse( int clientFD, int status, const char *body,
+//                            size_t bodyLen );
+//
+// DESCRIPTION
+//   Send the status ( SUCCESS or FAILURE ) and the command's
+//   output or error message, then close the connection.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+int sendControlResponse( int clientFD, int status, const char *body,
+                         size_t bodyLen )
+{
+  char statusLine[CTLSOCK_STATUSLEN];
+  int ret;
+
+  snprintf( statusLine, sizeof( statusLine ), "%s %lu\n",
+            status == SUCCESS ? "OK" : "ERR", (unsigned long)bodyLen );
+  ret = writeAll( clientFD, statusLine, strlen( statusLine ) );
+  if ( ret == SUCCESS && bodyLen > 0 )
+    ret = writeAll( clientFD, body, bodyLen );
+  if ( ret < 0 )
+    LOGPRINT( LVL_WARN, "sendControlResponse(): Could not send the "
+              "response: %s", strerror( errno ) );
+  close( clientFD );
+  return( ret );
+}
+
+
+//
+// NAME
+//   controlRequest - Send a request to orcad
+//
+// SYNOPSIS
+//   #include "ctlsock.h"
+//
+//   int controlRequest( const char *path, const char *request,
+//                       long timeoutMs, char **response );
+//
+// DESCRIPTION
+//   Connect to the control socket at path, send the request
+//   line and wait up to timeoutMs for the answer.  The output
+//   ( or error message ) is returned in *response as a
+//   malloc'd, null terminated string for the caller to free.
+//
+// RETURNS
+//   1                If orcad ran the command
+//  -1                If it failed ( see *response ) or on a
+//                    communications error
+//   CTLSOCK_NOSERVER If orcad is not running
+//   CTLSOCK_NOANSWER If orcad did not answer in time
+//
+int controlRequest( const char *path, const char *request, long timeoutMs,
+                    char **response )
+{
+  struct sockaddr_un addr;
+  struct timeval startTime;
+  char statusLine[CTLSOCK_STATUSLEN];
+  char status[4];
+  unsigned long bodyLen;
+  ssize_t len;
+  char *eol;
+  char *body;
+  int fd;
+
+  *response = NULL;
+  if ( fillSockAddr( &addr, path ) < 0 )
+    return( FAILURE );
+  if ( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 )
+    return( FAILURE );
+  if ( connect( fd, (struct sockaddr *)&addr, sizeof( addr ) ) < 0 )
+  {
+    close( fd );
+    if ( errno == ENOENT || errno == ECONNREFUSED )
+      return( CTLSOCK_NOSERVER );
+    return( FAILURE );
+  }
+
+  gettimeofday( &startTime, NULL );
+  if ( writeAll( fd, request, strlen( request ) ) < 0 ||
+       writeAll( fd, "\n", 1 ) < 0 )
+  {
+    close( fd );
+    return( FAILURE );
+  }
+
+  // The status line ( read a byte at a time so none of the
+  // body is consumed )
+  for ( len = 0; len < (ssize_t)sizeof( statusLine ) - 1; len++ )
+  {
+    if ( readUntil( fd, statusLine + len, 1, 0, &startTime,
+                    timeoutMs ) != 1 )
+    {
+      close( fd );
+      return( getMilliSecSince( &startTime ) >= timeoutMs ?
+              CTLSOCK_NOANSWER : FAILURE );
+    }
+    if ( statusLine[len] == '\n' )
+      break;
+  }
+  statusLine[len] = '\0';
+  if ( ( eol = strchr( statusLine, '\r' ) ) != NULL )
+    *eol = '\0';
+  if ( sscanf( statusLine, "%3s %lu", status, &bodyLen ) != 2 ||
+       bodyLen > ( 16UL << 20 ) ||
+       ( body = malloc( bodyLen + 1 ) ) == NULL )
+  {
+    close( fd );
+    return( FAILURE );
+  }
+
+  if ( ( len = readUntil( fd, body, bodyLen, 0, &startTime,
+                          timeoutMs ) ) != (ssize_t)bodyLen )
+  {
+    free( body );
+    close( fd );
+    return( FAILURE );
+  }
+  body[bodyLen] = '\0';
+  close( fd );
+
+  *response = body;
+  return( strcmp( status, "OK" ) == 0 ? SUCCESS : FAILURE );
+}
@@ -0,0 +1,51 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * ctlsock.h : Header for the orcad control socket
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  See ctlsock.c
+ *
+ */
+#ifndef _CTLSOCK_H
+#define _CTLSOCK_H
+
+#include <stddef.h>
+
+#define CTLSOCK_PATH       "/var/run/orcad.sock"
+#define CTLSOCK_MAXREQUEST 256
+
+// How long a client waits for orcad to answer.  orcad does
+// not answer while it is running a cast.
+#define CTLSOCK_TIMEOUT    30000      // ms
+
+//
+// controlRequest() return values besides SUCCESS/FAILURE
+//
+#define CTLSOCK_NOSERVER   -2         // orcad is not listening
+#define CTLSOCK_NOANSWER   -3         // orcad did not answer in time
+
+int openControlSocket( const char *path );
+void closeControlSocket( int listenFD, const char *path );
+int acceptControlRequest( int listenFD, long timeoutMs, char *request,
+                          size_t requestLen );
+int sendControlResponse( int clientFD, int status, const char *body,
+                         size_t bodyLen );
+int controlRequest( const char *path, const char *request, long timeoutMs,
+                    char **response );
+
+#endif
@@ -0,0 +1,661 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * datawriter.c : Batched, group committed data file writer
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  weatherd and auxiliaryd log a record every minute or so.
+ *  Flushing each one to the SD card means a small write, and
+ *  a read-modify-write of a flash page, per record.  A
+ *  dataWriter collects the records in memory and commits
+ *  them with a single O_APPEND write(2) every commitInterval
+ *  seconds ( data_commit_interval ), optionally followed by
+ *  an fsync() ( data_sync_policy ).  At most commitInterval
+ *  seconds of data are lost if the buoy loses power; on a
+ *  normal shutdown the buffer is committed first.
+ *
+ *  The daemons append to a temporary file which is renamed
+ *  to its final name when it is rotated.  The new temporary
+ *  file is written with its header under a ".new" name and
+ *  renamed into place, so it never exists without a header.
+ *
+ *  When a daemon starts and finds a temporary file left by
+ *  a crash any trailing partial record is cut off.  If the
+ *  file has the same header the daemon would write it is
+ *  resumed, otherwise ( e.g. the sensors were changed ) it
+ *  is moved to the caller's recovery name and a new file
+ *  is started.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "general.h"
+#include "log.h"
+#include "datawriter.h"
+
+static const char *dataSyncPolicyNames[] = { "none", "rotate", "commit",
+                                             NULL };
+
+
+//
+// NAME
+//   writeAll - Write a buffer, retrying short writes.
+//
+// RETURNS
+//   The number of bytes written.  This is less than len
+//   only if an error occured ( see errno ).
+//
+static size_t writeAll( int fd, const char *data, size_t len )
+{
+  size_t done = 0;
+  ssize_t ret;
+
+  while ( done < len )
+  {
+    if ( ( ret = write( fd, data + done, len - done ) ) < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+      break;
+    }
+    done += ret;
+  }
+  return( done );
+}
+
+
+//
+// NAME
+//   syncDirectory - fsync() the directory holding a file
+//
+// DESCRIPTION
+//   Makes a rename() of fileName durable.
+//
+static void syncDirectory( const char *fileName )
+{
+  char dirName[FILEPATHMAX];
+  char *slash;
+  int fd;
+
+  strncpy( dirName, fileName, FILEPATHMAX - 1 );
+  dirName[FILEPATHMAX - 1] = '\0';
+  if ( ( slash = strrchr( dirName, '/' ) ) == NULL )
+    strcpy( dirName, "." );
+  else if ( slash == dirName )
+    slash[1] = '\0';
+  else
+    *slash = '\0';
+
+  if ( ( fd = open( dirName, O_RDONLY ) ) >= 0 )
+  {
+    fsync( fd );
+    close( fd );
+  }
+}
+
+
+//
+// NAME
+//   createDataFile - Start a new file holding just the header
+//
+// DESCRIPTION
+//   The header is written to fileName.new which is then
+//   renamed to fileName, and fileName is opened for
+//   appending.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+static int createDataFile( struct dataWriter *dw )
+{
+  char newName[FILEPATHMAX + sizeof( DATAWRITER_NEWSUFFIX )];
+  size_t headerLen = strlen( dw->header );
+  int fd;
+
+  snprintf( newName, sizeof( newName ), "%s%s", dw->fileName,
+            DATAWRITER_NEWSUFFIX );
+  if ( ( fd = open( newName, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "createDataFile(): Could not create %s: %s",
+              newName, strerror( errno ) );
+    return( FAILURE );
+  }
+  if ( writeAll( fd, dw->header, headerLen ) != headerLen ||
+       ( dw->syncPolicy != DATASYNC_NONE && fsync( fd ) != 0 ) )
+  {
+    LOGPRINT( LVL_WARN, "createDataFile(): Could not write %s: %s",
+              newName, strerror( errno ) );
+    close( fd );
+    return( FAILURE );
+  }
+  close( fd );
+
+  if ( rename( newName, dw->fileName ) != 0 )
+  {
+    LOGPRINT( LVL_WARN, "createDataFile(): Could not rename %s: %s",
+              newName, strerror( errno ) );
+    return( FAILURE );
+  }
+  if ( dw->syncPolicy != DATASYNC_NONE )
+    syncDirectory( dw->fileName );
+
+  if ( ( dw->fd = open( dw->fileName, O_WRONLY | O_APPEND ) ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "createDataFile(): Could not open %s: %s",
+              dw->fileName, strerror( errno ) );
+    return( FAILURE );
+  }
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   recoverDataFile - Check for a file left by a crash
+//
+// DESCRIPTION
+//   Cut any partial last line off of an existing fileName.
+//   Keep it if it starts with our header, otherwise move it
+//   to recoverName ( or fileName.old if that is NULL ).
+//
+// RETURNS
+//   DATAWRITER_CREATED   : There is no file with records
+//   DATAWRITER_RESUMED   : The file can be appended to
+//   DATAWRITER_RECOVERED : The file was moved aside
+//
+static int recoverDataFile( struct dataWriter *dw, const char *recoverName )
+{
+  char oldName[FILEPATHMAX + 8];
+  char chunk[4096];
+  struct stat st;
+  size_t headerLen = strlen( dw->header );
+  off_t keep;
+  off_t pos;
+  ssize_t len;
+  ssize_t i;
+  int fd;
+
+  if ( ( fd = open( dw->fileName, O_RDWR ) ) < 0 )
+    return( DATAWRITER_CREATED );
+  if ( fstat( fd, &st ) != 0 )
+  {
+    close( fd );
+    return( DATAWRITER_CREATED );
+  }
+
+  // Find the end of the last complete line
+  keep = 0;
+  for ( pos = st.st_size; pos > 0; pos -= len )
+  {
+    len = ( pos < (off_t)sizeof( chunk ) ) ? pos : (off_t)sizeof( chunk );
+    if ( pread( fd, chunk, len, pos - len ) != len )
+      break;
+    for ( i = len; i > 0 && chunk[i - 1] != '\n'; i-- )
+      ;
+    if ( i > 0 )
+    {
+      keep = pos - len + i;
+      break;
+    }
+  }
+  if ( keep < st.st_size )
+  {
+    LOGPRINT( LVL_WARN, "recoverDataFile(): Dropping %ld bytes of a partial "
+              "record from %s", (long)( st.st_size - keep ), dw->fileName );
+    if ( ftruncate( fd, keep ) != 0 )
+      LOGPRINT( LVL_WARN, "recoverDataFile(): Could not truncate %s: %s",
+                dw->fileName, strerror( errno ) );
+  }
+
+  // Same header?  Carry on where we left off.
+  if ( keep >= (off_t)headerLen && headerLen < sizeof( chunk ) &&
+       pread( fd, chunk, headerLen, 0 ) == (ssize_t)headerLen &&
+       memcmp( chunk, dw->header, headerLen ) == 0 )
+  {
+    close( fd );
+    if ( keep == (off_t)headerLen )
+      return( DATAWRITER_CREATED );
+    return( DATAWRITER_RESUMED );
+  }
+  close( fd );
+
+  if ( keep == 0 )
+    return( DATAWRITER_CREATED );
+
+  if ( recoverName == NULL )
+  {
+    snprintf( oldName, sizeof( oldName ), "%s.old", dw->fileName );
+    recoverName = oldName;
+  }
+  if ( rename( dw->fileName, recoverName ) != 0 )
+  {
+    LOGPRINT( LVL_WARN, "recoverDataFile(): Could not move %s to %s: %s",
+              dw->fileName, recoverName, strerror( errno ) );
+    return( FAILURE );
+  }
+  LOGPRINT( LVL_ALRT, "recoverDataFile(): Moved %s, left by a crash, to %s.",
+            dw->fileName, recoverName );
+  return( DATAWRITER_RECOVERED );
+}
+
+
+//
+// NAME
+//   openDataWriter - Open a data file for batched appends.
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int openDataWriter( struct dataWriter *dw, const char *fileName,
+//                       const char *header, int commitInterval,
+//                       int syncPolicy, const char *recoverName );
+//
+// DESCRIPTION
+//   Start appending to the temporary file fileName, which
+//   begins with header.  Records are committed every
+//   commitInterval seconds ( 0 commits every record ) and
+//   synced according to syncPolicy ( enum dataSyncPolicies ).
+//   A file left by a crash is resumed or moved to
+//   recoverName ( see above ).
+//
+// RETURNS
+//   -1 : Failure
+//   DATAWRITER_CREATED, DATAWRITER_RESUMED or
+//   DATAWRITER_RECOVERED on success.
+//
+int openDataWriter( struct dataWriter *dw, const char *fileName,
+                    const char *header, int commitInterval, int syncPolicy,
+                    const char *recoverName )
+{
+  int ret;
+
+  memset( dw, 0, sizeof( struct dataWriter ) );
+  dw->fd = -1;
+  if ( strlen( fileName ) >= FILEPATHMAX )
+  {
+    LOGPRINT( LVL_WARN, "openDataWriter(): File name %s is too long",
+              fileName );
+    return( FAILURE );
+  }
+  strcpy( dw->fileName, fileName );
+  dw->commitInterval = commitInterval;
+  dw->syncPolicy = syncPolicy;
+  dw->lastCommit = time( NULL );
+  if ( ( dw->header = strdup( header ? header : "" ) ) == NULL ||
+       ( dw->buff = malloc( DATAWRITER_BUFFSIZE ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "openDataWriter(): Out of memory" );
+    free( dw->header );
+    dw->header = NULL;
+    return( FAILURE );
+  }
+
+  if ( ( ret = recoverDataFile( dw, recoverName ) ) == DATAWRITER_RESUMED )
+  {
+    if ( ( dw->fd = open( dw->fileName, O_WRONLY | O_APPEND ) ) < 0 )
+    {
+      LOGPRINT( LVL_WARN, "openDataWriter(): Could not open %s: %s",
+                dw->fileName, strerror( errno ) );
+      ret = FAILURE;
+    }else
+      LOGPRINT( LVL_ALRT, "openDataWriter(): Resuming %s.", dw->fileName );
+  }else if ( ret != FAILURE && createDataFile( dw ) < 0 )
+    ret = FAILURE;
+
+  if ( ret == FAILURE )
+  {
+    free( dw->header );
+    free( dw->buff );
+    dw->header = NULL;
+    dw->buff = NULL;
+  }
+  return( ret );
+}
+
+
+//
+// NAME
+//   writeDataWriter - Add data to the batch.
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int writeDataWriter( struct dataWriter *dw, const char *data,
+//                        size_t len );
+//
+// DESCRIPTION
+//   Buffer len bytes of data, committing the batch first if
+//   it is full.  Otherwise nothing is written until the next
+//   flushDataWriter().
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int writeDataWriter( struct dataWriter *dw, const char *data, size_t len )
+{
+  if ( dw->fd < 0 )
+    return( FAILURE );
+
+  if ( dw->buffLen + len > DATAWRITER_BUFFSIZE &&
+       commitDataWriter( dw ) < 0 )
+    return( FAILURE );
+
+  if ( len > DATAWRITER_BUFFSIZE )
+  {
+    if ( writeAll( dw->fd, data, len ) != len )
+    {
+      LOGPRINT( LVL_WARN, "writeDataWriter(): Could not write to %s: %s",
+                dw->fileName, strerror( errno ) );
+      return( FAILURE );
+    }
+    dw->numBytes += len;
+    return( SUCCESS );
+  }
+
+  memcpy( dw->buff + dw->buffLen, data, len );
+  dw->buffLen += len;
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   printDataWriter - Add formatted data to the batch.
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int printDataWriter( struct dataWriter *dw, const char *format,
+//                        ... );
+//
+// DESCRIPTION
+//   The fprintf() equivalent of writeDataWriter().  The
+//   result must fit in DATAWRITER_BUFFSIZE bytes.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int printDataWriter( struct dataWriter *dw, const char *format, ... )
+{
+  va_list args;
+  int len;
+
+  if ( dw->fd < 0 )
+    return( FAILURE );
+
+  va_start( args, format );
+  len = vsnprintf( dw->buff + dw->buffLen,
+                   DATAWRITER_BUFFSIZE - dw->buffLen, format, args );
+  va_end( args );
+  if ( len < 0 )
+    return( FAILURE );
+
+  if ( dw->buffLen + len >= DATAWRITER_BUFFSIZE )
+  {
+    // Did not fit, make room and try again
+    if ( dw->buffLen == 0 || commitDataWriter( dw ) < 0 )
+    {
+      LOGPRINT( LVL_WARN, "printDataWriter(): No room for a %d byte "
+                "record in %s", len, dw->fileName );
+      return( FAILURE );
+    }
+    va_start( args, format );
+    len = vsnprintf( dw->buff, DATAWRITER_BUFFSIZE, format, args );
+    va_end( args );
+    if ( len < 0 || len >= DATAWRITER_BUFFSIZE )
+      return( FAILURE );
+  }
+  dw->buffLen += len;
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   commitDataWriter - Write the batch to the file.
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int commitDataWriter( struct dataWriter *dw );
+//
+// DESCRIPTION
+//   Append everything buffered with one write(2), and
+//   fsync() it under DATASYNC_COMMIT.  Whatever could not
+//   be written stays buffered for the next attempt.
+//
+// RETURNS
+//   -1 : Failure
+//   The number of bytes written otherwise.
+//
+int commitDataWriter( struct dataWriter *dw )
+{
+  size_t written;
+
+  if ( dw->fd < 0 )
+    return( FAILURE );
+
+  dw->lastCommit = time( NULL );
+  if ( dw->buffLen == 0 )
+    return( 0 );
+
+  written = writeAll( dw->fd, dw->buff, dw->buffLen );
+  dw->numBytes += written;
+  if ( written < dw->buffLen )
+  {
+    LOGPRINT( LVL_WARN, "commitDataWriter(): Could not write to %s: %s",
+              dw->fileName, strerror( errno ) );
+    memmove( dw->buff, dw->buff + written, dw->buffLen - written );
+    dw->buffLen -= written;
+    return( FAILURE );
+  }
+  dw->buffLen = 0;
+  dw->numCommits++;
+
+  if ( dw->syncPolicy == DATASYNC_COMMIT && fsync( dw->fd ) != 0 )
+    LOGPRINT( LVL_WARN, "commitDataWriter(): Could not sync %s: %s",
+              dw->fileName, strerror( errno ) );
+
+  return( (int)written );
+}
+
+
+//
+// NAME
+//   flushDataWriter - Commit the batch if it is due.
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int flushDataWriter( struct dataWriter *dw, int force );
+//
+// DESCRIPTION
+//   Commit if force is set or commitInterval seconds have
+//   passed since the last commit.  Daemons call this once
+//   per pass of their main loop so that the loss window
+//   holds when no records are being written.
+//
+// RETURNS
+//   -1 : Failure
+//    0 : Nothing was due
+//   The number of bytes written otherwise.
+//
+int flushDataWriter( struct dataWriter *dw, int force )
+{
+  time_t now;
+
+  if ( dw->fd < 0 )
+    return( FAILURE );
+  if ( dw->buffLen == 0 )
+    return( 0 );
+
+  now = time( NULL );
+  if ( force || dw->commitInterval <= 0 || now < dw->lastCommit ||
+       ( now - dw->lastCommit ) >= dw->commitInterval )
+    return( commitDataWriter( dw ) );
+
+  return( 0 );
+}
+
+
+//
+// NAME
+//   rotateDataWriter - Move the data file to its final name.
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int rotateDataWriter( struct dataWriter *dw, const char *newName );
+//
+// DESCRIPTION
+//   Commit the batch, rename the file to newName and start
+//   a new file holding only the header.  If the rename
+//   fails the data stays in the current file, which is
+//   kept open.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int rotateDataWriter( struct dataWriter *dw, const char *newName )
+{
+  if ( dw->fd < 0 )
+    return( FAILURE );
+
+  commitDataWriter( dw );
+  if ( dw->syncPolicy != DATASYNC_NONE )
+    fsync( dw->fd );
+
+  if ( rename( dw->fileName, newName ) != 0 )
+  {
+    LOGPRINT( LVL_WARN, "rotateDataWriter(): Could not rename %s to %s: %s",
+              dw->fileName, newName, strerror( errno ) );
+    return( FAILURE );
+  }
+  close( dw->fd );
+  dw->fd = -1;
+  if ( dw->syncPolicy != DATASYNC_NONE )
+    syncDirectory( newName );
+
+  return( createDataFile( dw ) );
+}
+
+
+//
+// NAME
+//   closeDataWriter - Commit and close a data file.
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int closeDataWriter( struct dataWriter *dw, const char *newName );
+//
+// DESCRIPTION
+//   Commit the batch and close the file, renaming it to
+//   newName unless that is NULL.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int closeDataWriter( struct dataWriter *dw, const char *newName )
+{
+  int ret = SUCCESS;
+
+  if ( dw->fd < 0 )
+    return( FAILURE );
+
+  if ( commitDataWriter( dw ) < 0 )
+    ret = FAILURE;
+  if ( dw->syncPolicy != DATASYNC_NONE )
+    fsync( dw->fd );
+  close( dw->fd );
+  dw->fd = -1;
+
+  if ( newName != NULL )
+  {
+    if ( rename( dw->fileName, newName ) != 0 )
+    {
+      LOGPRINT( LVL_WARN, "closeDataWriter(): Could not rename %s to %s: %s",
+                dw->fileName, newName, strerror( errno ) );
+      ret = FAILURE;
+    }else if ( dw->syncPolicy != DATASYNC_NONE )
+      syncDirectory( newName );
+  }
+
+  free( dw->header );
+  free( dw->buff );
+  dw->header = NULL;
+  dw->buff = NULL;
+  dw->buffLen = 0;
+
+  return( ret );
+}
+
+
+//
+// NAME
+//   getDataSyncPolicyName - Config file name of a sync policy
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   const char *getDataSyncPolicyName( int syncPolicy );
+//
+const char *getDataSyncPolicyName( int syncPolicy )
+{
+  if ( syncPolicy < DATASYNC_NONE || syncPolicy > DATASYNC_COMMIT )
+    return( "unknown" );
+  return( dataSyncPolicyNames[syncPolicy] );
+}
+
+
+//
+// NAME
+//   parseDataSyncPolicy - Sync policy from its config file name
+//
+// SYNOPSIS
+//   #include "datawriter.h"
+//
+//   int parseDataSyncPolicy( const char *name );
+//
+// RETURNS
+//   -1 : Unknown policy
+//   A member of enum dataSyncPolicies otherwise.
+//
+int parseDataSyncPolicy( const char *name )
+{
+  int i;
+
+  for ( i = 0; dataSyncPolicyNames[i] != NULL; i++ )
+    if ( strcasecmp( name, dataSyncPolicyNames[i] ) == 0 )
+      return( i );
+  return( FAILURE );
+}
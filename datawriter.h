@@ -0,0 +1,88 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * datawriter.h : Header for the batched data file writer
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  See datawriter.c
+ *
+ */
+#ifndef _DATAWRITER_H
+#define _DATAWRITER_H
+
+#include <stdio.h>
+#include <time.h>
+#include "general.h"
+
+#define DATAWRITER_BUFFSIZE       65536
+#define DATAWRITER_NEWSUFFIX      ".new"
+
+// Defaults for data_commit_interval ( seconds ) and
+// data_sync_policy
+#define DATAWRITER_DEFAULT_INTERVAL 300
+#define DATAWRITER_DEFAULT_SYNC     DATASYNC_COMMIT
+
+//
+// When the data is fsync()'d to the card
+//
+enum dataSyncPolicies {
+  DATASYNC_NONE,      // Never, leave it to the kernel
+  DATASYNC_ROTATE,    // When the file is rotated or closed
+  DATASYNC_COMMIT     // After every commit
+};
+
+//
+// openDataWriter() return values
+//
+#define DATAWRITER_CREATED    1   // Started a new file
+#define DATAWRITER_RESUMED    2   // Appending to a file left by a crash
+#define DATAWRITER_RECOVERED  3   // A crashed file was moved aside
+
+/* dataWriter
+ *
+ * A text data file open for appending.  Records collect
+ * in buff and are written to the file at most every
+ * commitInterval seconds.
+ *
+ */
+struct dataWriter {
+  int fd;
+  char fileName[FILEPATHMAX];
+  char *header;
+  char *buff;
+  size_t buffLen;
+  int commitInterval;
+  int syncPolicy;
+  time_t lastCommit;
+  unsigned long numCommits;
+  unsigned long numBytes;
+};
+
+int openDataWriter( struct dataWriter *dw, const char *fileName,
+                    const char *header, int commitInterval, int syncPolicy,
+                    const char *recoverName );
+int writeDataWriter( struct dataWriter *dw, const char *data, size_t len );
+int printDataWriter( struct dataWriter *dw, const char *format, ... )
+                     __attribute__ ((format (printf, 2, 3)));
+int commitDataWriter( struct dataWriter *dw );
+int flushDataWriter( struct dataWriter *dw, int force );
+int rotateDataWriter( struct dataWriter *dw, const char *newName );
+int closeDataWriter( struct dataWriter *dw, const char *newName );
+const char *getDataSyncPolicyName( int syncPolicy );
+int parseDataSyncPolicy( const char *name );
+
+#endif
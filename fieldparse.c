@@ -0,0 +1,356 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * fieldparse.c : Instrument field parsers
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  These run on every sample of every sensor so they avoid
+ *  the scanf family altogether.  A line is split in place
+ *  into an array of field pointers and each field is then
+ *  converted on its own.  Empty fields are kept, which is
+ *  what lets a CSV line with optional values ( e.g. the 
+ *  Gill METPAK's "Q,,,1010.3,..." ) be read by column.
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include "general.h"
+#include "fieldparse.h"
+
+// Powers of ten for the decimal converter
+static const double pow10Table[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define POW10MAX 22
+
+// Mantissa digits beyond this are only counted
+#define MAXMANTISSADIGITS 19
+
+
+static int isFieldSpace( char c )
+{
+  return( c == ' ' || c == '\t' || c == '\r' || c == '\n' );
+}
+
+
+// 
+// NAME
+//   splitFields - Split a delimited line into fields in place.
+//
+// SYNOPSIS
+//   #include "fieldparse.h"
+//
+//   int splitFields( char *line, char delim, char **fields, 
+//                    int maxFields );
+//
+// DESCRIPTION
+//   Replace each delimiter in line with a '\0' and store a
+//   pointer to the start of each field in fields.  Empty
+//   fields are preserved ( "a,,b" is three fields ) and a 
+//   trailing CR/LF is removed from the last one.  Splitting
+//   stops after maxFields fields; the remainder of the line 
+//   is left in the last field.
+//
+// RETURNS
+//   The number of fields stored or -1 on bad arguments.
+//
+int splitFields( char *line, char delim, char **fields, int maxFields )
+{
+  int numFields = 0;
+  char *ptr;
+
+  if ( line == NULL || fields == NULL || maxFields < 1 )
+    return( FAILURE );
+
+  fields[numFields++] = line;
+  for ( ptr = line; *ptr != '\0'; ptr++ )
+  {
+    if ( *ptr == delim && numFields < maxFields )
+    {
+      *ptr = '\0';
+      fields[numFields++] = ptr + 1;
+    }else if ( *ptr == '\r' || *ptr == '\n' )
+    {
+      *ptr = '\0';
+      break;
+    }
+  }
+
+  return( numFields );
+}
+
+
+// 
+// NAME
+//   splitWords - Split a whitespace separated line in place.
+//
+// SYNOPSIS
+//   #include "fieldparse.h"
+//
+//   int splitWords( char *line, char **fields, int maxFields );
+//
+// DESCRIPTION
+//   Like splitFields() but runs of spaces, tabs and line
+//   terminators count as a single separator and leading
+//   whitespace is skipped, so there are no empty fields.
+//
+// RETURNS
+//   The number of fields stored or -1 on bad arguments.
+//
+int splitWords( char *line, char **fields, int maxFields )
+{
+  int numFields = 0;
+  char *ptr = line;
+
+  if ( line == NULL || fields == NULL || maxFields < 1 )
+    return( FAILURE );
+
+  while ( numFields < maxFields )
+  {
+    while ( isFieldSpace( *ptr ) )
+      ptr++;
+    if ( *ptr == '\0' )
+      break;
+    fields[numFields++] = ptr;
+    while ( *ptr != '\0' && ! isFieldSpace( *ptr ) )
+      ptr++;
+    if ( *ptr == '\0' )
+      break;
+    *ptr++ = '\0';
+  }
+
+  return( numFields );
+}
+
+
+// 
+// NAME
+//   parseDoubleField - Convert a field to a double.
+//
+// SYNOPSIS
+//   #include "fieldparse.h"
+//
+//   int parseDoubleField( const char *field, double *value );
+//
+// DESCRIPTION
+//   Convert a decimal number of the form [+-]ddd[.ddd][e[+-]dd]
+//   surrounded by optional whitespace.  The field must hold
+//   nothing else; empty fields and trailing junk are errors.
+//   value is only changed on success.  The digits are
+//   gathered into a 64 bit integer and scaled once, which
+//   is exact for the handful of significant digits our
+//   instruments send.
+//
+// RETURNS
+//   1 on success, -1 if the field is not a number.
+//
+int parseDoubleField( const char *field, double *value )
+{
+  const char *ptr = field;
+  uint64_t mantissa = 0;
+  int numDigits = 0;
+  int sigDigits = 0;
+  int decExponent = 0;
+  int expValue = 0;
+  int expNegative = 0;
+  int negative = 0;
+  double result;
+
+  if ( field == NULL || value == NULL )
+    return( FAILURE );
+
+  while ( isFieldSpace( *ptr ) )
+    ptr++;
+  if ( *ptr == '-' || *ptr == '+' )
+    negative = ( *ptr++ == '-' );
+
+  for ( ; *ptr >= '0' && *ptr <= '9'; ptr++, numDigits++ )
+  {
+    if ( sigDigits < MAXMANTISSADIGITS )
+    {
+      mantissa = mantissa * 10 + ( *ptr - '0' );
+      if ( mantissa )
+        sigDigits++;
+    }else
+      decExponent++;
+  }
+  if ( *ptr == '.' )
+  {
+    for ( ptr++; *ptr >= '0' && *ptr <= '9'; ptr++, numDigits++ )
+    {
+      if ( sigDigits < MAXMANTISSADIGITS )
+      {
+        mantissa = mantissa * 10 + ( *ptr - '0' );
+        if ( mantissa )
+          sigDigits++;
+        decExponent--;
+      }
+    }
+  }
+  if ( numDigits == 0 )
+    return( FAILURE );
+
+  if ( *ptr == 'e' || *ptr == 'E' )
+  {
+    ptr++;
+    if ( *ptr == '-' || *ptr == '+' )
+      expNegative = ( *ptr++ == '-' );
+    if ( *ptr < '0' || *ptr > '9' )
+      return( FAILURE );
+    for ( ; *ptr >= '0' && *ptr <= '9'; ptr++ )
+      if ( expValue < 1000 )
+        expValue = expValue * 10 + ( *ptr - '0' );
+    decExponent += expNegative ? -expValue : expValue;
+  }
+
+  while ( isFieldSpace( *ptr ) )
+    ptr++;
+  if ( *ptr != '\0' )
+    return( FAILURE );
+
+  result = (double)mantissa;
+  if ( mantissa != 0 )
+  {
+    while ( decExponent > POW10MAX )
+    {
+      result *= pow10Table[POW10MAX];
+      decExponent -= POW10MAX;
+    }
+    while ( decExponent < -POW10MAX )
+    {
+      result /= pow10Table[POW10MAX];
+      decExponent += POW10MAX;
+    }
+    if ( decExponent > 0 )
+      result *= pow10Table[decExponent];
+    else if ( decExponent < 0 )
+      result /= pow10Table[-decExponent];
+  }
+
+  *value = negative ? -result : result;
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   parseFloatField - Convert a field to a float.
+//
+// SYNOPSIS
+//   #include "fieldparse.h"
+//
+//   int parseFloatField( const char *field, float *value );
+//
+// DESCRIPTION
+//   See parseDoubleField().  value is only changed on 
+//   success.
+//
+// RETURNS
+//   1 on success, -1 if the field is not a number.
+//
+int parseFloatField( const char *field, float *value )
+{
+  double result;
+
+  if ( value == NULL || parseDoubleField( field, &result ) != SUCCESS )
+    return( FAILURE );
+  *value = (float)result;
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   parseIntField - Convert a field to an int.
+//
+// SYNOPSIS
+//   #include "fieldparse.h"
+//
+//   int parseIntField( const char *field, int *value );
+//
+// DESCRIPTION
+//   Convert a decimal integer of the form [+-]ddd surrounded
+//   by optional whitespace.  Empty fields, trailing junk and 
+//   values which do not fit in an int are errors.  value is
+//   only changed on success.
+//
+// RETURNS
+//   1 on success, -1 if the field is not an integer.
+//
+int parseIntField( const char *field, int *value )
+{
+  const char *ptr = field;
+  long long result = 0;
+  int negative = 0;
+  int numDigits = 0;
+
+  if ( field == NULL || value == NULL )
+    return( FAILURE );
+
+  while ( isFieldSpace( *ptr ) )
+    ptr++;
+  if ( *ptr == '-' || *ptr == '+' )
+    negative = ( *ptr++ == '-' );
+  for ( ; *ptr >= '0' && *ptr <= '9'; ptr++, numDigits++ )
+  {
+    result = result * 10 + ( *ptr - '0' );
+    if ( result > 2147483648LL )
+      return( FAILURE );
+  }
+  while ( isFieldSpace( *ptr ) )
+    ptr++;
+  if ( numDigits == 0 || *ptr != '\0' )
+    return( FAILURE );
+  if ( negative )
+    result = -result;
+  if ( result > 2147483647LL )
+    return( FAILURE );
+
+  *value = (int)result;
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   parseFloatFields - Convert a run of fields to floats.
+//
+// SYNOPSIS
+//   #include "fieldparse.h"
+//
+//   int parseFloatFields( char **fields, int numFields, 
+//                         float *values );
+//
+// DESCRIPTION
+//   Convert fields[0] through fields[numFields-1] into 
+//   values[], stopping at the first field which is not a
+//   number.
+//
+// RETURNS
+//   The number of leading fields converted.
+//
+int parseFloatFields( char **fields, int numFields, float *values )
+{
+  int i;
+
+  for ( i = 0; i < numFields; i++ )
+    if ( parseFloatField( fields[i], &values[i] ) != SUCCESS )
+      break;
+  return( i );
+}
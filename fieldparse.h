@@ -0,0 +1,38 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * fieldparse.h : Header for the instrument field parsers
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ * Small, reentrant routines for pulling fields out of the
+ * lines our instruments send.  Nothing is allocated and
+ * there is no hidden state ( unlike strtok ), lines are
+ * split in place and every converter reports whether the
+ * whole field was a valid number.
+ *
+ */
+#ifndef _FIELDPARSE_H
+#define _FIELDPARSE_H
+
+int splitFields( char *line, char delim, char **fields, int maxFields );
+int splitWords( char *line, char **fields, int maxFields );
+int parseFloatField( const char *field, float *value );
+int parseDoubleField( const char *field, double *value );
+int parseIntField( const char *field, int *value );
+int parseFloatFields( char **fields, int numFields, float *values );
+
+#endif
@@ -0,0 +1,185 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * fieldparse_bench.c : Timing harness for the field parsers
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Time the fieldparse.c converters against the C library
+ *  routines they replaced on a set of fields taken from real
+ *  instrument output ( SeaFET, METPAK, S9, CTD 19plus ).
+ *
+ *  usage: fieldparse_bench [-n iterations]
+ *
+ *  Each converter is run over every field n times ( default
+ *  200000 ) and the mean time per field is printed.  Build
+ *  with "make fieldparse_bench"; it is not installed.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "general.h"
+#include "fieldparse.h"
+
+#define BENCH_ITERATIONS 200000L
+
+// Fields as the instruments send them
+static const char *realFields[] = {
+  "23.2585735", "6.53811", "6.41548", "18.8480", "-0.97828925",
+  "-0.93706161", "0.90207696", "0.000", "3.9", "4.850", " 12.3456",
+  "1010.3", "-2.57", "1.5e-3", " 0.0521", "359", NULL
+};
+
+static const char *intFields[] = {
+  "19", "0", "10", "2014317", "-42", "4096", "123456", " 77", NULL
+};
+
+// A METPAK data line ( see weatherd.c )
+static const char metLine[] =
+  "Q,270,001.53,M,1010.3,+012.37,+045.6,+08.23,,,+11.9,00,\r\n";
+
+static volatile double sink;
+
+
+static double elapsedNs( struct timespec *start )
+{
+  struct timespec now;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return( ( now.tv_sec - start->tv_sec ) * 1e9 +
+          ( now.tv_nsec - start->tv_nsec ) );
+}
+
+
+static void report( const char *name, double ns, long count )
+{
+  printf( "  %-24s %8.1f ns/field\n", name, ns / count );
+}
+
+
+void usage( void )
+{
+  fprintf( stderr,
+    "usage: fieldparse_bench [-n iterations]\n"
+    "  -n iterations : Times each field is converted ( default: %ld )\n",
+    BENCH_ITERATIONS );
+}
+
+
+int main ( int argc, char *argv[] )
+{
+  struct timespec start;
+  char line[sizeof( metLine )];
+  char *fields[16];
+  char *end;
+  long iterations = BENCH_ITERATIONS;
+  long numReal, numInt, n;
+  double dval, sum;
+  float fval;
+  int ival;
+  int opt, i;
+
+  while ( ( opt = getopt( argc, argv, "n:" ) ) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'n':
+        iterations = strtol( optarg, &end, 10 );
+        if ( *end != '\0' || iterations < 1 )
+        {
+          usage();
+          exit( 1 );
+        }
+        break;
+      default:
+        usage();
+        exit( 1 );
+    }
+  }
+
+  for ( numReal = 0; realFields[numReal] != NULL; numReal++ );
+  for ( numInt = 0; intFields[numInt] != NULL; numInt++ );
+
+  printf( "fieldparse_bench: %ld iterations\n", iterations );
+
+  sum = 0;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for ( n = 0; n < iterations; n++ )
+    for ( i = 0; i < numReal; i++ )
+      if ( parseDoubleField( realFields[i], &dval ) == SUCCESS )
+        sum += dval;
+  report( "parseDoubleField", elapsedNs( &start ), iterations * numReal );
+  sink = sum;
+
+  sum = 0;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for ( n = 0; n < iterations; n++ )
+    for ( i = 0; i < numReal; i++ )
+      sum += strtod( realFields[i], &end );
+  report( "strtod", elapsedNs( &start ), iterations * numReal );
+  sink = sum;
+
+  sum = 0;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for ( n = 0; n < iterations; n++ )
+    for ( i = 0; i < numReal; i++ )
+      if ( parseFloatField( realFields[i], &fval ) == SUCCESS )
+        sum += fval;
+  report( "parseFloatField", elapsedNs( &start ), iterations * numReal );
+  sink = sum;
+
+  sum = 0;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for ( n = 0; n < iterations; n++ )
+    for ( i = 0; i < numReal; i++ )
+      if ( sscanf( realFields[i], "%f", &fval ) == 1 )
+        sum += fval;
+  report( "sscanf(\"%f\")", elapsedNs( &start ), iterations * numReal );
+  sink = sum;
+
+  sum = 0;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for ( n = 0; n < iterations; n++ )
+    for ( i = 0; i < numInt; i++ )
+      if ( parseIntField( intFields[i], &ival ) == SUCCESS )
+        sum += ival;
+  report( "parseIntField", elapsedNs( &start ), iterations * numInt );
+  sink = sum;
+
+  sum = 0;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for ( n = 0; n < iterations; n++ )
+    for ( i = 0; i < numInt; i++ )
+      sum += strtol( intFields[i], &end, 10 );
+  report( "strtol", elapsedNs( &start ), iterations * numInt );
+  sink = sum;
+
+  sum = 0;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for ( n = 0; n < iterations; n++ )
+  {
+    memcpy( line, metLine, sizeof( line ) );
+    sum += splitFields( line, ',', fields, 16 );
+  }
+  printf( "  %-24s %8.1f ns/line\n", "splitFields ( METPAK )",
+          elapsedNs( &start ) / iterations );
+  sink = sum;
+
+  return( 0 );
+}
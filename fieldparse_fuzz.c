@@ -0,0 +1,444 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * fieldparse_fuzz.c : Randomized check of the field parsers
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Feed parseDoubleField(), parseFloatField(), parseIntField()
+ *  and splitFields() random input and check every answer
+ *  against the C library.
+ *
+ *  usage: fieldparse_fuzz [-n cases] [-s seed]
+ *
+ *  The cases are a mix of well formed numbers, numbers with
+ *  a random edit ( a character changed, added or removed )
+ *  and random junk.  A field is expected to be accepted
+ *  exactly when strtod()/strtol() consume all of it but
+ *  surrounding blanks.  Hex, "inf" and "nan" are the one
+ *  deliberate difference: strtod() takes them, our parsers
+ *  reject them.  Accepted values must agree with strtod()
+ *  to within FUZZ_RELERR ( a float to within one ulp of the
+ *  rounded double ) and ints exactly.  On failure the output
+ *  value must be left alone.
+ *
+ *  Exits 0 if every case agreed, 1 otherwise ( the first
+ *  FUZZ_MAXREPORT disagreements are printed ).  Build with
+ *  "make fieldparse_fuzz"; it is not installed.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include "general.h"
+#include "fieldparse.h"
+
+#define FUZZ_CASES      1000000L
+#define FUZZ_FIELDLEN   64
+#define FUZZ_RELERR     1e-13
+#define FUZZ_MAXREPORT  10
+#define FUZZ_SENTINEL   -12345
+
+// Characters the junk and the edits are made of.  No \v or
+// \f: isspace() skips them but the instruments never send
+// them and our parsers do not treat them as blanks.
+static const char junkChars[] = "0123456789+-.eE \t\r\nxXnNiIa,;";
+
+static uint64_t rngState;
+static long numFailed = 0;
+
+
+//
+// xorshift64* so that a seed always gives the same cases
+//
+static uint64_t nextRandom( void )
+{
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return( rngState * 2685821657736338717ULL );
+}
+
+
+static int randomBelow( int n )
+{
+  return( (int)( nextRandom() % (uint64_t)n ) );
+}
+
+
+static void addDigits( char *buff, int *len, int count )
+{
+  while ( count-- > 0 && *len < FUZZ_FIELDLEN - 8 )
+    buff[(*len)++] = '0' + randomBelow( 10 );
+}
+
+
+//
+// A number in the instruments' format with random lengths
+//
+static void makeNumber( char *buff, int isInt )
+{
+  int len = 0;
+
+  if ( randomBelow( 4 ) == 0 )
+    buff[len++] = randomBelow( 2 ) ? ' ' : '\t';
+  if ( randomBelow( 3 ) == 0 )
+    buff[len++] = randomBelow( 2 ) ? '-' : '+';
+  addDigits( buff, &len, randomBelow( isInt ? 12 : 22 ) );
+  if ( ! isInt )
+  {
+    if ( randomBelow( 3 ) > 0 )
+    {
+      buff[len++] = '.';
+      addDigits( buff, &len, randomBelow( 22 ) );
+    }
+    if ( randomBelow( 4 ) == 0 )
+    {
+      buff[len++] = randomBelow( 2 ) ? 'e' : 'E';
+      if ( randomBelow( 2 ) )
+        buff[len++] = randomBelow( 2 ) ? '-' : '+';
+      addDigits( buff, &len, 1 + randomBelow( 3 ) );
+    }
+  }
+  if ( randomBelow( 4 ) == 0 )
+    buff[len++] = randomBelow( 2 ) ? ' ' : '\r';
+  buff[len] = '\0';
+}
+
+
+//
+// Change, add or remove one character
+//
+static void mutate( char *buff )
+{
+  int len = strlen( buff );
+  int pos = randomBelow( len + 1 );
+  char c = junkChars[randomBelow( sizeof( junkChars ) - 1 )];
+
+  switch ( randomBelow( 3 ) )
+  {
+    case 0:
+      if ( pos < len )
+        buff[pos] = c;
+      break;
+    case 1:
+      if ( len < FUZZ_FIELDLEN - 1 )
+      {
+        memmove( buff + pos + 1, buff + pos, len - pos + 1 );
+        buff[pos] = c;
+      }
+      break;
+    default:
+      if ( pos < len )
+        memmove( buff + pos, buff + pos + 1, len - pos );
+      break;
+  }
+}
+
+
+static void makeJunk( char *buff )
+{
+  int len = randomBelow( 20 );
+  int i;
+
+  for ( i = 0; i < len; i++ )
+    buff[i] = junkChars[randomBelow( sizeof( junkChars ) - 1 )];
+  buff[len] = '\0';
+}
+
+
+static void makeField( char *buff, int isInt )
+{
+  static const char *intEdges[] = { "2147483647", "2147483648",
+                                    "-2147483648", "-2147483649",
+                                    "-0", "+0", "00000000000000000000007" };
+  int kind = randomBelow( 10 );
+
+  if ( isInt && kind == 0 )
+    strcpy( buff, intEdges[randomBelow( 7 )] );
+  else if ( kind < 6 )
+    makeNumber( buff, isInt );
+  else if ( kind < 9 )
+  {
+    makeNumber( buff, isInt );
+    mutate( buff );
+  }else
+    makeJunk( buff );
+}
+
+
+static int isBlank( char c )
+{
+  return( c == ' ' || c == '\t' || c == '\r' || c == '\n' );
+}
+
+
+//
+// The reference answers
+//
+static int refDouble( const char *field, double *value )
+{
+  char *end;
+
+  if ( strpbrk( field, "xXiInN" ) != NULL )
+    return( FAILURE );
+  *value = strtod( field, &end );
+  if ( end == field )
+    return( FAILURE );
+  while ( isBlank( *end ) )
+    end++;
+  return( *end == '\0' ? SUCCESS : FAILURE );
+}
+
+
+static int refInt( const char *field, int *value )
+{
+  char *end;
+  long long result;
+
+  errno = 0;
+  result = strtoll( field, &end, 10 );
+  if ( end == field || errno == ERANGE ||
+       result < INT_MIN || result > INT_MAX )
+    return( FAILURE );
+  while ( isBlank( *end ) )
+    end++;
+  if ( *end != '\0' )
+    return( FAILURE );
+  *value = (int)result;
+  return( SUCCESS );
+}
+
+
+static int closeEnough( double got, double want )
+{
+  if ( isinf( want ) )
+    return( got == want );
+  // Past the pow10 table the scaling is repeated, so allow
+  // overflow right at the limit and loss in the subnormals
+  if ( fabs( want ) > 1e300 )
+    return( isinf( got ) || fabs( got - want ) <= FUZZ_RELERR * fabs( want ) );
+  if ( fabs( want ) < 1e-290 )
+    return( fabs( got ) < 1e-280 );
+  return( fabs( got - want ) <= FUZZ_RELERR * fabs( want ) );
+}
+
+
+static void reportFailure( const char *what, const char *field,
+                           const char *detail )
+{
+  const char *ptr;
+
+  if ( ++numFailed > FUZZ_MAXREPORT )
+    return;
+  printf( "  %s: \"", what );
+  for ( ptr = field; *ptr != '\0'; ptr++ )
+  {
+    if ( *ptr == '\r' )
+      printf( "\\r" );
+    else if ( *ptr == '\n' )
+      printf( "\\n" );
+    else if ( *ptr == '\t' )
+      printf( "\\t" );
+    else
+      putchar( *ptr );
+  }
+  printf( "\" %s\n", detail );
+}
+
+
+static void checkDouble( const char *field )
+{
+  char detail[128];
+  double got = FUZZ_SENTINEL, want = 0;
+  float gotFloat = FUZZ_SENTINEL, wantFloat;
+  int gotRet, wantRet;
+
+  gotRet = parseDoubleField( field, &got );
+  wantRet = refDouble( field, &want );
+  if ( gotRet != wantRet )
+  {
+    snprintf( detail, sizeof( detail ), "parsed %s, strtod %s",
+              gotRet == SUCCESS ? "ok" : "bad",
+              wantRet == SUCCESS ? "ok" : "bad" );
+    reportFailure( "parseDoubleField", field, detail );
+    return;
+  }
+  if ( gotRet != SUCCESS )
+  {
+    if ( got != FUZZ_SENTINEL )
+      reportFailure( "parseDoubleField", field, "changed value on failure" );
+  }else if ( ! closeEnough( got, want ) )
+  {
+    snprintf( detail, sizeof( detail ), "= %.17g, strtod = %.17g",
+              got, want );
+    reportFailure( "parseDoubleField", field, detail );
+  }
+
+  gotRet = parseFloatField( field, &gotFloat );
+  if ( gotRet != wantRet )
+  {
+    reportFailure( "parseFloatField", field, "disagrees with strtod" );
+    return;
+  }
+  if ( gotRet != SUCCESS )
+  {
+    if ( gotFloat != FUZZ_SENTINEL )
+      reportFailure( "parseFloatField", field, "changed value on failure" );
+    return;
+  }
+  wantFloat = (float)want;
+  if ( gotFloat != wantFloat &&
+       nextafterf( gotFloat, wantFloat ) != wantFloat &&
+       ! ( fabs( want ) > 1e300 || fabs( want ) < 1e-290 ) )
+  {
+    snprintf( detail, sizeof( detail ), "= %.9g, (float)strtod = %.9g",
+              gotFloat, wantFloat );
+    reportFailure( "parseFloatField", field, detail );
+  }
+}
+
+
+static void checkInt( const char *field )
+{
+  char detail[128];
+  int got = FUZZ_SENTINEL, want = 0;
+  int gotRet, wantRet;
+
+  gotRet = parseIntField( field, &got );
+  wantRet = refInt( field, &want );
+  if ( gotRet != wantRet )
+  {
+    snprintf( detail, sizeof( detail ), "parsed %s, strtol %s",
+              gotRet == SUCCESS ? "ok" : "bad",
+              wantRet == SUCCESS ? "ok" : "bad" );
+    reportFailure( "parseIntField", field, detail );
+  }else if ( gotRet != SUCCESS && got != FUZZ_SENTINEL )
+    reportFailure( "parseIntField", field, "changed value on failure" );
+  else if ( gotRet == SUCCESS && got != want )
+  {
+    snprintf( detail, sizeof( detail ), "= %d, strtol = %d", got, want );
+    reportFailure( "parseIntField", field, detail );
+  }
+}
+
+
+//
+// Split a random line and check that the fields put back
+// together give the line up to its first CR/LF
+//
+static void checkSplit( void )
+{
+  char line[FUZZ_FIELDLEN * 4];
+  char copy[sizeof( line )];
+  char joined[sizeof( line )];
+  char *fields[8];
+  int maxFields = 1 + randomBelow( 8 );
+  int numFields, expected, len, i;
+
+  line[0] = '\0';
+  for ( i = randomBelow( 4 ); i >= 0; i-- )
+  {
+    makeField( line + strlen( line ), 0 );
+    if ( randomBelow( 5 ) > 0 )
+      strcat( line, "," );
+  }
+  strcpy( copy, line );
+  len = strcspn( copy, "\r\n" );
+  copy[len] = '\0';
+  for ( expected = 1, i = 0; i < len; i++ )
+    if ( copy[i] == ',' && expected < maxFields )
+      expected++;
+
+  numFields = splitFields( line, ',', fields, maxFields );
+  joined[0] = '\0';
+  for ( i = 0; i < numFields; i++ )
+  {
+    if ( i > 0 )
+      strcat( joined, "," );
+    strcat( joined, fields[i] );
+  }
+  if ( numFields != expected || strcmp( joined, copy ) != 0 )
+    reportFailure( "splitFields", copy, "split wrong" );
+}
+
+
+void usage( void )
+{
+  fprintf( stderr,
+    "usage: fieldparse_fuzz [-n cases] [-s seed]\n"
+    "  -n cases : Number of random cases per check ( default: %ld )\n"
+    "  -s seed  : Random seed ( default: 1 )\n",
+    FUZZ_CASES );
+}
+
+
+int main ( int argc, char *argv[] )
+{
+  char field[FUZZ_FIELDLEN];
+  char *end;
+  long numCases = FUZZ_CASES;
+  long n;
+  int opt;
+
+  rngState = 1;
+  while ( ( opt = getopt( argc, argv, "n:s:" ) ) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'n':
+        numCases = strtol( optarg, &end, 10 );
+        if ( *end != '\0' || numCases < 1 )
+        {
+          usage();
+          exit( 1 );
+        }
+        break;
+      case 's':
+        rngState = strtoull( optarg, &end, 10 );
+        if ( *end != '\0' )
+        {
+          usage();
+          exit( 1 );
+        }
+        break;
+      default:
+        usage();
+        exit( 1 );
+    }
+  }
+  // xorshift can't start from 0
+  if ( rngState == 0 )
+    rngState = 1;
+
+  for ( n = 0; n < numCases; n++ )
+  {
+    makeField( field, 0 );
+    checkDouble( field );
+    makeField( field, 1 );
+    checkInt( field );
+    checkSplit();
+  }
+
+  printf( "fieldparse_fuzz: %ld cases, %ld disagreements\n", numCases,
+          numFailed );
+  return( numFailed > 0 ? 1 : 0 );
+}
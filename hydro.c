@@ -29,6 +29,25 @@
 #include "hydro.h"
 #include "log.h"
 #include "orcad.h"
+#include "buoy.h"
+
+
+//
+// NAME
+//   getHydroDriver - The driver for a hydro wire device type
+//
+// RETURNS
+//   The driver or NULL if deviceType is not a hydro wire device.
+//
+static const struct deviceDriver *getHydroDriver ( int hydroDeviceType )
+{
+  const struct deviceDriver *driver;
+
+  driver = getDeviceDriver( hydroDeviceType );
+  if ( driver == NULL || ! ( driver->flags & DRIVER_HYDROWIRE ) )
+    return( NULL );
+  return( driver );
+}
 
 
 //
@@ -49,28 +68,22 @@
 //   The function returns 1 upon success and a -1 upon failure.
 //
 int initHydro ( int hydroDeviceType, int hydroFD ) {
+  const struct deviceDriver *driver;
 
   // Say hello
   LOGPRINT( LVL_DEBG, "initHydro(): Called" );
 
-  if ( hydroDeviceType == SEABIRD_CTD_19 )
-  {
-    // Nothing to do for this type of device for now.
-  }
-  else if ( hydroDeviceType == SEABIRD_CTD_19_PLUS )
-  {
-    if ( initCTD19Plus( hydroFD ) < 0 )
-    {
-      return( FAILURE );
-    }
-  }
-  else
+  if ( ( driver = getHydroDriver( hydroDeviceType ) ) == NULL )
   { 
     LOGPRINT( LVL_DEBG, "initHydro(): Unknown hydro device "
               "type ( %d )", hydroDeviceType );
     return( FAILURE );
   }
 
+  // Not all devices need initializing
+  if ( driver->init != NULL && driver->init( hydroFD ) < 0 )
+    return( FAILURE );
+
   if ( syncHydroTime( hydroDeviceType, hydroFD ) < 0 )
   {
     LOGPRINT( LVL_ALRT, "initHydro(): Could not sync bitsyx and "
@@ -105,19 +118,19 @@ int initHydro ( int hydroDeviceType, int hydroFD ) {
 //
 int stopHydroLogging ( int hydroDeviceType, int hydroFD )
 {
+  const struct deviceDriver *driver;
+
   // Say hello
   LOGPRINT( LVL_DEBG, "stopHydroLogging(): Called" );
 
-  if ( hydroDeviceType == SEABIRD_CTD_19 )
-    return( stopLoggingCTD19( hydroFD ) );
-  else if ( hydroDeviceType == SEABIRD_CTD_19_PLUS )
-    return( stopLoggingCTD19Plus( hydroFD ) );
-  else
+  driver = getHydroDriver( hydroDeviceType );
+  if ( driver == NULL || driver->stop == NULL )
   { 
-    LOGPRINT( LVL_DEBG, "startHydroLogging(): Unknown hydro device "
+    LOGPRINT( LVL_DEBG, "stopHydroLogging(): Unknown hydro device "
               "type ( %d )", hydroDeviceType );
     return( FAILURE );
   }
+  return( driver->stop( hydroFD ) );
 
 }
 
@@ -144,22 +157,19 @@ int stopHydroLogging ( int hydroDeviceType, int hydroFD )
 //
 int startHydroLogging ( int hydroDeviceType, int hydroFD )
 {
+  const struct deviceDriver *driver;
 
   // Say hello
   LOGPRINT( LVL_DEBG, "startHydroLogging(): Called" );
 
-  if ( hydroDeviceType == SEABIRD_CTD_19 )
-  { printf( "Hmmm I think its a 19\n" );
-    return( startLoggingCTD19( hydroFD ) );
-  }
-  else if ( hydroDeviceType == SEABIRD_CTD_19_PLUS )
-    return( startLoggingCTD19Plus( hydroFD ) );
-  else
+  driver = getHydroDriver( hydroDeviceType );
+  if ( driver == NULL || driver->start == NULL )
   {
     LOGPRINT( LVL_DEBG, "startHydroLogging(): Unknown hydro device "
               "type ( %d )", hydroDeviceType );
     return( FAILURE );
   }
+  return( driver->start( hydroFD ) );
 
 }
 
@@ -185,13 +195,12 @@ int startHydroLogging ( int hydroDeviceType, int hydroFD )
 //          the movePackageUp/Down functions!
 double getHydroPressure ( int hydroDeviceType, int hydroFD )
 {
+  const struct deviceDriver *driver;
 
-  if ( hydroDeviceType == SEABIRD_CTD_19 )
-    return( getCTD19Pressure( hydroFD ) ); 
-  else if ( hydroDeviceType == SEABIRD_CTD_19_PLUS )
-    return( getCTD19PlusPressure( hydroFD ) ); 
-  else
+  driver = getHydroDriver( hydroDeviceType );
+  if ( driver == NULL || driver->readSample == NULL )
     return( FAILURE );
+  return( driver->readSample( hydroFD ) );
 
 }
 
@@ -203,36 +212,40 @@ double getHydroPressure ( int hydroDeviceType, int hydroFD )
 // SYNOPSIS
 //   #include "hydro.h"
 //
-//   int downloadHydroData( int hydroDeviceType, int hydroFD, FILE *outFile );
+//   int downloadHydroData( int hydroDeviceType, int hydroFD, FILE *outFile,
+//                          int useMark );
 //
 // DESCRIPTION
 //   Download data stored in the data logger attached to the
 //   hydro wire. The communications with the hydro wire are 
 //   provided through an open/initialized file descriptor hydroFD.
 //   The output file is passed in as outFile and should be 
-//   already opened and writable.
+//   already opened and writable.  With useMark set only the
+//   data since the last such download is fetched and the
+//   device's high-water mark is advanced ( orcad's casts );
+//   otherwise everything is fetched and the mark left alone.
 //
 // RETURNS
 //   Data is written to the file and the file remains open.
 //   Upon success a 1 is returned otherwise -1 is returned.
 //   Specific problems are logged at a LVL_WARN level.
 //     
-int downloadHydroData ( int hydroDeviceType, int hydroFD, FILE * outFile ) 
+int downloadHydroData ( int hydroDeviceType, int hydroFD, FILE * outFile,
+                         int useMark ) 
 {
+  const struct deviceDriver *driver;
 
   // Say hello
   LOGPRINT( LVL_DEBG, "downloadHydroData(): Called" );
 
-  if ( hydroDeviceType == SEABIRD_CTD_19 )
-    return( downloadCTD19Data( hydroFD, outFile ) );
-  else if ( hydroDeviceType == SEABIRD_CTD_19_PLUS )
-    return( downloadCTD19PlusData( hydroFD, outFile ) );
-  else
+  driver = getHydroDriver( hydroDeviceType );
+  if ( driver == NULL || driver->download == NULL )
   {
-    LOGPRINT( LVL_DEBG, "startHydroLogging(): Unknown hydro device "
+    LOGPRINT( LVL_DEBG, "downloadHydroData(): Unknown hydro device "
               "type ( %d )", hydroDeviceType );
     return( FAILURE );
   }
+  return( driver->download( hydroFD, outFile, useMark ) );
 
 }
 
@@ -245,7 +258,10 @@ int downloadHydroData ( int hydroDeviceType, int hydroFD, FILE * outFile )
 //   #include "ctd.h"
 //
 // DESCRIPTION
-//   Sync a Seabird CTD to the system date and time.
+//   Sync a hydro wire device to the system date and time.  The
+//   driver's syncTime() is used if it has one, otherwise the 
+//   clock is read with getTime() and set with setTime() when it 
+//   is more than a minute off.
 //
 // RETURNS
 //   1 Upon success
@@ -254,42 +270,34 @@ int downloadHydroData ( int hydroDeviceType, int hydroFD, FILE * outFile )
 int syncHydroTime ( int hydroDeviceType, int hydroFD ) {
   time_t now_t;
   struct tm *now_tm;
+  struct tm nowTM;
   time_t was_t;
   struct tm *was_tm;
   int timeOff = 0;
+  const struct deviceDriver *driver;
 
   // Say hello
   LOGPRINT( LVL_DEBG, "syncHydroTime(): Called" );
 
+  driver = getHydroDriver( hydroDeviceType );
+  if ( driver != NULL && driver->syncTime != NULL )
+    return( driver->syncTime( hydroFD ) );
+  if ( driver == NULL || driver->getTime == NULL || driver->setTime == NULL )
+  {
+    LOGPRINT( LVL_WARN, "syncHydroTime(): Unknown hydro device "
+              "type ( %d )", hydroDeviceType );
+    return( FAILURE );
+  }
 
   // Get the system time
   now_t = time( NULL );
-  now_tm = localtime( &now_t );
+  now_tm = localtime_r( &now_t, &nowTM );
 
-  if ( hydroDeviceType == SEABIRD_CTD_19 )
-  {
-    // Get the ctd time
-    if ( ( was_tm = getCTD19Time( hydroFD ) ) == NULL )
-    {
-      LOGPRINT( LVL_WARN, "syncHydroTime(): Could not get "
-                "ctd time!" );
-      return( FAILURE );
-    }
-  }
-  else if ( hydroDeviceType == SEABIRD_CTD_19_PLUS )
+  // Get the ctd time
+  if ( ( was_tm = driver->getTime( hydroFD ) ) == NULL )
   {
-    // Get the ctd time
-    if ( ( was_tm = getCTD19PlusTime( hydroFD ) ) == NULL )
-    {
-      LOGPRINT( LVL_WARN, "syncHydroTime(): Could not get "
-                "ctd time!" );
-      return( FAILURE );
-    }
-  }
-  else
-  {
-    LOGPRINT( LVL_WARN, "syncHydroTime(): Unknown hydro device "
-              "type ( %d )", hydroDeviceType );
+    LOGPRINT( LVL_WARN, "syncHydroTime(): Could not get "
+              "ctd time!" );
     return( FAILURE );
   }
 
@@ -315,47 +323,22 @@ int syncHydroTime ( int hydroDeviceType, int hydroFD ) {
 
   if ( timeOff ) 
   { 
-    if ( hydroDeviceType == SEABIRD_CTD_19 )
+    if ( driver->setTime( hydroFD, now_tm ) < 0 )
     {
-      sleep( 1 );
-      if ( setCTD19Time( hydroFD, now_tm ) < 0 )
-      {
-        LOGPRINT( LVL_ALRT, "syncHydroTime(): Could not set the CTD time!" );
-        return( FAILURE );
-      }
-
-      // Get the system time
-      now_t = time( NULL );
-      now_tm = localtime( &now_t );
-
-      // Get it again
-      if ( ( was_tm = getCTD19Time( hydroFD ) ) == NULL )
-      {
-        LOGPRINT( LVL_WARN, "syncHydroTime(): Could not get ctd time 2nd " 
-                            "time!" );
-        return( FAILURE );
-      }
+      LOGPRINT( LVL_ALRT, "syncHydroTime(): Could not set the CTD time!" );
+      return( FAILURE );
     }
-    else if ( hydroDeviceType == SEABIRD_CTD_19_PLUS )
+
+    // Get the system time
+    now_t = time( NULL );
+    now_tm = localtime_r( &now_t, &nowTM );
+
+    // Get it again
+    if ( ( was_tm = driver->getTime( hydroFD ) ) == NULL )
     {
-      // Set the time
-      if ( setCTD19PlusTime( hydroFD, now_tm ) < 0 )
-      {
-        LOGPRINT( LVL_ALRT, "syncHydroTime(): Could not set the CTD time!" );
-        return( FAILURE );
-      }
-
-      // Get the system time
-      now_t = time( NULL );
-      now_tm = localtime( &now_t );
-
-      // Get it again
-      if ( ( was_tm = getCTD19PlusTime( hydroFD ) ) == NULL )
-      {
-        LOGPRINT( LVL_WARN, "syncHydroTime(): Could not get ctd time 2nd "
-                            "time!" );      
-        return( FAILURE );
-      }
+      LOGPRINT( LVL_WARN, "syncHydroTime(): Could not get ctd time 2nd " 
+                          "time!" );
+      return( FAILURE );
     }
   
     // and make sure we set it correctly
@@ -34,7 +34,8 @@ int startHydroLogging ( int hydroDeviceType, int hdroFD );
 //   getHydroPressure - Read the pressure from the hydro-wire data stream
 double getHydroPressure ( int hydroDeviceType, int hydroFD );
 //   downloadHydroData - Download data archives from hydro device
-int downloadHydroData ( int hydroDeviceType, int hydroFD, FILE * outFile );
+int downloadHydroData ( int hydroDeviceType, int hydroFD, FILE * outFile,
+                        int useMark );
 //   syncHydroTime - Sync the CTD clock with ours
 int syncHydroTime ( int hydroDeviceType, int hydroFD );
 
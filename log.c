@@ -108,13 +108,17 @@ void logPrint ( int level, char *message, ... )
   va_list ap;
   time_t nowTimeT;
   struct tm *nowTM;
+  struct tm nowBuff;
   char nowStr[80];
 
   if ( logFile != NULL && level <= opts.debugLevel ) {
     nowStr[0] = '\0';
     va_start( ap, message );  
+    // Keep lines from different threads ( e.g. initializeHardware() ) 
+    // in one piece
+    flockfile( logFile );
     if ( time( &nowTimeT ) >= 0 ) {
-      nowTM = localtime( &nowTimeT );
+      nowTM = localtime_r( &nowTimeT, &nowBuff );
       if ( strftime( nowStr, 80, "%b %d %Y %H:%M:%S  ", nowTM ) >= 0 ) {
         if ( progName == NULL ) 
         {
@@ -138,6 +142,7 @@ void logPrint ( int level, char *message, ... )
       fprintf( stdout, "\n" );
     }
     fflush( logFile );
+    funlockfile( logFile );
     sync();
     va_end(ap);
   }
@@ -32,6 +32,7 @@
 #include "buoy.h"
 #include "orcad.h"
 #include "serial.h"
+#include "fieldparse.h"
 
 //
 // NAME
@@ -124,9 +125,9 @@ float readMeterWheelAdjusted ( struct sPort *mwPort, double factor )
 float readMeterWheelCount ( struct sPort *mwPort ) 
 {
   char buffer[80];
+  char *fields[4];
+  int numFields = 0;
   float retValue = -1.0;
-  char *comaPtr = NULL;
-  char *valuePtr = NULL;
   int mwFD = -1;
   int counts = -1;
   
@@ -143,20 +144,17 @@ float readMeterWheelCount ( struct sPort *mwPort )
             return( -1.0 );
           }
         
-    if (    ( ( comaPtr = index( buffer, ',' ) ) != NULL )
-         && ( ( comaPtr = index( ++comaPtr, ',' ) ) != NULL ) ) 
+    // The count is the third field
+    numFields = splitFields( buffer, ',', fields, 4 );
+    if ( numFields == 3 ) 
     {
-      valuePtr = ++comaPtr; 
-      if ( ( comaPtr = index( valuePtr, ',' ) ) != NULL ) 
-      {
-        *comaPtr = '\0';
-        if ( sscanf( valuePtr, "%g", &retValue ) == 1 ) {
-          return( retValue );
-        }
-      }else {
-        // Could not find third coma!
-        return( -2.0 );
-      }
+      // Could not find third coma!
+      return( -2.0 );
+    }
+    if ( numFields == 4 && 
+         parseFloatField( fields[2], &retValue ) == SUCCESS ) 
+    {
+      return( retValue );
     }
     // Could not find first two comas!
     return( -3.0 );
@@ -170,10 +168,10 @@ float readMeterWheelCount ( struct sPort *mwPort )
             // Error communicating with meter wheel!
             return( -1.0 );
          }
-    if ( ( comaPtr = index( buffer, ',' ) ) != NULL )
+    // The count is the second field
+    if ( splitFields( buffer, ',', fields, 2 ) == 2 )
     {
-      valuePtr = ++comaPtr; 
-      if ( sscanf( valuePtr, "%d", &counts ) == 1 ) {
+      if ( parseIntField( fields[1], &counts ) == SUCCESS ) {
         return( (float)(counts * 1.0 ));
       }else {
         // Could not parse count!
@@ -0,0 +1,333 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * metstats.c : Streaming met statistics
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  Each sample is folded into every window as it arrives so 
+ *  an update costs the same no matter how long the windows 
+ *  are, and reading a window's statistics never touches the
+ *  samples again.  Windows are tumbling: when a product is
+ *  written ( or a timed window runs out ) the window is read
+ *  and reset.
+ *
+ *  Wind directions follow the meteorological convention
+ *  ( the direction the wind blows from, clockwise from
+ *  true north ).  Directions are averaged as vectors.
+ *
+ */
+#include <math.h>
+#include <string.h>
+#include "general.h"
+#include "metstats.h"
+
+#define DEGTORAD ( M_PI / 180.0 )
+
+
+// 
+// NAME
+//   metAccumReset - Empty a scalar accumulator.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   void metAccumReset( struct metAccum *accum );
+//
+void metAccumReset( struct metAccum *accum )
+{
+  memset( accum, 0, sizeof( struct metAccum ) );
+}
+
+
+// 
+// NAME
+//   metAccumAdd - Add a value to a scalar accumulator.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   void metAccumAdd( struct metAccum *accum, double value );
+//
+// DESCRIPTION
+//   Update the count, minimum, maximum and the running mean
+//   and sum of squared differences using Welford's method, 
+//   which stays accurate where a sum of squares would not.
+//
+void metAccumAdd( struct metAccum *accum, double value )
+{
+  double delta;
+
+  if ( accum->n == 0 )
+  {
+    accum->min = value;
+    accum->max = value;
+  }else
+  {
+    if ( value < accum->min )
+      accum->min = value;
+    if ( value > accum->max )
+      accum->max = value;
+  }
+  accum->n++;
+  delta = value - accum->mean;
+  accum->mean += delta / accum->n;
+  accum->m2 += delta * ( value - accum->mean );
+}
+
+
+// 
+// NAME
+//   metAccumMean - The mean of a scalar accumulator.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   double metAccumMean( struct metAccum *accum, double missing );
+//
+// RETURNS
+//   The mean, or missing if no values have been added.
+//
+double metAccumMean( struct metAccum *accum, double missing )
+{
+  if ( accum->n == 0 )
+    return( missing );
+  return( accum->mean );
+}
+
+
+// 
+// NAME
+//   metAccumStdDev - The standard deviation of a scalar accumulator.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   double metAccumStdDev( struct metAccum *accum, double missing );
+//
+// RETURNS
+//   The sample standard deviation, or missing if fewer 
+//   than two values have been added.
+//
+double metAccumStdDev( struct metAccum *accum, double missing )
+{
+  if ( accum->n < 2 )
+    return( missing );
+  return( sqrt( accum->m2 / ( accum->n - 1 ) ) );
+}
+
+
+// 
+// NAME
+//   metWindVector - Split a wind reading into U and V components.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   void metWindVector( double speed, double direction, 
+//                       double *u, double *v );
+//
+// DESCRIPTION
+//   U is the eastward and V the northward component of the
+//   air movement, so a wind from the north ( 0 degrees )
+//   has a negative V.
+//
+void metWindVector( double speed, double direction, double *u, double *v )
+{
+  *u = -speed * sin( direction * DEGTORAD );
+  *v = -speed * cos( direction * DEGTORAD );
+}
+
+
+// 
+// NAME
+//   metWindMean - Vector mean of the wind in a window.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   int metWindMean( struct metWindAccum *wind, double *speed, 
+//                    double *direction );
+//
+// DESCRIPTION
+//   Average the U and V components and convert the mean
+//   vector back to a speed and a direction ( 0 to 360 ).
+//
+// RETURNS
+//   -1 if the window has no wind samples, 1 otherwise.
+//
+int metWindMean( struct metWindAccum *wind, double *speed, 
+                 double *direction )
+{
+  double u, v;
+
+  if ( wind->speed.n == 0 )
+    return( FAILURE );
+  u = wind->sumU / wind->speed.n;
+  v = wind->sumV / wind->speed.n;
+  *speed = sqrt( u * u + v * v );
+  *direction = atan2( -u, -v ) / DEGTORAD;
+  if ( *direction < 0 )
+    *direction += 360.0;
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   resetMetWindow - Start a window over.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   void resetMetWindow( struct metWindow *window, time_t now );
+//
+void resetMetWindow( struct metWindow *window, time_t now )
+{
+  long length = window->length;
+
+  memset( window, 0, sizeof( struct metWindow ) );
+  window->length = length;
+  window->start = now;
+}
+
+
+// 
+// NAME
+//   metWindowDue - Has a timed window run its length?
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   int metWindowDue( struct metWindow *window, time_t now );
+//
+// RETURNS
+//   1 if the window has a length and it has elapsed, 0 otherwise.
+//
+int metWindowDue( struct metWindow *window, time_t now )
+{
+  return( window->length > 0 && now - window->start >= window->length );
+}
+
+
+// 
+// NAME
+//   initMetStats - Set up a group of concurrent windows.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   void initMetStats( struct metStats *stats, const long *lengths, 
+//                      int numWindows, time_t now );
+//
+// DESCRIPTION
+//   Create numWindows ( at most METSTATS_MAXWINDOWS ) empty
+//   windows with the given lengths in seconds, all starting
+//   now.
+//
+void initMetStats( struct metStats *stats, const long *lengths, 
+                   int numWindows, time_t now )
+{
+  int i;
+
+  memset( stats, 0, sizeof( struct metStats ) );
+  if ( numWindows > METSTATS_MAXWINDOWS )
+    numWindows = METSTATS_MAXWINDOWS;
+  stats->numWindows = numWindows;
+  for ( i = 0; i < numWindows; i++ )
+  {
+    stats->window[i].length = lengths[i];
+    resetMetWindow( &(stats->window[i]), now );
+  }
+}
+
+
+// 
+// NAME
+//   metStatsAddPAR - Add a PAR sample to every window.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   void metStatsAddPAR( struct metStats *stats, time_t when, 
+//                        double par );
+//
+// DESCRIPTION
+//   Update each window's PAR statistics and integrate the
+//   dose ( trapezoid rule ) from the previous sample.  The
+//   interval between two samples belongs to the window 
+//   holding the later one, so no light is lost or counted
+//   twice at window boundaries.
+//
+void metStatsAddPAR( struct metStats *stats, time_t when, double par )
+{
+  double dose = 0.0;
+  long dt;
+  int i;
+
+  if ( stats->lastParTime > 0 )
+  {
+    dt = (long)( when - stats->lastParTime );
+    if ( dt > 0 && dt <= METSTATS_MAXPARGAP )
+      dose = 0.5 * ( par + stats->lastPar ) * dt;
+  }
+  stats->lastParTime = when;
+  stats->lastPar = par;
+
+  for ( i = 0; i < stats->numWindows; i++ )
+  {
+    metAccumAdd( &(stats->window[i].par), par );
+    stats->window[i].parDose += dose;
+  }
+}
+
+
+// 
+// NAME
+//   metStatsAddWind - Add a wind reading to every window.
+//
+// SYNOPSIS
+//   #include "metstats.h"
+//
+//   void metStatsAddWind( struct metStats *stats, double speed, 
+//                         double direction );
+//
+// DESCRIPTION
+//   Update each window's speed statistics, vector sums and
+//   gust.  Only valid readings should be added; missing 
+//   values ( e.g. -555 ) would corrupt the averages.
+//
+void metStatsAddWind( struct metStats *stats, double speed, 
+                      double direction )
+{
+  struct metWindAccum *wind;
+  double u, v;
+  int i;
+
+  metWindVector( speed, direction, &u, &v );
+  for ( i = 0; i < stats->numWindows; i++ )
+  {
+    wind = &(stats->window[i].wind);
+    if ( wind->speed.n == 0 || speed > wind->gustSpeed )
+    {
+      wind->gustSpeed = speed;
+      wind->gustDirection = direction;
+    }
+    metAccumAdd( &(wind->speed), speed );
+    wind->sumU += u;
+    wind->sumV += v;
+  }
+}
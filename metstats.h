@@ -0,0 +1,107 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * metstats.h : Header for the streaming met statistics
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ */
+#ifndef _METSTATS_H
+#define _METSTATS_H
+
+#include <time.h>
+
+// Most windows a metStats may track
+#define METSTATS_MAXWINDOWS 4
+
+// PAR samples further apart than this ( seconds ) are
+// not integrated across ( e.g. after a sensor outage )
+#define METSTATS_MAXPARGAP 300
+
+/* metAccum
+ *
+ * Running count, mean, variance ( Welford ), minimum
+ * and maximum of a scalar.
+ *
+ */
+struct metAccum {
+  unsigned long n;
+  double mean;
+  double m2;
+  double min;
+  double max;
+};
+
+/* metWindAccum
+ *
+ * Wind over a window: the scalar speed statistics,
+ * the summed unit-free U/V components for the vector
+ * mean and the gust ( highest speed ) with the 
+ * direction it came from.
+ *
+ */
+struct metWindAccum {
+  struct metAccum speed;
+  double sumU;
+  double sumV;
+  double gustSpeed;
+  double gustDirection;
+};
+
+/* metWindow
+ *
+ * All statistics for one averaging window.  length is
+ * in seconds; a window with a length of 0 is only 
+ * closed by the caller.  parDose is PAR integrated 
+ * over time ( umol/m^2 ).
+ *
+ */
+struct metWindow {
+  long length;
+  time_t start;
+  struct metAccum par;
+  double parDose;
+  struct metWindAccum wind;
+};
+
+/* metStats
+ *
+ * A set of concurrent windows fed from the same samples.
+ *
+ */
+struct metStats {
+  int numWindows;
+  struct metWindow window[METSTATS_MAXWINDOWS];
+  time_t lastParTime;
+  double lastPar;
+};
+
+void metAccumReset( struct metAccum *accum );
+void metAccumAdd( struct metAccum *accum, double value );
+double metAccumMean( struct metAccum *accum, double missing );
+double metAccumStdDev( struct metAccum *accum, double missing );
+void metWindVector( double speed, double direction, double *u, double *v );
+int metWindMean( struct metWindAccum *wind, double *speed, 
+                 double *direction );
+void resetMetWindow( struct metWindow *window, time_t now );
+int metWindowDue( struct metWindow *window, time_t now );
+void initMetStats( struct metStats *stats, const long *lengths, 
+                   int numWindows, time_t now );
+void metStatsAddPAR( struct metStats *stats, time_t when, double par );
+void metStatsAddWind( struct metStats *stats, double speed, 
+                      double direction );
+
+#endif
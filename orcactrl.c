@@ -51,9 +51,16 @@
 #include "parser.h"
 #include "util.h"
 #include "winch.h"
+#include "planner.h"
+#include "readingbus.h"
+#include "datawriter.h"
+#include "ctlsock.h"
 
 #define LINEBUFFER 180
 
+// How often "stream" checks for new readings
+#define STREAM_POLL_USECS 20000
+
 #define STDOUT stdout
 #define STDERR stderr
 extern const char *Version;
@@ -83,6 +90,9 @@ void cleanup_USR1 ();
 void cleanup (int passed_signal);
 void tokenizeCommand( char * cmdStr, struct cmdTokensStruct *tokenStruct );
 void freeCmdTokens( struct cmdTokensStruct *tokens );
+static int remoteCommand( char *commandEntities[], int entityCount );
+static void remoteShell( void );
+static int streamReadings( const char *csvFileName );
 
 
 // Global variable
@@ -93,6 +103,7 @@ int main(int argc, char *argv[], char *envp[])
 {
   int Optind;
   char msg[ LINEBUFFER ];
+  char *response;
 
   // Set the umask
   umask( 0077 );
@@ -107,9 +118,6 @@ int main(int argc, char *argv[], char *envp[])
     logFile = stdout;
   }
  
-  // Tell everyone we are doing something
-  printf("Orcactrl: Initializing hardware...\n");
-
   // Initialize our data structures
   if ( orcactlInitialize() < 0 ) 
   {
@@ -120,6 +128,26 @@ int main(int argc, char *argv[], char *envp[])
   // Read command line
   Optind = parseCommandLine(argc, argv); 
 
+  // If orcad is running it owns the hardware.  Send it our
+  // commands over its control socket rather than stopping it.
+  if ( Optind < argc )
+  {
+    if ( remoteCommand( &(argv[ Optind ]), argc - Optind ) != 
+         CTLSOCK_NOSERVER )
+      exit( 0 );
+  }else if ( controlRequest( CTLSOCK_PATH, "status", CTLSOCK_TIMEOUT,
+                             &response ) != CTLSOCK_NOSERVER )
+  {
+    if ( response != NULL )
+      fputs( response, stdout );
+    free( response );
+    remoteShell();
+    exit( 0 );
+  }
+
+  // Tell everyone we are doing something
+  printf("Orcactrl: Initializing hardware...\n");
+
   // Create a lockfile:
   //    Typically this is stored in /var/run/programname.pid.
   //    Where the contents of the file are the process id
@@ -171,6 +199,10 @@ int main(int argc, char *argv[], char *envp[])
       exit(0);
     }
   }
+
+  // Share our readings ( e.g. while moving the package ) so
+  // they can be followed with "orcactrl stream"
+  attachReadingBus( 1 );
    
   if( Optind < argc ){
     parseCommand( &(argv[ Optind ]), argc - Optind );
@@ -198,6 +230,244 @@ int main(int argc, char *argv[], char *envp[])
   return(0);
 }
 
+
+
+//
+// NAME
+//   remoteCommand - Run a command through a running orcad
+//
+// SYNOPSIS
+//   static int remoteCommand( char *commandEntities[], int entityCount );
+//
+// DESCRIPTION
+//   Send the command to orcad over its control socket and
+//   print the answer.  Commands which do not need the
+//   hardware ( help, view readings and stream ) are run here.
+//
+// RETURNS
+//   CTLSOCK_NOSERVER if orcad is not running, otherwise
+//   1 if the command was run or -1 if it was not.
+//
+static int remoteCommand( char *commandEntities[], int entityCount )
+{
+  char request[CTLSOCK_MAXREQUEST];
+  char *response;
+  int i, ret;
+
+  if ( entityCount < 1 )
+    return( SUCCESS );
+
+  if ( strcasecmp( "help", commandEntities[0] ) == 0 ||
+       strcasecmp( "h", commandEntities[0] ) == 0 ||
+       strcasecmp( "?", commandEntities[0] ) == 0 ||
+       strcasecmp( "stream", commandEntities[0] ) == 0 ||
+       ( entityCount == 2 &&
+         strcasecmp( "view", commandEntities[0] ) == 0 &&
+         strcasecmp( "readings", commandEntities[1] ) == 0 ) )
+  {
+    parseCommand( commandEntities, entityCount );
+    return( SUCCESS );
+  }
+
+  request[0] = '\0';
+  for ( i = 0; i < entityCount; i++ )
+  {
+    if ( strlen( request ) + strlen( commandEntities[i] ) + 2 > 
+         sizeof( request ) )
+    {
+      printf("Error: Command is too long!\n" );
+      return( FAILURE );
+    }
+    if ( i > 0 )
+      strcat( request, " " );
+    strcat( request, commandEntities[i] );
+  }
+
+  ret = controlRequest( CTLSOCK_PATH, request, CTLSOCK_TIMEOUT, &response );
+  if ( ret == CTLSOCK_NOSERVER )
+    return( ret );
+
+  if ( ret == CTLSOCK_NOANSWER )
+    printf( "orcad did not answer.  It may be running a cast.  Try again "
+            "later.\n" );
+  else if ( response != NULL )
+    fputs( response, stdout );
+  else
+    printf( "Lost contact with orcad!\n" );
+  free( response );
+
+  return( ret == SUCCESS ? SUCCESS : FAILURE );
+}
+
+
+//
+// NAME
+//   remoteShell - The interactive prompt while orcad is running
+//
+// SYNOPSIS
+//   static void remoteShell( void );
+//
+// RETURNS
+//   Nothing
+//
+static void remoteShell( void )
+{
+  char msg[ LINEBUFFER ];
+
+  fprintf( STDOUT, "\n\nORCA Control Program Ready ( commands are run by "
+           "orcad )\n" );
+  while( 1 )
+  {
+    fprintf( STDOUT, "orcactrl> " );
+    if( fgets( msg, sizeof(msg), stdin ) == 0 ) break;
+    tokenizeCommand( msg, &cmdTokens );
+    if ( cmdTokens.numTokens > 0  &&
+         ( strcasecmp( cmdTokens.tokens[0], "exit" ) == 0 ||
+           *cmdTokens.tokens[0] == 'q' || 
+           *cmdTokens.tokens[0] == 'Q' ) ) 
+    {
+      printf("Bye Bye...\n");
+      break;
+    }
+    if ( remoteCommand( cmdTokens.tokens, cmdTokens.numTokens ) == 
+         CTLSOCK_NOSERVER )
+    {
+      printf("orcad has stopped.  Restart orcactrl to use the hardware "
+             "directly.\n");
+      break;
+    }
+  }
+}
+
+
+
+//
+// NAME
+//   streamReadings - Follow the package readings as they are taken
+//
+// SYNOPSIS
+//   static int streamReadings( const char *csvFileName );
+//
+// DESCRIPTION
+//   Watch the readings table for new pressure, meter wheel,
+//   battery and relay readings published by orcad ( or an
+//   orcactrl moving the package ) and keep a one line display
+//   of the latest values up to date until 'x' is pressed.
+//   The table is checked every STREAM_POLL_USECS so every
+//   reading is seen.  If csvFileName is given each reading is
+//   also written to it as "time,channel,value".
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+static int streamReadings( const char *csvFileName )
+{
+  static const int channels[] = { BUS_PRESSURE, BUS_DEPTH, BUS_METERWHEEL,
+                                  BUS_INTBATTERY, BUS_EXTBATTERY,
+                                  BUS_RELAYS };
+  const int numChannels = sizeof( channels ) / sizeof( channels[0] );
+  struct busSample samples[READINGBUS_RINGLEN];
+  struct busSample latest[sizeof( channels ) / sizeof( channels[0] )];
+  uint32_t numSeen[sizeof( channels ) / sizeof( channels[0] )];
+  uint32_t lastSeen;
+  long numReadings = 0;
+  long numMissed = 0;
+  FILE *csvFile = NULL;
+  time_t newest;
+  struct tm newestTM;
+  char timeStr[16];
+  int relays;
+  char key;
+  int i, j, num, numNew;
+
+  if ( attachReadingBus( 0 ) < 0 )
+  {
+    printf( "No readings have been published.  Are the daemons "
+            "running?\n" );
+    return( FAILURE );
+  }
+
+  if ( csvFileName != NULL )
+  {
+    if ( ( csvFile = fopen( csvFileName, "w" ) ) == NULL )
+    {
+      printf( "Could not open %s: %s\n", csvFileName, strerror( errno ) );
+      return( FAILURE );
+    }
+    fprintf( csvFile, "time,channel,value\n" );
+  }
+
+  // Start from the current readings
+  for ( i = 0; i < numChannels; i++ )
+  {
+    numSeen[i] = 0;
+    getNewReadings( channels[i], &numSeen[i], samples, 0 );
+    if ( getLatestReading( channels[i], &latest[i] ) < 0 )
+      memset( &latest[i], 0, sizeof( latest[i] ) );
+  }
+
+  set_keypress();
+  printf( "\nStreaming readings.  Press 'x' to exit.\n" );
+  while ( ! ( read( 0, &key, 1 ) == 1 && key == 'x' ) )
+  {
+    numNew = 0;
+    newest = 0;
+    for ( i = 0; i < numChannels; i++ )
+    {
+      lastSeen = numSeen[i];
+      if ( ( num = getNewReadings( channels[i], &numSeen[i], samples,
+                                   READINGBUS_RINGLEN ) ) <= 0 )
+        continue;
+      numMissed += ( numSeen[i] - lastSeen ) - num;
+      if ( csvFile != NULL )
+        for ( j = 0; j < num; j++ )
+          fprintf( csvFile, "%.3f,%s,%g\n", samples[j].time,
+                   readingBus->channel[channels[i]].name, samples[j].value );
+      latest[i] = samples[num - 1];
+      if ( (time_t)latest[i].time > newest )
+        newest = (time_t)latest[i].time;
+      numNew += num;
+    }
+
+    if ( numNew > 0 )
+    {
+      numReadings += numNew;
+      localtime_r( &newest, &newestTM );
+      strftime( timeStr, sizeof( timeStr ), "%H:%M:%S", &newestTM );
+      relays = (int)latest[5].value;
+      printf( "\r%s pres=%6.2fdb prdp=%6.2fm mwdp=%6.1fm ipwr=%4.1fv "
+              "epwr=%4.1fv %s%c%c%c ", timeStr, latest[0].value,
+              latest[1].value, latest[2].value, latest[3].value,
+              latest[4].value,
+              latest[5].time == 0 ? "--" : 
+                ( ! ( relays & RELAY_WINCH ) ? "ws" :
+                  ( relays & RELAY_WINCHUP ) ? "wu" : "wd" ),
+              relays & RELAY_HYDRO ? 'H' : '-',
+              relays & RELAY_WEATHER ? 'W' : '-',
+              relays & RELAY_METER ? 'M' : '-' );
+      fflush( stdout );
+      if ( csvFile != NULL )
+        fflush( csvFile );
+    }
+    usleep( STREAM_POLL_USECS );
+  }
+  reset_keypress();
+
+  printf( "\n%ld readings", numReadings );
+  if ( csvFile != NULL )
+  {
+    fclose( csvFile );
+    printf( " written to %s", csvFileName );
+  }
+  printf( ".\n" );
+  if ( numMissed > 0 )
+    printf( "Warning: %ld readings arrived too quickly and were missed.\n",
+            numMissed );
+
+  return( SUCCESS );
+}
+
   
 void freeCmdTokens( struct cmdTokensStruct *tokenStruct )
 {
@@ -268,6 +538,9 @@ int orcactlInitialize()
   opts.ctdCalPA1 = 248.24555;
   opts.ctdCalPA2 = -6.524518E-2;
   opts.ctdCalPA3 = 5.430179E-8;
+  opts.ctdUploadBaud = 0;
+  opts.dataCommitInterval = DATAWRITER_DEFAULT_INTERVAL;
+  opts.dataSyncPolicy = DATAWRITER_DEFAULT_SYNC;
   opts.meterwheelCFactor = 1.718213058;
   opts.configFileName = defaultConfigFile;
   opts.dataFilePrefix = '\0';
@@ -286,6 +559,7 @@ void parseCommand( char *commandEntities[], int entityCount )
 {
 
   int i, ret, tgtDepth, intValue;
+  int useMark;
   int *depths;
   int hydroFD, hydroType, weatherFD, aquaFD;
   struct sPort *mwPort;
@@ -293,7 +567,9 @@ void parseCommand( char *commandEntities[], int entityCount )
   float floatVal1, floatVal2, floatVal3;
   double doubleVal1, doubleVal2;
   struct mission *mptr;
+  struct castStats castStats;
   FILE *outFile;
+  char tmpFileName[FILEPATHMAX + sizeof( CASTTMPSUFFIX )];
   //int i = 0;
   //for ( i = 0; i < entityCount; i++ )
   //{
@@ -399,6 +675,13 @@ void parseCommand( char *commandEntities[], int entityCount )
         {
           weatherFD = getDeviceFileDescriptor( DAVIS_WEATHER_STATION );
           logInstantWeather( weatherFD, stdout );
+        }else if ( strcasecmp( "readings", commandEntities[1] ) == 0 )
+        {
+          if ( attachReadingBus( 0 ) < 0 )
+            printf( "No readings have been published.  Are the daemons "
+                    "running?\n" );
+          else
+            printReadings( stdout );
         }else if ( strcasecmp( "all", commandEntities[1] ) == 0 )
         {
           mwPort = getMeterWheelPort();
@@ -735,6 +1018,30 @@ void parseCommand( char *commandEntities[], int entityCount )
       {
         printf("Missing mission name!\n");
       }
+    }else if ( strcasecmp( "timeline", commandEntities[0] ) == 0 )
+    {
+      // Default to the next 24 hours
+      intValue = 24;
+      if ( entityCount == 2 &&
+           ( sscanf(commandEntities[1], "%d", &intValue ) != 1 ||
+             intValue < 1 ) )
+      {
+        printf("Could not read the number of hours!\n");
+      }else if ( entityCount > 2 )
+      {
+        printf("Error: Command has too many/few paramters!\n" );
+      }else 
+      {
+        readCastStats( &castStats );
+        printMissionTimeline( stdout, opts.missions, &castStats,
+                              time(NULL), time(NULL) + ( intValue * 3600 ) );
+      }
+    }else if ( strcasecmp( "stream", commandEntities[0] ) == 0 )
+    {
+      if ( entityCount > 2 )
+        printf("Error: Command has too many/few paramters!\n" );
+      else
+        streamReadings( entityCount == 2 ? commandEntities[1] : NULL );
     }else if ( strcasecmp( "runctd", commandEntities[0] ) == 0 )
     {
       LOGPRINT( LVL_ALWY, "Running command: runctd" );
@@ -859,22 +1166,38 @@ void parseCommand( char *commandEntities[], int entityCount )
       }
     }else if ( strcasecmp( "download", commandEntities[0] ) == 0 )
     {
-      if ( entityCount == 3 )
+      if ( entityCount == 4 && 
+           ( strcasecmp( "ctd", commandEntities[1] ) != 0 ||
+             strcasecmp( "new", commandEntities[3] ) != 0 ) )
+      {
+        printf("Don't understand %s\n", commandEntities[3] );
+      }else if ( entityCount == 3 || entityCount == 4 )
       {
         if ( strcasecmp( "ctd", commandEntities[1] ) == 0 )
         {
+          // Only "new" uses ( and advances ) orcad's high-water
+          // mark.  Otherwise the whole memory is fetched and the
+          // next cast file still gets every new sample.
+          useMark = ( entityCount == 4 );
           hydroType = getHydroWireDeviceType();
           hydroFD = getDeviceFileDescriptor( hydroType );
-          if ( ( outFile = fopen( commandEntities[2], "w+" ) ) != NULL ) 
+          snprintf( tmpFileName, sizeof( tmpFileName ), "%s%s", 
+                    commandEntities[2], CASTTMPSUFFIX );
+          if ( ( outFile = fopen( tmpFileName, "w+" ) ) != NULL ) 
           {
-            LOGPRINT( LVL_ALWY, "Running Command: download ctd %s",
-                      commandEntities[2] );
-            ret = downloadHydroData( hydroType, hydroFD, outFile );
+            LOGPRINT( LVL_ALWY, "Running Command: download ctd %s%s",
+                      commandEntities[2], useMark ? " new" : "" );
+            ret = downloadHydroData( hydroType, hydroFD, outFile, useMark );
             LOGPRINT( LVL_ALRT, "Command Returned: %d", ret );
             fclose( outFile );
+            if ( ret > 0 )
+              rename( tmpFileName, commandEntities[2] );
+            else
+              LOGPRINT( LVL_ALRT, "Download not verified. Data left in %s",
+                        tmpFileName );
           }else {
             LOGPRINT( LVL_ALRT, "Could not open file %s!",
-                      commandEntities[2] );
+                      tmpFileName );
           }
        }else if ( strcasecmp( "weather", commandEntities[1] ) == 0 )
         {
@@ -883,7 +1206,8 @@ void parseCommand( char *commandEntities[], int entityCount )
           weatherFD = getDeviceFileDescriptor( DAVIS_WEATHER_STATION );
           if ( ( outFile = fopen( commandEntities[2], "w+" ) ) != NULL ) 
           {
-            ret = downloadWeatherData( weatherFD, outFile, 0 );
+            // The whole archive, leaving orcad's mark alone
+            ret = downloadWeatherRecords( weatherFD, outFile, 0 );
             LOGPRINT( LVL_ALRT, "Command Returned: %d", ret );
             fclose( outFile );
           }else {
@@ -949,22 +1273,25 @@ int parseCommandLine(int argc, char *argv[] )
 
  char *msg[] ={
  "\nusage: %s [-d debuglevel] [-c config file] [-h] [command]\n\n",
- " The main ORCA control utility.  NOTE: This utility should only be\n",
- " used when the orcaD process has been stopped!\n\n",
+ " The main ORCA control utility.  If orcad is running the commands\n",
+ " marked with * are run by orcad using its open ports.  The rest\n",
+ " can only be used when orcad has been stopped.\n\n",
  " General options:\n",
  "  -d (debuglevel)  - debug level\n",
  "  -c (config file) - hardware config file\n",
  "  -h               - Print this information\n\n",
  " Commands:\n",
- "  view      config |                          - View orcad.cfg\n",
+ "  view     *config |                          - View orcad.cfg\n",
  "            aquaconfig |                      - .. aquadopp config\n",  
  "            aquafat |                         - .. aquadopp recorder files\n", // TODO
- "            voltage |                         - .. internal/external power\n",
- "            weather |                         - .. Davis weather output\n",
- "            pressure |                        - .. CTD Pressure\n", 
- "            meterwheel |                      - .. Meterwheel count\n",
- "            all                               - .. General buoy state\n",
- "  set       minDepth (meters) |               - Set various parameters.\n",
+ "           *voltage |                         - .. internal/external power\n",
+ "           *weather |                         - .. Davis weather output\n",
+ "           *readings |                        - .. Latest readings shared\n",
+ "                                                by the daemons\n",
+ "           *pressure |                        - .. CTD Pressure\n", 
+ "           *meterwheel |                      - .. Meterwheel count\n",
+ "           *all                               - .. General buoy state\n",
+ " *set       minDepth (meters) |               - Set various parameters.\n",
  "            parkingDepth (meters) |\n",
  "            maxDepth (meters) |\n",
  "            debugLevel (number)\n",
@@ -978,7 +1305,18 @@ int parseCommandLine(int argc, char *argv[] )
  "                          (sample2 meters)\n",
  "                          ...                 - Move the package up discretely.\n",
  "  profile   (mission name)                    - Run through a profile.\n",
+ "  stream    [csv file]                        - Follow the pressure, meter\n",
+ "                                                wheel, voltage and relay\n",
+ "                                                readings as they are taken\n",
+ "                                                ( relays: winch stopped/up/\n",
+ "                                                down, Hydro, Weather, Meter ).\n",
+ " *timeline  [hours]                           - Show the projected mission\n",
+ "                                                timeline ( default 24 hours ).\n",
  "  download  ctd|weather (filename) |          - Download data to a file.\n",
+ "            ctd (filename) new              - Only the CTD samples since\n",
+ "                                                orcad's last cast download;\n",
+ "                                                they are then left out of\n",
+ "                                                the next cast file.\n",
  "            aquadopp                          - Download aquadopp data to\n", // TODO
  "                                                autogenerated file names.\n",
  "  clear     aquadopp                          - Erase the data stored on the\n", // TODO
@@ -987,7 +1325,11 @@ int parseCommandLine(int argc, char *argv[] )
  "  test      ctd_comm                          - Test the noise level of the\n",
  "                                                hydrowire. NOTE: Must have a\n",
  "                                                CTD attached.\n",
- "  sync      ctd|weather|aquadopp              - Sync instrument times to bitsyX.\n\n",
+ " *sync      ctd|weather|aquadopp              - Sync instrument times to bitsyX.\n",
+ " *status                                      - Show orcad's version and last\n",
+ "                                                cast ( orcad only ).\n",
+ " *reload                                      - Make orcad reread its config\n",
+ "                                                file ( orcad only ).\n\n",
   0} ;
 
 void displayOptions(void)
@@ -63,6 +63,8 @@
 #include "orcad.h"
 #include "parser.h"
 #include "profile.h"
+#include "readingbus.h"
+#include "datawriter.h"
 #include "hardio.h"
 #include "buoy.h"
 #include "ctd.h"
@@ -70,6 +72,9 @@
 #include "util.h"
 #include "meterwheel.h"
 #include "aquadopp.h"
+#include "planner.h"
+#include "ctdstream.h"
+#include "ctlsock.h"
 
 #define Name "orcad"
 extern const char *Version;
@@ -80,7 +85,15 @@ extern const char *Version;
 #define STDERR stderr
 #define SHMSZ   27
 
+// Time given the CTD to start up after powering the hydrowire
+// for an orcactrl request.  Matches the default mission lead time.
+#define HYDRO_SETTLE_SECS 5
+
 void processCommandLine(int argc, char *argv[] );
+static int reloadConfig( void );
+static void idleUntil( time_t wakeTime );
+static void handleControlRequest( int clientFD, char *request );
+static int runControlCommand( FILE *out, char *cmd[], int numTokens );
 
 //
 // Globals
@@ -95,6 +108,11 @@ void processCommandLine(int argc, char *argv[] );
 //   any more globals.
 //
 
+// Set by the SIGHUP handler, acted on by the main loop
+static volatile sig_atomic_t reloadRequested = 0;
+
+// The control socket orcactrl talks to us through
+static int controlFD = -1;
 
 int main(int argc, char *argv[], char *envp[])
 {
@@ -103,11 +121,14 @@ int main(int argc, char *argv[], char *envp[])
   int pgid = -1;
   sigset_t block;
   sigset_t oblock;
+  sigset_t hupSet;
   int weatherFD;
   time_t lastWeatherArchiveTime = -1;
   time_t lastWeatherStatusTime = -1;
   FILE * fpWeather = NULL;
   char weatherStatFile[FILEPATHMAX];
+  char weatherTmpFile[FILEPATHMAX + sizeof( CASTTMPSUFFIX )];
+  struct castStats castStats;
 
   // Initially point the logging to stderr 
   logFile = stderr;
@@ -202,7 +223,13 @@ int main(int argc, char *argv[], char *envp[])
     }
   }
 
-  if ( signal( SIGHUP, cleanup_HUP ) == SIG_ERR )
+  // SIGHUP rereads the config file.  It is held off except
+  // while the main loop is sleeping so that a reload never
+  // lands in the middle of a cast.
+  (void) sigemptyset( &hupSet );
+  (void) sigaddset( &hupSet, SIGHUP );
+  (void) sigprocmask( SIG_BLOCK, &hupSet, NULL );
+  if ( signal( SIGHUP, reload_HUP ) == SIG_ERR )
   {
     LOGPRINT( LVL_EMRG, "%s: main(): Could not install SIGHUP handler!", Name );
     cleanup( FAILURE );
@@ -281,6 +308,18 @@ int main(int argc, char *argv[], char *envp[])
   // Print out the options as we know them 
   logOpts( logFile );
 
+  // Share our readings with the other daemons and orcactrl
+  if ( attachReadingBus( 1 ) < 0 )
+    LOGPRINT( LVL_WARN, "main(): Readings will not be shared!" );
+
+  // Warn about missions which are scheduled too close together
+  readCastStats( &castStats );
+  checkScheduleOverlaps( opts.missions, &castStats, time(NULL) );
+
+  // Let orcactrl use our open ports while we are idle
+  if ( ( controlFD = openControlSocket( CTLSOCK_PATH ) ) < 0 )
+    LOGPRINT( LVL_WARN, "main(): orcactrl will not be able to reach us!" );
+
   //
   // Do main's endless loop here...
   //
@@ -296,15 +335,25 @@ int main(int argc, char *argv[], char *envp[])
   LOGPRINT( LVL_DEBG, "main(): Main schedule loop starting" );
 
   for (;;) {
-    sleep((sleep_time + 1) - (short) (time(NULL) % sleep_time));
+    // Keep the live weather stream flowing and answer orcactrl
+    // while we wait
+    (void) sigprocmask( SIG_UNBLOCK, &hupSet, NULL );
+    idleUntil( time(NULL) + 
+               (sleep_time + 1) - (short) (time(NULL) % sleep_time) );
+    (void) sigprocmask( SIG_BLOCK, &hupSet, NULL );
     LOGPRINT( LVL_DEBG, "main(): Main schedule loop waking up." );
 
+    // Like cron, pick up config file changes before 
+    // looking for jobs to run
+    if ( reloadRequested )
+    {
+      reloadRequested = 0;
+      reloadConfig();
+    }
+
     t2 = time(NULL);
     dt = t2 - t1;
 
-    // cron usually rechecks the config file for updates
-    // ...we could also do this.
-
     if (dt < -60 * 60 || dt > 60 * 60) 
     {
 
@@ -331,7 +380,7 @@ int main(int argc, char *argv[], char *envp[])
   
             if ( ( fpWeather = openNewWeatherFile() ) != NULL )
             {
-              if ( ( ret = downloadWeatherData( weatherFD, fpWeather, 0 ) ) < 0 )
+              if ( ( ret = downloadWeatherData( weatherFD, fpWeather ) ) < 0 )
               {
                 LOGPRINT( LVL_WARN, "%s: Failed to download weather archive. "
                           "Return code = %d.", ret );
@@ -344,29 +393,31 @@ int main(int argc, char *argv[], char *envp[])
             }
             lastWeatherArchiveTime = t2;
           }
-          // Currently hard-coded to 10 minutes
-          if ( ( t2 - lastWeatherStatusTime ) > 
-               ( 10 * 60)  )
+          // The status file is refreshed from the live LOOP stream
+          // whenever a new packet has arrived.  If the stream has
+          // nothing current fall back to polling the console every
+          // 10 minutes.
+          if ( getWeatherState()->updated > lastWeatherStatusTime ||
+               ( t2 - lastWeatherStatusTime ) > ( 10 * 60 ) )
           {
-            // Time to obtain a weather report.  Save the
-            // most recent weather data to a status file for
-            // download by our customers.
+            // Save the most recent weather data to a status file
+            // for download by our customers.  Write it under a
+            // temporary name so readers never see a partial file.
             snprintf( weatherStatFile, FILEPATHMAX, "%s/%s", opts.dataDirName, 
                       opts.weatherStatusFilename );
-            if( ( fpWeather = fopen( weatherStatFile, "w" ) ) != NULL )
+            snprintf( weatherTmpFile, sizeof( weatherTmpFile ), "%s%s",
+                      weatherStatFile, CASTTMPSUFFIX );
+            if( ( fpWeather = fopen( weatherTmpFile, "w" ) ) != NULL )
             {
-              // For some reason the downloadWeatherData routine
-              // is unable to consistently download the last record
-              // of the archive for the purposes creating an
-              // instant weather service.  Instead we will try using
-              // the logInstantWeather routine as a workaround.
-              //if ( ( ret = downloadWeatherData( weatherFD, fpWeather, 1 ) ) < 0 )
-              if ( ( ret = logInstantWeather( weatherFD, fpWeather ) ) < 0 )
+              if ( ( ret = logWeatherState( fpWeather ) ) < 0 )
+                ret = logInstantWeather( weatherFD, fpWeather );
+              fclose( fpWeather );
+              if ( ret < 0 )
               {
                 LOGPRINT( LVL_WARN, "%s: Failed to download weather status. "
                           "Return code = %d.", ret );
-              }
-              fclose( fpWeather );
+              }else
+                rename( weatherTmpFile, weatherStatFile );
             }else 
             {
               LOGPRINT( LVL_WARN, "%s: Failed to open the weather status file!" );
@@ -393,6 +444,394 @@ int main(int argc, char *argv[], char *envp[])
 
 
 
+//
+// NAME
+//   reloadConfig - Switch to an updated config file
+//
+// DESCRIPTION
+//   Called from the main loop after a SIGHUP.  The config
+//   file is parsed and checked by reloadConfigFile() and,
+//   if it is good, replaces the running configuration. Serial 
+//   devices whose settings did not change keep their open 
+//   handles.  Only the devices on ports which were added or
+//   changed are initialized; the term library and SMARTIO are
+//   left as they are.  If the file has an error
+//   we carry on with the configuration we have.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+static int reloadConfig ( void )
+{
+  struct optionsStruct oldOpts;
+  struct configArena *oldArena;
+  struct castStats castStats;
+  int numChanged;
+
+  LOGPRINT( LVL_ALRT, "reloadConfig(): Rereading %s", opts.configFileName );
+
+  if ( reloadConfigFile( opts.configFileName, &oldOpts, &oldArena ) < 0 )
+  {
+    LOGPRINT( LVL_ALRT, "reloadConfig(): Could not load the new config "
+              "file.  Keeping the current configuration." );
+    return( FAILURE );
+  }
+
+  numChanged = adoptSerialPorts( oldOpts.serialPorts );
+  freeConfigArena( oldArena );
+
+  if ( numChanged > 0 )
+  {
+    LOGPRINT( LVL_INFO, "reloadConfig(): %d serial port(s) added or "
+              "changed.  Initializing their devices.", numChanged );
+    if ( initializeDevices( 1 ) < 0 )
+      LOGPRINT( LVL_ALRT, "reloadConfig(): Could not initialize the "
+                "new devices!" );
+  }
+
+  logOpts( logFile );
+
+  readCastStats( &castStats );
+  checkScheduleOverlaps( opts.missions, &castStats, time(NULL) );
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   idleUntil - Wait for the next pass of the schedule loop
+//
+// DESCRIPTION
+//   Service the weather station's LOOP stream every
+//   WSLOOPINTERVAL seconds and answer orcactrl requests on
+//   the control socket until wakeTime.  Returns early if a
+//   config reload has been requested.
+//
+// RETURNS
+//   Nothing
+//
+static void idleUntil ( time_t wakeTime )
+{
+  char request[CTLSOCK_MAXREQUEST];
+  int weatherFD = -1;
+  int clientFD;
+  time_t now;
+  long waitSecs;
+
+  if ( hasSerialDevice( DAVIS_WEATHER_STATION ) > 0 )
+    weatherFD = getDeviceFileDescriptor( DAVIS_WEATHER_STATION );
+
+  while ( ( now = time( NULL ) ) < wakeTime && ! reloadRequested )
+  {
+    waitSecs = wakeTime - now;
+    if ( weatherFD > 0 )
+    {
+      serviceWeatherLoop( weatherFD );
+      if ( waitSecs > WSLOOPINTERVAL )
+        waitSecs = WSLOOPINTERVAL;
+    }
+
+    if ( controlFD < 0 )
+      sleep( waitSecs );
+    else if ( ( clientFD = acceptControlRequest( controlFD, waitSecs * 1000,
+                                                 request,
+                                                 sizeof( request ) ) ) >= 0 )
+      handleControlRequest( clientFD, request );
+  }
+}
+
+
+//
+// NAME
+//   handleControlRequest - Run an orcactrl request
+//
+// DESCRIPTION
+//   Split the request line into words, run it with
+//   runControlCommand() and send the output back to
+//   orcactrl.
+//
+// RETURNS
+//   Nothing
+//
+static void handleControlRequest ( int clientFD, char *request )
+{
+  char *cmd[8];
+  char *savePtr;
+  char *tok;
+  char *body = NULL;
+  size_t bodyLen = 0;
+  FILE *out;
+  int numTokens = 0;
+  int ret;
+
+  LOGPRINT( LVL_INFO, "handleControlRequest(): orcactrl request: %s",
+            request );
+
+  for ( tok = strtok_r( request, " \t", &savePtr );
+        tok != NULL && numTokens < 8;
+        tok = strtok_r( NULL, " \t", &savePtr ) )
+    cmd[numTokens++] = tok;
+
+  if ( ( out = open_memstream( &body, &bodyLen ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "handleControlRequest(): Out of memory" );
+    sendControlResponse( clientFD, FAILURE, "Out of memory\n", 14 );
+    return;
+  }
+  ret = runControlCommand( out, cmd, numTokens );
+  fclose( out );
+
+  sendControlResponse( clientFD, ret, body, bodyLen );
+  free( body );
+}
+
+
+//
+// NAME
+//   readHydroPressure - Take a pressure reading for orcactrl
+//
+// DESCRIPTION
+//   The hydrowire is only powered during casts so power it
+//   up long enough to take a single reading from the CTD.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+static int readHydroPressure ( double *pressure )
+{
+  int hydroType;
+  int hydroFD;
+  int sleepSec;
+  int ret = FAILURE;
+
+  if ( ( hydroType = getHydroWireDeviceType() ) < 0 ||
+       ( hydroFD = getDeviceFileDescriptor( hydroType ) ) < 0 )
+    return( FAILURE );
+
+  HYDRO_ON;
+  sleepSec = HYDRO_SETTLE_SECS;
+  while ( ( sleepSec = sleep( sleepSec ) ) > 0 ) { /* nothing */ }
+  if ( startHydroLogging( hydroType, hydroFD ) > 0 )
+  {
+    *pressure = getHydroPressure( hydroType, hydroFD );
+    stopHydroLogging( hydroType, hydroFD );
+    publishReading( BUS_PRESSURE, *pressure );
+    publishReading( BUS_DEPTH, convertDBToDepth( *pressure ) );
+    ret = SUCCESS;
+  }
+  HYDRO_OFF;
+
+  return( ret );
+}
+
+
+//
+// NAME
+//   runControlCommand - Run an orcactrl command
+//
+// DESCRIPTION
+//   The subset of orcactrl's commands which are safe to run
+//   between casts using our open ports.  Anything which
+//   moves the winch or takes over an instrument for a long
+//   time still requires orcad to be stopped.  Output and
+//   error messages are written to out.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+static int runControlCommand ( FILE *out, char *cmd[], int numTokens )
+{
+  struct castStats castStats;
+  struct sPort *mwPort;
+  double pressure;
+  float meters;
+  float intVolts;
+  float extVolts;
+  int hydroType;
+  int hydroFD;
+  int sleepSec;
+  int fd;
+  int intValue;
+  int ret;
+
+  if ( numTokens == 0 )
+  {
+    fprintf( out, "Empty request!\n" );
+    return( FAILURE );
+  }
+
+  if ( strcasecmp( "status", cmd[0] ) == 0 && numTokens == 1 )
+  {
+    fprintf( out, "orcad version %s ( pid %d )\n", Version, (int)getpid() );
+    fprintf( out, "Config file    = %s\n", opts.configFileName );
+    fprintf( out, "Last cast      = %ld\n", opts.lastCastNum );
+    return( SUCCESS );
+  }else if ( strcasecmp( "reload", cmd[0] ) == 0 && numTokens == 1 )
+  {
+    reloadRequested = 1;
+    fprintf( out, "Reloading %s\n", opts.configFileName );
+    return( SUCCESS );
+  }else if ( strcasecmp( "view", cmd[0] ) == 0 && numTokens == 2 )
+  {
+    if ( strcasecmp( "config", cmd[1] ) == 0 )
+    {
+      logOpts( out );
+      return( SUCCESS );
+    }else if ( strcasecmp( "voltage", cmd[1] ) == 0 )
+    {
+      intVolts = GET_INTERNAL_BATTERY_VOLTAGE;
+      extVolts = GET_EXTERNAL_BATTERY_VOLTAGE;
+      fprintf( out, "Internal Battery Voltage = %6.2f volts\n", intVolts );
+      fprintf( out, "External Battery Voltage = %6.2f volts\n", extVolts );
+      publishReading( BUS_INTBATTERY, intVolts );
+      publishReading( BUS_EXTBATTERY, extVolts );
+      return( SUCCESS );
+    }else if ( strcasecmp( "pressure", cmd[1] ) == 0 )
+    {
+      if ( readHydroPressure( &pressure ) < 0 )
+      {
+        fprintf( out, "Failed to read the CTD pressure!\n" );
+        return( FAILURE );
+      }
+      fprintf( out, "Water Pressure = %6.2f db = %6.2f meters\n",
+               pressure, convertDBToDepth( pressure ) );
+      return( SUCCESS );
+    }else if ( strcasecmp( "meterwheel", cmd[1] ) == 0 )
+    {
+      mwPort = getMeterWheelPort();
+      meters = readMeterWheelAdjusted( mwPort, opts.meterwheelCFactor );
+      if ( meters < 0 )
+      {
+        fprintf( out, "Meter wheel count could not be read! ( error:  %g )\n",
+                 meters );
+        return( FAILURE );
+      }
+      fprintf( out, "Meter Wheel Count Adjusted = %6.2f meters\n", meters );
+      publishReading( BUS_METERWHEEL, meters );
+      return( SUCCESS );
+    }else if ( strcasecmp( "weather", cmd[1] ) == 0 )
+    {
+      // Answer from the LOOP stream if it is current
+      if ( hasSerialDevice( DAVIS_WEATHER_STATION ) < 1 ||
+           ( fd = getDeviceFileDescriptor( DAVIS_WEATHER_STATION ) ) < 0 )
+      {
+        fprintf( out, "There is no weather station!\n" );
+        return( FAILURE );
+      }
+      if ( logWeatherState( out ) < 0 && logInstantWeather( fd, out ) < 0 )
+      {
+        fprintf( out, "Failed to read the weather station!\n" );
+        return( FAILURE );
+      }
+      return( SUCCESS );
+    }else if ( strcasecmp( "all", cmd[1] ) == 0 )
+    {
+      if ( readHydroPressure( &pressure ) < 0 )
+      {
+        fprintf( out, "Failed to read the CTD pressure!\n" );
+        return( FAILURE );
+      }
+      meters = readMeterWheelAdjusted( getMeterWheelPort(),
+                                       opts.meterwheelCFactor );
+      intVolts = GET_INTERNAL_BATTERY_VOLTAGE;
+      extVolts = GET_EXTERNAL_BATTERY_VOLTAGE;
+      fprintf( out, "pres=%6.2fdb prdp=%6.2fm mwdp=%6.1fm "
+               "ipwr=%4.1fv epwr=%4.1fv\n", pressure,
+               convertDBToDepth( pressure ), meters, intVolts, extVolts );
+      return( SUCCESS );
+    }
+  }else if ( strcasecmp( "set", cmd[0] ) == 0 && numTokens == 3 )
+  {
+    // These last until the config file is next read
+    if ( sscanf( cmd[2], "%d", &intValue ) != 1 )
+    {
+      fprintf( out, "Don't understand argument %s\n", cmd[2] );
+      return( FAILURE );
+    }
+    if ( strcasecmp( "minDepth", cmd[1] ) == 0 )
+      opts.minDepth = intValue;
+    else if ( strcasecmp( "parkingDepth", cmd[1] ) == 0 )
+      opts.parkingDepth = intValue;
+    else if ( strcasecmp( "maxDepth", cmd[1] ) == 0 )
+      opts.maxDepth = intValue;
+    else if ( strcasecmp( "debugLevel", cmd[1] ) == 0 )
+      opts.debugLevel = intValue;
+    else
+    {
+      fprintf( out, "Don't understand %s\n", cmd[1] );
+      return( FAILURE );
+    }
+    LOGPRINT( LVL_ALWY, "runControlCommand(): Changing Parameter: %s = %d",
+              cmd[1], intValue );
+    fprintf( out, "%s = %d\n", cmd[1], intValue );
+    return( SUCCESS );
+  }else if ( strcasecmp( "timeline", cmd[0] ) == 0 && numTokens <= 2 )
+  {
+    intValue = 24;
+    if ( numTokens == 2 &&
+         ( sscanf( cmd[1], "%d", &intValue ) != 1 || intValue < 1 ) )
+    {
+      fprintf( out, "Could not read the number of hours!\n" );
+      return( FAILURE );
+    }
+    readCastStats( &castStats );
+    printMissionTimeline( out, opts.missions, &castStats, time(NULL),
+                          time(NULL) + ( intValue * 3600 ) );
+    return( SUCCESS );
+  }else if ( strcasecmp( "sync", cmd[0] ) == 0 && numTokens == 2 )
+  {
+    if ( strcasecmp( "ctd", cmd[1] ) == 0 )
+    {
+      if ( ( hydroType = getHydroWireDeviceType() ) < 0 ||
+           ( hydroFD = getDeviceFileDescriptor( hydroType ) ) < 0 )
+      {
+        fprintf( out, "There is no CTD!\n" );
+        return( FAILURE );
+      }
+      HYDRO_ON;
+      sleepSec = HYDRO_SETTLE_SECS;
+      while ( ( sleepSec = sleep( sleepSec ) ) > 0 ) { /* nothing */ }
+      ret = syncHydroTime( hydroType, hydroFD );
+      HYDRO_OFF;
+    }else if ( strcasecmp( "weather", cmd[1] ) == 0 &&
+               hasSerialDevice( DAVIS_WEATHER_STATION ) > 0 &&
+               ( fd = getDeviceFileDescriptor( DAVIS_WEATHER_STATION ) ) > 0 )
+    {
+      // Reading and setting the clock stops the LOOP stream
+      // ( see getWSTime() ).  Restart it now rather than leave
+      // "status weather" and the reading bus stale until the
+      // next pass of idleUntil().
+      ret = syncWSTime( fd );
+      serviceWeatherLoop( fd );
+    }else if ( strcasecmp( "aquadopp", cmd[1] ) == 0 &&
+               hasSerialDevice( AQUADOPP ) > 0 )
+    {
+      ret = syncAquadoppTime( getDeviceFileDescriptor( AQUADOPP ) );
+    }else
+    {
+      fprintf( out, "Don't know how to sync %s\n", cmd[1] );
+      return( FAILURE );
+    }
+    if ( ret < 0 )
+    {
+      fprintf( out, "Failed to sync %s time!\n", cmd[1] );
+      return( FAILURE );
+    }
+    fprintf( out, "Synced %s time\n", cmd[1] );
+    return( SUCCESS );
+  }
+
+  fprintf( out, "\"%s%s%s\" can not be run while orcad is running.  Stop "
+           "orcad first.\n", cmd[0], numTokens > 1 ? " " : "",
+           numTokens > 1 ? cmd[1] : "" );
+  return( FAILURE );
+}
+
+
 int initialize() {
   static char defaultConfigFile[] = "/usr/local/orcaD/orcad.cfg";
 
@@ -410,6 +849,9 @@ int initialize() {
   opts.ctdCalPA1 = 248.24555;
   opts.ctdCalPA2 = -6.524518E-2;
   opts.ctdCalPA3 = 5.430179E-8;
+  opts.ctdUploadBaud = 0;
+  opts.dataCommitInterval = DATAWRITER_DEFAULT_INTERVAL;
+  opts.dataSyncPolicy = DATAWRITER_DEFAULT_SYNC;
   opts.solarCalibrationConstant = 0;
   opts.solarMillivoltResistance = 0;
   opts.solarADMultiplier = 0;
@@ -429,6 +871,13 @@ int runJobs ( struct mission *mPtr )
   unsigned int sleepSec;
   int ret, hydroFD, hydroDeviceType;
   int aquaFD = 0;
+  time_t now, powerUpTime;
+  time_t profileStart, profileEnd, downloadStart;
+  long downloadBytes = 0;
+  long downloadSecs = 0;
+  int downloadRet;
+  int streamSuffix;
+  struct castStats castStats;
   short nJobs = 0;
   struct mission *currMission;
   FILE *outFile;
@@ -443,22 +892,73 @@ int runJobs ( struct mission *mPtr )
 
       LOGPRINT( LVL_NOTC, "runJobs(): Running mission: %s", currMission->name);
 
+      //
+      // Pre-warm: testJobs() marks a mission early enough that
+      // we can power up the hydrowire and let the oxygen sensor
+      // warm up *before* the scheduled minute.  Wait for the
+      // power up time here.  If we are already late ( i.e a
+      // previous mission ran long ) push the sampling start
+      // back so that the package still gets its full warm up.
+      //
+      now = time( NULL );
+      if ( currMission->scheduledStart > 0 )
+      {
+        powerUpTime = currMission->scheduledStart - 
+                      currMission->warmupTime - currMission->leadTime;
+        if ( powerUpTime > now )
+        {
+          sleepSec = powerUpTime - now;
+          LOGPRINT( LVL_INFO, "runJobs(): Waiting %d secs to pre-warm "
+                    "mission %s", sleepSec, currMission->name );
+          while ( ( sleepSec = sleep( sleepSec ) ) > 0 ) { /* nothing */ }
+        }else if ( powerUpTime < now )
+        {
+          LOGPRINT( LVL_WARN, "runJobs(): Mission %s is starting %ld secs "
+                    "late", currMission->name, (long)( now - powerUpTime ) );
+          currMission->scheduledStart = now + currMission->warmupTime +
+                                        currMission->leadTime;
+        }
+      }
+
       // WMR 10/16/13: Toggle hydro wire power on. Now that the buoy's
       //               no longer have battery packs underwater we only
       //               need to power up the hydrowire during a profile.
       HYDRO_ON;
-      sleepSec = 5;
+      sleepSec = currMission->leadTime;
       LOGPRINT( LVL_INFO,
       "profile(): Powering up the hydrowire...and sleeping for %d secs", sleepSec );
       while ( ( sleepSec = sleep( sleepSec ) ) > 0 ) { /* nothing */ }
  
 
+      // Record the CTD data stream alongside the cast.  The stream
+      // file shares the cast number of the HEX file saved afterwards.
+      // A cast whose setup fails saves no HEX file and does not use
+      // up its number, so the stream file may already be there.
+      // Keep it and give this one a suffix.
+      hydroDeviceType = getHydroWireDeviceType();
+      if ( updateDataDir() > 0 )
+      {
+        snprintf( dataLogFile, FILEPATHMAX, "%s/%s%04ld.CTD",
+                  opts.dataSubDirName, opts.dataFilePrefix, 
+                  opts.lastCastNum + 1 );
+        for ( streamSuffix = 1; access( dataLogFile, F_OK ) == 0 &&
+                                streamSuffix < CTDSTREAM_MAXSUFFIX; streamSuffix++ )
+          snprintf( dataLogFile, FILEPATHMAX, "%s/%s%04ld_%d.CTD",
+                    opts.dataSubDirName, opts.dataFilePrefix, 
+                    opts.lastCastNum + 1, streamSuffix );
+        openCTDStream( hydroDeviceType, dataLogFile );
+      }
+
       // Do profile
+      profileStart = time( NULL );
       if ( ( ret = profile( currMission ) ) < 0 ) 
       {
         LOGPRINT( LVL_ALRT, "runJobs(): Mission %s profile returned: %d", 
                   currMission->name, ret );
       }
+      profileEnd = time( NULL );
+      downloadBytes = 0;
+      closeCTDStream();
 
       // Save the CTD Data in good times and bad:
       //     - as long as the error occured after
@@ -474,8 +974,12 @@ int runJobs ( struct mission *mPtr )
                                dataLogFile );
           hydroDeviceType = getHydroWireDeviceType();
           hydroFD = getDeviceFileDescriptor( hydroDeviceType );
-          downloadHydroData( hydroDeviceType, hydroFD, outFile );
-          fclose( outFile );
+          downloadStart = time( NULL );
+          downloadRet = downloadHydroData( hydroDeviceType, hydroFD, 
+                                           outFile, 1 );
+          downloadSecs = time( NULL ) - downloadStart;
+          downloadBytes = ftell( outFile );
+          commitCastFile( outFile, downloadRet > 0 );
         }else {
           LOGPRINT( LVL_CRIT, "runJobs(): Could not open open" 
                               " a new HEX file! Data not saved!" ); 
@@ -497,8 +1001,19 @@ int runJobs ( struct mission *mPtr )
         }
       }
 
+      // Learn the winch speed and download rate from good casts
+      if ( ret >= 0 && currMission->scheduledStart > 0 )
+      {
+        readCastStats( &castStats );
+        updateCastStats( &castStats, currMission, 
+                         profileEnd - profileStart,
+                         profileEnd - currMission->scheduledStart,
+                         downloadBytes, downloadSecs );
+      }
+
       nJobs++;
       currMission->cl_Pid = 0;
+      currMission->scheduledStart = 0;
 
       //
       // Sync the time with the CTD just for good measure
@@ -525,41 +1040,56 @@ int runJobs ( struct mission *mPtr )
   return ( nJobs );
 }
 
+//
+// NAME
+//   testJobs - Mark missions which are due to be run
+//
+// SYNOPSIS
+//   int testJobs( time_t t1, time_t t2, struct mission *mPtr );
+//
+// DESCRIPTION
+//   Find missions scheduled to start in the interval ( t1, t2 ] 
+//   and mark them ready to run.  Each mission's interval is shifted
+//   forward by its lead and warm up times plus one pass of the main
+//   schedule loop.  This lets runJobs() power up the hydrowire ahead
+//   of time so that sampling begins on the scheduled minute.  The
+//   scheduled start is saved in the mission's scheduledStart field.
+//
+// RETURNS
+//   The number of missions marked.
+//
 int testJobs (time_t t1, time_t t2, struct mission *mPtr)
 {
   short nJobs = 0;
-  time_t t;
+  time_t t, ahead;
   struct mission *currMission;
 
-  /* Find jobs > t1 and <= t2 */
-  for (t = t1 - t1 % 60; t <= t2; t += 60) {
-    if (t > t1) {
-      struct tm *tp = localtime(&t);
-      //for each mission
-      currMission = mPtr;
-      while ( currMission != NULL ) {
-        LOGPRINT( LVL_DEBG, 
-                  "testJobs(): Considering mission: %s", currMission->name);
-
-        if (    currMission->startMinsList[ tp->tm_min ]
-             && currMission->startHoursList[ tp->tm_hour ]
-             && (    currMission->startDaysOfMonthList[ tp->tm_mday ]
-                  || currMission->startDaysOfWeekList[ tp->tm_wday ] )
-             && currMission->startMonthsList[ tp->tm_mon ] )
+  //for each mission
+  currMission = mPtr;
+  while ( currMission != NULL ) {
+    LOGPRINT( LVL_DEBG, 
+              "testJobs(): Considering mission: %s", currMission->name);
+
+    ahead = currMission->leadTime + currMission->warmupTime + 60;
+
+    /* Find jobs > t1 + ahead and <= t2 + ahead */
+    for (t = (t1 + ahead) - (t1 + ahead) % 60; t <= t2 + ahead; t += 60) {
+      if (t > t1 + ahead) {
+        if ( isMissionStartTime( currMission, t ) )
         {
  
           LOGPRINT( LVL_DEBG, 
                     "testJobs(): Mission ready to run: %s", currMission->name);
           if (currMission->cl_Pid == 0) {
             currMission->cl_Pid = -1;
+            currMission->scheduledStart = t;
             ++nJobs;
           }
         }
-
-        currMission = currMission->nextMission;
-
       }
     }
+
+    currMission = currMission->nextMission;
   }
   return (nJobs);
 }
@@ -673,7 +1203,7 @@ void cleanup (int passed_signal)
       // of the volatile data archive.
       if ( ( fpWeather = openNewWeatherFile() ) != NULL )
       {
-        if ( ( ret = downloadWeatherData( weatherFD, fpWeather, 0 ) ) < 0 )
+        if ( ( ret = downloadWeatherData( weatherFD, fpWeather ) ) < 0 )
         {
           LOGPRINT( LVL_WARN, "cleanup(): Failed to download weather archive. "
                               "Return code = %d.", ret );
@@ -703,6 +1233,8 @@ void cleanup (int passed_signal)
     METER_OFF;
   }
 
+  closeControlSocket( controlFD, CTLSOCK_PATH );
+
   // TODO: shut off all io
 
   // TODO: close all file descriptors
@@ -718,9 +1250,9 @@ void cleanup_USR1 ()
   cleanup(SIGUSR1);
 }
 
-void cleanup_HUP ()
+void reload_HUP ()
 {
-  cleanup(SIGHUP);
+  reloadRequested = 1;
 }
 
 void cleanup_INT ()
@@ -22,6 +22,8 @@
 #ifndef _ORCAD_H
 #define _ORCAD_H
 
+#include <stdio.h>
+#include <time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <ftdi.h>
@@ -34,7 +36,9 @@
 /* serialDeviceTypes Enumeration
  *
  * Devices one might want to attach to the control
- * computer's serial ports or USB ports.
+ * computer's serial ports or USB ports.  Each type is 
+ * named in parser.c's deviceTypeNames[] and may have a
+ * deviceDriver ( see buoy.c ).
  *
  */ 
 enum serialDeviceTypes {
@@ -53,7 +57,8 @@ enum serialDeviceTypes {
   GILLMETPAK,
   RMYOUNGWIND,
   S9VAISALA, 
-  SEAFETPH
+  SEAFETPH,
+  NUMDEVICETYPES
 };
 
 /*
@@ -73,6 +78,7 @@ struct sPort {
   char *description;
   int  fileDescriptor;
   struct ftdi_context *ftdiContext;
+  int  adopted;          // Kept its handles across a config reload
   int vendorID;
   int productID;
   char *serialID;
@@ -85,6 +91,33 @@ struct sPort {
   struct sPort *nextPort;
 };
 
+/*
+ * Device driver flags
+ */
+#define DRIVER_HYDROWIRE  0x01    // Talks to us over the hydro wire
+
+/* deviceDriver
+ *
+ * The operations on one serial device type, registered 
+ * with registerDeviceDriver() in buoy.c.  Each takes the
+ * device's open file descriptor.  Operations the device
+ * does not have are NULL.
+ *
+ */
+struct deviceDriver {
+  enum serialDeviceTypes deviceType;
+  int flags;
+  int (*init)( int fd );
+  int (*start)( int fd );                     // Start logging
+  int (*stop)( int fd );                      // Stop logging
+  double (*readSample)( int fd );             // e.g. CTD pressure
+  int (*download)( int fd, FILE *outFile,     // useMark: see
+                    int useMark );            //   downloadHydroData()
+  int (*syncTime)( int fd );
+  struct tm *(*getTime)( int fd );
+  int (*setTime)( int fd, struct tm *time );
+};
+
 /*
  * Mission characteristics
  */
@@ -101,6 +134,9 @@ struct mission {
   int *depths;
   int numDepths;
   int auxSampleDirection;  /* See castDirection enumeration */
+  int leadTime;    /* Secs to let the hydrowire settle after power up */
+  int warmupTime;  /* Secs for the oxygen sensor to warm up */
+  time_t scheduledStart;   /* Time sampling should begin, or 0 */
   struct mission *nextMission;
 };
 
@@ -116,6 +152,8 @@ struct optionsStruct {
   int weatherArchiveDownloadPeriod; // Minutes before metFile is archived
   int auxiliarySamplePeriod;
   int auxiliaryArchiveDownloadPeriod;
+  int dataCommitInterval;         // Secs between MET/AUX file writes
+  int dataSyncPolicy;             // See enum dataSyncPolicies
   long lastCastNum;
   char isDaemon;
   char *dataFilePrefix;
@@ -135,6 +173,7 @@ struct optionsStruct {
   double solarADMultiplier;
   double meterwheelCFactor;
   double compassDeclination;
+  int ctdUploadBaud;              // Highest baud to try for CTD uploads, 0=off
 } opts;
 
 
@@ -144,7 +183,7 @@ int testJobs(time_t t1, time_t t2, struct mission *mPtr);
 void cleanup_TERM();
 void cleanup_QUIT();
 void cleanup_INT();
-void cleanup_HUP();
+void reload_HUP();
 void cleanup_USR1();
 void cleanup(int passed_signal);
 
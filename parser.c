@@ -32,6 +32,50 @@
 #include "log.h"
 #include "orcad.h"
 #include "parser.h"
+#include "datawriter.h"
+
+// The serial device "type" names used in the config file,
+// by enum serialDeviceTypes
+static const char *const deviceTypeNames[NUMDEVICETYPES] = {
+  [SEABIRD_CTD_19]              = "SEABIRD_CTD_19",
+  [SEABIRD_CTD_19_PLUS]         = "SEABIRD_CTD_19_PLUS",
+  [AGO_METER_WHEEL_COUNTER]     = "AGO_METER_WHEEL_COUNTER",
+  [DAVIS_WEATHER_STATION]       = "DAVIS_WEATHER_STATION",
+  [ENVIROTECH_ECOLAB]           = "ENVIROTECH_ECOLAB",
+  [SATLANTIC_ISIS]              = "SATLANTIC_ISIS",
+  [SATLANTIC_ISIS_X]            = "SATLANTIC_ISIS_X",
+  [CELL_MODEM]                  = "CELL_MODEM",
+  [AQUADOPP]                    = "AQUADOPP",
+  [ARDUINO_METER_WHEEL_COUNTER] = "ARDUINO_METER_WHEEL_COUNTER",
+  [AIRMAR_PB100]                = "AIRMAR_PB100",
+  [AIRMAR_PB200]                = "AIRMAR_PB200",
+  [GILLMETPAK]                  = "GILLMETPAK",
+  [RMYOUNGWIND]                 = "RMYOUNGWIND",
+  [S9VAISALA]                   = "S9VAISALA",
+  [SEAFETPH]                    = "SEAFETPH"
+};
+
+// Everything parseConfigFile() allocates for opts comes from
+// an arena of CONFIGBLOCKSIZE blocks so that a replaced 
+// configuration can be freed in one go.
+#define CONFIGBLOCKSIZE 4096
+#define CONFIGALIGN     sizeof( double )
+
+struct configArena {
+  struct configArena *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+// The arena holding opts' ports, missions and strings
+static struct configArena *optsArena = NULL;
+
+// opts as the program set it up before the first parse
+static struct optionsStruct configDefaults;
+static int haveConfigDefaults = 0;
+
+static int parseConfigStream( FILE *fpIn );
 
 // The day names used in config file
 static const char *const dayNamesList[] = {
@@ -101,6 +145,10 @@ void logOpts ( FILE * fd ) {
   fprintf( fd, "  data_file_prefix                = %s\n", opts.dataFilePrefix);
   fprintf( fd, "  data_storage_dir                = %s\n", opts.dataDirName );
   fprintf( fd, "  last_cast_num                   = %ld\n", opts.lastCastNum );
+  fprintf( fd, "  data_commit_interval            = %d\n", 
+           opts.dataCommitInterval );
+  fprintf( fd, "  data_sync_policy                = %s\n", 
+           getDataSyncPolicyName( opts.dataSyncPolicy ) );
   fprintf( fd, "  weather_data_prefix             = %s\n", 
            opts.weatherDataPrefix );
   //fprintf( fd, "  weather_sample_period           = %d\n", 
@@ -114,6 +162,7 @@ void logOpts ( FILE * fd ) {
   fprintf( fd, "  ctd_cal_PA1                     = %le\n", opts.ctdCalPA1 );
   fprintf( fd, "  ctd_cal_PA2                     = %le\n", opts.ctdCalPA2 );
   fprintf( fd, "  ctd_cal_PA3                     = %le\n", opts.ctdCalPA3 );
+  fprintf( fd, "  ctd_upload_baud                 = %d\n", opts.ctdUploadBaud );
   if ( opts.solarCalibrationConstant > 0 )
   {
     fprintf( fd, "  solar_calibration_constant      = %le\n", opts.solarCalibrationConstant );
@@ -140,39 +189,8 @@ void logOpts ( FILE * fd ) {
     else 
       fprintf( fd, "  RS232 Port\n");
     fprintf( fd, "  description   = %s\n", port->description );
-    fprintf( fd, "  device_type   = " );
-    if ( port->deviceType == SEABIRD_CTD_19 ) 
-      fprintf( fd, "SEABIRD_CTD_19\n" );
-    if ( port->deviceType == SEABIRD_CTD_19_PLUS ) 
-      fprintf( fd, "SEABIRD_CTD_19_PLUS\n" );
-    if ( port->deviceType == AGO_METER_WHEEL_COUNTER ) 
-      fprintf( fd, "AGO_METER_WHEEL_COUNTER\n" );
-    if ( port->deviceType == DAVIS_WEATHER_STATION ) 
-      fprintf( fd, "DAVIS_WEATHER_STATION\n" );
-    if ( port->deviceType == ENVIROTECH_ECOLAB ) 
-      fprintf( fd, "ENVIROTECH_ECOLAB\n" );
-    if ( port->deviceType == SATLANTIC_ISIS ) 
-      fprintf( fd, "SATLANTIC_ISIS\n" );
-    if ( port->deviceType == SATLANTIC_ISIS_X ) 
-      fprintf( fd, "SATLANTIC_ISIS_X\n" );
-    if ( port->deviceType == CELL_MODEM ) 
-      fprintf( fd, "CELL_MODEM\n" );
-    if ( port->deviceType == AQUADOPP ) 
-      fprintf( fd, "AQUADOPP\n" );
-    if ( port->deviceType == AIRMAR_PB100 ) 
-      fprintf( fd, "AIRMAR_PB100\n" );
-    if ( port->deviceType == AIRMAR_PB200 ) 
-      fprintf( fd, "AIRMAR_PB200\n" );
-    if ( port->deviceType == GILLMETPAK )
-      fprintf( fd, "GILLMETPAK\n" );
-    if ( port->deviceType == RMYOUNGWIND )
-      fprintf( fd, "RMYOUNGWIND\n" );
-    if ( port->deviceType == S9VAISALA )                  
-      fprintf( fd, "S9VAISALA\n" ); 
-    if ( port->deviceType == SEAFETPH )
-      fprintf( fd, "SEAFETPH\n" );
-    if ( port->deviceType == ARDUINO_METER_WHEEL_COUNTER ) 
-      fprintf( fd, "ARDUINO_METER_WHEEL_COUNTER\n" );
+    fprintf( fd, "  device_type   = %s\n", 
+             getDeviceTypeName( port->deviceType ) );
     if ( port->productID > 0 )
     {
       fprintf( fd, "  vendor_id     = %x\n", port->vendorID );
@@ -222,6 +240,8 @@ void logOpts ( FILE * fd ) {
              convArrayToRangeString( mptr->startDaysOfWeekList, 7, 
                                      dayNamesList ) );
     fprintf( fd, "  equilibration_time   = %d\n", mptr->equilibrationTime );
+    fprintf( fd, "  lead_time            = %d\n", mptr->leadTime );
+    fprintf( fd, "  warmup_time          = %d\n", mptr->warmupTime );
     fprintf( fd, "  aux_sample_direction =" );
     if ( mptr->auxSampleDirection == UP ) {
       fprintf( fd, " up\n" );
@@ -243,6 +263,108 @@ void logOpts ( FILE * fd ) {
 }
   
 
+//
+// NAME
+//   configAlloc - Allocate zeroed memory from the config arena
+//
+// DESCRIPTION
+//   Carve size bytes out of optsArena, starting a new block
+//   when the current one is full.
+//
+// RETURNS
+//   The memory or NULL if it could not be allocated.
+//
+static void *configAlloc ( size_t size )
+{
+  struct configArena *block = optsArena;
+  size_t blockSize;
+  void *mem;
+
+  size = ( size + CONFIGALIGN - 1 ) & ~( CONFIGALIGN - 1 );
+  if ( block == NULL || block->size - block->used < size )
+  {
+    blockSize = size > CONFIGBLOCKSIZE ? size : CONFIGBLOCKSIZE;
+    if ( ( block = malloc( sizeof( struct configArena ) + 
+                           blockSize ) ) == NULL )
+    {
+      LOGPRINT( LVL_CRIT, "configAlloc(): Out of memory!" );
+      return( NULL );
+    }
+    block->next = optsArena;
+    block->size = blockSize;
+    block->used = 0;
+    optsArena = block;
+  }
+  mem = block->data + block->used;
+  block->used += size;
+  memset( mem, 0, size );
+  return( mem );
+}
+
+
+//
+// NAME
+//   freeConfigArena - Free a configuration replaced by reloadConfigFile()
+//
+// SYNOPSIS
+//   #include "parser.h"
+//
+//   void freeConfigArena( struct configArena *arena );
+//
+// DESCRIPTION
+//   Free every port, mission and string of an old configuration.
+//
+// RETURNS
+//   Nothing
+//
+void freeConfigArena ( struct configArena *arena )
+{
+  struct configArena *next;
+
+  while ( arena != NULL )
+  {
+    next = arena->next;
+    free( arena );
+    arena = next;
+  }
+}
+
+
+//
+// NAME
+//   validateConfig - Sanity check a newly parsed configuration
+//
+// DESCRIPTION
+//   Checks made before a reloaded config replaces a running one.
+//
+// RETURNS
+//   1 If opts is usable
+//  -1 Otherwise
+//
+static int validateConfig ( void )
+{
+  struct sPort *port;
+
+  for ( port = opts.serialPorts; port != NULL; port = port->nextPort )
+  {
+    if ( port->tty == NULL && port->vendorID == 0 )
+    {
+      LOGPRINT( LVL_CRIT, "validateConfig(): Serial port %s has no "
+                "tty or vendor_id", 
+                port->description ? port->description : "" );
+      return( FAILURE );
+    }
+  }
+  if ( opts.minDepth > opts.maxDepth )
+  {
+    LOGPRINT( LVL_CRIT, "validateConfig(): min_depth ( %d ) is greater "
+              "than max_depth ( %d )", opts.minDepth, opts.maxDepth );
+    return( FAILURE );
+  }
+  return( SUCCESS );
+}
+
+
 //
 // NAME
 //   parseConfigFile - Open and parse the orcad configuration file.
@@ -263,6 +385,111 @@ void logOpts ( FILE * fd ) {
 int parseConfigFile ( char *fileName ) 
 {
   FILE *fpIn;
+  int ret;
+
+  // Remember the defaults for reloadConfigFile()
+  if ( ! haveConfigDefaults )
+  {
+    configDefaults = opts;
+    haveConfigDefaults = 1;
+  }
+
+  // Open up the config file
+  if ( ( fpIn = fopen(fileName, "r") ) == NULL ) {
+    LOGPRINT( LVL_CRIT, "parseConfigFile(): Error - cannot open file "
+                        "%s to read.", fileName);
+    return( FAILURE );
+  }
+  ret = parseConfigStream( fpIn );
+  fclose( fpIn );
+
+  return( ret );
+}
+
+
+//
+// NAME
+//   reloadConfigFile - Replace the running configuration
+//
+// SYNOPSIS
+//   #include "general.h"
+//   #include "parser.h"
+//
+//   int reloadConfigFile( char *fileName, struct optionsStruct *oldOpts,
+//                         struct configArena **oldArena );
+//
+// DESCRIPTION
+//   Parse the config file again, starting from the defaults
+//   parseConfigFile() was first called with, so options removed 
+//   from the file revert.  Run time state ( e.g. lastCastNum ) is
+//   kept.  The new ports, missions and strings go into a fresh 
+//   arena and the result is checked by validateConfig().
+//
+//   If all is well opts is replaced and the previous options
+//   and arena are returned in oldOpts/oldArena.  The caller
+//   must free the arena with freeConfigArena() once it is
+//   done with the old ports and missions.  On failure opts
+//   is left as it was.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+int reloadConfigFile ( char *fileName, struct optionsStruct *oldOpts,
+                       struct configArena **oldArena )
+{
+  struct optionsStruct saved = opts;
+  struct configArena *savedArena = optsArena;
+  FILE *fpIn;
+  int ret;
+
+  if ( ! haveConfigDefaults )
+  {
+    LOGPRINT( LVL_CRIT, "reloadConfigFile(): No configuration loaded yet" );
+    return( FAILURE );
+  }
+
+  if ( ( fpIn = fopen(fileName, "r") ) == NULL ) {
+    LOGPRINT( LVL_CRIT, "reloadConfigFile(): Error - cannot open file "
+                        "%s to read.", fileName);
+    return( FAILURE );
+  }
+
+  opts = configDefaults;
+  opts.debugLevel = saved.debugLevel;
+  opts.isDaemon = saved.isDaemon;
+  opts.inCritical = saved.inCritical;
+  opts.lastCastNum = saved.lastCastNum;
+  opts.configFileName = saved.configFileName;
+  memcpy( opts.dataSubDirName, saved.dataSubDirName, FILEPATHMAX );
+  optsArena = NULL;
+
+  ret = parseConfigStream( fpIn );
+  fclose( fpIn );
+  if ( ret < 0 || validateConfig() < 0 )
+  {
+    freeConfigArena( optsArena );
+    optsArena = savedArena;
+    opts = saved;
+    return( FAILURE );
+  }
+
+  *oldOpts = saved;
+  *oldArena = savedArena;
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   parseConfigStream - Parse an open configuration file into opts
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+static int parseConfigStream ( FILE *fpIn ) 
+{
   int i;
   char buffer[FILEBUFFLEN];
   char *name;
@@ -274,17 +501,11 @@ int parseConfigFile ( char *fileName )
   struct sPort *lastPort = NULL;
   char * token;
   int val;
+  int deviceType;
   int linesRead = 0;
   char * tokenLoc;
   char * valueLoc;
 
-  // Open up the config file
-  if ( ( fpIn = fopen(fileName, "r") ) == NULL ) {
-    LOGPRINT( LVL_CRIT, "parseConfigFile(): Error - cannot open file "
-                        "%s to read.", fileName);
-    return( FAILURE );
-  }
-  
   // Main loop
   while ( 1 ) {
   
@@ -307,10 +528,10 @@ int parseConfigFile ( char *fileName )
         in_mission = 0;
         if ( lastPort == NULL ) {
           lastPort = opts.serialPorts = 
-                    ( struct sPort * )malloc( sizeof( struct sPort ) );
+                    ( struct sPort * )configAlloc( sizeof( struct sPort ) );
         } else {
           lastPort->nextPort = 
-                    ( struct sPort * )malloc( sizeof( struct sPort ) );
+                    ( struct sPort * )configAlloc( sizeof( struct sPort ) );
           lastPort = lastPort->nextPort;
           lastPort->nextPort = NULL;
         }
@@ -325,20 +546,29 @@ int parseConfigFile ( char *fileName )
         in_serial = 0;
         if ( lastMission == NULL ) {
           lastMission = opts.missions = 
-                    ( struct mission * )malloc( sizeof( struct mission ) );
+                    ( struct mission * )configAlloc( sizeof( struct mission ) );
         } else {
           lastMission->nextMission = 
-                    ( struct mission * )malloc( sizeof( struct mission ) );
+                    ( struct mission * )configAlloc( sizeof( struct mission ) );
           lastMission = lastMission->nextMission;
           lastMission->nextMission = NULL;
         }
         // Set defaults
         lastMission->auxSampleDirection = BOTH;
+        lastMission->cl_Pid = 0;
+        lastMission->cycles = 0;
+        lastMission->equilibrationTime = 0;
+        lastMission->depths = NULL;
+        lastMission->numDepths = 0;
+        lastMission->leadTime = 5;
+        lastMission->warmupTime = 120;
+        lastMission->scheduledStart = 0;
+        lastMission->nextMission = NULL;
         if ( ( cptr = index(name, '[') ) != NULL ) 
           name = ++cptr;
         if ( ( cptr = rindex(name, ']') ) != NULL ) 
           *cptr = '\0';
-        lastMission->name = malloc( (strlen( name )+1) * sizeof( char ) );
+        lastMission->name = configAlloc( (strlen( name )+1) * sizeof( char ) );
         strcpy( lastMission->name, name );
         memset(lastMission->startMinsList, 0, 60);
         memset(lastMission->startHoursList, 0, 24);
@@ -352,42 +582,11 @@ int parseConfigFile ( char *fileName )
         // Serial specific parameters
         if ( strcmp( name, "description" ) == 0 ) {
           lastPort->description = 
-                 malloc( (strlen( value )+1) * sizeof( char ) );
+                 configAlloc( (strlen( value )+1) * sizeof( char ) );
           strcpy( lastPort->description, value );
         }else if ( strcmp( name, "type" ) == 0 ) {
-          if ( strcmp( value, "SEABIRD_CTD_19" ) == 0 ) {
-            lastPort->deviceType = SEABIRD_CTD_19;
-          }else if ( strcmp( value, "SEABIRD_CTD_19_PLUS" ) == 0 ) {
-            lastPort->deviceType = SEABIRD_CTD_19_PLUS;
-          }else if ( strcmp( value, "AGO_METER_WHEEL_COUNTER" ) == 0 ) {
-            lastPort->deviceType = AGO_METER_WHEEL_COUNTER;
-          }else if ( strcmp( value, "DAVIS_WEATHER_STATION" ) == 0 ) {
-            lastPort->deviceType = DAVIS_WEATHER_STATION;
-          }else if ( strcmp( value, "ENVIROTECH_ECOLAB" ) == 0 ) {
-            lastPort->deviceType = ENVIROTECH_ECOLAB;
-          }else if ( strcmp( value, "SATLANTIC_ISIS" ) == 0 ) {
-            lastPort->deviceType = SATLANTIC_ISIS;
-          }else if ( strcmp( value, "SATLANTIC_ISIS_X" ) == 0 ) {
-            lastPort->deviceType = SATLANTIC_ISIS_X;
-          }else if ( strcmp( value, "CELL_MODEM" ) == 0 ) {
-            lastPort->deviceType = CELL_MODEM;
-          }else if ( strcmp( value, "AQUADOPP" ) == 0 ) {
-            lastPort->deviceType = AQUADOPP;
-          }else if ( strcmp( value, "ARDUINO_METER_WHEEL_COUNTER" ) == 0 ) {
-            lastPort->deviceType = ARDUINO_METER_WHEEL_COUNTER;
-          }else if ( strcmp( value, "AIRMAR_PB100" ) == 0 ) {
-            lastPort->deviceType = AIRMAR_PB100;
-          }else if ( strcmp( value, "AIRMAR_PB200" ) == 0 ) {
-            lastPort->deviceType = AIRMAR_PB200;
-           }else if ( strcmp( value, "GILLMETPAK" ) == 0 ) {
-            lastPort->deviceType = GILLMETPAK;
-          }else if ( strcmp( value, "RMYOUNGWIND" ) == 0 ) {             
-            lastPort->deviceType = RMYOUNGWIND;
-          }else if ( strcmp( value, "S9VAISALA" ) == 0 ) {
-            lastPort->deviceType = S9VAISALA;
-          }else if ( strcmp( value, "SEAFETPH" ) == 0 ) {
-            lastPort->deviceType = SEAFETPH;
-
+          if ( ( deviceType = findDeviceType( value ) ) >= 0 ) {
+            lastPort->deviceType = deviceType;
           }else {
             LOGPRINT( LVL_CRIT, "parseConfigFile(): Unknown device type "
                       "value %s", value );
@@ -404,7 +603,7 @@ int parseConfigFile ( char *fileName )
 	       strcmp( value, "/dev/ttyUSB5" ) == 0  ||
 	       strcmp( value, "/dev/ttyUSB6" ) == 0  ||
                strcmp( value, "/dev/ttyUSB7" ) == 0   ) {
-            lastPort->tty = malloc( (strlen( value )+1) * sizeof( char ) );
+            lastPort->tty = configAlloc( (strlen( value )+1) * sizeof( char ) );
             strcpy( lastPort->tty, value );
           }else {
             LOGPRINT( LVL_CRIT, "parseConfigFile(): Unknown tty value "
@@ -467,7 +666,7 @@ int parseConfigFile ( char *fileName )
           }
         }else if ( strcmp( name, "serial_id" ) == 0 ) {
           lastPort->serialID = 
-                 malloc( (strlen( value )+1) * sizeof( char ) );
+                 configAlloc( (strlen( value )+1) * sizeof( char ) );
           strcpy( lastPort->serialID, value );
         }else {
           in_serial = 0;
@@ -505,6 +704,20 @@ int parseConfigFile ( char *fileName )
                       "equilibration_time value: %s", value );
             return( FAILURE );
           }
+        }else if ( strcmp( name, "lead_time" ) == 0 ) {
+          if ( sscanf(value, "%d", &(lastMission->leadTime) ) < 1 ||
+               lastMission->leadTime < 0 ) {
+            LOGPRINT( LVL_CRIT, "parseConfigFile(): Error reading "
+                      "lead_time value: %s", value );
+            return( FAILURE );
+          }
+        }else if ( strcmp( name, "warmup_time" ) == 0 ) {
+          if ( sscanf(value, "%d", &(lastMission->warmupTime) ) < 1 ||
+               lastMission->warmupTime < 0 ) {
+            LOGPRINT( LVL_CRIT, "parseConfigFile(): Error reading "
+                      "warmup_time value: %s", value );
+            return( FAILURE );
+          }
         }else if ( strcmp( name, "aux_sample_direction" ) == 0 ) {
           if ( strcmp( value, "both" ) == 0 ) { 
             lastMission->auxSampleDirection = BOTH;
@@ -533,7 +746,7 @@ int parseConfigFile ( char *fileName )
             }
           }
           lastMission->depths = 
-              malloc( lastMission->numDepths * sizeof( int ) );
+              configAlloc( lastMission->numDepths * sizeof( int ) );
           tokenLoc = value;
           for ( i = 0; i < lastMission->numDepths; i++ ) {
             if ( ( token = strsep( &tokenLoc, " \t\n\r" ) ) != NULL ) {
@@ -571,11 +784,11 @@ int parseConfigFile ( char *fileName )
           }
         }else if ( strcmp( name, "data_file_prefix" ) == 0 ) {
             opts.dataFilePrefix = 
-                malloc( (strlen( value )+1) * sizeof( char ) );
+                configAlloc( (strlen( value )+1) * sizeof( char ) );
             strcpy( opts.dataFilePrefix, value );
         }else if ( strcmp( name, "weather_data_prefix" ) == 0 ) {
             opts.weatherDataPrefix = 
-                malloc( (strlen( value )+1) * sizeof( char ) );
+                configAlloc( (strlen( value )+1) * sizeof( char ) );
             strcpy( opts.weatherDataPrefix, value );
         }else if ( strcmp( name, "weather_sample_period" ) == 0 ) {
           // Deprecated
@@ -592,7 +805,7 @@ int parseConfigFile ( char *fileName )
           }
         }else if ( strcmp( name, "weather_status_filename" ) == 0 ) {
             opts.weatherStatusFilename = 
-                malloc( (strlen( value )+1) * sizeof( char ) );
+                configAlloc( (strlen( value )+1) * sizeof( char ) );
             strcpy( opts.weatherStatusFilename, value );
         }else if ( strcmp( name, "weather_status_update_period" ) == 0 ) {
           // Deprecated
@@ -603,7 +816,7 @@ int parseConfigFile ( char *fileName )
           //}
         }else if ( strcmp( name, "auxiliary_data_prefix" ) == 0 ) {
             opts.auxiliaryDataPrefix =
-                malloc( (strlen( value )+1) * sizeof( char ) );
+                configAlloc( (strlen( value )+1) * sizeof( char ) );
             strcpy( opts.auxiliaryDataPrefix, value );
         }else if ( strcmp( name, "auxiliary_sample_period" ) == 0 ) {
           if ( sscanf(value, "%d", &opts.auxiliarySamplePeriod ) < 1 ) {
@@ -617,12 +830,32 @@ int parseConfigFile ( char *fileName )
                       "auxiliary_archive_download_period value: %s", value );
             return( FAILURE );
           }
+        }else if ( strcmp( name, "data_commit_interval" ) == 0 ) {
+          if ( sscanf(value, "%d", &opts.dataCommitInterval ) < 1 ||
+               opts.dataCommitInterval < 0 ) {
+            LOGPRINT( LVL_CRIT, "parseConfigFile(): Error reading "
+                      "data_commit_interval value: %s", value );
+            return( FAILURE );
+          }
+        }else if ( strcmp( name, "data_sync_policy" ) == 0 ) {
+          if ( ( opts.dataSyncPolicy = parseDataSyncPolicy( value ) ) < 0 ) {
+            LOGPRINT( LVL_CRIT, "parseConfigFile(): Error reading "
+                      "data_sync_policy value: %s", value );
+            return( FAILURE );
+          }
        }else if ( strcmp( name, "compass_declination" ) == 0 ) {
           if ( sscanf(value, "%lf", &opts.compassDeclination ) < 1 ) {
             LOGPRINT( LVL_CRIT, "parseConfigFile(): Error reading "
                       "compass_decliation value: %s", value );
             return( FAILURE );
           }
+        }else if ( strcmp( name, "ctd_upload_baud" ) == 0 ) {
+          if ( sscanf(value, "%d", &opts.ctdUploadBaud ) < 1 ||
+               ( opts.ctdUploadBaud != 0 && opts.ctdUploadBaud < 600 ) ) {
+            LOGPRINT( LVL_CRIT, "parseConfigFile(): Error reading "
+                      "ctd_upload_baud value: %s", value );
+            return( FAILURE );
+          }
         }else if ( strcmp( name, "ctd_cal_PA1" ) == 0 ) {
           if ( sscanf(value, "%lf", &opts.ctdCalPA1 ) < 1 ) {
             LOGPRINT( LVL_CRIT, "parseConfigFile(): Error reading "
@@ -677,7 +910,6 @@ int parseConfigFile ( char *fileName )
     }
 
   }
-  fclose( fpIn );
 
   return( SUCCESS );
 
@@ -1235,3 +1467,51 @@ void fixDayDow (struct mission * misn)
     memset(misn->startDaysOfWeekList, 0, 7);
   }
 }
+
+
+//
+// NAME
+//   findDeviceType - Lookup a serial device type by name
+//
+// SYNOPSIS
+//   #include "parser.h"
+//
+//   int findDeviceType( const char *name );
+//
+// DESCRIPTION
+//   Convert a config file "type" value ( e.g. "SEABIRD_CTD_19" )
+//   to its enum serialDeviceTypes value.
+//
+// RETURNS
+//   The device type or -1 if the name is not known.
+//
+int findDeviceType( const char *name )
+{
+  int i;
+
+  for ( i = 0; i < NUMDEVICETYPES; i++ )
+    if ( deviceTypeNames[i] != NULL && strcmp( deviceTypeNames[i], name ) == 0 )
+      return( i );
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   getDeviceTypeName - The config file name of a device type
+//
+// SYNOPSIS
+//   #include "parser.h"
+//
+//   const char *getDeviceTypeName( int deviceType );
+//
+// RETURNS
+//   The name or "UNKNOWN" for an invalid type.
+//
+const char *getDeviceTypeName( int deviceType )
+{
+  if ( deviceType < 0 || deviceType >= NUMDEVICETYPES ||
+       deviceTypeNames[deviceType] == NULL )
+    return( "UNKNOWN" );
+  return( deviceTypeNames[deviceType] );
+}
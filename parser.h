@@ -25,12 +25,20 @@
 int getNextConfigTokens( FILE *fIN, char *buffer, char **name, 
                          char **value, int *linesRead );
 int tokenizeConfigLine( char *buffer, char **name, char **value );
+struct configArena;
+struct optionsStruct;
+
 int parseConfigFile( char *fileName );
+int reloadConfigFile( char *fileName, struct optionsStruct *oldOpts,
+                      struct configArena **oldArena );
+void freeConfigArena( struct configArena *arena );
 void logOpts( FILE * fd );
 char * convArrayToRangeString( char *ary, int arraySize, 
                                const char *const *names );
 char *parseCronField(char *ary, int modvalue, int off,
                      const char *const *names, char *ptr);
 void fixDayDow(struct mission *misn);
+int findDeviceType( const char *name );
+const char *getDeviceTypeName( int deviceType );
 
 #endif
@@ -0,0 +1,514 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * planner.c : Mission duration estimates and schedule planning
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "general.h"
+#include "orcad.h"
+#include "log.h"
+#include "planner.h"
+
+
+//
+// Fold a new observation into a running average.
+//
+static double foldStat( double current, double observed, long numCasts )
+{
+  long window = numCasts;
+
+  if ( window > CASTSTATS_WINDOW )
+    window = CASTSTATS_WINDOW;
+  if ( window < 1 )
+    window = 1;
+  return( current + ( ( observed - current ) / window ) );
+}
+
+
+//
+// Count the discrete sampling depths in [ top, bottom ]
+//
+static int countDiscreteStops( struct mission *missn, int top, int bottom )
+{
+  int j;
+  int stops = 0;
+
+  for ( j = 0; j < missn->numDepths; j++ )
+  {
+    if ( missn->depths[j] >= top && missn->depths[j] <= bottom )
+      stops++;
+  }
+  return( stops );
+}
+
+
+//
+// NAME
+//   readCastStats - Read the learned cast statistics.
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   int readCastStats( struct castStats *stats );
+//
+// DESCRIPTION
+//   Read the winch speed and CTD download statistics which
+//   were learned from past casts.  The file name is stored in
+//   opts.dataDirName/CASTSTATSFILE.  If the file cannot be
+//   read the stats are set to the defaults in planner.h.
+//
+// RETURNS
+//    1 Upon Success
+//   -1 Upon failure ( defaults are used )
+//
+int readCastStats ( struct castStats *stats )
+{
+  FILE *statsFile;
+  char statsFileName[FILEPATHMAX + sizeof( CASTSTATSFILE )];
+  struct castStats tmpStats;
+
+  stats->winchSpeed = DEFAULT_WINCH_SPEED;
+  stats->downloadRate = DEFAULT_DOWNLOAD_RATE;
+  stats->dataRate = DEFAULT_DATA_RATE;
+  stats->numCasts = 0;
+
+  snprintf( statsFileName, sizeof( statsFileName ),
+            "%s/%s", opts.dataDirName, CASTSTATSFILE );
+  if ( ( statsFile = fopen( statsFileName, "r" ) ) == NULL )
+  {
+    return( FAILURE );
+  }
+
+  if ( fscanf( statsFile, "%lf %lf %lf %ld", &tmpStats.winchSpeed,
+               &tmpStats.downloadRate, &tmpStats.dataRate,
+               &tmpStats.numCasts ) == 4 &&
+       tmpStats.winchSpeed > 0 && tmpStats.downloadRate > 0 &&
+       tmpStats.dataRate >= 0 )
+  {
+    fclose( statsFile );
+    *stats = tmpStats;
+    return( SUCCESS );
+  }
+
+  LOGPRINT( LVL_WARN, "readCastStats(): Could not parse %s. Using defaults.",
+            statsFileName );
+  fclose( statsFile );
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   writeCastStats - Save the learned cast statistics.
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   int writeCastStats( struct castStats *stats );
+//
+// DESCRIPTION
+//   Write the cast statistics to opts.dataDirName/CASTSTATSFILE.
+//
+// RETURNS
+//    1 Upon Success
+//   -1 Upon failure
+//
+int writeCastStats ( struct castStats *stats )
+{
+  FILE *statsFile;
+  char statsFileName[FILEPATHMAX + sizeof( CASTSTATSFILE )];
+
+  snprintf( statsFileName, sizeof( statsFileName ),
+            "%s/%s", opts.dataDirName, CASTSTATSFILE );
+  if ( ( statsFile = fopen( statsFileName, "w+" ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "writeCastStats(): Could not open %s for writing!",
+              statsFileName );
+    return( FAILURE );
+  }
+  fprintf( statsFile, "%lf %lf %lf %ld\n", stats->winchSpeed,
+           stats->downloadRate, stats->dataRate, stats->numCasts );
+  fclose( statsFile );
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   updateCastStats - Learn from a completed cast.
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   int updateCastStats( struct castStats *stats, struct mission *missn,
+//                        long castSecs, long sampleSecs,
+//                        long downloadBytes, long downloadSecs );
+//
+// DESCRIPTION
+//   Fold the timings of a completed cast into the running
+//   statistics and save them.  castSecs is the time the CTD
+//   spent logging, sampleSecs the time from the start of
+//   sampling ( after the warm up ) until the package was
+//   parked again and downloadBytes/downloadSecs describe the
+//   CTD upload.  The winch speed is derived by removing the
+//   equilibration stops from sampleSecs and dividing the
+//   mission's travel distance by what remains.  Observations
+//   which are zero or negative are ignored.
+//
+// RETURNS
+//    1 Upon Success
+//   -1 Upon failure
+//
+int updateCastStats ( struct castStats *stats, struct mission *missn,
+                      long castSecs, long sampleSecs,
+                      long downloadBytes, long downloadSecs )
+{
+  int travel, stops;
+  long winchSecs;
+
+  getMissionTravel( missn, &travel, &stops );
+  winchSecs = sampleSecs -
+              ( stops * ( missn->equilibrationTime + PLAN_STOP_OVERHEAD ) );
+
+  stats->numCasts++;
+  if ( travel > 0 && winchSecs > 0 )
+    stats->winchSpeed = foldStat( stats->winchSpeed,
+                                  (double)travel / winchSecs,
+                                  stats->numCasts );
+  if ( downloadBytes > 0 && downloadSecs > 0 )
+    stats->downloadRate = foldStat( stats->downloadRate,
+                                    (double)downloadBytes / downloadSecs,
+                                    stats->numCasts );
+  if ( downloadBytes > 0 && castSecs > 0 )
+    stats->dataRate = foldStat( stats->dataRate,
+                                (double)downloadBytes / castSecs,
+                                stats->numCasts );
+
+  LOGPRINT( LVL_INFO, "updateCastStats(): winch speed = %.3f m/s, "
+            "download rate = %.1f bytes/s, data rate = %.1f bytes/s "
+            "( %ld casts )", stats->winchSpeed, stats->downloadRate,
+            stats->dataRate, stats->numCasts );
+
+  return( writeCastStats( stats ) );
+}
+
+
+//
+// NAME
+//   getMissionTravel - Compute the winch travel for a mission.
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   void getMissionTravel( struct mission *missn, int *travel,
+//                          int *stops );
+//
+// DESCRIPTION
+//   Walk through the same sequence of moves that profile()
+//   makes for the mission and total up the distance travelled
+//   ( meters ) and the number of equilibration stops made.
+//
+// RETURNS
+//   Nothing.  Results are stored in travel and stops.
+//
+void getMissionTravel ( struct mission *missn, int *travel, int *stops )
+{
+  float cycles = missn->cycles;
+  int depth = opts.parkingDepth;
+  int tgtDepth;
+
+  *travel = 0;
+  *stops = 0;
+
+  if ( cycles <= 0 )
+    return;
+
+  // Up discretely to the minimum depth and equilibrate
+  *travel += abs( depth - opts.minDepth );
+  *stops += countDiscreteStops( missn, opts.minDepth, depth ) + 1;
+  depth = opts.minDepth;
+  cycles -= 0.25;
+
+  while ( cycles > 0 )
+  {
+    // Down to the maximum or parking depth and equilibrate
+    if ( cycles > 0.5 )
+      tgtDepth = opts.maxDepth;
+    else
+      tgtDepth = opts.parkingDepth;
+    *travel += abs( tgtDepth - depth );
+    *stops += 1;
+    depth = tgtDepth;
+    if ( cycles > 0.5 )
+      cycles -= 0.5;
+    else
+      cycles -= 0.25;
+
+    // Up discretely to the minimum or parking depth
+    if ( cycles > 0 )
+    {
+      if ( cycles > 0.25 )
+        tgtDepth = opts.minDepth;
+      else
+        tgtDepth = opts.parkingDepth;
+      *travel += abs( depth - tgtDepth );
+      *stops += countDiscreteStops( missn, tgtDepth, depth );
+      depth = tgtDepth;
+      if ( cycles > 0.25 )
+        cycles -= 0.5;
+      else
+        cycles -= 0.25;
+    }
+  }
+}
+
+
+//
+// NAME
+//   estimateMissionDuration - Predict how long a mission will take.
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   long estimateMissionDuration( struct mission *missn,
+//                                 struct castStats *stats );
+//
+// DESCRIPTION
+//   Estimate the time from powering up the hydrowire until
+//   the mission's data has been downloaded.  This includes
+//   the lead and warm up times, the winch travel at the
+//   learned winch speed, the equilibration stops and the
+//   CTD upload at the learned download rate.
+//
+// RETURNS
+//   The estimated duration in seconds.
+//
+long estimateMissionDuration ( struct mission *missn,
+                               struct castStats *stats )
+{
+  int travel, stops;
+  double sampleSecs, downloadSecs;
+
+  getMissionTravel( missn, &travel, &stops );
+
+  sampleSecs = ( travel / stats->winchSpeed ) +
+               ( stops * ( missn->equilibrationTime + PLAN_STOP_OVERHEAD ) );
+  downloadSecs = ( stats->dataRate * ( missn->warmupTime + sampleSecs ) ) /
+                 stats->downloadRate;
+
+  return( (long)( missn->leadTime + missn->warmupTime + sampleSecs +
+                  downloadSecs + PLAN_MISSION_OVERHEAD + 0.5 ) );
+}
+
+
+//
+// NAME
+//   isMissionStartTime - Is a mission scheduled for a given minute?
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   int isMissionStartTime( struct mission *missn, time_t t );
+//
+// DESCRIPTION
+//   Check the mission's cron style schedule against the
+//   local time t.
+//
+// RETURNS
+//   1 if the mission is scheduled to start at t, 0 otherwise.
+//
+int isMissionStartTime ( struct mission *missn, time_t t )
+{
+  struct tm *tp = localtime( &t );
+
+  if (    missn->startMinsList[ tp->tm_min ]
+       && missn->startHoursList[ tp->tm_hour ]
+       && (    missn->startDaysOfMonthList[ tp->tm_mday ]
+            || missn->startDaysOfWeekList[ tp->tm_wday ] )
+       && missn->startMonthsList[ tp->tm_mon ] )
+    return( 1 );
+
+  return( 0 );
+}
+
+
+//
+// Walk the schedule from "from" to "until" the same way
+// orcad would run it.  Missions which would still be busy
+// when the next one needs to power up are counted as
+// overlaps.  If fd is not NULL a timeline is printed to it.
+// If logOverlaps is set the first PLAN_MAX_OVERLAP_WARNINGS
+// overlaps are logged.
+//
+static int walkSchedule ( struct mission *missions, struct castStats *stats,
+                          time_t from, time_t until, FILE *fd,
+                          int logOverlaps )
+{
+  struct mission *mptr;
+  time_t t, powerUp, start, finish;
+  time_t busyUntil = 0;
+  char *busyName = NULL;
+  long duration;
+  int overlaps = 0;
+  char startStr[20], powerStr[10], finishStr[10];
+
+  for ( t = from - ( from % 60 ) + 60; t <= until; t += 60 )
+  {
+    mptr = missions;
+    while ( mptr != NULL )
+    {
+      if ( isMissionStartTime( mptr, t ) )
+      {
+        duration = estimateMissionDuration( mptr, stats );
+        powerUp = t - mptr->leadTime - mptr->warmupTime;
+        start = t;
+        if ( powerUp < busyUntil )
+        {
+          overlaps++;
+          if ( logOverlaps && overlaps <= PLAN_MAX_OVERLAP_WARNINGS )
+          {
+            strftime( startStr, sizeof( startStr ), "%Y/%m/%d %H:%M",
+                      localtime( &t ) );
+            LOGPRINT( LVL_WARN, "checkScheduleOverlaps(): Mission %s "
+                      "scheduled for %s overlaps mission %s and will be "
+                      "delayed %ld minutes", mptr->name, startStr,
+                      busyName, ( busyUntil - powerUp + 59 ) / 60 );
+          }
+          start += busyUntil - powerUp;
+          powerUp = busyUntil;
+        }
+        finish = powerUp + duration;
+
+        if ( fd != NULL )
+        {
+          strftime( startStr, sizeof( startStr ), "%Y/%m/%d %H:%M",
+                    localtime( &t ) );
+          strftime( powerStr, sizeof( powerStr ), "%H:%M:%S",
+                    localtime( &powerUp ) );
+          strftime( finishStr, sizeof( finishStr ), "%H:%M:%S",
+                    localtime( &finish ) );
+          fprintf( fd, "  %s  %-20s  power %s  done %s  %5.1f min",
+                   startStr, mptr->name, powerStr, finishStr,
+                   duration / 60.0 );
+          if ( start != t )
+            fprintf( fd, "  OVERLAP ( starts %ld min late )",
+                     ( start - t + 59 ) / 60 );
+          fprintf( fd, "\n" );
+        }
+
+        busyUntil = finish;
+        busyName = mptr->name;
+      }
+      mptr = mptr->nextMission;
+    }
+  }
+  return( overlaps );
+}
+
+
+//
+// NAME
+//   checkScheduleOverlaps - Warn about missions which will pile up.
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   int checkScheduleOverlaps( struct mission *missions,
+//                              struct castStats *stats, time_t from );
+//
+// DESCRIPTION
+//   Walk the mission schedule for PLAN_OVERLAP_HORIZON minutes
+//   starting at "from" using the estimated mission durations.
+//   A warning is logged for the first few mission runs which
+//   would have to wait for a previous one to finish followed by
+//   a count of all of them.
+//
+// RETURNS
+//   The number of overlapping mission runs found.
+//
+int checkScheduleOverlaps ( struct mission *missions,
+                            struct castStats *stats, time_t from )
+{
+  int overlaps;
+
+  overlaps = walkSchedule( missions, stats, from,
+                           from + ( PLAN_OVERLAP_HORIZON * 60 ), NULL, 1 );
+  if ( overlaps > 0 )
+    LOGPRINT( LVL_WARN, "checkScheduleOverlaps(): %d mission runs overlap "
+              "in the next %d days!", overlaps,
+              PLAN_OVERLAP_HORIZON / 1440 );
+  return( overlaps );
+}
+
+
+//
+// NAME
+//   printMissionTimeline - Print the projected mission timeline.
+//
+// SYNOPSIS
+//   #include "planner.h"
+//
+//   int printMissionTimeline( FILE *fd, struct mission *missions,
+//                             struct castStats *stats, time_t from,
+//                             time_t until );
+//
+// DESCRIPTION
+//   Print each scheduled mission run between "from" and
+//   "until" along with the time the hydrowire is powered
+//   up, the projected completion time and any delay caused
+//   by a previous mission still running.
+//
+// RETURNS
+//   The number of overlapping mission runs found.
+//
+int printMissionTimeline ( FILE *fd, struct mission *missions,
+                           struct castStats *stats, time_t from,
+                           time_t until )
+{
+  struct mission *mptr;
+  int travel, stops;
+  int overlaps;
+
+  fprintf( fd, "MISSION ESTIMATES\n" );
+  fprintf( fd, "-----------------\n" );
+  fprintf( fd, "  winch speed = %.3f m/s, download rate = %.1f bytes/s, "
+           "data rate = %.1f bytes/s ( learned from %ld casts )\n\n",
+           stats->winchSpeed, stats->downloadRate, stats->dataRate,
+           stats->numCasts );
+  mptr = missions;
+  while ( mptr != NULL )
+  {
+    getMissionTravel( mptr, &travel, &stops );
+    fprintf( fd, "  %-20s  travel %4d m  stops %2d  duration %5.1f min\n",
+             mptr->name, travel, stops,
+             estimateMissionDuration( mptr, stats ) / 60.0 );
+    mptr = mptr->nextMission;
+  }
+
+  fprintf( fd, "\nTIMELINE\n" );
+  fprintf( fd, "--------\n" );
+  overlaps = walkSchedule( missions, stats, from, until, fd, 0 );
+  if ( overlaps > 0 )
+    fprintf( fd, "\n  %d mission runs overlap!\n", overlaps );
+  fflush( fd );
+  return( overlaps );
+}
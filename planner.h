@@ -0,0 +1,68 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * planner.h : Header for the mission duration planner
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ */
+#ifndef _PLANNER_H
+#define _PLANNER_H
+
+// File ( in opts.dataDirName ) holding the learned cast statistics
+#define CASTSTATSFILE "castStats.txt"
+
+// Starting guesses used until we have learned from a few casts
+#define DEFAULT_WINCH_SPEED    0.30   // meters/second
+#define DEFAULT_DOWNLOAD_RATE  100.0  // bytes/second for the CTD upload
+#define DEFAULT_DATA_RATE      25.0   // bytes logged per second of cast
+
+// Number of casts after which new casts are weighted equally
+#define CASTSTATS_WINDOW 8
+
+// Fixed time costs ( seconds ) which are not learned
+#define PLAN_STOP_OVERHEAD     5    // status reads at each stop
+#define PLAN_MISSION_OVERHEAD  30   // file setup, time sync etc.
+
+// How far ahead to look for overlapping missions ( minutes )
+#define PLAN_OVERLAP_HORIZON   (7 * 1440)
+
+// Only log this many individual overlaps
+#define PLAN_MAX_OVERLAP_WARNINGS 5
+
+struct castStats {
+  double winchSpeed;    // meters/second while the winch is running
+  double downloadRate;  // bytes/second while uploading from the CTD
+  double dataRate;      // bytes logged by the CTD per second of cast
+  long numCasts;        // number of casts folded into the averages
+};
+
+int readCastStats( struct castStats *stats );
+int writeCastStats( struct castStats *stats );
+int updateCastStats( struct castStats *stats, struct mission *missn,
+                     long castSecs, long sampleSecs,
+                     long downloadBytes, long downloadSecs );
+void getMissionTravel( struct mission *missn, int *travel, int *stops );
+long estimateMissionDuration( struct mission *missn,
+                              struct castStats *stats );
+int isMissionStartTime( struct mission *missn, time_t t );
+int checkScheduleOverlaps( struct mission *missions,
+                           struct castStats *stats, time_t from );
+int printMissionTimeline( FILE *fd, struct mission *missions,
+                          struct castStats *stats, time_t from,
+                          time_t until );
+
+#endif
@@ -41,11 +41,87 @@
 #include "winch.h"
 #include "profile.h"
 #include "aquadopp.h"
+#include "ctdstream.h"
+#include "readingbus.h"
 
 // TANK TESTING CHIMERAS
 //#define movePackageUpDiscretely(a,b,c,d,e,f,g) sleep( 155 )
 //#define movePackageDown(a,b,c,d) sleep( 310 )
 
+// 
+// NAME
+//  publishPackageStatus - Share the package status readings.
+//
+// SYNOPSIS
+//   #include "profile.h"
+//
+//   void publishPackageStatus( double pressure, double pressureDepth,
+//                              float meterWheelDepth, float intbatt,
+//                              float extbatt );
+//
+// DESCRIPTION
+//   Publish the values of a "pres= prdp= ..." status line to
+//   the readings table along with the state of the power
+//   relays ( RELAY_* bits ).  Failed ( negative ) readings 
+//   are not published.
+//
+void publishPackageStatus( double pressure, double pressureDepth,
+                           float meterWheelDepth, float intbatt,
+                           float extbatt )
+{
+  if ( pressure >= 0 )
+  {
+    publishReading( BUS_PRESSURE, pressure );
+    publishReading( BUS_DEPTH, pressureDepth );
+  }
+  if ( meterWheelDepth >= 0 )
+    publishReading( BUS_METERWHEEL, meterWheelDepth );
+  if ( intbatt >= 0 )
+    publishReading( BUS_INTBATTERY, intbatt );
+  if ( extbatt >= 0 )
+    publishReading( BUS_EXTBATTERY, extbatt );
+
+  if ( readingBus == NULL )
+    return;
+  publishReading( BUS_RELAYS, getRelayStatus() );
+}
+
+
+// 
+// NAME
+//  getRelayStatus - Read the state of the power relays.
+//
+// SYNOPSIS
+//   #include "profile.h"
+//
+//   int getRelayStatus( void );
+//
+// DESCRIPTION
+//   Query each power relay on the I/O board.  This talks to
+//   the board once per relay so it must not be called from
+//   the winch's critical loops.
+//
+// RETURNS
+//   The RELAY_* bits of the relays which are on.
+//
+int getRelayStatus( void )
+{
+  int relays = 0;
+
+  if ( WINCH_PWR_STATUS > 0 )
+    relays |= RELAY_WINCH;
+  if ( WINCH_DIR_STATUS > 0 )
+    relays |= RELAY_WINCHUP;
+  if ( HYDRO_STATUS > 0 )
+    relays |= RELAY_HYDRO;
+  if ( WEATHER_STATUS > 0 )
+    relays |= RELAY_WEATHER;
+  if ( METER_STATUS > 0 )
+    relays |= RELAY_METER;
+  return( relays );
+}
+
+
 // 
 // NAME
 //  profile - Run a profile mission.
@@ -243,6 +319,8 @@ int profile ( struct mission *missn )
             "profile(): pres=%6.2fdb prdp=%6.2fm mwdp=%6.1f "
             "ipwr=%4.1fv epwr=%4.1fv", pressure, pressureDepth,
             meterWheelDepth, intbatt, extbatt );
+  publishPackageStatus( pressure, pressureDepth, meterWheelDepth,
+                        intbatt, extbatt );
 
   // Check that CTD is within 5 db of parking pressure 
   if ( fabs( pressureDepth - opts.parkingDepth) > 5.0 ) 
@@ -252,13 +330,23 @@ int profile ( struct mission *missn )
   }
   
   //
-  // WAIT FOR 2 MINUTES FOR OXYGEN SENSOR TO WARM UP
+  // WAIT FOR THE OXYGEN SENSOR TO WARM UP
+  //   If the mission was pre-warmed by the scheduler only wait out
+  //   what remains until the scheduled start.  Otherwise ( i.e run
+  //   from orcactrl ) wait the full warm up time.
   //
-  sleepSec = 120;
+  sleepSec = missn->warmupTime;
+  if ( missn->scheduledStart > 0 )
+  {
+    if ( missn->scheduledStart <= time( NULL ) )
+      sleepSec = 0;
+    else if ( missn->scheduledStart - time( NULL ) < missn->warmupTime )
+      sleepSec = missn->scheduledStart - time( NULL );
+  }
   LOGPRINT( LVL_INFO, 
       "profile(): Sleeping for %d seconds while the oxygen sensor warms up.", 
       sleepSec );
-  while ( ( sleepSec = sleep( sleepSec ) ) > 0 ) { /* nothing */ }
+  sleepCTDStream( hydroFD, sleepSec );
 
 
   // 
@@ -319,6 +407,8 @@ int profile ( struct mission *missn )
               "profile(): pres=%6.2fdb prdp=%6.2fm mwdp=%6.1f "
               "ipwr=%4.1fv epwr=%4.1fv", pressure, pressureDepth,
               meterWheelDepth, intbatt, extbatt );
+    publishPackageStatus( pressure, pressureDepth, meterWheelDepth,
+                          intbatt, extbatt );
 
     // 
     // Stop the auxilary sampling if need be
@@ -341,7 +431,7 @@ int profile ( struct mission *missn )
     LOGPRINT( LVL_INFO,
               "profile(): Sleeping for %d seconds sensor equilibrate.", 
               sleepSec );
-    while ( ( sleepSec = sleep( sleepSec ) ) > 0 ) { /*nothing*/ }
+    sleepCTDStream( hydroFD, sleepSec );
 
     //
     // Check winch voltage
@@ -428,6 +518,8 @@ int profile ( struct mission *missn )
                 "profile(): pres=%6.2fdb prdp=%6.2fm mwdp=%6.1f "
                 "ipwr=%4.1fv epwr=%4.1fv", pressure, pressureDepth,
                 meterWheelDepth, intbatt, extbatt );
+      publishPackageStatus( pressure, pressureDepth, meterWheelDepth,
+                            intbatt, extbatt );
 
       // 
       // Stop the auxilary sampling if need be
@@ -450,7 +542,7 @@ int profile ( struct mission *missn )
       LOGPRINT( LVL_INFO,
                 "profile(): Sleeping for %d seconds sensor equilibrate.", 
                 sleepSec );
-      while ( ( sleepSec = sleep( sleepSec ) ) > 0 ) { /*nothing*/ }
+      sleepCTDStream( hydroFD, sleepSec );
 
       //
       // Check winch voltage
@@ -538,6 +630,8 @@ int profile ( struct mission *missn )
                   "profile(): pres=%6.2fdb prdp=%6.2fm mwdp=%6.1f "
                   "ipwr=%4.1fv epwr=%4.1fv", pressure, pressureDepth,
                   meterWheelDepth, intbatt, extbatt );
+        publishPackageStatus( pressure, pressureDepth, meterWheelDepth,
+                              intbatt, extbatt );
 
         // Decrement cycles if we were successful
         if ( cycles > 0.25 ) 
@@ -34,5 +34,9 @@
 #define EPROF -3  // Return value for errors during profiling
 
 int profile( struct mission *missn );
+void publishPackageStatus( double pressure, double pressureDepth,
+                           float meterWheelDepth, float intbatt,
+                           float extbatt );
+int getRelayStatus( void );
 
 #endif
@@ -0,0 +1,480 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * readingbus.c : Shared latest readings table
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  orcad, weatherd and auxiliaryd publish every reading they
+ *  take into a System V shared memory segment ( key 
+ *  READINGBUS_KEY ) holding a struct readingBus.  Each sensor
+ *  channel keeps its newest READINGBUS_RINGLEN samples.  Any
+ *  process may attach read-only ( e.g. orcactrl's "view 
+ *  readings" ) and get the current conditions without file
+ *  I/O or talking to the instruments.
+ *
+ *  Each channel is written by a single daemon and guarded by
+ *  a sequence lock: the publisher makes seq odd, updates the
+ *  samples and makes it even again.  Readers copy the channel
+ *  and retry if seq was odd or changed under them, so they
+ *  never block the publisher.
+ *
+ *  The segment is created ( and its channel names filled in )
+ *  by the first daemon to start and outlives the daemons, so
+ *  the last readings remain available after a restart.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include "general.h"
+#include "log.h"
+#include "readingbus.h"
+
+// Attempts at a consistent copy before giving up on a channel
+#define READINGBUS_RETRIES 1000
+
+struct readingBus *readingBus = NULL;
+static int busWritable = 0;
+
+// Channel descriptions, in enum busChannels order
+static const struct {
+  const char *name;
+  const char *units;
+  const char *source;
+} busChannelInfo[NUMBUSCHANNELS] = {
+  { "barometer", "inHg", "met" },
+  { "humidity", "%", "met" },
+  { "airTemperature", "C", "met" },
+  { "dewPoint", "C", "met" },
+  { "windSpeed", "knots", "met" },
+  { "windDirection", "degrees", "met" },
+  { "windCenterline", "degrees", "met" },
+  { "compassDir", "degrees", "met" },
+  { "PAR", "umol/m2/s", "met" },
+  { "solarRadiation", "W/m2", "met" },
+  { "pHInternal", "pH", "auxiliaryd" },
+  { "pHExternal", "pH", "auxiliaryd" },
+  { "seafetTemperature", "C", "auxiliaryd" },
+  { "seafetSupply", "V", "auxiliaryd" },
+  { "pressure", "db", "orcad" },
+  { "depth", "m", "orcad" },
+  { "meterWheel", "m", "orcad" },
+  { "internalBattery", "V", "orcad" },
+  { "externalBattery", "V", "orcad" },
+  { "relays", "bits", "orcad" }
+};
+
+
+//
+// NAME
+//   initReadingBus - Fill in a new segment
+//
+static void initReadingBus( struct readingBus *bus )
+{
+  int i;
+
+  memset( bus, 0, sizeof( struct readingBus ) );
+  bus->version = READINGBUS_VERSION;
+  bus->numChannels = NUMBUSCHANNELS;
+  bus->ringLen = READINGBUS_RINGLEN;
+  for ( i = 0; i < NUMBUSCHANNELS; i++ )
+  {
+    strncpy( bus->channel[i].name, busChannelInfo[i].name,
+             READINGBUS_NAMELEN - 1 );
+    strncpy( bus->channel[i].units, busChannelInfo[i].units,
+             READINGBUS_UNITSLEN - 1 );
+    strncpy( bus->channel[i].source, busChannelInfo[i].source,
+             READINGBUS_SRCLEN - 1 );
+  }
+  // The magic number is set last so readers only see a
+  // complete table
+  __sync_synchronize();
+  bus->magic = READINGBUS_MAGIC;
+}
+
+
+// 
+// NAME
+//   attachReadingBus - Attach to the shared readings table.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   int attachReadingBus( int writable );
+//
+// DESCRIPTION
+//   Map the readings segment into this process and point
+//   the global readingBus at it.  Publishers ( writable = 1 )
+//   create the segment if it does not exist, or replace one
+//   left by an incompatible version of orcaD.  Readers 
+//   ( writable = 0 ) attach read-only and fail if no daemon
+//   has created the segment yet.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int attachReadingBus( int writable )
+{
+  struct readingBus *bus;
+  struct shmid_ds info;
+  int shmID;
+  int created = 0;
+  int i;
+
+  if ( readingBus != NULL )
+    return( SUCCESS );
+
+  if ( writable )
+  {
+    shmID = shmget( READINGBUS_KEY, sizeof( struct readingBus ),
+                    IPC_CREAT | IPC_EXCL | 0644 );
+    if ( shmID >= 0 )
+      created = 1;
+    else if ( errno == EEXIST &&
+              ( shmID = shmget( READINGBUS_KEY, 0, 0 ) ) >= 0 &&
+              shmctl( shmID, IPC_STAT, &info ) == 0 &&
+              info.shm_segsz != sizeof( struct readingBus ) )
+    {
+      // Left behind by a different layout
+      LOGPRINT( LVL_NOTC, "attachReadingBus(): Replacing an old readings "
+                          "segment" );
+      shmctl( shmID, IPC_RMID, NULL );
+      if ( ( shmID = shmget( READINGBUS_KEY, sizeof( struct readingBus ),
+                             IPC_CREAT | IPC_EXCL | 0644 ) ) >= 0 )
+        created = 1;
+    }
+  }else
+    shmID = shmget( READINGBUS_KEY, 0, 0 );
+
+  if ( shmID < 0 )
+  {
+    LOGPRINT( writable ? LVL_WARN : LVL_INFO, 
+              "attachReadingBus(): Could not get the readings segment: %s",
+              strerror( errno ) );
+    return( FAILURE );
+  }
+
+  bus = (struct readingBus *)shmat( shmID, NULL, writable ? 0 : SHM_RDONLY );
+  if ( bus == (void *)-1 )
+  {
+    LOGPRINT( LVL_WARN, "attachReadingBus(): Could not attach the readings "
+                        "segment: %s", strerror( errno ) );
+    return( FAILURE );
+  }
+
+  if ( created )
+    initReadingBus( bus );
+  else
+  {
+    // Give a daemon which is creating it a moment to finish
+    for ( i = 0; i < 10 && bus->magic != READINGBUS_MAGIC; i++ )
+      usleep( 100000 );
+    if ( bus->magic != READINGBUS_MAGIC || 
+         bus->version != READINGBUS_VERSION ||
+         bus->numChannels != NUMBUSCHANNELS )
+    {
+      if ( ! writable )
+      {
+        LOGPRINT( LVL_WARN, "attachReadingBus(): The readings segment is "
+                            "not from this version of orcaD" );
+        shmdt( bus );
+        return( FAILURE );
+      }
+      initReadingBus( bus );
+    }
+  }
+
+  readingBus = bus;
+  busWritable = writable;
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   detachReadingBus - Detach from the shared readings table.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   void detachReadingBus( void );
+//
+// DESCRIPTION
+//   Unmap the segment.  The segment itself ( and the last 
+//   readings ) remain for other processes.
+//
+void detachReadingBus( void )
+{
+  if ( readingBus == NULL )
+    return;
+  shmdt( readingBus );
+  readingBus = NULL;
+  busWritable = 0;
+}
+
+
+// 
+// NAME
+//   publishReading - Store a new reading.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   void publishReading( int channel, float value );
+//
+// DESCRIPTION
+//   Add value, stamped with the current time, to the 
+//   channel's samples.  Does nothing if this process is not
+//   attached as a publisher, so shared code may call it
+//   from any program.
+//
+void publishReading( int channel, float value )
+{
+  struct busChannel *chan;
+  struct busSample *sample;
+  struct timeval now;
+
+  if ( readingBus == NULL || ! busWritable || 
+       channel < 0 || channel >= NUMBUSCHANNELS )
+    return;
+
+  gettimeofday( &now, NULL );
+  chan = &(readingBus->channel[channel]);
+  sample = &(chan->ring[chan->numSamples % READINGBUS_RINGLEN]);
+
+  chan->seq++;
+  __sync_synchronize();
+  sample->time = now.tv_sec + now.tv_usec / 1000000.0;
+  sample->value = value;
+  chan->numSamples++;
+  __sync_synchronize();
+  chan->seq++;
+}
+
+
+//
+// NAME
+//   copyBusChannel - Take a consistent copy of a channel
+//
+// RETURNS
+//   -1 if the channel kept changing ( or is mid update from
+//   a publisher which died ), 1 otherwise.
+//
+static int copyBusChannel( int channel, struct busChannel *copy )
+{
+  struct busChannel *chan = &(readingBus->channel[channel]);
+  uint32_t seq;
+  int i;
+
+  for ( i = 0; i < READINGBUS_RETRIES; i++ )
+  {
+    seq = chan->seq;
+    if ( seq & 1 )
+      continue;
+    __sync_synchronize();
+    memcpy( copy, (const void *)chan, sizeof( struct busChannel ) );
+    __sync_synchronize();
+    if ( chan->seq == seq )
+      return( SUCCESS );
+  }
+  return( FAILURE );
+}
+
+
+// 
+// NAME
+//   getLatestReading - Get a channel's newest reading.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   int getLatestReading( int channel, struct busSample *sample );
+//
+// RETURNS
+//   -1 : No reading is available ( or not attached )
+//    1 : Success
+//
+int getLatestReading( int channel, struct busSample *sample )
+{
+  struct busChannel copy;
+
+  if ( readingBus == NULL || channel < 0 || channel >= NUMBUSCHANNELS ||
+       copyBusChannel( channel, &copy ) < 0 || copy.numSamples == 0 )
+    return( FAILURE );
+
+  *sample = copy.ring[( copy.numSamples - 1 ) % READINGBUS_RINGLEN];
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   getRecentReadings - Get a channel's recent readings.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   int getRecentReadings( int channel, struct busSample *samples,
+//                          int maxSamples );
+//
+// DESCRIPTION
+//   Copy up to maxSamples ( at most READINGBUS_RINGLEN ) of
+//   the newest readings into samples, oldest first.
+//
+// RETURNS
+//   The number of samples copied, or -1 on failure.
+//
+int getRecentReadings( int channel, struct busSample *samples, 
+                       int maxSamples )
+{
+  struct busChannel copy;
+  uint32_t first;
+  int num;
+  int i;
+
+  if ( readingBus == NULL || channel < 0 || channel >= NUMBUSCHANNELS ||
+       copyBusChannel( channel, &copy ) < 0 )
+    return( FAILURE );
+
+  num = copy.numSamples < READINGBUS_RINGLEN ? copy.numSamples : 
+                                               READINGBUS_RINGLEN;
+  if ( num > maxSamples )
+    num = maxSamples;
+  first = copy.numSamples - num;
+  for ( i = 0; i < num; i++ )
+    samples[i] = copy.ring[( first + i ) % READINGBUS_RINGLEN];
+  return( num );
+}
+
+
+// 
+// NAME
+//   getNewReadings - Get a channel's readings since the last call.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   int getNewReadings( int channel, uint32_t *numSeen,
+//                       struct busSample *samples, int maxSamples );
+//
+// DESCRIPTION
+//   For following a channel as it is published.  *numSeen
+//   is the channel's sample count at the previous call; the
+//   readings published since then are copied into samples, 
+//   oldest first, and *numSeen is advanced.  Call it first
+//   with maxSamples = 0 to start from the current reading.
+//   If more than READINGBUS_RINGLEN ( or maxSamples ) readings
+//   arrived between calls only the newest are returned.  The
+//   number skipped is the advance of *numSeen less the 
+//   number returned.
+//
+// RETURNS
+//   The number of samples copied, or -1 on failure.
+//
+int getNewReadings( int channel, uint32_t *numSeen, 
+                    struct busSample *samples, int maxSamples )
+{
+  struct busChannel copy;
+  uint32_t num;
+  uint32_t first;
+  uint32_t i;
+
+  if ( readingBus == NULL || channel < 0 || channel >= NUMBUSCHANNELS ||
+       copyBusChannel( channel, &copy ) < 0 )
+    return( FAILURE );
+
+  // The channel was reset under us ( e.g. a new segment )
+  if ( copy.numSamples < *numSeen )
+    *numSeen = 0;
+
+  num = copy.numSamples - *numSeen;
+  if ( num > READINGBUS_RINGLEN )
+    num = READINGBUS_RINGLEN;
+  if ( maxSamples < 0 || num > (uint32_t)maxSamples )
+    num = maxSamples < 0 ? 0 : maxSamples;
+  first = copy.numSamples - num;
+  for ( i = 0; i < num; i++ )
+    samples[i] = copy.ring[( first + i ) % READINGBUS_RINGLEN];
+  *numSeen = copy.numSamples;
+  return( num );
+}
+
+
+// 
+// NAME
+//   findBusChannel - Look up a channel by name.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   int findBusChannel( const char *name );
+//
+// RETURNS
+//   The channel number or -1 if there is no such channel.
+//
+int findBusChannel( const char *name )
+{
+  int i;
+
+  for ( i = 0; i < NUMBUSCHANNELS; i++ )
+    if ( strcasecmp( name, busChannelInfo[i].name ) == 0 )
+      return( i );
+  return( FAILURE );
+}
+
+
+// 
+// NAME
+//   printReadings - List the latest reading of every channel.
+//
+// SYNOPSIS
+//   #include "readingbus.h"
+//
+//   void printReadings( FILE *fp );
+//
+// DESCRIPTION
+//   Write one "name = value units ( age )" line per channel
+//   in the style of weather-status.dat.  Channels which have
+//   never been published are skipped and readings older than
+//   READINGBUS_STALE seconds are marked as stale.
+//
+void printReadings( FILE *fp )
+{
+  struct busSample sample;
+  struct timeval now;
+  double age;
+  int i;
+
+  gettimeofday( &now, NULL );
+  for ( i = 0; i < NUMBUSCHANNELS; i++ )
+  {
+    if ( getLatestReading( i, &sample ) < 0 )
+      continue;
+    age = now.tv_sec + now.tv_usec / 1000000.0 - sample.time;
+    fprintf( fp, "%s = %.3f %s ( %.0f secs ago%s )\n", busChannelInfo[i].name,
+             sample.value, busChannelInfo[i].units, age, 
+             age > READINGBUS_STALE ? ", stale" : "" );
+  }
+}
@@ -0,0 +1,110 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * readingbus.h : Header for the shared latest readings table
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  See readingbus.c
+ *
+ */
+#ifndef _READINGBUS_H
+#define _READINGBUS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define READINGBUS_KEY      0x4f524342    // "ORCB"
+#define READINGBUS_MAGIC    0x5244474f
+#define READINGBUS_VERSION  2
+#define READINGBUS_RINGLEN  32
+#define READINGBUS_NAMELEN  24
+#define READINGBUS_UNITSLEN 12
+#define READINGBUS_SRCLEN   12
+
+// Readings are considered stale after this many seconds
+// without an update ( see printReadings() ).
+#define READINGBUS_STALE    900
+
+//
+// Every channel has exactly one publishing daemon.
+//
+enum busChannels {
+  // weatherd ( or orcad with a Davis station )
+  BUS_BAROMETER, BUS_HUMIDITY, BUS_AIRTEMP, BUS_DEWPOINT, BUS_WINDSPEED,
+  BUS_WINDDIRECTION, BUS_WINDCENTERLINE, BUS_COMPASS, BUS_PAR,
+  BUS_SOLARRAD,
+  // auxiliaryd
+  BUS_PHINT, BUS_PHEXT, BUS_SEAFETTEMP, BUS_SEAFETSUPPLY,
+  // orcad
+  BUS_PRESSURE, BUS_DEPTH, BUS_METERWHEEL, BUS_INTBATTERY, BUS_EXTBATTERY,
+  BUS_RELAYS,
+  NUMBUSCHANNELS
+};
+
+//
+// BUS_RELAYS bits
+//
+#define RELAY_WINCH    0x01
+#define RELAY_WINCHUP  0x02
+#define RELAY_HYDRO    0x04
+#define RELAY_WEATHER  0x08
+#define RELAY_METER    0x10
+
+struct busSample {
+  double time;        // secs since the epoch
+  float value;
+  uint32_t reserved;
+};
+
+//
+// busChannel
+//
+//   seq is the channel's sequence lock: odd while the
+//   publisher is updating it.  The newest sample is
+//   ring[( numSamples - 1 ) % READINGBUS_RINGLEN].
+//
+struct busChannel {
+  volatile uint32_t seq;
+  uint32_t numSamples;
+  char name[READINGBUS_NAMELEN];
+  char units[READINGBUS_UNITSLEN];
+  char source[READINGBUS_SRCLEN];
+  struct busSample ring[READINGBUS_RINGLEN];
+};
+
+struct readingBus {
+  volatile uint32_t magic;
+  uint32_t version;
+  uint32_t numChannels;
+  uint32_t ringLen;
+  struct busChannel channel[NUMBUSCHANNELS];
+};
+
+extern struct readingBus *readingBus;
+
+int attachReadingBus( int writable );
+void detachReadingBus( void );
+void publishReading( int channel, float value );
+int getLatestReading( int channel, struct busSample *sample );
+int getRecentReadings( int channel, struct busSample *samples, 
+                       int maxSamples );
+int getNewReadings( int channel, uint32_t *numSeen, 
+                    struct busSample *samples, int maxSamples );
+int findBusChannel( const char *name );
+void printReadings( FILE *fp );
+
+#endif
@@ -0,0 +1,413 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * seafet.c : Satlantic SeaFET pH sensor functions
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  The SeaFET is run in polled mode.  Any character wakes it
+ *  ( we send "!!!!!" ) and it then accepts the sample command
+ *  "s", which it echoes, for 5 seconds.  After sampling it
+ *  sends one full ASCII frame and goes back to sleep.
+ *
+ *  Example from the sensor:
+ *
+ *    SATPHA0217,2014317,23.2585735,6.53811,6.41548,18.8480,nan,nan,
+ *      nan,nan,-0.97828925,-0.93706161,0.90207696,0.000,19,3.9,4.850,
+ *      0.000,6.073,0.101,0,10,0.00000000,0x0000,172<CR><LF>
+ *
+ *  Columns ( AS = ASCII string, AF = ASCII float, AI = ASCII
+ *  integer, missing values are "nan" ):
+ *
+ *    HEADER     "SAT", the frame type ( PHA ) and the serial
+ *               number: AS 10
+ *    DATE       Sample date ( UTC ), YYYYDDD: AI 7
+ *    TIME       Sample time ( UTC ), decimal hours: AF 9-10
+ *    PH_INT     Internal pH ( total scale ): AF 7-8
+ *    PH_EXT     External pH ( total scale ): AF 7-8
+ *    TEMP       ISFET thermistor temperature ( C ): AF 6-8
+ *    TEMP_CTD   CTD temperature ( C ): AF 6-8
+ *    S_CTD      CTD salinity ( psu ): AF 6-7
+ *    O_CTD      CTD oxygen concentration ( ml/L ): AF 5-6
+ *    P_CTD      CTD pressure ( dbar ): AF 5-6
+ *    VRS_INT    Internal FET voltage ( V ): AF 10-11
+ *    VRS_EXT    External FET voltage ( V ): AF 10-11
+ *    V_THERM    Thermistor voltage ( V ): AF 10
+ *    V_SUPPLY   Supply voltage ( V ): AF 5-6
+ *    I_SUPPLY   Supply current ( mA ): AI
+ *    HUMIDITY   Enclosure relative humidity ( % ): AF 3-4
+ *    V_5V       Internal 5V supply voltage ( V ): AF 5
+ *    V_MBATT    Main battery pack voltage ( V ): AF 5-6
+ *    V_ISO      Internal isolated supply voltage ( V ): AF 5
+ *    V_ISOBATT  Isolated battery pack voltage ( V ): AF 5
+ *    I_B        Substrate leakage current ( nA ): AI
+ *    I_K        Counter electrode leakage current ( nA ): AI
+ *    V_K        Counter electrode voltage ( V ): AF 10-11
+ *    STATUS     Status word ( 16 bit hex bitmask ): AS 6
+ *    CHECKSUM   The byte sum of the frame up to and including
+ *               the comma before CHECKSUM, plus CHECKSUM, is
+ *               0 mod 256: AI 1-3
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <sys/time.h>
+#include "general.h"
+#include "log.h"
+#include "orcad.h"
+#include "serial.h"
+#include "term.h"
+#include "timer.h"
+#include "fieldparse.h"
+#include "seafet.h"
+
+//
+// The measurement columns ( PH_INT through V_K ) and where
+// they go in a struct seafetFrame.
+//
+#define SEAFET_FIRSTMEASUREMENT 3
+#define SF_FLOAT 0
+#define SF_INT   1
+
+static const struct {
+  size_t offset;
+  int type;
+} seafetColumns[SEAFET_NUMVALUES - 2] = {
+  { offsetof( struct seafetFrame, phInt ), SF_FLOAT },
+  { offsetof( struct seafetFrame, phExt ), SF_FLOAT },
+  { offsetof( struct seafetFrame, temp ), SF_FLOAT },
+  { offsetof( struct seafetFrame, tempCTD ), SF_FLOAT },
+  { offsetof( struct seafetFrame, salinityCTD ), SF_FLOAT },
+  { offsetof( struct seafetFrame, oxygenCTD ), SF_FLOAT },
+  { offsetof( struct seafetFrame, pressureCTD ), SF_FLOAT },
+  { offsetof( struct seafetFrame, vrsInt ), SF_FLOAT },
+  { offsetof( struct seafetFrame, vrsExt ), SF_FLOAT },
+  { offsetof( struct seafetFrame, vTherm ), SF_FLOAT },
+  { offsetof( struct seafetFrame, vSupply ), SF_FLOAT },
+  { offsetof( struct seafetFrame, iSupply ), SF_INT },
+  { offsetof( struct seafetFrame, humidity ), SF_FLOAT },
+  { offsetof( struct seafetFrame, v5V ), SF_FLOAT },
+  { offsetof( struct seafetFrame, vMainBatt ), SF_FLOAT },
+  { offsetof( struct seafetFrame, vIso ), SF_FLOAT },
+  { offsetof( struct seafetFrame, vIsoBatt ), SF_FLOAT },
+  { offsetof( struct seafetFrame, iB ), SF_INT },
+  { offsetof( struct seafetFrame, iK ), SF_INT },
+  { offsetof( struct seafetFrame, vK ), SF_FLOAT }
+};
+
+
+//
+// NAME
+//   waitForWakeUp - Wait for the SeaFET's wake up prompt
+//
+// DESCRIPTION
+//   Wait up to SEAFET_WAKE_TIMEOUT for the sensor to start
+//   talking and then for SEAFET_QUIET_TIMEOUT of silence
+//   after it.  The prompt itself is discarded.
+//
+// RETURNS
+//   1 If the prompt was seen
+//  -1 If the sensor said nothing
+//
+static int waitForWakeUp( int fd )
+{
+  struct timeval startTime;
+  long timeout = SEAFET_WAKE_TIMEOUT;
+  int numBytes = 0;
+  char value;
+
+  gettimeofday( &startTime, NULL );
+  while ( serialGetByte( fd, &value, timeout ) == 1 )
+  {
+    numBytes++;
+    timeout = SEAFET_QUIET_TIMEOUT;
+    if ( getMilliSecSince( &startTime ) > SEAFET_WAKE_TIMEOUT )
+      break;
+  }
+  return( numBytes > 0 ? SUCCESS : FAILURE );
+}
+
+
+//
+// NAME
+//   sampleSeaFET - Take a sample with the SeaFET
+//
+// SYNOPSIS
+//   #include "seafet.h"
+//
+//   int sampleSeaFET( int fd, char *frameBuff,
+//                     struct seafetFrame *frame );
+//
+// DESCRIPTION
+//   Wake the sensor, send the sample command and read the
+//   frame it sends back.  frameBuff ( SEAFET_FRAMELEN bytes )
+//   receives the raw frame and frame its parsed values.
+//   Incomplete frames and frames with a bad checksum are
+//   logged and dropped.
+//
+// RETURNS
+//   The length of the frame or -1 upon failure.
+//
+int sampleSeaFET( int fd, char *frameBuff, struct seafetFrame *frame )
+{
+  int len;
+
+  // Flush and resync ourselves on a line
+  term_flush( fd );
+
+  serialPutLine( fd, "!!!!!" );
+  if ( waitForWakeUp( fd ) < 0 )
+    LOGPRINT( LVL_DEBG, "sampleSeaFET(): No wake up prompt" );
+
+  if ( serialChat( fd, "s", "s", SEAFET_ECHO_TIMEOUT, "s" ) < 1 )
+  {
+    LOGPRINT( LVL_WARN, "sampleSeaFET(): Sensor failed to echo 's' after "
+              "sending sample 's' command ( one attempt made )." );
+    return( FAILURE );
+  }
+
+  len = readSeaFETFrame( fd, frameBuff, SEAFET_FRAME_TIMEOUT );
+  term_flush( fd );
+  if ( len < 0 )
+  {
+    LOGPRINT( LVL_WARN, "sampleSeaFET(): Timed out waiting for a complete "
+              "frame." );
+    return( FAILURE );
+  }
+
+  if ( checkSeaFETFrame( frameBuff ) < 0 ||
+       parseSeaFETFrame( frameBuff, frame ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "sampleSeaFET(): Dropping a corrupt frame: %.*s",
+              len - 2, frameBuff );
+    return( FAILURE );
+  }
+
+  return( len );
+}
+
+
+//
+// NAME
+//   readSeaFETFrame - Read a frame from the SeaFET
+//
+// SYNOPSIS
+//   #include "seafet.h"
+//
+//   int readSeaFETFrame( int fd, char *frameBuff, long timeout );
+//
+// DESCRIPTION
+//   Read lines for up to timeout ms until one which starts
+//   with "SATPH", has SEAFET_NUMFIELDS fields and ends with
+//   <CR><LF> arrives.  We return as soon as the frame is
+//   complete.  Other lines ( e.g. prompts ) are discarded.
+//   frameBuff must hold SEAFET_FRAMELEN bytes.
+//
+// RETURNS
+//   The length of the frame or -1 upon a timeout.
+//
+int readSeaFETFrame( int fd, char *frameBuff, long timeout )
+{
+  struct timeval startTime;
+  long remaining;
+  char *frameStart;
+  char *p;
+  int numFields;
+  int len = 0;
+  char value;
+
+  gettimeofday( &startTime, NULL );
+  frameBuff[0] = '\0';
+  while ( ( remaining = timeout - getMilliSecSince( &startTime ) ) > 0 &&
+          serialGetByte( fd, &value, remaining ) == 1 )
+  {
+    // Too long to be a frame
+    if ( len == SEAFET_FRAMELEN - 1 )
+      len = 0;
+    frameBuff[len++] = value;
+    frameBuff[len] = '\0';
+    if ( value != '\n' )
+      continue;
+
+    // Skip anything in front of the header
+    if ( ( frameStart = strstr( frameBuff, "SATPH" ) ) != NULL )
+    {
+      for ( numFields = 1, p = frameStart; *p != '\0'; p++ )
+        if ( *p == ',' )
+          numFields++;
+      if ( numFields == SEAFET_NUMFIELDS && len > 1 && 
+           frameBuff[len - 2] == '\r' )
+      {
+        len -= frameStart - frameBuff;
+        memmove( frameBuff, frameStart, len + 1 );
+        return( len );
+      }
+      LOGPRINT( LVL_WARN, "readSeaFETFrame(): Dropping an incomplete "
+                "frame ( %d fields )", numFields );
+    }
+    len = 0;
+  }
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   checkSeaFETFrame - Verify a frame's checksum
+//
+// SYNOPSIS
+//   #include "seafet.h"
+//
+//   int checkSeaFETFrame( const char *frameBuff );
+//
+// DESCRIPTION
+//   Check that the sum of the frame's bytes up to and
+//   including the comma before CHECKSUM, plus the CHECKSUM,
+//   is 0 mod 256.
+//
+// RETURNS
+//   1 If the checksum is good
+//  -1 If it is bad or missing
+//
+int checkSeaFETFrame( const char *frameBuff )
+{
+  const char *lastComma;
+  const char *p;
+  char *endPtr;
+  unsigned int sum = 0;
+  long checksum;
+
+  if ( ( lastComma = strrchr( frameBuff, ',' ) ) == NULL )
+    return( FAILURE );
+
+  checksum = strtol( lastComma + 1, &endPtr, 10 );
+  if ( endPtr == lastComma + 1 || *endPtr != '\r' ||
+       checksum < 0 || checksum > 255 )
+    return( FAILURE );
+
+  for ( p = frameBuff; p <= lastComma; p++ )
+    sum += (unsigned char)*p;
+
+  return( ( ( sum + checksum ) & 0xFF ) == 0 ? SUCCESS : FAILURE );
+}
+
+
+//
+// NAME
+//   parseSeaFETFrame - Parse the fields of a SeaFET frame
+//
+// SYNOPSIS
+//   #include "seafet.h"
+//
+//   int parseSeaFETFrame( const char *frameBuff,
+//                         struct seafetFrame *frame );
+//
+// DESCRIPTION
+//   Store all SEAFET_NUMFIELDS fields of a "SATPH..." frame
+//   in frame.  Measurements the sensor sent as "nan" are set
+//   to NaN ( or SEAFET_NOINT ).  The checksum is not verified,
+//   see checkSeaFETFrame().
+//
+// RETURNS
+//   1 Upon success
+//  -1 If it is not a complete data frame
+//
+int parseSeaFETFrame( const char *frameBuff, struct seafetFrame *frame )
+{
+  char line[SEAFET_FRAMELEN];
+  char *fields[SEAFET_NUMFIELDS + 1];
+  char *endPtr;
+  int intValue;
+  unsigned long status;
+  int i;
+
+  if ( strncmp( frameBuff, "SATPH", 5 ) != 0 )
+    return( FAILURE );
+
+  strncpy( line, frameBuff, sizeof( line ) - 1 );
+  line[sizeof( line ) - 1] = '\0';
+  if ( splitFields( line, ',', fields, SEAFET_NUMFIELDS + 1 ) !=
+       SEAFET_NUMFIELDS )
+    return( FAILURE );
+
+  memset( frame, 0, sizeof( *frame ) );
+  strncpy( frame->header, fields[0], SEAFET_HEADERLEN );
+
+  // The time stamp is required
+  if ( parseIntField( fields[1], &intValue ) < 0 ||
+       parseDoubleField( fields[2], &frame->time ) < 0 )
+    return( FAILURE );
+  frame->date = intValue;
+
+  for ( i = 0; i < SEAFET_NUMVALUES - 2; i++ )
+  {
+    void *dest = (char *)frame + seafetColumns[i].offset;
+    const char *field = fields[SEAFET_FIRSTMEASUREMENT + i];
+
+    if ( seafetColumns[i].type == SF_INT )
+      *(int32_t *)dest = parseIntField( field, &intValue ) < 0 ?
+                           SEAFET_NOINT : intValue;
+    else if ( parseFloatField( field, (float *)dest ) < 0 )
+      *(float *)dest = NAN;
+  }
+
+  status = strtoul( fields[23], &endPtr, 16 );
+  if ( endPtr == fields[23] || *endPtr != '\0' || status > 0xFFFF ||
+       parseIntField( fields[24], &intValue ) < 0 ||
+       intValue < 0 || intValue > 255 )
+    return( FAILURE );
+  frame->status = status;
+  frame->checksum = intValue;
+
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   getSeaFETValues - The numeric columns of a frame
+//
+// SYNOPSIS
+//   #include "seafet.h"
+//
+//   void getSeaFETValues( const struct seafetFrame *frame,
+//                         float *values );
+//
+// DESCRIPTION
+//   Store DATE through V_K ( SEAFET_NUMVALUES values, in frame
+//   order ) in values, e.g. for a binary archive.  Missing
+//   values are NaN.
+//
+void getSeaFETValues( const struct seafetFrame *frame, float *values )
+{
+  int i;
+
+  values[0] = frame->date;
+  values[1] = frame->time;
+  for ( i = 0; i < SEAFET_NUMVALUES - 2; i++ )
+  {
+    const void *src = (const char *)frame + seafetColumns[i].offset;
+
+    if ( seafetColumns[i].type == SF_INT )
+      values[i + 2] = *(const int32_t *)src == SEAFET_NOINT ?
+                        NAN : *(const int32_t *)src;
+    else
+      values[i + 2] = *(const float *)src;
+  }
+}
@@ -0,0 +1,94 @@
+/*********************************************************************
+ * orcaD - ORCA Buoy Management System
+ *         Oceanic Remote Chemical Analyzer
+ *
+ * seafet.h : Header for the Satlantic SeaFET pH sensor functions
+ *
+ * Created: October 2026
+ *
+ * Authors: Robert Hubley <rhubley@gmail.com>
+ *          Wendi Ruef <wruef@ocean.washington.edu>
+ *
+ * See LICENSE for conditions of use.
+ *
+ * $Id$
+ *
+ *********************************************************************
+ * $Log$
+ *
+ *********************************************************************
+ *
+ *  See seafet.c
+ *
+ */
+#ifndef _SEAFET_H
+#define _SEAFET_H
+
+#include <stdint.h>
+
+//
+// A full ASCII frame is at most 197 characters.  It has
+// SEAFET_NUMFIELDS comma separated fields ( HEADER through
+// CHECKSUM ) and ends with <CR><LF>.
+//
+#define SEAFET_FRAMELEN      256
+#define SEAFET_NUMFIELDS     25
+#define SEAFET_NUMVALUES     22        // DATE through V_K
+#define SEAFET_HEADERLEN     10
+
+//
+// Timeouts ( ms ).  The sensor accepts the sample command for
+// 5 seconds after waking.  It prints a prompt on waking; once
+// the prompt has been followed by SEAFET_QUIET_TIMEOUT of
+// silence it is ready.
+//
+#define SEAFET_WAKE_TIMEOUT  2000L
+#define SEAFET_QUIET_TIMEOUT 100L
+#define SEAFET_ECHO_TIMEOUT  2000L
+#define SEAFET_FRAME_TIMEOUT 8000L
+
+// Integer columns the sensor sent as "nan"
+#define SEAFET_NOINT         INT32_MIN
+
+//
+// seafetFrame
+//
+//   One SATPHA/SATPHL frame.  Columns the sensor reports
+//   as "nan" ( e.g. with no CTD attached ) are NaN, or
+//   SEAFET_NOINT for the integer columns.
+//
+struct seafetFrame {
+  char header[SEAFET_HEADERLEN + 1];  // SATPHA0217
+  int32_t date;            // YYYYDDD ( UTC )
+  double time;             // decimal hours ( UTC )
+  float phInt;             // internal pH ( total scale )
+  float phExt;             // external pH ( total scale )
+  float temp;              // ISFET thermistor temperature ( C )
+  float tempCTD;           // CTD temperature ( C )
+  float salinityCTD;       // CTD salinity ( psu )
+  float oxygenCTD;         // CTD oxygen ( ml/L )
+  float pressureCTD;       // CTD pressure ( dbar )
+  float vrsInt;            // internal FET voltage ( V )
+  float vrsExt;            // external FET voltage ( V )
+  float vTherm;            // thermistor voltage ( V )
+  float vSupply;           // supply voltage ( V )
+  int32_t iSupply;         // supply current ( mA )
+  float humidity;          // enclosure relative humidity ( % )
+  float v5V;               // internal 5V supply ( V )
+  float vMainBatt;         // main battery pack ( V )
+  float vIso;              // isolated supply ( V )
+  float vIsoBatt;          // isolated battery pack ( V )
+  int32_t iB;              // substrate leakage current ( nA )
+  int32_t iK;              // counter electrode leakage current ( nA )
+  float vK;                // counter electrode voltage ( V )
+  uint16_t status;         // status bits
+  uint8_t checksum;
+};
+
+int sampleSeaFET( int fd, char *frameBuff, struct seafetFrame *frame );
+int readSeaFETFrame( int fd, char *frameBuff, long timeout );
+int checkSeaFETFrame( const char *frameBuff );
+int parseSeaFETFrame( const char *frameBuff, struct seafetFrame *frame );
+void getSeaFETValues( const struct seafetFrame *frame, float *values );
+
+#endif
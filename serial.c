@@ -27,6 +27,7 @@
 #include <sys/time.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
 #include "general.h"
 #include "term.h"
 #include "timer.h"
@@ -351,6 +352,69 @@ ssize_t serialGetData ( int fd, char *buffer,
   return( (ssize_t)bPtr );
 }
 
+//
+// NAME
+//   serialGetBlock - Read exactly nBytes from a serial port.
+//
+// SYNOPSIS
+//   #include "serial.h"
+//
+//   ssize_t serialGetBlock( int fd, char *buffer,
+//                           long nBytes, long idleTimeout );
+//
+// DESCRIPTION
+//   Read nBytes from the open file descriptor ( fd ) using
+//   as few read() calls as possible.  Unlike serialGetData
+//   the timeout is an idle timeout: the read only gives up
+//   once no data has arrived for idleTimeout milliseconds.
+//   This lets a long binary transfer complete at whatever
+//   rate the line supports while still detecting a stalled
+//   instrument promptly.
+//
+// RETURNS
+//   The number of bytes read ( less than nBytes on
+//   timeout ) or -1 upon failure.
+//
+ssize_t serialGetBlock ( int fd, char *buffer,
+                         long nBytes, long idleTimeout )
+{
+  long bPtr = 0;
+  ssize_t bytesRead;
+  struct pollfd pfd;
+  int ret;
+
+  // Just some sanity checks
+  if ( buffer == NULL || nBytes < 1 || idleTimeout < 1 )
+    return( FAILURE );
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while ( bPtr < nBytes ) {
+    ret = poll( &pfd, 1, (int)idleTimeout );
+    if ( ret < 0 ) {
+      if ( errno == EINTR )
+        continue;
+      return( FAILURE );
+    }
+    if ( ret == 0 )
+      break;
+    bytesRead = read( fd, buffer + bPtr, nBytes - bPtr );
+    if ( bytesRead < 0 ) {
+      // Check errno ( EINTR && EAGAIN are ok )
+      if ( errno != EINTR && errno != EAGAIN ) {
+        return( FAILURE );
+      }
+    }else if ( bytesRead == 0 ) {
+      // Hangup - nothing more will arrive
+      break;
+    }else {
+      bPtr += bytesRead;
+    }
+  }
+
+  return( (ssize_t)bPtr );
+}
+
 
 // 
 // NAME
@@ -40,6 +40,10 @@ ssize_t serialPutLine( int fd, char *buffer );
 int serialChat( int fd, char *statement, char *response, 
                 long timeout, char *lineTerm );
 ssize_t serialGetData ( int fd, char *buffer, long nBytes, long timeout );
+// Read exactly nBytes, giving up only after idleTimeout milliseconds
+// pass without any data arriving.
+ssize_t serialGetBlock ( int fd, char *buffer, long nBytes,
+                         long idleTimeout );
 ssize_t serialPutData ( int fd, char *buffer, long nBytes );
 
 ssize_t usbGetLine ( struct sPort *port, char *buffer,
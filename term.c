@@ -630,6 +630,16 @@ term_set_baudrate (int fd, int baudrate)
 		case 230400:
 			spd = B230400;
 			break;
+#ifdef B460800
+		case 460800:
+			spd = B460800;
+			break;
+#endif
+#ifdef B921600
+		case 921600:
+			spd = B921600;
+			break;
+#endif
 		default:
 			term_errno = TERM_EBAUD;
 			rval = -1;
@@ -660,6 +670,60 @@ term_set_baudrate (int fd, int baudrate)
 
 /***************************************************************************/
 
+int
+term_get_baudrate (int fd)
+{
+	int rval, i;
+
+	rval = 0;
+
+	do { /* dummy */
+
+		i = term_find(fd);
+		if ( i < 0 ) {
+			rval = -1;
+			break;
+		}
+
+		switch (cfgetospeed(&term.nexttermios[i])) {
+		case B0:      rval = 0;      break;
+		case B50:     rval = 50;     break;
+		case B75:     rval = 75;     break;
+		case B110:    rval = 110;    break;
+		case B134:    rval = 134;    break;
+		case B150:    rval = 150;    break;
+		case B200:    rval = 200;    break;
+		case B300:    rval = 300;    break;
+		case B600:    rval = 600;    break;
+		case B1200:   rval = 1200;   break;
+		case B1800:   rval = 1800;   break;
+		case B2400:   rval = 2400;   break;
+		case B4800:   rval = 4800;   break;
+		case B9600:   rval = 9600;   break;
+		case B19200:  rval = 19200;  break;
+		case B38400:  rval = 38400;  break;
+		case B57600:  rval = 57600;  break;
+		case B115200: rval = 115200; break;
+		case B230400: rval = 230400; break;
+#ifdef B460800
+		case B460800: rval = 460800; break;
+#endif
+#ifdef B921600
+		case B921600: rval = 921600; break;
+#endif
+		default:
+			term_errno = TERM_EBAUD;
+			rval = -1;
+			break;
+		}
+
+	} while (0);
+
+	return rval;
+}
+
+/***************************************************************************/
+
 int
 term_set_parity (int fd, enum parity_e parity)
 {
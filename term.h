@@ -359,7 +359,8 @@ int term_set_raw (int fd);
  * the device are not affected by this function.
  *
  * Supported baudrates: 0, 50, 75, 110, 134, 150, 200, 300, 600, 1200,
- *   1800, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400
+ *   1800, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, and
+ *   460800, 921600 where the system headers define them.
  *
  * Returns negative on failure, non negative on success. Returns
  * failure only to indicate invalid arguments, so the return value can
@@ -367,6 +368,17 @@ int term_set_raw (int fd);
  */
 int term_set_baudrate (int fd, int baudrate);
 
+/* F term_get_baudrate
+ *
+ * Returns the baudrate held in the "nexttermios" structure associated
+ * with the managed filedes "fd". This is the rate the device is
+ * running at unless a term_set_baudrate() call has not yet been
+ * applied.
+ *
+ * Returns the baudrate, or negative on failure.
+ */
+int term_get_baudrate (int fd);
+
 /* F term_set_parity
  *
  * Sets the parity mode in the "nexttermios" structure associated with
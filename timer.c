@@ -20,7 +20,12 @@
  *
  */
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/time.h>
+#include "general.h"
+#include "timer.h"
 
 
 //
@@ -54,3 +59,183 @@ suseconds_t getMilliSecSince( struct timeval *startTime ) {
 
 }
 
+
+
+//
+// NAME
+//   alignPeriodicTimer - Next deadline after a given time
+//
+static time_t alignPeriodicTimer( struct periodicTimer *timer, time_t now )
+{
+  return( ( ( now - timer->offset ) / timer->period + 1 ) * timer->period +
+          timer->offset );
+}
+
+
+//
+// NAME
+//   getRealTime - Read the wall clock
+//
+static void getRealTime( struct timespec *now )
+{
+#ifdef CLOCK_REALTIME
+  clock_gettime( CLOCK_REALTIME, now );
+#else
+  struct timeval tv;
+
+  gettimeofday( &tv, NULL );
+  now->tv_sec = tv.tv_sec;
+  now->tv_nsec = tv.tv_usec * 1000;
+#endif
+}
+
+
+//
+// NAME
+//   initPeriodicTimer - Start a wall clock aligned sampling cadence.
+//
+// SYNOPSIS
+//   #include "timer.h"
+//
+//   int initPeriodicTimer( struct periodicTimer *timer, long period, 
+//                          long offset );
+//
+// DESCRIPTION
+//   Set up timer to fire every period seconds on multiples
+//   of period since the epoch plus offset seconds.  I.e a 
+//   period of 60 fires at the top of every minute and a
+//   period of 900 at 00, 15, 30 and 45 minutes past the 
+//   hour ( UTC ).  The first deadline is the next boundary
+//   after now.  Use waitPeriodicTimer() to wait for each
+//   deadline.
+//
+// RETURNS
+//   1 on success, -1 if the period is not positive.
+//
+int initPeriodicTimer( struct periodicTimer *timer, long period, 
+                       long offset )
+{
+  memset( timer, 0, sizeof( struct periodicTimer ) );
+  if ( period < 1 )
+    return( FAILURE );
+  timer->period = period;
+  timer->offset = ( ( offset % period ) + period ) % period;
+  timer->next = alignPeriodicTimer( timer, time( NULL ) );
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   msUntilPeriodicTimer - Time left before the next deadline.
+//
+// SYNOPSIS
+//   #include "timer.h"
+//
+//   long msUntilPeriodicTimer( struct periodicTimer *timer );
+//
+// DESCRIPTION
+//   For callers which do useful work ( e.g. draining a 
+//   streaming port ) while waiting for the deadline.
+//
+// RETURNS
+//   Milliseconds until the next deadline, 0 if it has passed.
+//
+long msUntilPeriodicTimer( struct periodicTimer *timer )
+{
+  struct timespec now;
+  long ms;
+
+  getRealTime( &now );
+  ms = ( timer->next - now.tv_sec ) * 1000L - now.tv_nsec / 1000000L;
+  return( ms > 0 ? ms : 0 );
+}
+
+
+//
+// NAME
+//   waitPeriodicTimer - Sleep until the timer's next deadline.
+//
+// SYNOPSIS
+//   #include "timer.h"
+//
+//   int waitPeriodicTimer( struct periodicTimer *timer );
+//
+// DESCRIPTION
+//   Sleep until the next deadline using an absolute wall 
+//   clock sleep, so the time spent sampling between calls
+//   does not accumulate as drift.  timer->fired is set to
+//   the deadline ( use it to stamp the sample ) and the 
+//   next deadline is one period later.
+//
+//   A deadline passed by no more than PERIODICTIMER_GRACE
+//   milliseconds fires immediately.  If it passed longer 
+//   ago ( the last sample overran ) the missed deadlines 
+//   are skipped and counted in numOverruns/numSkipped, and
+//   we wait for the next one instead of sampling off the 
+//   cadence.  If the clock
+//   has been stepped back more than a period the deadlines
+//   are realigned to the new time.
+//
+// RETURNS
+//   The number of deadlines skipped ( normally 0 ) or -1
+//   if the sleep failed.
+//
+int waitPeriodicTimer( struct periodicTimer *timer )
+{
+  struct timespec now;
+  struct timespec deadline;
+  long lateMs;
+  int skipped = 0;
+#if defined( CLOCK_REALTIME ) && defined( TIMER_ABSTIME )
+  int ret;
+#endif
+
+  getRealTime( &now );
+  lateMs = ( now.tv_sec - timer->next ) * 1000L + now.tv_nsec / 1000000L;
+  if ( lateMs > PERIODICTIMER_GRACE )
+  {
+    skipped = ( now.tv_sec - timer->next ) / timer->period + 1;
+    timer->next = alignPeriodicTimer( timer, now.tv_sec );
+    timer->numOverruns++;
+    timer->numSkipped += skipped;
+  }else if ( timer->next - now.tv_sec > timer->period )
+    timer->next = alignPeriodicTimer( timer, now.tv_sec );
+
+  deadline.tv_sec = timer->next;
+  deadline.tv_nsec = 0;
+#if defined( CLOCK_REALTIME ) && defined( TIMER_ABSTIME )
+  while ( ( ret = clock_nanosleep( CLOCK_REALTIME, TIMER_ABSTIME, 
+                                   &deadline, NULL ) ) != 0 )
+  {
+    if ( ret != EINTR )
+      return( FAILURE );
+  }
+#else
+  // No absolute sleep.  Sleep the remainder, rechecking the
+  // clock after each ( possibly interrupted ) sleep.
+  for (;;)
+  {
+    struct timespec remaining;
+
+    getRealTime( &now );
+    if ( now.tv_sec >= deadline.tv_sec )
+      break;
+    remaining.tv_sec = deadline.tv_sec - now.tv_sec - 1;
+    remaining.tv_nsec = 999999999L - now.tv_nsec;
+    if ( nanosleep( &remaining, NULL ) != 0 && errno != EINTR )
+      return( FAILURE );
+  }
+#endif
+
+  getRealTime( &now );
+  timer->fired = timer->next;
+  timer->next += timer->period;
+  timer->numFired++;
+  timer->lastLateness = ( now.tv_sec - timer->fired ) * 1000L + 
+                        now.tv_nsec / 1000000L;
+  if ( timer->lastLateness > timer->maxLateness )
+    timer->maxLateness = timer->lastLateness;
+
+  return( skipped );
+}
@@ -22,6 +22,36 @@
 #ifndef _TIMER_H
 #define _TIMER_H
 
+#include <time.h>
+#include <sys/time.h>
+
+//
+// periodicTimer
+//
+//   A sampling cadence with absolute, wall clock aligned
+//   deadlines ( see initPeriodicTimer() ).  Deadlines which
+//   are missed entirely because the previous sample ran
+//   long are skipped and counted rather than run late.
+//
+// Milliseconds a deadline may be missed by and still fire
+#define PERIODICTIMER_GRACE 500
+
+struct periodicTimer {
+  long period;              // Seconds between deadlines
+  long offset;              // Seconds past the period boundary
+  time_t next;              // Next deadline
+  time_t fired;             // Deadline of the latest wake up
+  unsigned long numFired;
+  unsigned long numOverruns;   // Wake ups which skipped deadlines
+  unsigned long numSkipped;    // Deadlines skipped
+  long lastLateness;        // Milliseconds past the deadline we woke
+  long maxLateness;
+};
+
 suseconds_t getMilliSecSince( struct timeval *startTime );
+int initPeriodicTimer( struct periodicTimer *timer, long period, 
+                       long offset );
+long msUntilPeriodicTimer( struct periodicTimer *timer );
+int waitPeriodicTimer( struct periodicTimer *timer );
 
 #endif
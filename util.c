@@ -116,15 +116,19 @@ int updateDataDir ()
 //   a new data subdirectory.  It then increments the opts.lastCastNum
 //   global and stores it in a file by calling writeLastCastInfo().
 //   Lastly the file is created using the opts.dataFilePrefix global
-//   along with the cast number and "HEX" extension.
+//   along with the cast number and "HEX" extension.  The file is
+//   opened under a temporary CASTTMPSUFFIX name and only gets
+//   its final name from commitCastFile().
 //
 // RETURNS
 //    1   :  Success
 //   -1   :  Failure
 //
+static char castFileName[FILEPATHMAX];
+
 FILE * openNewCastFile ()
 {
-  char   dataLogFile[FILEPATHMAX];
+  char   dataLogFile[FILEPATHMAX + sizeof( CASTTMPSUFFIX )];
   struct tm * now_tm;
   time_t now_t;
   FILE   *fpl;
@@ -146,8 +150,9 @@ FILE * openNewCastFile ()
   }
   LOGPRINT( LVL_INFO, "openNewCastFile(): Starting Cast Number %d at %s", 
             opts.lastCastNum, asctime( now_tm ) );
-  sprintf( dataLogFile,"%s/%s%04ld.HEX", opts.dataSubDirName, 
-           opts.dataFilePrefix, opts.lastCastNum );
+  snprintf( castFileName, FILEPATHMAX, "%s/%s%04ld.HEX", 
+            opts.dataSubDirName, opts.dataFilePrefix, opts.lastCastNum );
+  sprintf( dataLogFile, "%s%s", castFileName, CASTTMPSUFFIX );
   //
   // SET UP NEW DATA FILE
   //
@@ -161,6 +166,55 @@ FILE * openNewCastFile ()
   return( fpl );
 }
 
+
+//
+// NAME
+//   commitCastFile - Close the cast file opened by openNewCastFile()
+//
+// SYNOPSIS
+//    #include "util.h"
+//
+//    int commitCastFile( FILE *fpl, int verified );
+//
+// DESCRIPTION
+//   Flush the cast file to disk and close it.  If the download
+//   was verified the temporary file is renamed to its final
+//   ".HEX" name, otherwise it is left under the CASTTMPSUFFIX
+//   name so that a partial or corrupt upload is never mistaken
+//   for a good one.
+//
+// RETURNS
+//    1   :  The file was renamed
+//   -1   :  The file was left under its temporary name
+//
+int commitCastFile( FILE *fpl, int verified )
+{
+  char tmpFileName[FILEPATHMAX + sizeof( CASTTMPSUFFIX )];
+
+  sprintf( tmpFileName, "%s%s", castFileName, CASTTMPSUFFIX );
+
+  fflush( fpl );
+  fsync( fileno( fpl ) );
+  if ( fclose( fpl ) != 0 )
+    verified = 0;
+
+  if ( ! verified )
+  {
+    LOGPRINT( LVL_WARN, "commitCastFile(): Download not verified. Data "
+              "left in %s", tmpFileName );
+    return( FAILURE );
+  }
+
+  if ( rename( tmpFileName, castFileName ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "commitCastFile(): Could not rename %s: %s",
+              tmpFileName, strerror( errno ) );
+    return( FAILURE );
+  }
+
+  return( SUCCESS );
+}
+
 // 
 // NAME
 //   openNewWeatherFile - Create a new data file to store weather data.
@@ -22,9 +22,14 @@
 #ifndef _UTIL_H
 #define _UTIL_H 1
 
+// Cast files are written under this suffix and renamed
+// once the download has been verified
+#define CASTTMPSUFFIX ".part"
+
 
 FILE * openNewWeatherFile();
 FILE * openNewCastFile();
+int commitCastFile( FILE *fpl, int verified );
 int updateDataDir();
 int writeLastCastInfo( long castIdx );
 long readLastCastInfo();
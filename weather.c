@@ -20,10 +20,12 @@
  *********************************************************************
  *
  */
+#define _GNU_SOURCE     // memmem()
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 #include <termios.h>
 #include "general.h"
@@ -33,12 +35,63 @@
 #include "serial.h"
 #include "log.h" 
 #include "weather.h"
+#include "readingbus.h"
 
 
 // This is a string version of ACK...for use in
 // the serial routines.
 static char ackStr[] = { 0x06, 0x00 };
 
+//
+// The live weather state fed by the LOOP packet stream
+// ( see serviceWeatherLoop ) and the partial packet buffer.
+//
+static struct weatherState wsState;
+static unsigned char loopBuff[WSLOOPBUFFLEN];
+static int loopBuffLen = 0;
+static int loopActive = 0;
+static int loopRemaining = 0;
+static time_t loopStarted = 0;
+
+
+//
+// NAME
+//   wakeWeatherStation - Get the weather station's attention
+//
+// SYNOPSIS
+//   static int wakeWeatherStation( int wsFD );
+//
+// DESCRIPTION
+//   Wake the console up so it will accept a command.  Any
+//   character cancels a LOOP stream, so one is sent first and
+//   the tail of the stream discarded before the wake up
+//   sequence.  The stream is restarted by serviceWeatherLoop
+//   the next time it is called.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+static int wakeWeatherStation ( int wsFD )
+{
+  if ( loopActive )
+  {
+    serialPutLine( wsFD, "\n" );
+    usleep( 500000 );
+    loopActive = 0;
+    loopBuffLen = 0;
+  }
+
+  term_flush( wsFD );
+  if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
+    if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
+      if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
+        return( FAILURE );
+
+  return( SUCCESS );
+}
+
+
 
 //
 // NAME
@@ -138,74 +191,54 @@ int initializeWeatherStation ( int wsFD )
 
 //
 // NAME
-//   logInstantWeather - routine to log instant weather data to a file desc.
+//   publishLOOPRecord - Share a LOOP packet's outside readings
 //
-// SYNOPSIS
-//   #include "weather.h"
+// DESCRIPTION
+//   Convert to the units of the readings table ( see 
+//   readingbus.c ) and publish.  Dashed ( missing ) values
+//   are skipped.
 //
-//   int logInstantWeather( int wsFD, FILE * outFile );
+static void publishLOOPRecord ( struct weatherLOOPRevB *rec )
+{
+  if ( rec->barometer != 0 )
+    publishReading( BUS_BAROMETER, rec->barometer / 1000.0 );
+  if ( rec->outsideHumidity != 255 )
+    publishReading( BUS_HUMIDITY, rec->outsideHumidity );
+  if ( rec->outsideTemperature != 32767 )
+    publishReading( BUS_AIRTEMP, 
+                    ( rec->outsideTemperature / 10.0 - 32.0 ) * 5.0 / 9.0 );
+  if ( rec->windSpeed != 255 )
+    publishReading( BUS_WINDSPEED, rec->windSpeed * 0.868976 );
+  if ( rec->windDirection != 0 && rec->windDirection <= 360 )
+    publishReading( BUS_WINDDIRECTION, rec->windDirection );
+  if ( rec->solarRadiation != 32767 )
+    publishReading( BUS_SOLARRAD, rec->solarRadiation );
+}
+
+
 //
-// DESCRIPTION
-//   This function is used by orcad to display instantaneous
-//   weather data to the screen or file.  The weather station
-//   communications file descriptor should be opened and
-//   ready for reading/writing.  The outFile should be opened
-//   and ready for writing.
+// NAME
+//   printLOOPRecord - Write a LOOP packet in human readable form
 //
-// RETURNS
-//   1 Upon success
-//  -1 Upon failure
+// SYNOPSIS
+//   static void printLOOPRecord( FILE * outFile,
+//                                struct weatherLOOPRevB *rec,
+//                                time_t when );
 //
-int logInstantWeather ( int wsFD, FILE * outFile ) 
+// DESCRIPTION
+//   Format the interesting fields of a LOOP packet, stamped
+//   with the time it was received, for the weather status
+//   file or the screen.
+//
+static void printLOOPRecord ( FILE * outFile, struct weatherLOOPRevB *rec,
+                              time_t when )
 {
-  char buffer[128];
-  struct weatherLOOPRevB *rec;
-  int bytesRead;
-  time_t nowTimeT;
   struct tm *nowTM;
   char nowStr[80];
 
-  
-  // Say hello
-  LOGPRINT( LVL_DEBG, "logInstantWeather(): Called" );
-
-  // Initialize the date/time string
   nowStr[0] = '\0';
-
-  // Wake up the weather station
-  term_flush( wsFD );
-  if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
-    if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
-      if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
-      {
-        LOGPRINT( LVL_CRIT, "logInstantWeather(): Could not wake "
-                  "up the weather station!" );
-        return( FAILURE );
-      }
-
-  //
-  // Start the archive dump
-  //
-  serialPutLine( wsFD, "LOOP 1\r" );
-
-  if ( ( bytesRead = 
-             serialGetData( wsFD, (char *)buffer, 100, 4000L ) ) != 100 )
-  {
-        LOGPRINT( LVL_CRIT, "logInstantWeather(): Did not receive "
-                  "a complete LOOP data record.  Size = %d should "
-                  "have been 100", bytesRead );
-        return( FAILURE );
-  }
-
-  // Grab the current time
-  if ( time( &nowTimeT ) >= 0 ) 
-  {
-    nowTM = localtime( &nowTimeT );
+  if ( ( nowTM = localtime( &when ) ) != NULL )
     strftime( nowStr, 80, "%b %d %Y %H:%M:%S  ", nowTM );
-  }
-
-  // Cast the buffer to the data structure
-  rec = (struct weatherLOOPRevB *)&(buffer[2]);
 
   fprintf( outFile, 
            "%s\nbarometer = %.2f hg\ninsideHumidity = %d %%\n"
@@ -274,116 +307,625 @@ int logInstantWeather ( int wsFD, FILE * outFile )
   }
 
   fprintf( outFile, "\n" );
+}
+
+
+//
+// NAME
+//   logInstantWeather - routine to log instant weather data to a file desc.
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   int logInstantWeather( int wsFD, FILE * outFile );
+//
+// DESCRIPTION
+//   This function is used by orcad to display instantaneous
+//   weather data to the screen or file.  The weather station
+//   communications file descriptor should be opened and
+//   ready for reading/writing.  The outFile should be opened
+//   and ready for writing.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+int logInstantWeather ( int wsFD, FILE * outFile ) 
+{
+  char buffer[128];
+  struct weatherLOOPRevB *rec;
+  int bytesRead;
+  time_t nowTimeT;
+
+  
+  // Say hello
+  LOGPRINT( LVL_DEBG, "logInstantWeather(): Called" );
+
+  // Wake up the weather station
+  if ( wakeWeatherStation( wsFD ) < 0 )
+  {
+    LOGPRINT( LVL_CRIT, "logInstantWeather(): Could not wake "
+              "up the weather station!" );
+    return( FAILURE );
+  }
+
+  //
+  // Start the archive dump
+  //
+  serialPutLine( wsFD, "LOOP 1\r" );
+
+  if ( ( bytesRead = 
+             serialGetData( wsFD, (char *)buffer, 100, 4000L ) ) != 100 )
+  {
+        LOGPRINT( LVL_CRIT, "logInstantWeather(): Did not receive "
+                  "a complete LOOP data record.  Size = %d should "
+                  "have been 100", bytesRead );
+        return( FAILURE );
+  }
+
+  // Grab the current time
+  nowTimeT = time( NULL );
+
+  // Cast the buffer to the data structure
+  rec = (struct weatherLOOPRevB *)&(buffer[2]);
+
+  printLOOPRecord( outFile, rec, nowTimeT );
+
+  return( SUCCESS );
+}
+
+
+
+
+
+//
+// NAME
+//   startWeatherLoop - Start the console streaming LOOP packets
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   int startWeatherLoop( int wsFD );
+//
+// DESCRIPTION
+//   Ask the console for WSLOOPPACKETS LOOP packets.  The console
+//   sends one every 2 seconds until the count runs out or any
+//   other character is sent to it.  The packets are collected
+//   by serviceWeatherLoop.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+int startWeatherLoop ( int wsFD )
+{
+  char command[16];
+  char byte = 0;
+  int i;
+
+  if ( wakeWeatherStation( wsFD ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "startWeatherLoop(): Could not wake "
+              "up the weather station!" );
+    return( FAILURE );
+  }
+
+  // The response is <ack> followed by the packets ( possibly
+  // behind the '\r' left over from the wake up response )
+  snprintf( command, sizeof( command ), "LOOP %d\n", WSLOOPPACKETS );
+  serialPutLine( wsFD, command );
+  for ( i = 0; i < 3; i++ )
+    if ( serialGetByte( wsFD, &byte, 2000L ) < 1 || byte == 0x06 )
+      break;
+  if ( i == 3 || byte != 0x06 )
+  {
+    LOGPRINT( LVL_WARN, "startWeatherLoop(): Weather station did not "
+              "acknowledge the LOOP command!" );
+    return( FAILURE );
+  }
+
+  loopActive = 1;
+  loopRemaining = WSLOOPPACKETS;
+  loopStarted = time( NULL );
+  loopBuffLen = 0;
+  LOGPRINT( LVL_DEBG, "startWeatherLoop(): Streaming %d LOOP packets",
+            WSLOOPPACKETS );
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   serviceWeatherLoop - Collect streamed LOOP packets
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   int serviceWeatherLoop( int wsFD );
+//
+// DESCRIPTION
+//   Read whatever the console has sent since the last call
+//   and pull complete LOOP packets out of it.  Packets are
+//   found by their "LOO" prefix and must pass their CRC before
+//   they replace the live weather state; anything else is
+//   skipped a byte at a time until the stream is back in step.
+//   The stream is ( re )started when it is not running, has
+//   used up its packet count or has gone quiet for
+//   WSLOOPTIMEOUT seconds.
+//
+// RETURNS
+//   The number of packets received or -1 if the stream could
+//   not be started.
+//
+int serviceWeatherLoop ( int wsFD )
+{
+  struct weatherLOOPRevB *rec;
+  unsigned char *ptr;
+  ssize_t bytesRead;
+  time_t now = time( NULL );
+  int numPackets = 0;
+
+  if ( loopActive )
+  {
+    do {
+      if ( loopBuffLen == WSLOOPBUFFLEN )
+      {
+        // Fell too far behind - keep the newest half
+        memmove( loopBuff, loopBuff + WSLOOPBUFFLEN / 2,
+                 WSLOOPBUFFLEN / 2 );
+        loopBuffLen = WSLOOPBUFFLEN / 2;
+      }
+      bytesRead = read( wsFD, loopBuff + loopBuffLen,
+                        WSLOOPBUFFLEN - loopBuffLen );
+      if ( bytesRead > 0 )
+        loopBuffLen += bytesRead;
+    } while ( bytesRead > 0 );
+
+    while ( loopBuffLen >= (int)WSLOOPLEN )
+    {
+      if ( ( ptr = memmem( loopBuff, loopBuffLen, "LOO", 3 ) ) == NULL )
+      {
+        // Keep a possible partial prefix
+        memmove( loopBuff, loopBuff + loopBuffLen - 2, 2 );
+        loopBuffLen = 2;
+        break;
+      }
+      loopBuffLen -= ptr - loopBuff;
+      memmove( loopBuff, ptr, loopBuffLen );
+      if ( loopBuffLen < (int)WSLOOPLEN )
+        break;
+
+      if ( ( crc16AddData( loopBuff, WSLOOPLEN, 0 ) & 0xFFFF ) == 0 )
+      {
+        rec = (struct weatherLOOPRevB *)loopBuff;
+        memcpy( &wsState.loop, rec, WSLOOPLEN );
+        wsState.updated = now;
+        publishLOOPRecord( &wsState.loop );
+        wsState.numPackets++;
+        loopRemaining--;
+        numPackets++;
+        loopBuffLen -= WSLOOPLEN;
+        memmove( loopBuff, loopBuff + WSLOOPLEN, loopBuffLen );
+      }else
+      {
+        wsState.numBadPackets++;
+        loopBuffLen--;
+        memmove( loopBuff, loopBuff + 1, loopBuffLen );
+      }
+    }
+  }
+
+  if ( ! loopActive || loopRemaining <= 0 ||
+       ( now - ( wsState.updated > loopStarted ? wsState.updated :
+                                                 loopStarted ) ) >
+         WSLOOPTIMEOUT )
+  {
+    if ( startWeatherLoop( wsFD ) < 0 )
+      return( FAILURE );
+  }
+
+  return( numPackets );
+}
+
+
+//
+// NAME
+//   sleepWeatherLoop - Sleep while collecting LOOP packets
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   void sleepWeatherLoop( int wsFD, unsigned int seconds );
+//
+// DESCRIPTION
+//   Wait for the given number of seconds, servicing the LOOP
+//   stream every WSLOOPINTERVAL seconds so the live weather
+//   state stays current.
+//
+// RETURNS
+//   Nothing.
+//
+void sleepWeatherLoop ( int wsFD, unsigned int seconds )
+{
+  time_t endTime = time( NULL ) + seconds;
+  time_t now;
+
+  while ( ( now = time( NULL ) ) < endTime )
+  {
+    serviceWeatherLoop( wsFD );
+    sleep( ( endTime - now ) < WSLOOPINTERVAL ? ( endTime - now ) :
+                                                WSLOOPINTERVAL );
+  }
+}
+
+
+//
+// NAME
+//   getWeatherState - The live weather state
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   const struct weatherState *getWeatherState( void );
+//
+// RETURNS
+//   A pointer to the latest LOOP packet and its bookkeeping.
+//   updated is 0 if no packet has been received yet.
+//
+const struct weatherState *getWeatherState ( void )
+{
+  return( &wsState );
+}
+
+
+//
+// NAME
+//   logWeatherState - Write the live weather state to a file desc.
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   int logWeatherState( FILE * outFile );
+//
+// DESCRIPTION
+//   Write the most recent LOOP packet in the same form as
+//   logInstantWeather without talking to the console.
+//
+// RETURNS
+//   1 Upon success
+//  -1 If no current packet is available
+//
+int logWeatherState ( FILE * outFile )
+{
+  if ( wsState.updated == 0 ||
+       ( time( NULL ) - wsState.updated ) > WSLOOPTIMEOUT * 6 )
+    return( FAILURE );
+
+  printLOOPRecord( outFile, &wsState.loop, wsState.updated );
+  return( SUCCESS );
+}
+
+
+//
+// NAME
+//   readWSLastRecord - Get the time of the last archive record downloaded
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   long readWSLastRecord( void );
+//
+// DESCRIPTION
+//   Read the Davis date and time stamps of the newest archive
+//   record saved so far from opts.dataDirName/WSLASTRECORDFILE.
+//
+// RETURNS
+//   The stamps combined as ( dateStamp << 16 ) | timeStamp, or
+//   0 if nothing has been downloaded yet.
+//
+long readWSLastRecord ( void )
+{
+  FILE *recordFile;
+  char recordFileName[FILEPATHMAX + sizeof( WSLASTRECORDFILE )];
+  unsigned int dateStamp, timeStamp;
+  long lastRecord = 0;
+
+  snprintf( recordFileName, sizeof( recordFileName ),
+            "%s/%s", opts.dataDirName, WSLASTRECORDFILE );
+  if ( ( recordFile = fopen( recordFileName, "r" ) ) == NULL )
+    return( 0 );
+
+  if ( fscanf( recordFile, "%u %u", &dateStamp, &timeStamp ) == 2 )
+    lastRecord = WSRECORDKEY( dateStamp, timeStamp );
+
+  fclose( recordFile );
+  return( lastRecord );
+}
+
+
+//
+// NAME
+//   writeWSLastRecord - Store the time of the last archive record downloaded
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   int writeWSLastRecord( long lastRecord );
+//
+// DESCRIPTION
+//   Save the combined date/time stamp ( see readWSLastRecord )
+//   of the newest archive record written to the MET files.  The
+//   stamp is written to a temporary file, synced and then renamed
+//   over the old one so a power loss never leaves a truncated or
+//   empty mark behind.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+int writeWSLastRecord ( long lastRecord )
+{
+  FILE *recordFile;
+  char recordFileName[FILEPATHMAX + sizeof( WSLASTRECORDFILE )];
+  char tmpFileName[FILEPATHMAX + sizeof( WSLASTRECORDFILE ) + 4];
+  int ret;
+
+  snprintf( recordFileName, sizeof( recordFileName ),
+            "%s/%s", opts.dataDirName, WSLASTRECORDFILE );
+  snprintf( tmpFileName, sizeof( tmpFileName ), "%s.tmp", recordFileName );
+  if ( ( recordFile = fopen( tmpFileName, "w" ) ) == NULL )
+  {
+    LOGPRINT( LVL_WARN, "writeWSLastRecord(): Could not open %s for "
+              "writing!", tmpFileName );
+    return( FAILURE );
+  }
+
+  ret = fprintf( recordFile, "%lu %lu\n", ( lastRecord >> 16 ) & 0xFFFF,
+                 lastRecord & 0xFFFF );
+  if ( fflush( recordFile ) != 0 || fsync( fileno( recordFile ) ) < 0 )
+    ret = -1;
+  if ( fclose( recordFile ) != 0 )
+    ret = -1;
+
+  if ( ret < 0 )
+  {
+    LOGPRINT( LVL_WARN, "writeWSLastRecord(): Could not write %s: %s",
+              tmpFileName, strerror( errno ) );
+    unlink( tmpFileName );
+    return( FAILURE );
+  }
+
+  if ( rename( tmpFileName, recordFileName ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "writeWSLastRecord(): Could not rename %s: %s",
+              tmpFileName, strerror( errno ) );
+    unlink( tmpFileName );
+    return( FAILURE );
+  }
 
   return( SUCCESS );
 }
 
 
+//
+// NAME
+//   getWSPage - Read one archive page and check its CRC
+//
+// SYNOPSIS
+//   static int getWSPage( int wsFD, unsigned char *page );
+//
+// DESCRIPTION
+//   Read a WSPAGELEN byte archive page.  If the page is short
+//   or fails its CRC a NAK is sent so the weather station
+//   resends it, up to WSPAGERETRIES times.
+//
+// RETURNS
+//   1 Upon success
+//  -1 Upon failure
+//
+static int getWSPage ( int wsFD, unsigned char *page )
+{
+  int retries = 0;
+  ssize_t bytesRead;
+
+  for ( ;; )
+  {
+    bytesRead = serialGetBlock( wsFD, (char *)page, WSPAGELEN, 2000L );
+    if ( bytesRead == WSPAGELEN &&
+         ( crc16AddData( page, WSPAGELEN, 0 ) & 0xFFFF ) == 0 )
+      return( SUCCESS );
+
+    if ( retries++ >= WSPAGERETRIES )
+      break;
+    LOGPRINT( LVL_WARN, "getWSPage(): Bad archive page ( %d bytes%s ) - "
+              "requesting it again.", (int)bytesRead,
+              ( bytesRead == WSPAGELEN ? ", CRC error" : "" ) );
+    term_flush( wsFD );
+    serialPutByte( wsFD, WSNAK );
+  }
+
+  return( FAILURE );
+}
+
+
+//
+// NAME
+//   downloadWeatherData - Download new records from the weather station archive.
+//
+// SYNOPSIS
+//   #include "weather.h"
+//
+//   int downloadWeatherData( int wsFD, FILE * outFile );
+//
+// DESCRIPTION
+//   Download the archive records logged since the last download
+//   into the MET files.  The date/time of the newest record
+//   saved is kept in opts.dataDirName/WSLASTRECORDFILE so only
+//   the pages holding new records are transferred ( see
+//   downloadWeatherRecords() ).
+//
+// RETURNS
+//   Writes data to the outFile and flushes it at the end.
+//   Returns 1 upon success and -1 upon failure.
+//
+int downloadWeatherData ( int wsFD, FILE * outFile ) 
+{
+  return( downloadWeatherRecords( wsFD, outFile, 1 ) );
+}
+
 
 //
 // NAME
-//   downloadWeatherData - Download from the weather station archive.
+//   downloadWeatherRecords - Download records from the weather station archive.
 //
 // SYNOPSIS
 //   #include "weather.h"
 //
-//   int downloadWeatherData( int wsFD, FILE * outFile, int lastRecordOnly );
+//   int downloadWeatherRecords( int wsFD, FILE * outFile, int useMark );
 //
 // DESCRIPTION
-//   Download data from the Davis weather data logger's archive.
-//   This routine can either download all the data and write it
-//   to a file or simply the last data record if "lastRecordOnly" 
-//   is set to 1.  The outfile must be open and ready for writing
-//   and the wsFD file descriptor must be open to the Davis
-//   weather station communications port.  If the entire archive
-//   is downloaded the archive is cleared before the routine
-//   returns.
+//   Download archive records using the Davis DMPAFT command.
+//   If useMark is set only the records newer than the mark in
+//   opts.dataDirName/WSLASTRECORDFILE are transferred and the
+//   mark is advanced past them.  Otherwise the whole archive is
+//   transferred and the mark is neither read nor written, so a
+//   manual download does not take records away from orcad.
+//   Every page is checked against its CRC and bad pages are
+//   requested again.  The outfile must be open and ready for
+//   writing and the wsFD file descriptor must be open to the
+//   Davis weather station communications port.
+//
+//   The archive is no longer cleared after a download; it is a
+//   ring buffer so the oldest records are simply overwritten.
 //
 // RETURNS
 //   Writes data to the outFile and flushes it at the end.
 //   Returns 1 upon success and -1 upon failure.
 //
-int downloadWeatherData ( int wsFD, FILE * outFile, int lastRecordOnly ) 
+int downloadWeatherRecords ( int wsFD, FILE * outFile, int useMark ) 
 {
-  unsigned char buffer[268];
-  struct weatherDMPRevB lastRecord;
-  int i,j, numRecords = 0;
-  int bytesRead;
+  unsigned char page[WSPAGELEN];
+  unsigned char request[6];
+  unsigned int crc;
+  struct weatherDMPRevB *rec;
+  struct tm *wsTime;
+  long lastRecord, recordKey;
+  int numPages, startIndex;
+  int i, j, numRecords = 0;
+  int retValue = SUCCESS;
   
   // Say hello
-  LOGPRINT( LVL_DEBG, "downloadWeatherData(): Called" );
+  LOGPRINT( LVL_DEBG, "downloadWeatherRecords(): Called" );
 
   // Wake up the weather station
-  term_flush( wsFD );
-  if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
-    if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
-      if ( serialChat( wsFD, "\n", "\n", 5000L, "\n" ) < 1 ) 
-      {
-        LOGPRINT( LVL_CRIT, "downloadWeatherData(): Could not wake "
-                  "up the weather station!" );
-        return( FAILURE );
-      }
+  if ( wakeWeatherStation( wsFD ) < 0 )
+  {
+    LOGPRINT( LVL_CRIT, "downloadWeatherRecords(): Could not wake "
+              "up the weather station!" );
+    return( FAILURE );
+  }
 
   //
-  // Start the archive dump
+  // A mark in the future means the station clock was reset
+  // backwards.  Take the whole archive rather than wait for
+  // the clock to catch up.
   //
-  serialPutLine( wsFD, "DMP\r" );
+  lastRecord = useMark ? readWSLastRecord() : 0;
+  if ( lastRecord > 0 && ( wsTime = getWSTime( wsFD ) ) != NULL )
+  {
+    recordKey = WSRECORDKEY( wsTime->tm_mday + ( wsTime->tm_mon + 1 ) * 32 +
+                               ( wsTime->tm_year - 100 ) * 512,
+                             wsTime->tm_hour * 100 + wsTime->tm_min );
+    if ( lastRecord > recordKey )
+    {
+      LOGPRINT( LVL_WARN, "downloadWeatherRecords(): Last record downloaded "
+                "is newer than the weather station clock. Downloading "
+                "the whole archive." );
+      lastRecord = 0;
+    }
+  }
 
-  // The response is '\r' <ack> 
-  serialGetByte( wsFD, (char *)buffer, 1000L );
-  serialGetByte( wsFD, (char *)buffer, 1000L );
+  //
+  // Start the archive dump
+  //   DMPAFT <ack> 
+  //   dateStamp(2) timeStamp(2) crc(2) <ack>
+  //   numPages(2) startIndex(2) crc(2)
+  //
+  term_flush( wsFD );
+  if ( serialChat( wsFD, "DMPAFT\n", ackStr, 2000L, ackStr ) < 1 )
+  {
+    LOGPRINT( LVL_CRIT, "downloadWeatherRecords(): Weather station did not "
+              "acknowledge the DMPAFT command!" );
+    return( FAILURE );
+  }
+  request[0] = ( lastRecord >> 16 ) & 0xFF;
+  request[1] = ( lastRecord >> 24 ) & 0xFF;
+  request[2] = lastRecord & 0xFF;
+  request[3] = ( lastRecord >> 8 ) & 0xFF;
+  crc = crc16AddData( request, 4, 0 );
+  request[4] = ( crc >> 8 ) & 0xFF;
+  request[5] = crc & 0xFF;
+  serialPutData( wsFD, (char *)request, 6 );
+  if ( serialGetByte( wsFD, (char *)page, 2000L ) < 1 || page[0] != 0x06 )
+  {
+    LOGPRINT( LVL_CRIT, "downloadWeatherRecords(): Weather station rejected "
+              "the DMPAFT time stamp!" );
+    return( FAILURE );
+  }
+  if ( serialGetBlock( wsFD, (char *)page, 6, 2000L ) != 6 ||
+       ( crc16AddData( page, 6, 0 ) & 0xFFFF ) != 0 )
+  {
+    LOGPRINT( LVL_CRIT, "downloadWeatherRecords(): Bad DMPAFT page count "
+              "from the weather station!" );
+    serialPutByte( wsFD, WSESC );
+    return( FAILURE );
+  }
+  numPages = page[0] | ( page[1] << 8 );
+  startIndex = page[2] | ( page[3] << 8 );
+  LOGPRINT( LVL_INFO, "downloadWeatherRecords(): %d new archive pages",
+            numPages );
 
   //
   //  Read archive pages
-  //    1 Byte page index ( since there are 512 pages this goes
-  //                        through all indexes twice )
+  //    1 Byte page sequence number
   //    52 Bytes RevB Data Record
   //    52 Bytes RevB Data Record
   //    52 Bytes RevB Data Record
   //    52 Bytes RevB Data Record
   //    52 Bytes RevB Data Record
   //    4  Bytes Unused
-  //    2  Bytes Checksum 
-  while ( ( bytesRead = 
-               serialGetData( wsFD, (char *)buffer, 267, 4000L ) ) > 0 )
+  //    2  Bytes CRC
+  //
+  //  Records before startIndex in the first page, and any
+  //  after the newest in the last page, are older than the
+  //  time stamp we asked for ( or empty ).
+  //
+  serialPutByte( wsFD, ( numPages > 0 ) ? 0x06 : WSESC );
+  for ( i = 0; i < numPages; i++ )
   {
-    for ( j = 0; j < 5; j++ )
+    if ( getWSPage( wsFD, page ) < 0 )
     {
-      for ( i = 1; i <= 52; i++ )
-      {
-        if ( buffer[(j*52)+i] != 255 )
-          break;
-      }
-      if ( i == 53 && buffer[(j*52)+i] == 255 )
-      {
-        // Empty record
-        if ( lastRecordOnly && numRecords > 0 )
-        {
-          logDMPRecord( outFile, &lastRecord );
-        }
-        break;
-      }else {
-        numRecords++;
-        if ( lastRecordOnly )
-        {
-          // Save the last record
-          memcpy( &lastRecord, &(buffer[(j*52)+1]), 52 );
-        }else
-        {
-          logDMPRecord( outFile, 
-                                 (struct weatherDMPRevB *)&(buffer[(j*52)+1]) );
-        }
-      }
+      LOGPRINT( LVL_CRIT, "downloadWeatherRecords(): Giving up on archive "
+                "page %d of %d.", i + 1, numPages );
+      retValue = FAILURE;
+      break;
     }
-    if ( j < 5 ) 
+    for ( j = ( i == 0 ? startIndex : 0 ); j < WSRECORDSPERPAGE; j++ )
     {
-      break;
+      rec = (struct weatherDMPRevB *)&( page[ 1 + j * WSRECORDLEN ] );
+      if ( rec->dateStamp == 0xFFFF || rec->timeStamp == 0xFFFF )
+        continue;
+      recordKey = WSRECORDKEY( rec->dateStamp, rec->timeStamp );
+      if ( recordKey <= lastRecord )
+        continue;
+      logDMPRecord( outFile, rec );
+      lastRecord = recordKey;
+      numRecords++;
     }
-    term_flush( wsFD );
-    serialPutLine( wsFD, ackStr );
+    serialPutByte( wsFD, ( i + 1 < numPages ) ? 0x06 : WSESC );
   }
-  // Send ESC to end archive transmission early
-  serialPutByte( wsFD, 0x1B );
+  if ( retValue < 0 )
+    serialPutByte( wsFD, WSESC );
   // Just in case it sends back a response
   term_flush( wsFD );
   // Give us some time to relax and take in the weather 
@@ -391,21 +933,25 @@ int downloadWeatherData ( int wsFD, FILE * outFile, int lastRecordOnly )
   sleep( 1 );
 
   //
-  // Clear the archive if we just downloaded the whole thing.  
-  // If we are just peeking at the status then we should
-  // leave it intact.
+  // Only move the mark past records which are safely in the file
   //
-  if ( !lastRecordOnly )
+  if ( numRecords > 0 )
   {
-    if ( serialChat( wsFD, "CLRLOG\n", ackStr, 1000L, ackStr ) < 1 )
+    if ( fflush( outFile ) == 0 )
     {
-      LOGPRINT( LVL_CRIT, "downloadWeatherData(): Failed to clear "
-                "the archive!" );
-      return( FAILURE );
+      if ( useMark )
+        writeWSLastRecord( lastRecord );
+    }else
+    {
+      LOGPRINT( LVL_CRIT, "downloadWeatherRecords(): Could not write the "
+                "weather records!" );
+      retValue = FAILURE;
     }
   }
+  LOGPRINT( LVL_INFO, "downloadWeatherRecords(): Saved %d new records",
+            numRecords );
   
-  return( SUCCESS );
+  return( retValue );
 }
 
 
@@ -421,7 +967,9 @@ int downloadWeatherData ( int wsFD, FILE * outFile, int lastRecordOnly )
 //
 // DESCRIPTION
 //   Get the date and time in UNIX struct tm format from 
-//   the Davis weather station.
+//   the Davis weather station.  A LOOP stream is stopped
+//   first ( see wakeWeatherStation ) so its packets are not
+//   mistaken for the reply.
 //
 // RETURNS
 //   A pointer to a tm structure or NULL upon
@@ -433,6 +981,13 @@ struct tm *getWSTime ( int fd )
   int bytesRead = 0;
   char dataBuff[8];
 
+  if ( wakeWeatherStation( fd ) < 0 )
+  {
+    LOGPRINT( LVL_INFO, "getWSTime(): Could not wake up the weather "
+              "station" );
+    return ( (struct tm *)NULL );
+  }
+
   if ( serialChat( fd, "GETTIME\r", ackStr, 2000L, ackStr ) < 1 )
   {
     LOGPRINT( LVL_INFO, "getWSTime(): Didn't get ACK after sending GETTIME" );
@@ -479,7 +1034,8 @@ struct tm *getWSTime ( int fd )
 //
 // DESCRIPTION
 //   Set the date/time on the Davis weather station to
-//   the values stored in the UNIX tm format.
+//   the values stored in the UNIX tm format.  A LOOP stream
+//   is stopped first ( see wakeWeatherStation ).
 //
 // RETURNS
 //    1 Upon success
@@ -490,6 +1046,9 @@ int setWSTime ( int fd, struct tm *time ) {
   char byte;
   unsigned int crc;
 
+  if ( wakeWeatherStation( fd ) < 0 )
+    return ( -1 );
+
   if ( serialChat( fd, "SETTIME\r", ackStr, 1000L, ackStr ) < 1 )
   {
     return ( -1 );
@@ -528,6 +1087,8 @@ int setWSTime ( int fd, struct tm *time ) {
 //
 // DESCRIPTION
 //   Sync a Davis weather station to the system date and time.  
+//   Stops a running LOOP stream ( see getWSTime/setWSTime );
+//   serviceWeatherLoop restarts it the next time it is called.
 //
 // RETURNS
 //   1 Upon success
@@ -536,6 +1097,7 @@ int setWSTime ( int fd, struct tm *time ) {
 int syncWSTime ( int fd ) {
  time_t now_t;
  struct tm *now_tm;
+ struct tm nowTM;
  time_t was_t;
  struct tm *was_tm;
  int timeOff = 0;
@@ -543,7 +1105,7 @@ int syncWSTime ( int fd ) {
   
  // Get the system time
  now_t = time( NULL );
- now_tm = localtime( &now_t );
+ now_tm = localtime_r( &now_t, &nowTM );
 
  // Get the weather station time
  if ( ( was_tm = getWSTime( fd ) ) == NULL )
@@ -666,3 +1228,17 @@ int logDMPRecord( FILE * outFile, struct weatherDMPRevB *rec )
   return( 1 );
 }
 
+
+//
+// Device driver ( see buoy.c ).  The station logs on its
+// own, so there is no start/stop.
+//
+const struct deviceDriver davisDriver = {
+  .deviceType = DAVIS_WEATHER_STATION,
+  .flags = 0,
+  .init = initializeWeatherStation,
+  .download = downloadWeatherRecords,
+  .syncTime = syncWSTime,
+  .getTime = getWSTime,
+  .setTime = setWSTime
+};
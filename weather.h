@@ -22,6 +22,25 @@
 #ifndef _WEATHER_H
 #define _WEATHER_H
 
+#include <time.h>
+
+
+//
+// Davis archive download ( DMPAFT ).  An archive page holds
+// WSRECORDSPERPAGE records of WSRECORDLEN bytes plus a sequence
+// number, 4 unused bytes and a CRC.  The date/time stamp of the
+// last record saved is kept in WSLASTRECORDFILE ( in the data
+// directory ) and compared as WSRECORDKEY( dateStamp, timeStamp ).
+//
+#define WSLASTRECORDFILE  "weatherLastRecord.txt"
+#define WSPAGELEN         267
+#define WSRECORDLEN       52
+#define WSRECORDSPERPAGE  5
+#define WSPAGERETRIES     3
+#define WSNAK             0x21
+#define WSESC             0x1B
+#define WSRECORDKEY( date, time ) \
+          ( ( (long)( date ) << 16 ) | ( (long)( time ) & 0xFFFF ) )
 
 enum downloadTypes {
   LOGLST,
@@ -379,13 +398,44 @@ struct weatherLOOPRevB {
 
 
 
+//
+// Live weather from the LOOP packet stream.  The console sends a
+// WSLOOPLEN byte LOOP packet every 2 seconds for WSLOOPPACKETS
+// packets; the stream is restarted if it goes quiet for
+// WSLOOPTIMEOUT seconds and serviced every WSLOOPINTERVAL
+// seconds by sleepWeatherLoop.
+//
+#define WSLOOPLEN       sizeof( struct weatherLOOPRevB )
+#define WSLOOPPACKETS   200
+#define WSLOOPTIMEOUT   10
+#define WSLOOPINTERVAL  2
+#define WSLOOPBUFFLEN   1024
+
+struct weatherState {
+  // When the latest packet arrived ( 0 = never )
+  time_t updated;
+  unsigned long numPackets;
+  unsigned long numBadPackets;
+  struct weatherLOOPRevB loop;
+};
+
 int syncWSTime( int fd );
 int setWSTime( int fd, struct tm *time );
 struct tm *getWSTime( int fd );
-int downloadWeatherData( int wsFD, FILE * outFile, int lastRecordOnly );
+int downloadWeatherData( int wsFD, FILE * outFile );
+int downloadWeatherRecords( int wsFD, FILE * outFile, int useMark );
+long readWSLastRecord( void );
+int writeWSLastRecord( long lastRecord );
 int logInstantWeather ( int wsFD, FILE * outFile );
+int startWeatherLoop( int wsFD );
+int serviceWeatherLoop( int wsFD );
+void sleepWeatherLoop( int wsFD, unsigned int seconds );
+const struct weatherState *getWeatherState( void );
+int logWeatherState( FILE * outFile );
 int logDMPRecord( FILE * outFile , struct weatherDMPRevB *rec );
 int initializeWeatherStation( int wsFD );
 
+extern const struct deviceDriver davisDriver;
+
 
 #endif
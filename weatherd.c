@@ -31,6 +31,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <poll.h>
 #include <math.h>
 
 #include <ftdi.h>
@@ -43,20 +46,48 @@
 #include <orcad.h>
 #include <parser.h>
 #include <serial.h>
+#include <timer.h>
+#include <fieldparse.h>
+#include <metstats.h>
+#include <readingbus.h>
+#include <datawriter.h>
 
 #define FAILURE -1
 #define LCKFILE "/var/run/weatherd.pid"
 #define Name "weatherd"
 #define LOGFILE "/usr/local/orcaD/logs/weatherd"
 #define STDERR stderr
-#define METBUFFLEN 256
 
 extern const char *Version;
 struct ftdi_context *ftdic = NULL;
-FILE * fpWeather = NULL;
+struct dataWriter metWriter = { .fd = -1 };   // not open yet
 FILE * fpInstWeather = NULL;
 time_t timeLastArchiveCreated;
 struct s_CombinedWeatherData wData;
+struct s9Parser s9Parser;
+struct binArchive metArchive;
+
+#define TMPMETFILE "/usr/local/orcaD/data/tmpMetFile"
+
+// Binary archive columns, in MET file order after the date
+static const struct binArchiveField metArchiveFields[] = {
+  { "barometer", "inHg", 3 },
+  { "humidity", "%", 2 },
+  { "temperature", "C", 2 },
+  { "dewPoint", "C", 2 },
+  { "instWindDirectionCenterline", "degrees", 2 },
+  { "instWindSpeed", "knots", 2 },
+  { "maxWindDirectionCenterline", "degrees", 2 },
+  { "maxWindSpeed", "knots", 2 },
+  { "instPAR", "umol/m2/s", 2 },
+  { "avgPAR", "umol/m2/s", 2 },
+  { "latitude", "degrees", 2 },
+  { "longitude", "degrees", 2 },
+  { "compassDir", "degrees", 2 },
+  { "instWindDirectionCompass", "degrees", 2 }
+};
+#define NUMMETARCHIVEFIELDS \
+  ( sizeof( metArchiveFields ) / sizeof( struct binArchiveField ) )
 
 
 /*
@@ -297,11 +328,9 @@ int main(int argc, char **argv)
   // Print out the options as we know them
   logOpts( logFile );
 
-  if ( ( fpWeather = fopen("/usr/local/orcaD/data/tmpMetFile", "w" ) ) == NULL )
-  {     
-    LOGPRINT( LVL_EMRG, "Could not open up a new weather file!");
-    cleanup( FAILURE );
-  }
+  // Share our readings with the other daemons
+  if ( attachReadingBus( 1 ) < 0 )
+    LOGPRINT( LVL_WARN, "main(): Readings will not be shared!" );
 
   if ( hasSerialDevice( GILLMETPAK ) > 0 ||
        hasSerialDevice( RMYOUNGWIND ) > 0 ||
@@ -323,6 +352,1054 @@ int main(int argc, char **argv)
 
 
 
+// 
+// NAME
+//   initS9Parser - Reset a Soundnine/Vaisala stream parser.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   void initS9Parser( struct s9Parser *parser );
+//
+// DESCRIPTION
+//   Clear the parser state, the partially assembled line,
+//   the pending record and the last published record.
+//
+void initS9Parser( struct s9Parser *parser )
+{
+  memset( parser, 0, sizeof( struct s9Parser ) );
+  parser->state = S9_IDLE;
+}
+
+
+// 
+// NAME
+//   parseS9Fields - Convert the comma separated values of an S9 line.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int parseS9Fields( char *line, const char *types, ... );
+//
+// DESCRIPTION
+//   If line is a tagged block ( "<S9CD v='1'>...</S9CD>" ) 
+//   only the text between the tags is used, otherwise the 
+//   whole line is.  The values are split on commas and 
+//   converted in place according to types, one character 
+//   per value: 'f' stores to a float *, 'i' to an int *.
+//   The line must hold exactly as many values as types.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int parseS9Fields( char *line, const char *types, ... )
+{
+  char *fields[S9MAXFIELDS];
+  char *body = line;
+  char *end;
+  int numFields;
+  int ret = SUCCESS;
+  int i;
+  va_list ap;
+
+  if ( *line == '<' )
+  {
+    if ( ( body = strchr( line, '>' ) ) == NULL )
+      return( FAILURE );
+    body++;
+    if ( ( end = strchr( body, '<' ) ) != NULL )
+      *end = '\0';
+  }
+
+  numFields = splitFields( body, ',', fields, S9MAXFIELDS );
+  if ( numFields != (int)strlen( types ) )
+    return( FAILURE );
+
+  va_start( ap, types );
+  for ( i = 0; i < numFields && ret == SUCCESS; i++ )
+  {
+    if ( types[i] == 'i' )
+      ret = parseIntField( fields[i], va_arg( ap, int * ) );
+    else
+      ret = parseFloatField( fields[i], va_arg( ap, float * ) );
+  }
+  va_end( ap );
+
+  return( ret );
+}
+
+
+// 
+// NAME
+//   s9ParseLine - Advance the S9 stream parser by one line.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   void s9ParseLine( struct s9Parser *parser, char *line );
+//
+// DESCRIPTION
+//   A <creport> tag starts a new pending record, the S9CD,
+//   S9CRD and PORT1 blocks are decoded into it as they 
+//   complete and </creport> publishes it as the latest 
+//   record.  Lines seen outside of a report ( e.g. when
+//   the daemon starts mid-record ) are counted and 
+//   dropped, as are reports which never received the 
+//   anemometer data, so a published record is always a
+//   whole, consistent one.
+//
+void s9ParseLine( struct s9Parser *parser, char *line )
+{
+  struct s9Record *rec = &(parser->pending);
+  int stype;
+
+  // The anemometer data line is indented in the stream
+  while ( *line == ' ' || *line == '\t' )
+    line++;
+  if ( *line == '\0' )
+    return;
+
+  stype = S9GetSentenceType( line );
+  if ( stype == CREPORT )
+  {
+    if ( parser->state != S9_IDLE )
+      parser->numDiscarded++;
+    memset( rec, 0, sizeof( struct s9Record ) );
+    parser->state = S9_REPORT;
+    return;
+  }
+
+  if ( parser->state == S9_IDLE )
+  {
+    // Waiting for the start of a report
+    return;
+  }
+
+  if ( parser->state == S9_PORT1 )
+  {
+    if ( line[0] == '$' )
+    {
+      if ( parseS9Fields( line + 1, "ffffffffiif",
+                   &(rec->WS), &(rec->WM), &(rec->WP), &(rec->WD),
+                   &(rec->DM), &(rec->DX), &(rec->GU), &(rec->TS), 
+                   &(rec->VA), &(rec->FS), &(rec->VI) ) == SUCCESS )
+        rec->havePORT1 = 1;
+      else
+        LOGPRINT( LVL_DEBG, "s9ParseLine(): Bad PORT1 data: %s", line );
+      return;
+    }
+    if ( stype == PORT1END )
+      parser->state = S9_REPORT;
+    else
+      LOGPRINT( LVL_DEBG, "s9ParseLine(): Unexpected line in PORT1 "
+                "block: %s", line );
+    return;
+  }
+
+  switch ( stype )
+  {
+    case S9CD:
+      if ( parseS9Fields( line, "ffiffffii",
+                   &(rec->PSI), &(rec->INC), &(rec->MAG), &(rec->THETA),
+                   &(rec->PHI), &(rec->TILT), &(rec->TEMP), &(rec->RATE),
+                   &(rec->NS) ) == SUCCESS )
+        rec->haveS9CD = 1;
+      break;
+
+    case S9CRD:
+      if ( parseS9Fields( line, "fffffffi",
+                   &(rec->MX), &(rec->MY), &(rec->MZ), &(rec->AX),
+                   &(rec->AY), &(rec->AZ), &(rec->rawTEMP), 
+                   &(rec->rawNS) ) == SUCCESS )
+        rec->haveS9CRD = 1;
+      break;
+
+    case PORT1:
+      parser->state = S9_PORT1;
+      break;
+
+    case CREPORTEND:
+      parser->state = S9_IDLE;
+      if ( rec->havePORT1 )
+      {
+        time( &(rec->completed) );
+        parser->latest = *rec;
+        parser->numRecords++;
+        parser->fresh = 1;
+      }else
+        parser->numDiscarded++;
+      break;
+
+    default:
+      LOGPRINT( LVL_DEBG, "s9ParseLine(): Unknown sentence: %s", line );
+      break;
+  }
+}
+
+
+// 
+// NAME
+//   s9ParserAddData - Feed raw S9 port data to the parser.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int s9ParserAddData( struct s9Parser *parser, const char *data,
+//                        int len );
+//
+// DESCRIPTION
+//   Assemble newline terminated lines across calls and hand
+//   each one to s9ParseLine().  Every byte is looked at
+//   exactly once and nothing is ever flushed, so the parser
+//   can be fed whatever read() returned.  A line which does
+//   not fit in METBUFFLEN is garbage ( a lost terminator or
+//   line noise ) and is dropped through its next newline
+//   rather than parsed as a truncated sentence.
+//
+// RETURNS
+//   The number of records published by this call.
+//
+int s9ParserAddData( struct s9Parser *parser, const char *data, int len )
+{
+  unsigned long numRecords = parser->numRecords;
+  int i;
+
+  for ( i = 0; i < len; i++ )
+  {
+    if ( data[i] == '\r' )
+      continue;
+    if ( data[i] == '\n' )
+    {
+      if ( parser->overflow )
+        parser->overflow = 0;
+      else
+      {
+        parser->line[parser->lineLen] = '\0';
+        s9ParseLine( parser, parser->line );
+      }
+      parser->lineLen = 0;
+      continue;
+    }
+    if ( parser->overflow )
+      continue;
+    if ( parser->lineLen >= METBUFFLEN - 1 )
+    {
+      LOGPRINT( LVL_DEBG, "s9ParserAddData(): Line too long - discarding "
+                "through the next newline" );
+      parser->overflow = 1;
+      parser->lineLen = 0;
+      continue;
+    }
+    parser->line[parser->lineLen++] = data[i];
+  }
+
+  return( (int)( parser->numRecords - numRecords ) );
+}
+
+
+// 
+// NAME
+//   drainS9Port - Keep the S9 stream parser current.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int drainS9Port( int fd, struct s9Parser *parser, long timeout );
+//
+// DESCRIPTION
+//   Feed everything arriving on the S9 port to the parser
+//   for timeout milliseconds ( a timeout of zero consumes
+//   only what is already waiting ).  Used in place of a
+//   plain sleep between samples so records are stamped
+//   close to the time they were produced and the port's
+//   input queue never backs up.
+//
+// RETURNS
+//   -1 : Failure
+//   The number of records published.
+//
+int drainS9Port( int fd, struct s9Parser *parser, long timeout )
+{
+  struct pollfd pfd;
+  struct timeval startTime;
+  char buff[METBUFFLEN];
+  ssize_t bytesRead;
+  long remaining;
+  int numRecords = 0;
+  int ret;
+
+  gettimeofday( &startTime, NULL );
+  for (;;)
+  {
+    remaining = timeout - getMilliSecSince( &startTime );
+    if ( remaining < 0 )
+      remaining = 0;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ret = poll( &pfd, 1, (int)remaining );
+    if ( ret < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+      LOGPRINT( LVL_WARN, "drainS9Port(): poll() failed: %s", 
+                strerror( errno ) );
+      return( FAILURE );
+    }
+    if ( ret == 0 )
+      break;
+    bytesRead = read( fd, buff, sizeof( buff ) );
+    if ( bytesRead < 0 )
+    {
+      if ( errno == EINTR || errno == EAGAIN )
+        continue;
+      LOGPRINT( LVL_WARN, "drainS9Port(): Read failed: %s", 
+                strerror( errno ) );
+      return( FAILURE );
+    }
+    if ( bytesRead == 0 )
+      break;
+    numRecords += s9ParserAddData( parser, buff, (int)bytesRead );
+  }
+
+  return( numRecords );
+}
+
+
+// 
+// NAME
+//   startMetReader - Prepare a met device for a concurrent sample.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   void startMetReader( struct metReader *reader, int fd,
+//                        int deviceType );
+//
+// DESCRIPTION
+//   Reset the reader state, flush any stale input on the
+//   port and send the device its sample query.  The METPAK
+//   and R.M. Young are polled ( "?Q" and "MA!" ).  The S9
+//   streams its reports unprompted and its port is never
+//   flushed; the reader is done right away if the stream 
+//   parser already holds a record that hasn't been used.
+//   The reader timeout is the time the device was given 
+//   when the sensors were read one after another ( both
+//   read attempts ).
+//
+void startMetReader( struct metReader *reader, int fd, int deviceType )
+{
+  memset( reader, 0, sizeof( struct metReader ) );
+  reader->fd = fd;
+  reader->deviceType = deviceType;
+
+  if ( deviceType == S9VAISALA )
+  {
+    // One report period plus a little
+    reader->timeout = 12000L;
+    drainS9Port( fd, &s9Parser, 0L );
+    if ( s9Parser.fresh )
+    {
+      reader->done = 1;
+      reader->sampleTime = s9Parser.latest.completed;
+    }
+    return;
+  }
+
+  // Flush and resync ourselves on a line
+  term_flush( fd );
+  switch ( deviceType )
+  {
+    case GILLMETPAK:
+      serialPutLine( fd, "?Q" );
+      reader->timeout = 7000L;
+      break;
+    case RMYOUNGWIND:
+      serialPutLine( fd, "MA!" );
+      reader->timeout = 2000L;
+      break;
+    default:
+      reader->timeout = 1000L;
+      break;
+  }
+}
+
+
+// 
+// NAME
+//   metReaderAddLine - Offer a received line to a met reader.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int metReaderAddLine( struct metReader *reader, char *line );
+//
+// DESCRIPTION
+//   Keep the line if it belongs to the sample being collected
+//   and mark the reader done ( stamping it with the current
+//   time ) once the sample is complete.  The METPAK and 
+//   R.M. Young reply with a single line; short lines are 
+//   echoes or noise and are ignored as the two attempt 
+//   serialGetLine() reads used to.
+//
+// RETURNS
+//   1 if the reader now holds a complete sample, 0 otherwise.
+//
+int metReaderAddLine( struct metReader *reader, char *line )
+{
+  int len = strlen( line );
+
+  if ( reader->done )
+    return( 1 );
+
+  switch ( reader->deviceType )
+  {
+    case GILLMETPAK:
+      if ( len < 30 )
+        return( 0 );
+      break;
+    case RMYOUNGWIND:
+      if ( len < 10 )
+        return( 0 );
+      break;
+  }
+
+  strncpy( reader->line, line, METBUFFLEN - 1 );
+  reader->line[METBUFFLEN - 1] = '\0';
+  reader->done = 1;
+  time( &(reader->sampleTime) );
+
+  return( reader->done );
+}
+
+
+// 
+// NAME
+//   pollMetReaders - Collect samples from all met devices at once.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int pollMetReaders( struct metReader *readers, int numReaders );
+//
+// DESCRIPTION
+//   Wait on every reader's port with a single poll() and
+//   assemble newline terminated lines per port as the data
+//   arrives.  Each reader is finished when it holds a 
+//   complete sample or its own timeout expires, so a slow
+//   or silent sensor no longer delays the others and the
+//   whole pass takes as long as the slowest device rather
+//   than the sum of them all.  A partial line left on a 
+//   timed out port is offered to the reader as is, just 
+//   as serialGetLine() would have returned it.  The S9 
+//   port's data goes straight to the stream parser and
+//   its reader is done once a new record is published.
+//
+// RETURNS
+//   -1 : Failure
+//   The number of readers holding a complete sample.
+//
+int pollMetReaders( struct metReader *readers, int numReaders )
+{
+  struct pollfd fds[MAXMETREADERS];
+  int readerIdx[MAXMETREADERS];
+  struct timeval startTime;
+  struct metReader *reader;
+  char buff[METBUFFLEN];
+  ssize_t bytesRead;
+  long elapsed;
+  long waitTime;
+  int nfds;
+  int numDone;
+  int ret;
+  int i, j;
+
+  if ( numReaders > MAXMETREADERS )
+    numReaders = MAXMETREADERS;
+
+  gettimeofday( &startTime, NULL );
+  for (;;)
+  {
+    elapsed = getMilliSecSince( &startTime );
+    nfds = 0;
+    waitTime = -1;
+    for ( i = 0; i < numReaders; i++ )
+    {
+      reader = &readers[i];
+      if ( reader->done || reader->timedOut )
+        continue;
+      if ( elapsed >= reader->timeout )
+      {
+        reader->timedOut = 1;
+        if ( reader->partialLen > 0 )
+          metReaderAddLine( reader, reader->partial );
+        if ( ! reader->done )
+          LOGPRINT( LVL_WARN, "pollMetReaders(): Timed out waiting for "
+                    "device %d after %ld ms.", reader->deviceType,
+                    reader->timeout );
+        continue;
+      }
+      fds[nfds].fd = reader->fd;
+      fds[nfds].events = POLLIN;
+      fds[nfds].revents = 0;
+      readerIdx[nfds] = i;
+      nfds++;
+      if ( waitTime < 0 || reader->timeout - elapsed < waitTime )
+        waitTime = reader->timeout - elapsed;
+    }
+    if ( nfds == 0 )
+      break;
+
+    ret = poll( fds, nfds, (int)waitTime );
+    if ( ret < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+      LOGPRINT( LVL_WARN, "pollMetReaders(): poll() failed: %s", 
+                strerror( errno ) );
+      return( FAILURE );
+    }
+
+    for ( i = 0; i < nfds; i++ )
+    {
+      if ( ! ( fds[i].revents & ( POLLIN | POLLERR | POLLHUP ) ) )
+        continue;
+      reader = &readers[readerIdx[i]];
+      bytesRead = read( reader->fd, buff, sizeof( buff ) );
+      if ( bytesRead < 0 )
+      {
+        if ( errno != EINTR && errno != EAGAIN )
+        {
+          LOGPRINT( LVL_WARN, "pollMetReaders(): Read from device %d "
+                    "failed: %s", reader->deviceType, strerror( errno ) );
+          reader->timedOut = 1;
+        }
+        continue;
+      }
+      if ( reader->deviceType == S9VAISALA )
+      {
+        s9ParserAddData( &s9Parser, buff, (int)bytesRead );
+        if ( s9Parser.fresh )
+        {
+          reader->done = 1;
+          reader->sampleTime = s9Parser.latest.completed;
+        }
+        continue;
+      }
+      for ( j = 0; j < bytesRead && ! reader->done; j++ )
+      {
+        reader->partial[reader->partialLen++] = buff[j];
+        reader->partial[reader->partialLen] = '\0';
+        if ( buff[j] == '\n' || reader->partialLen >= METBUFFLEN - 1 )
+        {
+          metReaderAddLine( reader, reader->partial );
+          reader->partialLen = 0;
+          reader->partial[0] = '\0';
+        }
+      }
+    }
+  }
+
+  numDone = 0;
+  for ( i = 0; i < numReaders; i++ )
+    if ( readers[i].done )
+      numDone++;
+  return( numDone );
+}
+
+
+// 
+// NAME
+//   parseMetpakSample - Parse a GILL METPAK "?Q" reply.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int parseMetpakSample( struct metReader *reader,
+//                          struct s_CombinedWeatherData *wData );
+//
+// DESCRIPTION
+//   Save the barometer ( converted from hectoPascals to
+//   inches of mercury ), relative humidity, air temperature 
+//   and dewpoint into wData.
+//
+//   Example: <STX>Q,,,1010.3,036.0,+027.6,+011.1,,+9998.0007,+9998.0005,0000.000,+12.0,0B,<EXT>11<CRLF>
+//
+//   Columns:
+//   NODE,DIR,SPEED,PRESS,RH,TEMP,DEWPOINT,PRT,AN1,AN2,DIG1,VOLT,STATUS,CHECK
+//   Note: columns are comma separated, missing values are empty fields between commas
+//     <STX>: start of string (ASCII value 2)
+//     Node PollAddress: Q by default
+//     Wind Direction: degrees, valid only if anemometer is installed
+//     WindSpeed   : meters/second, valid only if anemometer is installed
+//     Barometric Pressure: hectoPascals
+//     Relative Humidity: percent
+//     Air Temperature: degrees Celcius
+//     Dewpoint: degrees Celcius
+//     Platinum Resistive Temperature: valid only if PRT is installed
+//     Analog voltage 1: auxiliary analog channel
+//     Analog voltage 2: auxiliary analog channel
+//     Digital signal 1: auxiliary digital channel
+//     Source voltage: volts
+//     Status: 
+//     Checksum:
+//
+// RETURNS
+//   -1 : Failure ( no reply received or it is too short )
+//    1 : Success
+//
+int parseMetpakSample( struct metReader *reader, 
+                       struct s_CombinedWeatherData *wData )
+{
+  char buffer[METBUFFLEN];
+  char *fields[METPAK_MAXFIELDS];
+  int numFields = 0;
+
+  if ( ! reader->done )
+  {
+    LOGPRINT( LVL_WARN, "Failed receiving after ?Q command." );
+    return( FAILURE );
+  }
+  strcpy( buffer, reader->line );
+  wData->metSampleTime = reader->sampleTime;
+
+  // parse buffer
+  // 
+  // old conversion:  1 hectoPascal = 0.0296133971008484 inches of mercury
+  // According to the NIST Special Pub. 811 
+  //	(http://physics.nist.gov/cuu/pdf/sp811.pdf)
+  // 1 inhg = 3.38638 kilo Pascals = 33.8638 hectoPascals @ 0 deg C.
+  // 1 hectoPascal = 0.0295300586466965 inhg
+  // NOTE: using one scanf doesn't work with a CSV line with optional
+  //       values.  I.e "###,###,,####" would through off the scanf
+  //       pointers and it would terminate early.  splitFields() keeps
+  //       the empty fields so the values are picked out by column.
+  numFields = splitFields( buffer, ',', fields, METPAK_MAXFIELDS );
+  if ( numFields <= METPAK_DEWPOINT )
+  {
+    LOGPRINT( LVL_WARN, "Short reply from metpak ( %d fields )!", 
+              numFields );
+    return( FAILURE );
+  }
+  // Barometric Pressure
+  if ( parseFloatField( fields[METPAK_PRESS], 
+                        &(wData->inchesBarometricPressure) ) == SUCCESS )
+    // convert from hectoPascals to inches of mercury
+    wData->inchesBarometricPressure *= 0.0295300586466965;
+  else
+    LOGPRINT( LVL_WARN, "Failed to parse barometic pressure from "
+           "metpak!" );
+  // Relative Humidity
+  if ( parseFloatField( fields[METPAK_RH], &(wData->pctHumidity) ) 
+       != SUCCESS )
+    LOGPRINT( LVL_WARN, "Failed to parse relative humidity from "
+           "metpak!" );
+  // Temperature
+  if ( parseFloatField( fields[METPAK_TEMP], &(wData->temperatureCelsius) ) 
+       != SUCCESS )
+    LOGPRINT( LVL_WARN, "Failed to parse temperature from "
+           "metpak!" );
+  // Dewpoint
+  if ( parseFloatField( fields[METPAK_DEWPOINT], &(wData->dewpointCelsius) )
+       != SUCCESS )
+    LOGPRINT( LVL_WARN, "Failed to parse dewpoint from "
+           "metpak!" );
+
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   parseRMYoungSample - Parse an R.M. Young "MA!" reply.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int parseRMYoungSample( struct metReader *reader,
+//                           struct s_CombinedWeatherData *wData );
+//
+// DESCRIPTION
+//   Save the wind speed ( knots ), true and centerline wind
+//   direction and compass heading into wData.
+//
+//   Example: A 0000 3470 0000 0000 0007 0008 3520 3550
+//
+//   Columns:
+//     PollAddress : Address of the 32500 RM Young compass unit
+//     WindSpeed   : Wind speed from the 85106 RM Young Anemometer in RAW counts.
+//                   NOTE: This needs to be converted to units using the
+//                         following conversion factors.  Note...the wrong conversions
+//                         were used originally, from an outdated manual, specifically we used
+//                         the conversion 0.09526 for counts to knots instead of 0.1943.  Old 
+//                         conversions are listed below for reference purposes, with new conversions
+//                         listed below.
+//                           m/s: 0.04903 (old)
+//                           mph: 0.1097 (old)
+//                           knots: 0.09526 (old)
+//                           km/hr: 0.1765 (old)
+//                         correct conversions (from manual 35200-90S)
+//                           m/s: 0.1000 (new)
+//                           mph: 0.2237 (new)
+//                           knots: 0.1943 (new)
+//                           km/hr: 0.3600 (new)
+//     CorrectedWindDirection*10 : Wind direction from anemomter corrected using the
+//                                 electronic compass, multplied by 10.
+//     VIN1         : Unused voltage input.
+//     VIN2         : Unused voltage input.
+//     VIN3         : Voltage from anemomter V1.
+//     VIN4         : Voltage form anemomter V2.
+//     CompassDirection*10 :  Compass direction in degrees, multplied by 10.
+//     UncorrectedWindDirection : Wind direction relative to centerline in degrees, multiplied by 10.
+//
+// RETURNS
+//   -1 : Failure ( no reply received or it could not be parsed )
+//    1 : Success
+//
+int parseRMYoungSample( struct metReader *reader,
+                        struct s_CombinedWeatherData *wData )
+{
+  int instWindSpeed = 0;
+  int instWindDirectionTrue = 0;
+  int instWindDirectionCenterline = 0;
+  int compassDir = 0;
+  char buffer[METBUFFLEN];
+  char *fields[RMYOUNG_NUMFIELDS + 1];
+
+  if ( ! reader->done )
+  {
+    LOGPRINT( LVL_WARN, "Failed receiving after MA! command." );
+    return( FAILURE );
+  }
+  wData->windSampleTime = reader->sampleTime;
+
+  LOGPRINT( LVL_DEBG, "buffer line: %s", reader->line);
+  strcpy( buffer, reader->line );
+  if ( splitWords( buffer, fields, RMYOUNG_NUMFIELDS + 1 ) 
+         != RMYOUNG_NUMFIELDS ||
+       strcmp( fields[0], "A" ) != 0 ||
+       parseIntField( fields[1], &instWindSpeed ) != SUCCESS ||
+       parseIntField( fields[2], &instWindDirectionTrue ) != SUCCESS ||
+       parseIntField( fields[7], &compassDir ) != SUCCESS ||
+       parseIntField( fields[8], &instWindDirectionCenterline ) != SUCCESS )
+  {
+    LOGPRINT( LVL_WARN, "Failed to parse reply to MA! command." );
+    return( FAILURE );
+  }
+
+  // convert from raw counts to knots
+  wData->instWindSpeed = (float)instWindSpeed * 0.1943;
+  LOGPRINT( LVL_DEBG, "wind speed: %f vs %d", wData->instWindSpeed, instWindSpeed);
+
+  // convert true wind direction to degrees by dividing by 10.  
+  wData->instWindDirectionTrue = ((float)instWindDirectionTrue / 10);
+  LOGPRINT( LVL_DEBG, "wind direction: %f vs %d", wData->instWindDirectionTrue, instWindDirectionTrue);
+
+  // convert compass reading to degrees by dividing by 10
+  wData->compassDir = (float)compassDir / 10;
+  LOGPRINT( LVL_DEBG, "compass: %f vs %d", wData->compassDir, compassDir);
+
+  // convert centerline wind direction to degrees by dividing by 10
+  wData->instWindDirectionCenterline =  (float)instWindDirectionCenterline / 10;
+  LOGPRINT( LVL_DEBG, "wind direction centerline: %f vs %d", wData->instWindDirectionCenterline, instWindDirectionCenterline);
+
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   parseS9Sample - Parse a Soundnine/Vaisala <creport> block.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int parseS9Sample( struct metReader *reader,
+//                      struct s_CombinedWeatherData *wData );
+//
+// DESCRIPTION
+//   Save the compass heading and attitude ( S9CD ) and the
+//   Vaisala wind data ( PORT1 ) into wData and derive the
+//   true wind direction from the centerline direction and
+//   compass heading.
+//
+//   Example: 
+//     <creport v='1' t='11'>
+//     <S9CD v='1'>185.10,59.65,502,6.93,-86.19,86.20,17.72,1,3</S9CD>
+//     <S9CRD v='1'>-303.33, -398.67, 50.00, -127.67, -1042.67, 69.67, -36.00,  3</S9CRD>
+//     <PORT1>
+//            $999.00,999.00,999.00,999.00,00.00,99.90,0,0,0,0,13.0
+//     </PORT1>
+//     </creport>
+//
+//   The blocks are decoded by the stream parser ( see
+//   s9ParseLine() ) and this takes the latest record it
+//   published.
+//
+//   S9CD = processed data from Soundnine compass module
+//     <S9CD v='1'>185.10,59.65,502,6.93,-86.19,86.20,17.72,1,3</S9CD>
+//     PSI, INC, MAG, THETA, PHI, TILT, TEMP, RATE, NS
+//       PSI: compass heading (rotation around z axis), degrees
+//            *** saved as wData.CompassDir
+//       INC: Angle of the magnetic vector from the XY plane, degrees
+//       MAG: Magnitude of the magnetic vector, gauss
+//       THETA: Rotation around y axis, degrees
+//       PHI: Rotation around the x axis, degrees
+//       TILT: Angle of the acceleration vector from the XY plane
+//       TEMP: Approximate sensor temperature, degrees C
+//       RATE: Sensor sampling rate, Hz
+//       NS: Number os samples in current sample period.  The number of seconds
+//           in the sample period = NS/RATE
+//   S9CRD = raw data from Soundnine compass module
+//     <S9CRD v='1'>-303.33, -398.67, 50.00, -127.67, -1042.67, 69.67, -36.00,  3</S9CRD>
+//       MX: Raw magnetometer x value, gauss
+//       MY: Raw magnetometer y value, gauss
+//       MZ: Raw magnetometer z value, gauss
+//       AX: Raw accelerometer x value, (g)
+//       AY: Raw accelerometer y value, (g)
+//       AZ: Raw accelerometer z value, (g)
+//       TEMP: Approximate sensor temperature, degrees C
+//       NS: Number os samples in current sample period.  The number of seconds
+//           in the sample period = NS/RATE
+//   PORT1 = data from Vaisala anemomoeter
+//     <PORT1> 
+//            $999.00,999.00,999.00,999.00,00.00,99.90,0,0,0,0,13.0
+//     </PORT1>
+//       WS: Wind speed, average, m/s
+//           *** saved as wData.instWindSpeed
+//       WM: Wind speed, minimum, m/s
+//       WP: Wind speed, maximum, m/s
+//       WD: Wind direction, average, degrees
+//           *** saved as wData.instWindDirectionCenterline
+//       DM: Wind direction minimum, average, degrees
+//       DX: Wind direction maximum, average, degrees
+//       GU: Wind gust speed, m/s
+//       TS: Sonic temperature, degrees C
+//       VA: Validity of the measurement data
+//         0 = Unable to measure
+//         1 = Valid wind measurement data
+//       FS: Error codes:
+//         0 = no error
+//         1 = Wind speed exceeds operating limits
+//         2 = Sonic temperature exceed operating limits
+//         3 = Wind speed and sonic temp exceed operating limits
+//       VI: Supply voltage, volts		
+//
+// RETURNS
+//   -1 : Failure ( no report received or no valid wind data )
+//    1 : Success
+//
+int parseS9Sample( struct metReader *reader,
+                   struct s_CombinedWeatherData *wData )
+{
+  struct s9Record *rec = &(s9Parser.latest);
+
+  if ( ! reader->done )
+  {
+    LOGPRINT( LVL_WARN, "Failed receiving a complete report from the "
+              "S9 device." );
+    return( FAILURE );
+  }
+  s9Parser.fresh = 0;
+  wData->windSampleTime = rec->completed;
+
+  if ( rec->haveS9CD )
+  {
+    wData->compassDir = rec->PSI;
+    wData->INC = rec->INC;
+    wData->MAG = rec->MAG;
+    wData->THETA = rec->THETA;
+    wData->PHI = rec->PHI;
+    wData->TILT = rec->TILT;
+    wData->TEMP = rec->TEMP;
+    wData->RATE = rec->RATE;
+    wData->NS = rec->NS;
+    LOGPRINT (LVL_DEBG, "Compass: %f", wData->compassDir);
+  }
+
+  wData->instWindSpeed = rec->WS;
+  wData->WM = rec->WM;
+  wData->WP = rec->WP;
+  wData->instWindDirectionCenterline = rec->WD;
+  wData->DM = rec->DM;
+  wData->DX = rec->DX;
+  wData->GU = rec->GU;
+  wData->TS = rec->TS;
+  wData->VA = rec->VA;
+  wData->FS = rec->FS;
+  wData->VI = rec->VI;
+  LOGPRINT (LVL_DEBG, "windSpeed: %f, windDirection: %f",wData->instWindSpeed, wData->instWindDirectionCenterline); 
+
+  if ( wData->instWindSpeed >= 900 )
+    return( FAILURE );
+
+  wData->instWindDirectionTrue = wData->instWindDirectionCenterline + wData->compassDir;
+  if ( wData->instWindDirectionTrue < 0 )
+    wData->instWindDirectionTrue = 360 + wData->instWindDirectionTrue;
+  if ( wData->instWindDirectionTrue > 360 )
+    wData->instWindDirectionTrue = wData->instWindDirectionTrue - 360;
+
+  return( SUCCESS );
+}
+
+
+
+/*************************************************************************/
+
+
+
+// 
+// NAME
+//   printStatusWindow - Write a window's summary to the status file.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   void printStatusWindow( FILE *fp, char *prefix, 
+//                           struct metWindow *window );
+//
+// DESCRIPTION
+//   Write the vector mean wind direction, mean wind speed,
+//   its standard deviation, the gust and its direction and
+//   the mean and integrated PAR for the window.  Each name
+//   is prefixed with prefix ( and capitalized to match ), so
+//   an empty prefix gives the original weather-status.dat 
+//   names.  Values with no samples are written as -555.
+//
+void printStatusWindow( FILE *fp, char *prefix, struct metWindow *window )
+{
+  double speed = -555;
+  double direction = -555;
+  int hasPrefix = ( prefix[0] != '\0' );
+
+  if ( metWindMean( &(window->wind), &speed, &direction ) == SUCCESS )
+    speed = window->wind.speed.mean;
+
+  fprintf( fp, "%s%cindDirection = %.1f degrees\n", prefix, 
+           hasPrefix ? 'W' : 'w', direction );
+  fprintf( fp, "%s%cindSpeed = %.1f knots\n", prefix, 
+           hasPrefix ? 'W' : 'w', speed );
+  fprintf( fp, "%s%caxWindDirection = %.1f degrees\n", prefix, 
+           hasPrefix ? 'M' : 'm', 
+           window->wind.speed.n ? window->wind.gustDirection : -555 );
+  fprintf( fp, "%s%caxWindSpeed = %.1f knots\n", prefix, 
+           hasPrefix ? 'M' : 'm', 
+           window->wind.speed.n ? window->wind.gustSpeed : -555 );
+  fprintf( fp, "%s%cindSpeedStdDev = %.2f knots\n", prefix, 
+           hasPrefix ? 'W' : 'w', 
+           metAccumStdDev( &(window->wind.speed), -555 ) );
+  fprintf( fp, "%s%cvgPAR = %.1f umol/s*meter^2\n", prefix, 
+           hasPrefix ? 'A' : 'a', metAccumMean( &(window->par), -555 ) );
+  fprintf( fp, "%sPARDose = %.4f mol/meter^2\n", prefix, 
+           window->parDose / 1000000.0 );
+}
+
+
+// 
+// NAME
+//   openMetArchive - Start the binary companion to the MET file.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   int openMetArchive( const char *fileHeader, int writerState,
+//                       const char *recoverName );
+//
+// DESCRIPTION
+//   Create the temporary binary archive which is renamed
+//   along with the temporary MET file.  The MET file's 
+//   header is kept as the archive's description.  A 
+//   failure is logged but does not stop the text logging.
+//   writerState is what openDataWriter() did with the MET
+//   file: if it was resumed the archive left with it is 
+//   resumed too, if it was moved to recoverName so is the
+//   archive.
+//
+// RETURNS
+//   -1 : Failure
+//    1 : Success
+//
+int openMetArchive( const char *fileHeader, int writerState,
+                    const char *recoverName )
+{
+  char archiveFile[FILEPATHMAX + sizeof( BINARC_SUFFIX )];
+
+  if ( writerState == DATAWRITER_RESUMED &&
+       resumeBinArchive( &metArchive, TMPMETFILE BINARC_SUFFIX,
+                         metArchiveFields, NUMMETARCHIVEFIELDS ) == SUCCESS )
+    return( SUCCESS );
+
+  if ( writerState == DATAWRITER_RECOVERED && recoverName != NULL )
+  {
+    snprintf( archiveFile, sizeof( archiveFile ), "%s%s", recoverName, BINARC_SUFFIX );
+    rename( TMPMETFILE BINARC_SUFFIX, archiveFile );
+  }
+
+  if ( createBinArchive( &metArchive, TMPMETFILE BINARC_SUFFIX, fileHeader,
+                         metArchiveFields, NUMMETARCHIVEFIELDS ) < 0 )
+  {
+    LOGPRINT( LVL_WARN, "openMetArchive(): Could not start the binary "
+                        "MET archive!" );
+    return( FAILURE );
+  }
+  return( SUCCESS );
+}
+
+
+// 
+// NAME
+//   saveMetArchive - Close and rename the binary MET archive.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   void saveMetArchive( const char *dataLogFile );
+//
+// DESCRIPTION
+//   Write the archive's index and move it next to the MET 
+//   file dataLogFile ( as dataLogFile.bin ).
+//
+void saveMetArchive( const char *dataLogFile )
+{
+  char archiveFile[FILEPATHMAX + sizeof( BINARC_SUFFIX )];
+
+  if ( metArchive.fp == NULL )
+    return;
+  syncBinArchive( &metArchive, opts.dataSyncPolicy != DATASYNC_NONE );
+  closeBinArchive( &metArchive );
+  snprintf( archiveFile, sizeof( archiveFile ), "%s%s", dataLogFile, BINARC_SUFFIX );
+  rename( TMPMETFILE BINARC_SUFFIX, archiveFile );
+}
+
+
+// 
+// NAME
+//   makeMetFileName - Name the MET file saved at a given time.
+//
+// SYNOPSIS
+//   #include "weatherd.h"
+//
+//   void makeMetFileName( char *dataLogFile, time_t when );
+//
+// DESCRIPTION
+//   Fill dataLogFile ( FILEPATHMAX long ) with the data 
+//   directory path of the MET file saved at when, creating
+//   the data directory if necessary.
+//
+void makeMetFileName( char *dataLogFile, time_t when )
+{
+  struct tm *whenTM;
+
+  updateDataDir();
+  whenTM = localtime( &when );
+  snprintf( dataLogFile, FILEPATHMAX, "%s/%s%04d%02d%02d%02d%02d.MET", 
+            opts.dataSubDirName, opts.weatherDataPrefix,
+            whenTM->tm_year + 1900, whenTM->tm_mon + 1, whenTM->tm_mday,
+            whenTM->tm_hour, whenTM->tm_min );
+}
+
+
 int wsMonitor( )
 {
   int metPort = -1;
@@ -336,31 +1413,38 @@ int wsMonitor( )
   char nowStr[80];
   char weatherStatFile[FILEPATHMAX];
   char dataLogFile[FILEPATHMAX];
-  char buffer[METBUFFLEN];
+  struct metReader metReaders[MAXMETREADERS];
+  int numReaders = 0;
+  int ret;
   int instWeatherCounter = 0;
   float srad = 0;
-  float sradTotal = 0.0;
-  int sradCount = 0;
-  float windSpeedTotal = -1;
-  float maxWindSpeed = -1;
-  float maxWindSpeedDirection = -1;  
-  float windDirectionTrueTotal = -1;
-  int numScanned = 0;
-  int dummyInt;   // Used as dummy fields in scanf
   int i;
-  char *token = NULL;
-  int instWindSpeed = 0;
-  int instWindDirectionTrue = 0;
-  int instWindDirectionCenterline = 0;
-  int compassDir = 0;
   int windCompass = 0;
   float PARumolPerMeterSquared = 0.0;
-  double math_degT, rad, u_mean, v_mean, NEWrad, NEW_degT;
-  double NEWmag = 0;
-  float windVectorUTotal = -1;
-  float windVectorVTotal = -1;
+  double instU, instV;
+  struct metStats stats;
+  struct metWindow lastHour;
+  long windowLengths[NUMMETWINDOWS];
+  struct periodicTimer sampleTimer;
+  time_t nextMetTime;
+  long metPeriod;
+  long waitMs;
+  int skipped;
+  int rotated;
   char *fileHeader = NULL;
+  float archiveValues[NUMMETARCHIVEFIELDS];
+  struct stat tmpStat;
  
+  // The sensors below each add to the header.  It must 
+  // come out the same every time for openDataWriter() to
+  // resume a MET file after a crash.
+  if ( ( fileHeader = calloc( 1, sizeof(char) ) ) == NULL )
+  {
+    LOGPRINT( LVL_EMRG, "wsMonitor(): Could not allocate memory for the "
+              "file header!");
+    cleanup( FAILURE );
+  }
+
   if ( hasSerialDevice( GILLMETPAK  ) > 0 )
   {
      LOGPRINT( LVL_DEBG, "wsMonitor(): Have a GILLMETPAK!");  
@@ -421,6 +1505,7 @@ int wsMonitor( )
       LOGPRINT( LVL_EMRG, "wsMonitor(): Could not open up wind device!");
       cleanup( FAILURE );
     }
+    initS9Parser( &s9Parser );
   }
 
 
@@ -448,8 +1533,20 @@ int wsMonitor( )
   }
   strcat( fileHeader, fieldDesc );
 
-  // Write header to file
-  fprintf( fpWeather,"%s", fileHeader);
+  // Start the MET file, or pick up the one we were writing
+  // before a crash.  A crashed file with a different header 
+  // is saved under the time it was last written.
+  if ( stat( TMPMETFILE, &tmpStat ) != 0 )
+    tmpStat.st_mtime = time( NULL );
+  makeMetFileName( dataLogFile, tmpStat.st_mtime );
+  if ( ( ret = openDataWriter( &metWriter, TMPMETFILE, fileHeader, 
+                               opts.dataCommitInterval, opts.dataSyncPolicy,
+                               dataLogFile ) ) < 0 )
+  {     
+    LOGPRINT( LVL_EMRG, "Could not open up a new weather file!");
+    cleanup( FAILURE );
+  }
+  openMetArchive( fileHeader, ret, dataLogFile );
 
   // Last minute initializations
   time( &nowTimeT );  
@@ -459,43 +1556,82 @@ int wsMonitor( )
 
   clearCombinedWeatherData( &wData );
 
+  // The MET line and status file windows are closed as
+  // those products are written, the hourly one on time.
+  windowLengths[METWIN_MET] = 0;
+  windowLengths[METWIN_STATUS] = 0;
+  windowLengths[METWIN_HOUR] = 3600;
+  initMetStats( &stats, windowLengths, NUMMETWINDOWS, nowTimeT );
+  memset( &lastHour, 0, sizeof( struct metWindow ) );
+
   LOGPRINT( LVL_ALRT, "Logging started" );
 
   //
   // Collection Loop
   //
+  // Sample on wall clock aligned boundaries ( e.g. every
+  // 10 seconds on :00, :10, ... ) and write a MET record on
+  // every samplesBeforeMETUpdate'th boundary ( e.g. on the
+  // minute ).
+  if ( initPeriodicTimer( &sampleTimer, opts.minTimeBetweenSamples, 0 ) < 0 )
+  {
+    LOGPRINT( LVL_EMRG, "wsMonitor(): Bad minTimeBetweenSamples %d!",
+              opts.minTimeBetweenSamples );
+    cleanup( FAILURE );
+  }
+  metPeriod = (long)opts.samplesBeforeMETUpdate * opts.minTimeBetweenSamples;
+  if ( metPeriod < opts.minTimeBetweenSamples )
+    metPeriod = opts.minTimeBetweenSamples;
+  nextMetTime = ( ( sampleTimer.next + metPeriod - 1 ) / metPeriod ) * 
+                metPeriod;
+
   for (;;)
   {
-    // Record the time
-    time( &nowTimeT );  
+    // Wait for the next sample time.  The S9 streams 
+    // continuously, so keep its parser fed while we wait
+    // rather than flushing the port ( and landing mid-record )
+    // at sample time.
+    if ( hasSerialDevice( S9VAISALA ) > 0 )
+    {
+      while ( ( waitMs = msUntilPeriodicTimer( &sampleTimer ) ) > 0 &&
+              drainS9Port( windPort, &s9Parser, waitMs ) >= 0 )
+        ;
+    }
+    if ( ( skipped = waitPeriodicTimer( &sampleTimer ) ) > 0 )
+      LOGPRINT( LVL_WARN, "wsMonitor(): Sampling overran, skipped %d "
+                "sample(s) ( %lu overruns so far, latest wake up %ld ms "
+                "late ).", skipped, sampleTimer.numOverruns, 
+                sampleTimer.lastLateness );
+    else if ( skipped < 0 )
+    {
+      LOGPRINT( LVL_WARN, "wsMonitor(): Sample timer failed!" );
+      sleep( opts.minTimeBetweenSamples );
+    }
+
+    // Samples are stamped with the time they were scheduled
+    nowTimeT = sampleTimer.fired;
     nowTM = localtime( &nowTimeT );
 
     // Check to see if we need to create a MET archive
     if ( ( nowTimeT - timeLastArchiveCreated ) > (opts.weatherArchiveDownloadPeriod * 60) )
     {
-      // Time to close the MET file and reopen a new one
-      fclose( fpWeather );
-
-      updateDataDir();
-      
-      // Move the temporary file into a new MET file
-      sprintf( dataLogFile,"%s/%s%04d%02d%02d%02d%02d.MET", 
-           opts.dataSubDirName,
-           opts.weatherDataPrefix,
-           nowTM->tm_year + 1900, nowTM->tm_mon + 1, nowTM->tm_mday,
-           nowTM->tm_hour, nowTM->tm_min );
-
+      // Time to move the temporary file into a new MET file
+      // and start another
+      makeMetFileName( dataLogFile, nowTimeT );
       LOGPRINT( LVL_ALRT, "Creating %s.", dataLogFile );
-      rename( "/usr/local/orcaD/data/tmpMetFile", dataLogFile );
-
-      if ( ( fpWeather = fopen("/usr/local/orcaD/data/tmpMetFile", "w" ) ) 
-            == NULL )
+      if ( ( rotated = rotateDataWriter( &metWriter, dataLogFile ) ) < 0 &&
+           metWriter.fd < 0 )
       {     
         LOGPRINT( LVL_ALRT, "Could not open up a new weather file!");
         cleanup( FAILURE );
       }
-      fprintf( fpWeather,"%s", fileHeader);
-      fflush( fpWeather );
+      // If the rename failed the samples stay in the temporary
+      // file, so the binary archive must stay with them
+      if ( rotated >= 0 )
+      {
+        saveMetArchive( dataLogFile );
+        openMetArchive( fileHeader, DATAWRITER_CREATED, NULL );
+      }
 
       timeLastArchiveCreated = nowTimeT;
     }
@@ -571,338 +1707,54 @@ int wsMonitor( )
 	       opts.solarCalibrationConstant) ; 
     }
 
-    sradTotal += PARumolPerMeterSquared;
-    sradCount++;
+    metStatsAddPAR( &stats, nowTimeT, PARumolPerMeterSquared );
+    publishReading( BUS_PAR, PARumolPerMeterSquared );
 
     wData.numSamples++;
 
-    if ( wData.numSamples == opts.samplesBeforeMETUpdate )
+    if ( nowTimeT >= nextMetTime )
     {
+      nextMetTime = ( nowTimeT / metPeriod + 1 ) * metPeriod;
+
       // Read from the met/wind device(s)
       //  -- metPort/windPort
-
-      // METPAK Data
       //
-      // Example: <STX>Q,,,1010.3,036.0,+027.6,+011.1,,+9998.0007,+9998.0005,0000.000,+12.0,0B,<EXT>11<CRLF>      //
-      //
-      // Columns:
-      // NODE,DIR,SPEED,PRESS,RH,TEMP,DEWPOINT,PRT,AN1,AN2,DIG1,VOLT,STATUS,CHECK
-      // Note: columns are comma separated, missing values are empty fields between commas
-      //   <STX>: start of string (ASCII value 2)
-      //   Node PollAddress: Q by default
-      //   Wind Direction: degrees, valid only if anemometer is installed
-      //   WindSpeed   : meters/second, valid only if anemometer is installed
-      //   Barometric Pressure: hectoPascals
-      //   Relative Humidity: percent
-      //   Air Temperature: degrees Celcius
-      //   Dewpoint: degrees Celcius
-      //   Platinum Resistive Temperature: valid only if PRT is installed
-      //   Analog voltage 1: auxiliary analog channel
-      //   Analog voltage 2: auxiliary analog channel
-      //   Digital signal 1: auxiliary digital channel
-      //   Source voltage: volts
-      //   Status: 
-      //   Checksum:
-
-      // Flush and resync ourselves on a line
-      term_flush( metPort );
-      serialPutLine( metPort, "?Q" );
-      // TODO: Figure out what this really is
-      if ( serialGetLine( metPort, buffer, METBUFFLEN, 6000L, "\n" ) < 30 )
-      {
-        //LOGPRINT( LVL_EMRG, "GILLMETPAK buffer 1: %s", buffer );
-        if ( serialGetLine( metPort, buffer, METBUFFLEN, 1000L, "\n" ) < 30 )
-        {
-          //LOGPRINT( LVL_EMRG, "GILLMETPAK buffer 2: %s", buffer );
-          LOGPRINT( LVL_WARN, "Failed receiving after "
-                   "?Q command ( two attempts made )." );
-        }
-      }
-      
-      // parse buffer
-      // Save : barometer ( convert from hectoPascals to inches of mercury )
-      //      rel humdity, air temp, dewpoint
-      // 
-      // old conversion:  1 hectoPascal = 0.0296133971008484 inches of mercury
-      // According to the NIST Special Pub. 811 
-      //	(http://physics.nist.gov/cuu/pdf/sp811.pdf)
-      // 1 inhg = 3.38638 kilo Pascals = 33.8638 hectoPascals @ 0 deg C.
-      // 1 hectoPascal = 0.0295300586466965 inhg
-      // NOTE: using one scanf doesn't work with a CSV line with optional
-      //       values.  I.e "###,###,,####" would through off the scanf
-      //       pointers and it would terminate early.  Use strtok instead.
-      // <STX>Q
-      // Empty (<STX>Q)
-      token = strtok(buffer,",");
-      //// Empty ( optional WIND DIR )
-      ////token = strtok(NULL,",");
-      ////LOGPRINT( LVL_EMRG, "GILLMETPAK token 2: %s", token);
-      //// Empty ( optional WIND SPEED )
-      ////token = strtok(NULL,",");
-      ////LOGPRINT( LVL_EMRG, "GILLMETPAK token 3: %s", token);
-      // Barometric Pressure
-      token = strtok(NULL,",");
-      numScanned = sscanf(token,"%f", &(wData.inchesBarometricPressure));
-      if ( numScanned == 1 )
-        // convert from hectoPascals to inches of mercury
-        wData.inchesBarometricPressure *= 0.0295300586466965;
-      else
-        LOGPRINT( LVL_WARN, "Failed to parse barometic pressure from "
-               "metpak!" );
-      // Relative Humidity
-      token = strtok(NULL,",");
-      numScanned = sscanf(token,"%f", &(wData.pctHumidity));
-      if (numScanned != 1 )
-        LOGPRINT( LVL_WARN, "Failed to parse relative humidity from "
-               "metpak!" );
-      // Temperature
-      token = strtok(NULL,",");
-      numScanned = sscanf(token,"%f", &(wData.temperatureCelsius));
-      if (numScanned != 1 )
-        LOGPRINT( LVL_WARN, "Failed to parse temperature from "
-               "metpak!" );
-      // Dewpoint
-      token = strtok(NULL,",");
-      numScanned = sscanf(token,"%f", &(wData.dewpointCelsius));
-      if (numScanned != 1 )
-        LOGPRINT( LVL_WARN, "Failed to parse dewpoint from "
-               "metpak!" );
+      // Query every device up front and collect the replies
+      // concurrently.  Each device's sample is stamped with
+      // the time its reply completed.
+      numReaders = 0;
+      if ( metPort > 0 )
+        startMetReader( &metReaders[numReaders++], metPort, GILLMETPAK );
+      if ( hasSerialDevice( RMYOUNGWIND ) > 0 )
+        startMetReader( &metReaders[numReaders++], windPort, RMYOUNGWIND );
+      else if ( hasSerialDevice( S9VAISALA ) > 0 )
+        startMetReader( &metReaders[numReaders++], windPort, S9VAISALA );
+      pollMetReaders( metReaders, numReaders );
 
       // Indicate 
       windCompass = 0;
-      if ( hasSerialDevice( RMYOUNGWIND ) > 0 )
+      for ( i = 0; i < numReaders; i++ )
       {
-
-        // WIND/COMPASS Data
-        //
-        // Example: A 0000 3470 0000 0000 0007 0008 3520 3550
-        //
-        //
-        // Columns:
-        //   PollAddress : Address of the 32500 RM Young compass unit
-        //   WindSpeed   : Wind speed from the 85106 RM Young Anemometer in RAW counts.
-        //                 NOTE: This needs to be converted to units using the
-        //                       following conversion factors.  Note...the wrong conversions
-        //			were used originally, from an outdated manual, specifically we used
-        //			the conversion 0.09526 for counts to knots instead of 0.1943.  Old 
-        // 			conversions are listed below for reference purposes, with new conversions
-        //			listed below.
-        //                         m/s: 0.04903 (old)
-        //                         mph: 0.1097 (old)
-        //                         knots: 0.09526 (old)
-        //                         km/hr: 0.1765 (old)
-        //			correct conversions (from manual 35200-90S)
-        // 			m/s: 0.1000 (new)
-        //			mph: 0.2237 (new)
-        //			knots: 0.1943 (new)
-        //			km/hr: 0.3600 (new)
-        //   CorrectedWindDirection*10 : Wind direction from anemomter corrected using the
-        //                               electronic compass, multplied by 10.
-        //   VIN1         : Unused voltage input.
-        //   VIN2         : Unused voltage input.
-        //   VIN3         : Voltage from anemomter V1.
-        //   VIN4         : Voltage form anemomter V2.
-        //   CompassDirection*10 :  Compass direction in degrees, multplied by 10.
-        //   UncorrectedWindDirection : Wind direction relative to centerline in degrees, multiplied by 10.
-        term_flush( windPort );
-        serialPutLine( windPort, "MA!" );
-        // TODO: Figure out what this really is
-        if ( serialGetLine( windPort, buffer, METBUFFLEN, 1000L, "\n" ) < 10 )
-          if ( serialGetLine( windPort, buffer, METBUFFLEN, 1000L, "\n" ) < 10 )
-             LOGPRINT( LVL_WARN, "Failed receiving after "
-                "MA! command ( two attempts made )." );
-
-
-        // parse buffer and save into wData
-        instWindSpeed = 0;
-        instWindDirectionTrue = 0;
-        instWindDirectionCenterline = 0;
-        compassDir = 0;
-        LOGPRINT( LVL_DEBG, "buffer line: %s", buffer);
-        numScanned = sscanf(buffer,
-                          "A %4d %4d %4d %4d %4d %4d %4d %4d ", 
-          &instWindSpeed, &instWindDirectionTrue,
-          &dummyInt, &dummyInt, &dummyInt, &dummyInt, &compassDir,
-          &instWindDirectionCenterline );
-
-        // convert from raw counts to knots
-        wData.instWindSpeed = (float)instWindSpeed * 0.1943;
-	 LOGPRINT( LVL_DEBG, "wind speed: %f vs %d", wData.instWindSpeed, instWindSpeed);
-
-        // convert true wind direction to degrees by dividing by 10.  
-	wData.instWindDirectionTrue = ((float)instWindDirectionTrue / 10);
-	 LOGPRINT( LVL_DEBG, "wind direction: %f vs %d", wData.instWindDirectionTrue, instWindDirectionTrue);
-
-        // convert compass reading to degrees by dividing by 10
-        wData.compassDir = (float)compassDir / 10;
-	 LOGPRINT( LVL_DEBG, "compass: %f vs %d", wData.compassDir, compassDir);
-
-        // convert centerline wind direction to degrees by dividing by 10
-        wData.instWindDirectionCenterline =  (float)instWindDirectionCenterline / 10;
-	 LOGPRINT( LVL_DEBG, "wind direction centerline: %f vs %d", wData.instWindDirectionCenterline, instWindDirectionCenterline);
-
-        windCompass = 1;
-      } // END RMYOUNGWIND LOOP
-      
-      if ( hasSerialDevice( S9VAISALA ) > 0 )
-      {
-        // WIND/COMPASS Data
-        //
-        // Example: 
-	//     <creport v='1' t='11'>
-	//     <S9CD v='1'>185.10,59.65,502,6.93,-86.19,86.20,17.72,1,3</S9CD>
-	//     <S9CRD v='1'>-303.33, -398.67, 50.00, -127.67, -1042.67, 69.67, -36.00,  3</S9CRD>
-	//     <PORT1>
-       	//            $999.00,999.00,999.00,999.00,00.00,99.90,0,0,0,0,13.0
-	//     </PORT1>
-	//     </creport>
-        //
-        //  S9CD = processed data from Soundnine compass module
-	//	<S9CD v='1'>185.10,59.65,502,6.93,-86.19,86.20,17.72,1,3</S9CD>
-	//	PSI, INC, MAG, THETA, PHI, TILT, TEMP, RATE, NS
-	// 	        PSI: compass heading (rotation around z axis), degrees
-	//		     *** saved as wData.CompassDir
-	// 		INC: Angle of the magnetic vector from the XY plane, degrees
-	//		MAG: Magnitude of the magnetic vector, gauss
-	//		THETA: Rotation around y axis, degrees
-	//		PHI: Rotation around the x axis, degrees
-	//		TILT: Angle of the acceleration vector from the XY plane
-	//		TEMP: Approximate sensor temperature, degrees C
-	//		RATE: Sensor sampling rate, Hz
-	//		NS: Number os samples in current sample period.  The number of seconds
-	//		    in the sample period = NS/RATE
-	//  S9CRD = raw data from Soundnine compass module
-	//	 <S9CRD v='1'>-303.33, -398.67, 50.00, -127.67, -1042.67, 69.67, -36.00,  3</S9CRD>
-	//		MX: Raw magnetometer x value, gauss
-	//		MY: Raw magnetometer y value, gauss
-	//		MZ: Raw magnetometer z value, gauss
-	//		AX: Raw accelerometer x value, (g)
-	//		AY: Raw accelerometer y value, (g)
-	//		AZ: Raw accelerometer z value, (g)
-	//		TEMP: Approximate sensor temperature, degrees C
-	//		NS: Number os samples in current sample period.  The number of seconds
-	//		    in the sample period = NS/RATE
-	//		
-	//  PORT1 = data from Vaisala anemomoeter
-	//	<PORT1> 
-	//	       $999.00,999.00,999.00,999.00,00.00,99.90,0,0,0,0,13.0
-	//	</PORT1>
-	//		WS: Wind speed, average, m/s
-	//		    *** saved as wData.instWindSpeed
-	//		WM: Wind speed, minimum, m/s
-	//		WP: Wind speed, maximum, m/s
-	//		WD: Wind direction, average, degrees
-	//		    *** saved as wData.instWindDirectionCenterline
-	//		DM: Wind direction minimum, average, degrees
-	//		DX: Wind direction maximum, average, degrees
-	//		GU: Wind gust speed, m/s
-	//		TS: Sonic temperature, degrees C
-	//		VA: Validity of the measurement data
-	//			0 = Unable to measure
-	//			1 = Valid wind measurement data
-	//		FS: Error codes:
-	//			0 = no error
-	//			1 = Wind speed exceeds operating limits
-	//			2 = Sonic temperature exceed operating limits
-	//			3 = Wind speed and sonic temp exceed operating limits
-	//		VI: Supply voltage, volts		
-	//	
-        // 
-        //  
-      	// Read buffer from S9
-        term_flush( windPort );
-
-        // 
-        // Theory: Each time we loop through here we parse 1 sentence from the
-        //         serial port.  2/3rds of the time we ignore the sentence.
-	// 	   We cycle through 6 times to read an entire record.
-	//
-	for ( i = 0; i < 6; i++ ) {
-	  LOGPRINT( LVL_DEBG, "mark 1: iteration: %d", i);
-          if ( serialGetLine( windPort, buffer, METBUFFLEN, 1000L, "\n" ) < 5 )       
-            if ( serialGetLine( windPort, buffer, METBUFFLEN, 1000L, "\n" ) < 5 )
-               LOGPRINT( LVL_WARN, "Failed receiving data "
-                  "from S9 device ( two attempts made )." );
-	       LOGPRINT( LVL_DEBG, "weatherd: Entering S9 loop, ready to read buffer.");
-	       int stype = S9GetSentenceType ( buffer );
-	       LOGPRINT( LVL_DEBG, "mark 2: iteration: %d", i);
-	       LOGPRINT( LVL_DEBG, "buffer line: %s", buffer);
-	       switch( stype )
-	       {
-	         case CREPORT:
-	           // ignore this data line for now
-                  LOGPRINT( LVL_DEBG, "weatherd: Read CREPORT, ignoring." );
-		  LOGPRINT( LVL_DEBG, "mark 3: iteration: %d", i);
-                  break;
-
-	         case S9CD:
-	         LOGPRINT( LVL_DEBG, "weatherd: Read S9CD, processing..." );
-		 LOGPRINT (LVL_DEBG, "buffer line: %s", buffer);
-	         numScanned = sscanf(buffer, "<S9CD v='1'>%f,%f,%d,%f,%f,%f,%f,%d,%d</S9CD>",
-		    &(wData.compassDir), &(wData.INC), &(wData.MAG), &(wData.THETA),
-	    	    &(wData.PHI), &(wData.TILT), &(wData.TEMP), &(wData.RATE), &(wData.NS) );
-		 LOGPRINT (LVL_DEBG, "Compass: %f", wData.compassDir);
-		 LOGPRINT( LVL_DEBG, "mark 4: iteration: %d", i);
-	         break;
-
-	         case S9CRD:
-	          // ignore this data line for now
-	          LOGPRINT( LVL_DEBG, "weatherd: Read S9CRD, ignoring." );
-		  LOGPRINT( LVL_DEBG, "mark 5: iteration: %d", i);
-	          break;
-
-	         case PORT1:
-	 	   LOGPRINT( LVL_DEBG, "weatherd: Read PORT1, processing...");
-	            if ( serialGetLine( windPort, buffer, METBUFFLEN, 1000L, "\n" ) < 10 )
-	              if ( serialGetLine( windPort, buffer, METBUFFLEN, 1000L, "\n" ) < 10 )
-           	        LOGPRINT( LVL_WARN, "Failed receiving data after <PORT1> tag ( two attempts made )." );
-			LOGPRINT (LVL_DEBG, "buffer line: %s", buffer);
-                        numScanned = sscanf(buffer, "$%f,%f,%f,%f,%f,%f,%f,%f,%d,%d,%f",
-                           &(wData.instWindSpeed), &(wData.WM), &(wData.WP), &(wData.instWindDirectionCenterline),
-                           &(wData.DM), &(wData.DX), &(wData.GU), &(wData.TS), &(wData.VA), &(wData.FS),
-		           &(wData.VI) );
-			LOGPRINT (LVL_DEBG, "windSpeed: %f, windDirection: %f",wData.instWindSpeed, wData.instWindDirectionCenterline); 
-	 	   LOGPRINT( LVL_DEBG, "mark 6: iteration: %d", i);
-	           break;
-
-	         case PORT1END:
-		   // ignore this data line for now
-                   LOGPRINT( LVL_DEBG, "weatherd: Read PORT1END, ignoring." );
-		   LOGPRINT( LVL_DEBG, "mark 7: iteration: %d", i);
-                   break;
-              
-                 case CREPORTEND:
-		   // ignore this date line for now
-                   LOGPRINT( LVL_DEBG, "weatherd: Read CREPORTEND, ignoring." );
-		   LOGPRINT( LVL_DEBG, "mark 8: iteration: %d", i);
-                   break;
-
-                 default:                   
-                  LOGPRINT( LVL_DEBG, "weatherd: Unknown sentence: %s", buffer );
-		  LOGPRINT( LVL_DEBG, "mark 9: iteration: %d", i);
-		  wData.instWindSpeed = 999;
-		  wData.instWindDirectionCenterline = 999;
-                  break;
-
-	       }; // switch(...
-	}; // for ( i = 0; i < 6...  
-
-        LOGPRINT( LVL_DEBG, "weatherd: S9 buffer parse complete." );
-       if (wData.instWindSpeed < 900 )
-       {
-         wData.instWindDirectionTrue = wData.instWindDirectionCenterline + wData.compassDir;
-	 if ( wData.instWindDirectionTrue < 0 )
-	   wData.instWindDirectionTrue = 360 + wData.instWindDirectionTrue;
-         if (wData.instWindDirectionTrue > 360 )
-	   wData.instWindDirectionTrue = wData.instWindDirectionTrue - 360;
-         windCompass = 1;
-       }else
-       {
-	 windCompass = 0;
-       }
-	
-
-      } // END S9VAISALA LOOP
+        switch ( metReaders[i].deviceType )
+        {
+          case GILLMETPAK:
+            parseMetpakSample( &metReaders[i], &wData );
+            break;
+          case RMYOUNGWIND:
+          case S9VAISALA:
+            if ( metReaders[i].deviceType == RMYOUNGWIND )
+              ret = parseRMYoungSample( &metReaders[i], &wData );
+            else
+              ret = parseS9Sample( &metReaders[i], &wData );
+            if ( ret == SUCCESS )
+              windCompass = 1;
+            break;
+        }
+        LOGPRINT( LVL_DEBG, "wsMonitor(): Device %d sample %s at %ld.",
+                  metReaders[i].deviceType,
+                  metReaders[i].done ? "completed" : "timed out",
+                  (long)metReaders[i].sampleTime );
+      }
 
       if (windCompass == 1 )
       {
@@ -919,14 +1771,12 @@ int wsMonitor( )
         //
         // vectorize wind speed and direction to allow for averaging
         //
-        // convert from weather coordinates to math coordinates
-        math_degT = 270 - wData.instWindDirectionTrue;
-        if (math_degT < 0 )
-	  math_degT += 360;
-        // convert from degrees to radians
-        rad = math_degT * ((double)3.14159 /(double) 180.0 );
-        wData.instU = wData.instWindSpeed * cos(rad);
-        wData.instV = wData.instWindSpeed * sin(rad);
+        metWindVector( wData.instWindSpeed, wData.instWindDirectionTrue,
+                       &instU, &instV );
+        wData.instU = instU;
+        wData.instV = instV;
+        metStatsAddWind( &stats, wData.instWindSpeed, 
+                         wData.instWindDirectionTrue );
       }else
       {
        // Set some rational defaults to indicate problems with instrument or lack of instrument.
@@ -939,7 +1789,6 @@ int wsMonitor( )
 	 wData.instWindDirectionTrue = -555;
       }
 
-      time( &nowTimeT );  
       nowTM = localtime( &nowTimeT );
       nowStr[0] = '\0';
       if ( strftime( nowStr, 80, "%m/%d/%Y %H:%M:%S", nowTM ) 
@@ -949,7 +1798,7 @@ int wsMonitor( )
               "%s: wsMonitor(): Could not format the time!", Name );
         nowStr[0] = '\0';
       }
-      fprintf( fpWeather, "%s\t%.3f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t"
+      printDataWriter( &metWriter, "%s\t%.3f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t"
              "%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%0.2f\t%0.2f\n",
           nowStr,
           wData.inchesBarometricPressure,
@@ -961,30 +1810,55 @@ int wsMonitor( )
           wData.maxWindSpeedDirectionCenterline,
           wData.maxWindSpeed,
           PARumolPerMeterSquared,
-          sradTotal/sradCount,
+          metAccumMean( &(stats.window[METWIN_MET].par), 0.0 ),
           wData.latitude, 
           wData.longitude, wData.compassDir, wData.instWindDirectionTrue );
-      fflush(fpWeather);
 
-      // DEBUG
-      //printf("%s\twindSpeed=%.2f\twindDirection=%.2f\n", nowStr, wData.instWindSpeed,
-      //       wData.instWindDirectionTrue );
-      // END DEBUG
+      archiveValues[0] = wData.inchesBarometricPressure;
+      archiveValues[1] = wData.pctHumidity;
+      archiveValues[2] = wData.temperatureCelsius;
+      archiveValues[3] = wData.dewpointCelsius;
+      archiveValues[4] = wData.instWindDirectionCenterline;
+      archiveValues[5] = wData.instWindSpeed;
+      archiveValues[6] = wData.maxWindSpeedDirectionCenterline;
+      archiveValues[7] = wData.maxWindSpeed;
+      archiveValues[8] = PARumolPerMeterSquared;
+      archiveValues[9] = metAccumMean( &(stats.window[METWIN_MET].par), 0.0 );
+      archiveValues[10] = wData.latitude;
+      archiveValues[11] = wData.longitude;
+      archiveValues[12] = wData.compassDir;
+      archiveValues[13] = wData.instWindDirectionTrue;
+      // The archive marks missing values as NaN, not -555
+      for ( i = 0; i < NUMMETARCHIVEFIELDS; i++ )
+        if ( archiveValues[i] == -555 )
+          archiveValues[i] = NAN;
+      if ( metArchive.fp != NULL )
+        appendBinArchive( &metArchive, nowTimeT, archiveValues );
+
+      if ( metPort > 0 )
+      {
+        publishReading( BUS_BAROMETER, wData.inchesBarometricPressure );
+        publishReading( BUS_HUMIDITY, wData.pctHumidity );
+        publishReading( BUS_AIRTEMP, wData.temperatureCelsius );
+        publishReading( BUS_DEWPOINT, wData.dewpointCelsius );
+      }
+      if ( windCompass == 1 )
+      {
+        publishReading( BUS_WINDSPEED, wData.instWindSpeed );
+        publishReading( BUS_WINDDIRECTION, wData.instWindDirectionTrue );
+        publishReading( BUS_WINDCENTERLINE, 
+                        wData.instWindDirectionCenterline );
+        publishReading( BUS_COMPASS, wData.compassDir );
+      }
 
-      windSpeedTotal += wData.instWindSpeed;
-      windDirectionTrueTotal += wData.instWindDirectionTrue;
-      windVectorUTotal += wData.instU;
-      windVectorVTotal += wData.instV;
+      resetMetWindow( &(stats.window[METWIN_MET]), nowTimeT );
 
-      if ( wData.instWindSpeed > maxWindSpeed )
+      if ( metWindowDue( &(stats.window[METWIN_HOUR]), nowTimeT ) )
       {
-        maxWindSpeed = wData.instWindSpeed;
-        maxWindSpeedDirection = wData.instWindDirectionTrue;
-        // DEBUG
-        //printf("Setting Max: windSpeed=%.2f\twindDirection=%.2f\n", maxWindSpeed, 
-        //     maxWindSpeedDirection );
-        // END DEBUG
+        lastHour = stats.window[METWIN_HOUR];
+        resetMetWindow( &(stats.window[METWIN_HOUR]), nowTimeT );
       }
+
       instWeatherCounter++;
 
       if ( instWeatherCounter == opts.metUpdatesBeforeInstUpdate )
@@ -1005,68 +1879,38 @@ int wsMonitor( )
             nowStr[0] = '\0';
           }
  
-	// Average wind speed and direction vectors
-	u_mean =  windVectorUTotal / (float)instWeatherCounter;
-	v_mean =  windVectorUTotal / (float)instWeatherCounter;
-        // convert U and V components to radians and magnitude
-        NEWmag = sqrt(pow(u_mean,2) + pow(v_mean,2));
-	NEWrad = atan2(v_mean,u_mean);
-        // convert from radians to degrees
-	NEW_degT = ((double)180.0 / (double)3.14159 ) * NEWrad;
-        // convert from math coordinates to weather coordinates
-	NEW_degT += 180;
-
           fprintf( fpInstWeather,
            "%s\nbarometer = %.3f inches\nhumidity = %.1f %%\n"
-           "temperature = %.1f celsius\ndewPoint = %.1f celsius\n"
-           "windDirection = %.1f degrees\nwindSpeed = %.1f knots\n"
-           "maxWindDirection = %.1f degrees\nmaxWindSpeed = %.1f knots\n"
-           "PAR = %.1f umol/s*meter^2\navgPAR = %.1f umol/s*meter^2\n"
-           "compassDir = %0.1f degrees\n",
+           "temperature = %.1f celsius\ndewPoint = %.1f celsius\n",
               nowStr,
               wData.inchesBarometricPressure,
               wData.pctHumidity,
               wData.temperatureCelsius,
-              wData.dewpointCelsius,
-              // Changed the instWeather wind speed/direction to
-              // averages ( of metFile data ):
-              //wData.instWindDirectionTrue,
-              //wData.instWindSpeed,
-              //windDirectionTrueTotal / (float)instWeatherCounter,
-              NEW_degT,
-              windSpeedTotal / (float)instWeatherCounter,
-              maxWindSpeedDirection,
-              maxWindSpeed,
-              PARumolPerMeterSquared,
-              sradTotal / (float)sradCount, wData.compassDir );
+              wData.dewpointCelsius );
+          // Wind speed/direction are averages ( of metFile data ),
+          // the direction a vector average.
+          printStatusWindow( fpInstWeather, "", 
+                             &(stats.window[METWIN_STATUS]) );
+          fprintf( fpInstWeather,
+           "PAR = %.1f umol/s*meter^2\n"
+           "compassDir = %0.1f degrees\n",
+              PARumolPerMeterSquared, wData.compassDir );
+          if ( lastHour.start > 0 )
+            printStatusWindow( fpInstWeather, "hour", &lastHour );
           fflush(fpInstWeather);
           fclose( fpInstWeather );
         }
-        // DEBUG
-        //printf("Printing Max: windSpeed=%.2f\twindDirection=%.2f\n", maxWindSpeed, 
-        //     maxWindSpeedDirection );
-        // END DEBUG
 
         instWeatherCounter = 0;
-
-        windSpeedTotal = -1;
-        windDirectionTrueTotal = -1;
-        maxWindSpeed = -1;
-        maxWindSpeedDirection = -1;
+        resetMetWindow( &(stats.window[METWIN_STATUS]), nowTimeT );
       }
 
       clearCombinedWeatherData( &wData );
-      sradTotal = 0.0;
-      sradCount = 0;
-    } // if ( wData.numSamples ==  ......
-    else 
-    {
-      // Give a chance for other system tasks to run
-      // NOTE: This was more important on the bitsyX
-      //       series of computers. I am sure this
-      //       barely makes a difference on a RaspberryPi
-      sleep( opts.minTimeBetweenSamples );
-    }
+    } // if ( nowTimeT >= nextMetTime ) ......
+
+    // Write out the batched MET records if they are due
+    if ( flushDataWriter( &metWriter, 0 ) > 0 && metArchive.fp != NULL )
+      syncBinArchive( &metArchive, opts.dataSyncPolicy == DATASYNC_COMMIT );
 
     fflush(stderr);
     fflush(stdout);
@@ -1102,6 +1946,8 @@ int initialize() {
   opts.serialPorts = '\0';
   opts.missions = '\0';
   opts.compassDeclination = 0.0;
+  opts.dataCommitInterval = DATAWRITER_DEFAULT_INTERVAL;
+  opts.dataSyncPolicy = DATAWRITER_DEFAULT_SYNC;
 
   return( SUCCESS );
 }
@@ -1168,8 +2014,6 @@ int S9GetSentenceType ( const char *buff )
 
 void cleanup (int passed_signal)
 {   
-  time_t nowTimeT;
-  struct tm *nowTM;
   char dataLogFile[FILEPATHMAX];
   sigset_t block;
   sigset_t oblock;
@@ -1178,20 +2022,15 @@ void cleanup (int passed_signal)
   (void) sigfillset (&block);
   sigprocmask (SIG_SETMASK, &block, &oblock);
 
-  // Try and close the weather file
-  fclose( fpWeather );
-
-  // Move the temporary file into a new MET file
-  updateDataDir();
-                  
-  time( &nowTimeT );  
-  nowTM = localtime( &nowTimeT );
-  sprintf( dataLogFile,"%s/%s%04d%02d%02d%02d%02d.MET", opts.dataSubDirName,
-           opts.weatherDataPrefix,
-           nowTM->tm_year + 1900, nowTM->tm_mon + 1, nowTM->tm_mday,
-           nowTM->tm_hour, nowTM->tm_min );
-  LOGPRINT( LVL_ALRT, "Saving data to %s.", dataLogFile );
-  rename( "/usr/local/orcaD/data/tmpMetFile", dataLogFile );
+  // Write out what is batched and move the temporary file 
+  // into a new MET file
+  if ( metWriter.fd >= 0 )
+  {
+    makeMetFileName( dataLogFile, time( NULL ) );
+    LOGPRINT( LVL_ALRT, "Saving data to %s.", dataLogFile );
+    closeDataWriter( &metWriter, dataLogFile );
+    saveMetArchive( dataLogFile );
+  }
 
   // Not really necessary
   //ftdi_usb_close(ftdic);
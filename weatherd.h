@@ -24,7 +24,10 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <time.h>
 #include "term.h"
+#include "metstats.h"
+#include "binarchive.h"
 
 /* S9SentenceTypes Enumeration
  *
@@ -54,6 +57,132 @@ static const char *S9SentenceNames[] = {
 
 const int numSentenceTypes = 6;
 
+#define METBUFFLEN 256
+#define MAXMETREADERS 3
+
+// GILL METPAK "?Q" reply columns ( counting the node as 0 )
+#define METPAK_MAXFIELDS 16
+#define METPAK_PRESS     3
+#define METPAK_RH        4
+#define METPAK_TEMP      5
+#define METPAK_DEWPOINT  6
+
+// R.M. Young "MA!" reply: the address and eight values
+#define RMYOUNG_NUMFIELDS 9
+
+// Most values in any S9 block
+#define S9MAXFIELDS 16
+
+/* metWindows Enumeration
+ *
+ * The averaging windows kept by wsMonitor: one per
+ * MET file line, one per weather-status.dat update
+ * and a timed hour.
+ *
+ */
+enum metWindows {
+  METWIN_MET,
+  METWIN_STATUS,
+  METWIN_HOUR,
+  NUMMETWINDOWS
+};
+
+/* metReader
+ *
+ * Per-device state used to collect one sample from
+ * each met device concurrently.  Lines are assembled
+ * from the port in partial[] and the reply is kept
+ * in line[].  sampleTime is when the device's sample
+ * completed.
+ *
+ */
+struct metReader {
+  int fd;
+  int deviceType;
+  long timeout;           // milliseconds
+  int done;
+  int timedOut;
+  char line[METBUFFLEN];
+  int partialLen;
+  char partial[METBUFFLEN];
+  time_t sampleTime;
+};
+
+
+/* S9ParserStates Enumeration
+ *
+ * Where the S9 stream parser is within the
+ * <creport> ... </creport> record.
+ *
+ */
+enum S9ParserStates {
+  S9_IDLE,
+  S9_REPORT,
+  S9_PORT1
+};
+
+/* s9Record
+ *
+ * One complete Soundnine/Vaisala report: the S9CD
+ * processed compass data, the S9CRD raw compass
+ * data and the PORT1 anemometer data.  completed is
+ * when the </creport> tag was received.
+ *
+ */
+struct s9Record {
+  int haveS9CD;
+  float PSI;
+  float INC;
+  int MAG;
+  float THETA;
+  float PHI;
+  float TILT;
+  float TEMP;
+  int RATE;
+  int NS;
+  int haveS9CRD;
+  float MX;
+  float MY;
+  float MZ;
+  float AX;
+  float AY;
+  float AZ;
+  float rawTEMP;
+  int rawNS;
+  int havePORT1;
+  float WS;
+  float WM;
+  float WP;
+  float WD;
+  float DM;
+  float DX;
+  float GU;
+  float TS;
+  int VA;
+  int FS;
+  float VI;
+  time_t completed;
+};
+
+/* s9Parser
+ *
+ * Incremental parser for the continuous S9 stream.
+ * Blocks are decoded into pending as they arrive and
+ * a whole record is copied to latest ( and fresh is
+ * set ) when the report closes.
+ *
+ */
+struct s9Parser {
+  int state;
+  int lineLen;
+  int overflow;
+  char line[METBUFFLEN];
+  struct s9Record pending;
+  struct s9Record latest;
+  int fresh;
+  unsigned long numRecords;
+  unsigned long numDiscarded;
+};
 
 struct s_WMDA {
   float barsBarometricPressure;
@@ -134,6 +263,8 @@ struct s_CombinedWeatherData {
   int VA;
   int FS;
   float VI;
+  time_t metSampleTime;
+  time_t windSampleTime;
 };
 
 int initialize();
@@ -141,6 +272,25 @@ int wsMonitor();
 void clearCombinedWeatherData( struct s_CombinedWeatherData * wData );
 void processCommandLine(int argc, char *argv[] );
 int S9GetSentenceType( const char *buff );
+void initS9Parser( struct s9Parser *parser );
+int parseS9Fields( char *line, const char *types, ... );
+void s9ParseLine( struct s9Parser *parser, char *line );
+int s9ParserAddData( struct s9Parser *parser, const char *data, int len );
+int drainS9Port( int fd, struct s9Parser *parser, long timeout );
+void printStatusWindow( FILE *fp, char *prefix, struct metWindow *window );
+void startMetReader( struct metReader *reader, int fd, int deviceType );
+int metReaderAddLine( struct metReader *reader, char *line );
+int pollMetReaders( struct metReader *readers, int numReaders );
+int parseMetpakSample( struct metReader *reader, 
+                       struct s_CombinedWeatherData *wData );
+int parseRMYoungSample( struct metReader *reader,
+                        struct s_CombinedWeatherData *wData );
+int parseS9Sample( struct metReader *reader,
+                   struct s_CombinedWeatherData *wData );
+int openMetArchive( const char *fileHeader, int writerState,
+                    const char *recoverName );
+void saveMetArchive( const char *dataLogFile );
+void makeMetFileName( char *dataLogFile, time_t when );
 void cleanup_TERM();
 void cleanup_QUIT();
 void cleanup_INT();
@@ -37,6 +37,41 @@
 #include "meterwheel.h"
 #include "buoy.h"
 #include "winch.h"
+#include "ctdstream.h"
+#include "profile.h"
+#include "readingbus.h"
+
+
+//
+// NAME
+//   publishWinchStatus - Share the winch loop readings.
+//
+// SYNOPSIS
+//   static void publishWinchStatus( double pressure, double pressureDepth,
+//                                   float meterWheelDepth, float extbatt,
+//                                   int relays );
+//
+// DESCRIPTION
+//   Publish the readings taken on each pass of the critical
+//   loops below.  Only the reading bus is written, which never
+//   blocks.  relays is the RELAY_* state read before the loop
+//   started.  Failed ( negative ) readings are not published.
+//
+static void publishWinchStatus( double pressure, double pressureDepth,
+                                float meterWheelDepth, float extbatt,
+                                int relays )
+{
+  if ( pressure >= 0 )
+  {
+    publishReading( BUS_PRESSURE, pressure );
+    publishReading( BUS_DEPTH, pressureDepth );
+  }
+  if ( meterWheelDepth >= 0 )
+    publishReading( BUS_METERWHEEL, meterWheelDepth );
+  if ( extbatt >= 0 )
+    publishReading( BUS_EXTBATTERY, extbatt );
+  publishReading( BUS_RELAYS, relays );
+}
 
 
 //
@@ -111,6 +146,8 @@ int movePackageUpDiscretely ( int hydroFD, int hydroDeviceType,
             "movePackageUpDiscretely(): pres=%6.2fdb prdp=%6.2fm mwdp=%6.1f "
             "ipwr=%4.1fv epwr=%4.1fv", pressure, pressureDepth,
             meterWheelDepth, intbatt, extbatt );
+    publishPackageStatus( pressure, pressureDepth, meterWheelDepth,
+                          intbatt, extbatt );
 
    
     //
@@ -119,7 +156,7 @@ int movePackageUpDiscretely ( int hydroFD, int hydroDeviceType,
     LOGPRINT( LVL_INFO,
               "movePackageUpDiscretely(): Sleeping for %d seconds for sensor "
               "equilibration.", equilibrationTime );
-    sleep( equilibrationTime );
+    sleepCTDStream( hydroFD, equilibrationTime );
     LOGPRINT( LVL_CRIT,
               "movePackageUpDiscretely(): Meter Wheel Adjusted Count = %f "
               "meters", meterWheelDepth );
@@ -197,6 +234,7 @@ int movePackageUp ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, int
   double Pm4 = 0, Pm3 = 0, Pm2 = 0, Pm1 = 0;
   int mCntStatic = 0;
   int mPresStatic = 0;
+  int relays = 0;
 
 
   LOGPRINT( LVL_VERB, 
@@ -235,6 +273,11 @@ int movePackageUp ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, int
 
     LOGPRINT( LVL_DEBG, "movePackageUp(): Entering critical loop!" );
 
+    // The loop below must not wait on the I/O board, so the
+    // relay state for the reading bus is read up front.
+    if ( readingBus != NULL )
+      relays = getRelayStatus() | RELAY_WINCH | RELAY_WINCHUP;
+
     //*******************************************************************
     //          C R I T I C A L   S E C T I O N   S T A R T
     //
@@ -282,6 +325,8 @@ int movePackageUp ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, int
       LOGPRINT( LVL_VERB, "movePackageUp(): critical loop pressureDepth = "
                           "%f, meterWheelDepth = %f, extVolts = %f;", 
                           pressureDepth, meterWheelDepth, tmpVolts );
+      publishWinchStatus( pressure, pressureDepth,
+                          mwPort ? meterWheelDepth : -1, tmpVolts, relays );
  
       // Check winch direction 
       if( i > 4 )
@@ -351,6 +396,7 @@ int movePackageUp ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, int
     //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
     //          C R I T I C A L   S E C T I O N   E N D
     //*******************************************************************
+    publishReading( BUS_RELAYS, relays & ~( RELAY_WINCH | RELAY_WINCHUP ) );
     LOGPRINT( LVL_DEBG, 
               "movePackageUp(): Exited critical loop, status = %d, "
               "pressureDepth = %6.2f, tgtDepth = %d", status, pressureDepth,
@@ -481,6 +527,7 @@ int movePackageDown ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, in
   double Pm4 = 0, Pm3 = 0, Pm2 = 0, Pm1 = 0;
   int mCntStatic = 0;
   int mPresStatic = 0;
+  int relays = 0;
 
   LOGPRINT( LVL_VERB, 
           "movePackageDown(): Called attempting to move package to %d meters", 
@@ -517,6 +564,11 @@ int movePackageDown ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, in
 
     LOGPRINT( LVL_DEBG, "movePackageDown(): Entering critical loop!" );
 
+    // The loop below must not wait on the I/O board, so the
+    // relay state for the reading bus is read up front.
+    if ( readingBus != NULL )
+      relays = ( getRelayStatus() & ~RELAY_WINCHUP ) | RELAY_WINCH;
+
     //*******************************************************************
     //          C R I T I C A L   S E C T I O N   S T A R T
     //
@@ -563,6 +615,8 @@ int movePackageDown ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, in
       LOGPRINT( LVL_VERB, "movePackageDown(): critical loop pressureDepth = "
                           "%f, meterWheelDepth = %f, extVolts = %f;", 
                           pressureDepth, meterWheelDepth, tmpVolts );
+      publishWinchStatus( pressure, pressureDepth,
+                          mwPort ? meterWheelDepth : -1, tmpVolts, relays );
  
       // Check winch direction 
       if( i > 4 )
@@ -634,6 +688,7 @@ int movePackageDown ( int hydroFD, int hydroDeviceType, struct sPort *mwPort, in
     //^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
     //          C R I T I C A L   S E C T I O N   E N D
     //*******************************************************************
+    publishReading( BUS_RELAYS, relays & ~( RELAY_WINCH | RELAY_WINCHUP ) );
     LOGPRINT( LVL_DEBG, 
               "movePackageDown(): Exited critical loop, status = %d, "
               "pressureDepth = %6.2f, tgtDepth = %d", status, pressureDepth,